@@ -6,9 +6,34 @@
 #ifndef TY_COORDINATE_MAPPER_H_
 #define TY_COORDINATE_MAPPER_H_
 
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include "TYApi.h"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define TY_MAPPER_X86
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#  include <immintrin.h>
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#  define TY_MAPPER_NEON
+#  include <arm_neon.h>
+#endif
+
+#if defined(TY_MAPPER_X86) && (defined(__GNUC__) || defined(__clang__))
+#  define TY_MAPPER_TARGET(isa) __attribute__((target(isa)))
+#else
+#  define TY_MAPPER_TARGET(isa)
+#endif
+
 typedef struct TY_PIXEL_DESC
 {
   int16_t x;      // x coordinate in pixels
@@ -150,6 +175,58 @@ static inline TY_STATUS TYMapDepthImageToColorCoordinate(
                   uint32_t mappedW, uint32_t mappedH, uint16_t* mappedDepth, 
                   float f_scale_unit = 1.0f);
 
+/// Depth pixel to color pixel projection, with the depth back projection, the extrinsic
+/// and the color intrinsic folded together. For depth pixel (u, v) with depth d:
+///   [x * w, y * w, w] = d * (c0 + u * du + v * dv) + t
+/// where (x, y) is the color pixel and w the depth in color camera, before f_scale_unit.
+typedef struct TYDepthToColorProjection
+{
+  float du[3];
+  float dv[3];
+  float c0[3];
+  float t[3];
+  float f_scale_unit;
+}TYDepthToColorProjection;
+
+/// @brief Fold depth_calib, color_calib extrinsic and color intrinsic into one projection.
+/// @param  [in]  depth_calib           Depth image's calibration data.
+/// @param  [in]  depthW                Width of current depth image.
+/// @param  [in]  depthH                Height of current depth image.
+/// @param  [in]  color_calib           Color image's calibration data.
+/// @param  [in]  mappedW               Width of target image.
+/// @param  [in]  mappedH               Height of target image.
+/// @param  [out] proj                  Output projection.
+/// @retval TY_STATUS_OK        Succeed.
+/// @retval TY_STATUS_ERROR     Extrinsic inversion failed.
+static inline TY_STATUS TYInitDepthToColorProjection(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t mappedW, uint32_t mappedH,
+                  TYDepthToColorProjection* proj,
+                  float f_scale_unit = 1.0f);
+
+/// @brief Fused version of TYMapDepthImageToColorCoordinate.
+///        Each depth pixel is back projected, transformed, projected and z-buffered in one
+///        streaming pass, without the intermediate point cloud. Pixels are placed with the
+///        same rounding as TYMapPoint3dToDepthImage, so the output matches the original
+///        function up to float rounding on pixel borders.
+/// @param  [in]  depth_calib           Depth image's calibration data.
+/// @param  [in]  depthW                Width of current depth image.
+/// @param  [in]  depthH                Height of current depth image.
+/// @param  [in]  depth                 Depth image.
+/// @param  [in]  color_calib           Color image's calibration data.
+/// @param  [in]  mappedW               Width of target depth image.
+/// @param  [in]  mappedH               Height of target depth image.
+/// @param  [in,out] mappedDepth        Output depth image, should be zero filled by caller.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYMapDepthImageToColorCoordinateFused(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t mappedW, uint32_t mappedH, uint16_t* mappedDepth,
+                  float f_scale_unit = 1.0f);
+
 /// @brief Create depth image to color coordinate lookup table.
 /// @param  [in]  depth_calib           Depth image's calibration data.
 /// @param  [in]  depthW                Width of current depth image.
@@ -193,6 +270,50 @@ static inline TY_STATUS TYMapRGBPixelsToDepthCoordinate(
 	TY_PIXEL_COLOR_DESC* dst,
 	float f_scale_unit = 1.0f);
 
+/// Color pixel to depth pixel projection, same layout as TYDepthToColorProjection with
+/// the two cameras swapped. For color pixel (u, v) at depth d in the color camera, the
+/// points (x, y) for all d form the epipolar line of (u, v) in the depth image.
+typedef TYDepthToColorProjection TYColorToDepthProjection;
+
+/// @brief Fold color_calib, its extrinsic and the depth intrinsic into one projection.
+///        Depends on calibration only, compute once and reuse for every frame.
+/// @param  [in]  color_calib           Color image's calibration data.
+/// @param  [in]  rgbW                  Width of RGB image.
+/// @param  [in]  rgbH                  Height of RGB image.
+/// @param  [in]  depth_calib           Depth image's calibration data.
+/// @param  [in]  depthW                Width of current depth image.
+/// @param  [in]  depthH                Height of current depth image.
+/// @param  [out] proj                  Output projection.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYInitColorToDepthProjection(
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t rgbW, uint32_t rgbH,
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  TYColorToDepthProjection* proj,
+                  float f_scale_unit = 1.0f);
+
+/// @brief Map RGB pixels to depth coordinate with a precomputed projection.
+///        Walks the depth pixels crossed by each pixel's epipolar line between min_distance and
+///        max_distance and keeps the one whose depth best agrees with the line, so a query costs
+///        about one step per crossed depth pixel instead of one projection per millimeter.
+/// @param  [in]  proj                  Projection from TYInitColorToDepthProjection.
+/// @param  [in]  depthW                Width of current depth image.
+/// @param  [in]  depthH                Height of current depth image.
+/// @param  [in]  depth                 Current depth image.
+/// @param  [in]  src                   Input RGB pixels info.
+/// @param  [in]  cnt                   Input src RGB pixels cnt
+/// @param  [in]  min_distance          The min distance, in depth image units.
+/// @param  [in]  max_distance          The longest distance, in depth image units.
+/// @param  [out] dst                   Output RGB pixels info, x and y are -1 when no depth pixel matches.
+/// @retval TY_STATUS_OK                Succeed.
+static inline TY_STATUS TYMapRGBPixelsToDepthCoordinate(
+                  const TYColorToDepthProjection* proj,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_PIXEL_COLOR_DESC* src, uint32_t cnt,
+                  uint32_t min_distance, uint32_t max_distance,
+                  TY_PIXEL_COLOR_DESC* dst);
+
 /// @brief Map original RGB image to depth coordinate RGB image.
 /// @param  [in]  depth_calib           Depth image's calibration data.
 /// @param  [in]  depthW                Width of current depth image.
@@ -270,6 +391,312 @@ static inline TY_STATUS TYMapMono8ImageToDepthCoordinate(
                   uint8_t* mappedMono,
                   float f_scale_unit = 1.0f);
 
+// ------------------------------
+//  registration context
+// ------------------------------
+
+class TYMapperWorkerPool;
+
+/// How the context mapping functions fetch source pixels, see TYRegistrationSetSampleMode.
+enum TYRegistrationSampleMode
+{
+  TY_REGISTRATION_SAMPLE_NEAREST    = 0,  // lut rescaled and rounded, same as the calibration based functions
+  TY_REGISTRATION_SAMPLE_BILINEAR   = 1,  // sub-pixel projection, 2x2 bilinear blend
+  TY_REGISTRATION_SAMPLE_EDGE_AWARE = 2,  // bilinear, skipping neighbours unlike the nearest one
+};
+
+/// Occlusion test for depth to color lookup tables, see TYPixelsOcclusionResolve.
+/// A point is hidden when it lies farther than threshold + relative * depth behind
+/// the nearest point landing within radius pixels of it.
+typedef struct TYOcclusionParams
+{
+  uint32_t  radius;     // splat radius of each point in the z-buffer, in pixels
+  float     threshold;  // depth units
+  float     relative;   // fraction of the point depth added to threshold
+}TYOcclusionParams;
+
+/// @brief Remove hidden points from a depth to color lookup table in one z-buffer
+///        scatter pass plus one check pass, without filling the z-buffer holes.
+///        Faster replacement of TYPixelsOverlapRemove, rejected entries are set the same
+///        way to (-1, -1, 0).
+/// @param  [in,out] lut                Lookup table, imageW x imageH target coordinates.
+/// @param  [in]  count                 Number of lut entries.
+/// @param  [in]  imageW                Width of target image.
+/// @param  [in]  imageH                Height of target image.
+/// @param  [in]  params                Occlusion test settings.
+/// @param  [out] zbuffer               Caller scratch, imageW x imageH.
+static inline void TYPixelsOcclusionResolve(TY_PIXEL_DESC* lut, uint32_t count,
+                  uint32_t imageW, uint32_t imageH,
+                  const TYOcclusionParams* params, uint16_t* zbuffer);
+
+/// Reusable state for color to depth registration.
+/// Created once for a (depth_calib, color_calib, depthW, depthH, f_scale_unit) tuple,
+/// it keeps the inverted extrinsic and all per-frame scratch buffers, so the
+/// context versions of TYMap*ImageToDepthCoordinate do not touch the heap.
+/// A context handles one frame at a time, see TYRegistrationSetThreadCount
+/// to spread that frame over several cores.
+typedef struct TYRegistrationContext
+{
+  TY_CAMERA_CALIB_INFO  depth_calib;
+  TY_CAMERA_CALIB_INFO  color_calib;
+  TY_CAMERA_EXTRINSIC   extri_inv;    // color_calib->extrinsic inverted, depth to color
+  uint32_t              depthW;
+  uint32_t              depthH;
+  float                 f_scale_unit;
+
+  TY_VECT_3F*           p3d;          // depthW * depthH points
+  TY_PIXEL_DESC*        lut;          // depthW * depthH depth to color lookup table
+  uint16_t*             zbuffer;      // depthW * depthH scratch for overlap removal
+
+  uint32_t              threads;      // row bands processed in parallel, 1 by default
+  TYMapperWorkerPool*   pool;         // threads - 1 persistent workers, NULL when threads is 1
+  uint32_t*             spill;        // depthW * depthH, per band lut indices landing outside the band
+  uint32_t*             spill_count;  // threads entries
+  TY_STATUS*            band_status;  // threads entries
+
+  int                   sample_mode;      // TYRegistrationSampleMode
+  uint32_t              edge_threshold;   // 8 bit units, for TY_REGISTRATION_SAMPLE_EDGE_AWARE
+
+  bool                  zbuffer_occlusion;  // TYPixelsOcclusionResolve instead of TYPixelsOverlapRemove
+  TYOcclusionParams     occlusion;
+}TYRegistrationContext;
+
+/// @brief Create a registration context and allocate all its scratch buffers.
+/// @param  [in]  depth_calib           Depth image's calibration data.
+/// @param  [in]  color_calib           Color image's calibration data.
+/// @param  [in]  depthW                Width of depth image.
+/// @param  [in]  depthH                Height of depth image.
+/// @param  [out] ctx                   Created context, release with TYDestroyRegistrationContext.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      Any depth_calib, color_calib or ctx is NULL.
+/// @retval TY_STATUS_INVALID_PARAMETER depthW or depthH is 0.
+/// @retval TY_STATUS_OUT_OF_MEMORY     Scratch buffer allocation failed.
+static inline TY_STATUS TYCreateRegistrationContext(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  TYRegistrationContext** ctx,
+                  float f_scale_unit = 1.0f);
+
+/// @brief Release a context created by TYCreateRegistrationContext.
+/// @param  [in]  ctx                   Context to release, NULL is ignored.
+static inline void TYDestroyRegistrationContext(TYRegistrationContext* ctx);
+
+/// @brief Set how many threads the context mapping functions use.
+///        The image is split in that many row bands, handled by a persistent worker pool
+///        plus the calling thread. Output is identical for every thread count.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  threads               Thread count, 0 for the number of cores.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx is NULL.
+/// @retval TY_STATUS_OUT_OF_MEMORY     Pool or band buffer allocation failed, ctx is left single threaded.
+static inline TY_STATUS TYRegistrationSetThreadCount(
+                  TYRegistrationContext* ctx, uint32_t threads);
+
+/// @brief Choose how source pixels are fetched by the context mapping functions.
+///        Nearest rounds the depth resolution lookup table, like the calibration based functions.
+///        Bilinear keeps the sub-pixel position of each point, projected straight to the source
+///        image size, and blends its 2x2 neighbours. Edge aware does the same but drops the
+///        neighbours differing from the nearest one by more than edge_threshold in any channel,
+///        so colors do not bleed across object borders.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  mode                  TYRegistrationSampleMode.
+/// @param  [in]  edge_threshold        Channel difference limit in 8 bit units, scaled by 257 for 16 bit images.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx is NULL.
+/// @retval TY_STATUS_INVALID_PARAMETER Unknown mode.
+static inline TY_STATUS TYRegistrationSetSampleMode(
+                  TYRegistrationContext* ctx, int mode,
+                  uint32_t edge_threshold = 24);
+
+/// @brief Choose how hidden points are removed from ctx->lut.
+///        By default the context matches the calibration based functions, which fill the
+///        z-buffer holes and reject points more than 10 depth units behind it. With params
+///        the single pass TYPixelsOcclusionResolve test is used instead.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  params                Occlusion test settings, NULL restores the default.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx is NULL.
+static inline TY_STATUS TYRegistrationSetOcclusion(
+                  TYRegistrationContext* ctx, const TYOcclusionParams* params);
+
+/// @brief Build ctx->lut from a depth image, with overlapped pixels removed.
+///        Shared first step of the context mapping functions below.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  depth                 Current depth image, ctx->depthW x ctx->depthH.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYRegistrationUpdateLookupTable(
+                  TYRegistrationContext* ctx, const uint16_t* depth);
+
+/// @brief Same as TYMapRGBImageToDepthCoordinate, using ctx buffers.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  depth                 Current depth image.
+/// @param  [in]  rgbW                  Width of RGB image.
+/// @param  [in]  rgbH                  Height of RGB image.
+/// @param  [in]  inRgb                 Current RGB image.
+/// @param  [out] mappedRgb             Output RGB image, ctx->depthW x ctx->depthH.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t rgbW, uint32_t rgbH, const uint8_t* inRgb,
+                  uint8_t* mappedRgb);
+
+/// @brief Same as TYMapRGB48ImageToDepthCoordinate, using ctx buffers.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  depth                 Current depth image.
+/// @param  [in]  rgbW                  Width of RGB48 image.
+/// @param  [in]  rgbH                  Height of RGB48 image.
+/// @param  [in]  inRgb                 Current RGB48 image.
+/// @param  [out] mappedRgb             Output RGB48 image, ctx->depthW x ctx->depthH.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t rgbW, uint32_t rgbH, const uint16_t* inRgb,
+                  uint16_t* mappedRgb);
+
+/// @brief Same as TYMapMono16ImageToDepthCoordinate, using ctx buffers.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  depth                 Current depth image.
+/// @param  [in]  rgbW                  Width of MONO16 image.
+/// @param  [in]  rgbH                  Height of MONO16 image.
+/// @param  [in]  gray                  Current MONO16 image.
+/// @param  [out] mappedGray            Output MONO16 image, ctx->depthW x ctx->depthH.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYMapMono16ImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t rgbW, uint32_t rgbH, const uint16_t* gray,
+                  uint16_t* mappedGray);
+
+/// @brief Same as TYMapMono8ImageToDepthCoordinate, using ctx buffers.
+/// @param  [in]  ctx                   Registration context.
+/// @param  [in]  depth                 Current depth image.
+/// @param  [in]  monoW                 Width of MONO8 image.
+/// @param  [in]  monoH                 Height of MONO8 image.
+/// @param  [in]  inMono                Current MONO8 image.
+/// @param  [out] mappedMono            Output MONO8 image, ctx->depthW x ctx->depthH.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYMapMono8ImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t monoW, uint32_t monoH, const uint8_t* inMono,
+                  uint8_t* mappedMono);
+
+// ------------------------------
+//  color resolution depth
+// ------------------------------
+
+/// Reusable state for depth to color registration at color resolution.
+/// Each depth sample is splatted over its footprint in the color image, the area one
+/// depth pixel covers there, instead of a single pixel, so upsampling VGA depth to a
+/// 4K color frame leaves no grid of holes. Holes left by occlusion or missing depth are
+/// filled row by row as soon as no later depth row can reach them.
+/// Depth rows can be pushed in bands while they arrive, output goes to a caller buffer.
+typedef struct TYDepthToColorContext
+{
+  TYDepthToColorProjection proj;
+  uint32_t              depthW;
+  uint32_t              depthH;
+  uint32_t              mappedW;
+  uint32_t              mappedH;
+  float                 f_scale_unit;
+  float                 footprint_limit;  // max footprint half size, in color pixels
+  float                 min_depth;        // depth units, expected range, decides when rows are final
+  float                 max_depth;
+  uint32_t              max_hole;         // longest hole run filled, in color pixels, 0 disables
+
+  uint16_t*             out;              // current frame, caller buffer
+  uint32_t              next_row;         // next depth row expected
+  uint32_t              final_rows;       // color rows [0, final_rows) receive no more samples
+}TYDepthToColorContext;
+
+/// @brief Create a context for color resolution depth output.
+/// @param  [in]  depth_calib           Depth image's calibration data.
+/// @param  [in]  color_calib           Color image's calibration data.
+/// @param  [in]  depthW                Width of depth image.
+/// @param  [in]  depthH                Height of depth image.
+/// @param  [in]  mappedW               Width of target depth image, usually the color image width.
+/// @param  [in]  mappedH               Height of target depth image.
+/// @param  [out] ctx                   Created context, release with TYDestroyDepthToColorContext.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      Any depth_calib, color_calib or ctx is NULL.
+/// @retval TY_STATUS_INVALID_PARAMETER Any size is 0.
+/// @retval TY_STATUS_ERROR             Extrinsic inversion failed.
+/// @retval TY_STATUS_OUT_OF_MEMORY     Context allocation failed.
+static inline TY_STATUS TYCreateDepthToColorContext(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  uint32_t mappedW, uint32_t mappedH,
+                  TYDepthToColorContext** ctx,
+                  float f_scale_unit = 1.0f);
+
+/// @brief Release a context created by TYCreateDepthToColorContext.
+/// @param  [in]  ctx                   Context to release, NULL is ignored.
+static inline void TYDestroyDepthToColorContext(TYDepthToColorContext* ctx);
+
+/// @brief Set the depth range expected in the scene, 200mm to 10000mm by default.
+///        Only used to tell which color rows are final while streaming, a narrow range
+///        releases rows earlier. Samples outside the range are still mapped, but no
+///        longer reach rows already reported as ready.
+/// @param  [in]  ctx                   Depth to color context.
+/// @param  [in]  min_distance          The min distance(mm).
+/// @param  [in]  max_distance          The longest distance(mm).
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx is NULL.
+/// @retval TY_STATUS_INVALID_PARAMETER min_distance is 0 or above max_distance.
+static inline TY_STATUS TYDepthToColorSetDepthRange(
+                  TYDepthToColorContext* ctx,
+                  uint32_t min_distance, uint32_t max_distance);
+
+/// @brief Set the longest hole filled, along rows and columns. A hole is filled with the
+///        farther of the two depths around it, since holes next to edges are background
+///        hidden from the depth camera. Defaults to twice the footprint size.
+/// @param  [in]  ctx                   Depth to color context.
+/// @param  [in]  max_hole              Longest hole in color pixels, 0 disables filling.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx is NULL.
+static inline TY_STATUS TYDepthToColorSetHoleFill(
+                  TYDepthToColorContext* ctx, uint32_t max_hole);
+
+/// @brief Start a frame. mappedDepth is cleared and receives the output of the following
+///        TYDepthToColorPushRows and TYDepthToColorEnd calls.
+/// @param  [in]  ctx                   Depth to color context.
+/// @param  [out] mappedDepth           Output depth image, ctx->mappedW x ctx->mappedH.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx or mappedDepth is NULL.
+static inline TY_STATUS TYDepthToColorBegin(
+                  TYDepthToColorContext* ctx, uint16_t* mappedDepth);
+
+/// @brief Map the next rowCount depth rows of the frame.
+/// @param  [in]  ctx                   Depth to color context.
+/// @param  [in]  rows                  Depth rows, ctx->depthW pixels each, following the previous call.
+/// @param  [in]  rowCount              Number of rows.
+/// @param  [out] readyRows             Optional, output rows [0, *readyRows) are complete and
+///                                     will not change any more.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx or rows is NULL.
+/// @retval TY_STATUS_WRONG_MODE        No frame started with TYDepthToColorBegin.
+/// @retval TY_STATUS_INVALID_PARAMETER More rows than left in the frame.
+static inline TY_STATUS TYDepthToColorPushRows(
+                  TYDepthToColorContext* ctx,
+                  const uint16_t* rows, uint32_t rowCount,
+                  uint32_t* readyRows = NULL);
+
+/// @brief Finish the frame, filling holes in the remaining rows. Rows not pushed stay empty.
+/// @param  [in]  ctx                   Depth to color context.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_NULL_POINTER      ctx is NULL.
+/// @retval TY_STATUS_WRONG_MODE        No frame started with TYDepthToColorBegin.
+static inline TY_STATUS TYDepthToColorEnd(TYDepthToColorContext* ctx);
+
+/// @brief Map a whole depth image to color resolution, Begin + PushRows + End in one call.
+/// @param  [in]  ctx                   Depth to color context.
+/// @param  [in]  depth                 Depth image, ctx->depthW x ctx->depthH.
+/// @param  [out] mappedDepth           Output depth image, ctx->mappedW x ctx->mappedH.
+/// @retval TY_STATUS_OK        Succeed.
+static inline TY_STATUS TYMapDepthImageToColorCoordinate(
+                  TYDepthToColorContext* ctx, const uint16_t* depth,
+                  uint16_t* mappedDepth);
+
 
 #define TYMAP_CHECKRET(f, bufToFree) \
   do{ \
@@ -319,6 +746,116 @@ static inline TY_STATUS TYMapDepthImageToColorCoordinate(
   return TY_STATUS_OK;
 }
 
+/// Shared part of the projection init: src pixel ray -> extri -> dst intrinsic.
+static inline void TYInitPixelProjection(
+                  const TY_CAMERA_CALIB_INFO* src_calib,
+                  uint32_t srcW, uint32_t srcH,
+                  const TY_CAMERA_EXTRINSIC* extri,
+                  const TY_CAMERA_CALIB_INFO* dst_calib,
+                  uint32_t dstW, uint32_t dstH,
+                  TYDepthToColorProjection* proj,
+                  float f_scale_unit)
+{
+  // intrinsics are calibrated at intrinsicWidth x intrinsicHeight, scale to the working size
+  const float* kd = src_calib->intrinsic.data;
+  float sdx = 1.f * srcW / src_calib->intrinsicWidth;
+  float sdy = 1.f * srcH / src_calib->intrinsicHeight;
+  float fx = kd[0] * sdx, cx = kd[2] * sdx;
+  float fy = kd[4] * sdy, cy = kd[5] * sdy;
+
+  const float* kc = dst_calib->intrinsic.data;
+  float scx = 1.f * dstW / dst_calib->intrinsicWidth;
+  float scy = 1.f * dstH / dst_calib->intrinsicHeight;
+  float kcm[9] = { kc[0] * scx, kc[1] * scx, kc[2] * scx,
+                   kc[3] * scy, kc[4] * scy, kc[5] * scy,
+                   kc[6],       kc[7],       kc[8] };
+
+  // m = Kc * [R | t]
+  const float* e = extri->data;
+  float m[3][4];
+  for(int r = 0; r < 3; r++)
+  for(int c = 0; c < 4; c++)
+    m[r][c] = kcm[r * 3 + 0] * e[0 * 4 + c] + kcm[r * 3 + 1] * e[1 * 4 + c] + kcm[r * 3 + 2] * e[2 * 4 + c];
+
+  // ray(u, v) = ((u - cx) / fx, (v - cy) / fy, 1), z = d * f_scale_unit
+  for(int r = 0; r < 3; r++) {
+    proj->du[r] = f_scale_unit * m[r][0] / fx;
+    proj->dv[r] = f_scale_unit * m[r][1] / fy;
+    proj->c0[r] = f_scale_unit * (m[r][2] - m[r][0] * cx / fx - m[r][1] * cy / fy);
+    proj->t[r]  = m[r][3];
+  }
+  proj->f_scale_unit = f_scale_unit;
+}
+
+static inline TY_STATUS TYInitDepthToColorProjection(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t mappedW, uint32_t mappedH,
+                  TYDepthToColorProjection* proj,
+                  float f_scale_unit)
+{
+  TY_CAMERA_EXTRINSIC extri_inv;
+  TY_STATUS err = TYInvertExtrinsic(&color_calib->extrinsic, &extri_inv);
+  if(err) return err;
+  TYInitPixelProjection(depth_calib, depthW, depthH, &extri_inv,
+        color_calib, mappedW, mappedH, proj, f_scale_unit);
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYInitColorToDepthProjection(
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t rgbW, uint32_t rgbH,
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  TYColorToDepthProjection* proj,
+                  float f_scale_unit)
+{
+  // color_calib->extrinsic maps color camera points to depth camera
+  TYInitPixelProjection(color_calib, rgbW, rgbH, &color_calib->extrinsic,
+        depth_calib, depthW, depthH, proj, f_scale_unit);
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYMapDepthImageToColorCoordinateFused(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t mappedW, uint32_t mappedH, uint16_t* mappedDepth,
+                  float f_scale_unit)
+{
+  TYDepthToColorProjection proj;
+  TY_STATUS err = TYInitDepthToColorProjection(depth_calib, depthW, depthH,
+                    color_calib, mappedW, mappedH, &proj, f_scale_unit);
+  if(err) return err;
+
+  const float maxX = mappedW - 0.5f;
+  const float maxY = mappedH - 0.5f;
+  for(uint32_t v = 0; v < depthH; v++) {
+    const uint16_t* src = &depth[v * depthW];
+    float bx = proj.c0[0] + v * proj.dv[0];
+    float by = proj.c0[1] + v * proj.dv[1];
+    float bz = proj.c0[2] + v * proj.dv[2];
+    for(uint32_t u = 0; u < depthW; u++) {
+      if(!src[u]) continue;
+      float d = src[u];
+      float w = d * (bz + u * proj.du[2]) + proj.t[2];
+      if(w <= 0.f) continue;
+      float iw = 1.f / w;
+      float x = (d * (bx + u * proj.du[0]) + proj.t[0]) * iw;
+      float y = (d * (by + u * proj.du[1]) + proj.t[1]) * iw;
+      if(x < -0.5f || y < -0.5f || x >= maxX || y >= maxY) continue;
+
+      float z = w / f_scale_unit + 0.5f;
+      if(z >= 65536.f) continue;
+      uint16_t zv = (uint16_t)z;
+      uint16_t* dst = &mappedDepth[(uint32_t)(y + 0.5f) * mappedW + (uint32_t)(x + 0.5f)];
+      if(zv && (*dst == 0 || *dst > zv)) *dst = zv;
+    }
+  }
+  return TYDepthImageFillEmptyRegion(mappedDepth, mappedW, mappedH);
+}
+
 static inline TY_STATUS TYMapRGBPixelsToDepthCoordinate(
 	const TY_CAMERA_CALIB_INFO* depth_calib,
 	uint32_t depthW, uint32_t depthH, const uint16_t* depth,
@@ -330,49 +867,96 @@ static inline TY_STATUS TYMapRGBPixelsToDepthCoordinate(
 	TY_PIXEL_COLOR_DESC* dst,
 	float f_scale_unit)
 {
-  uint32_t m_distance_range = max_distance - min_distance;
-  TY_CAMERA_EXTRINSIC extri = color_calib->extrinsic;
+  TYColorToDepthProjection proj;
+  TY_STATUS err = TYInitColorToDepthProjection(color_calib, rgbW, rgbH,
+                    depth_calib, depthW, depthH, &proj, f_scale_unit);
+  if(err) return err;
+  return TYMapRGBPixelsToDepthCoordinate(&proj, depthW, depthH, depth,
+                    src, cnt, min_distance, max_distance, dst);
+}
+
+static inline TY_STATUS TYMapRGBPixelsToDepthCoordinate(
+                  const TYColorToDepthProjection* proj,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_PIXEL_COLOR_DESC* src, uint32_t cnt,
+                  uint32_t min_distance, uint32_t max_distance,
+                  TY_PIXEL_COLOR_DESC* dst)
+{
+  const float* t = proj->t;
+  const float inv_scale = 1.f / proj->f_scale_unit;
+  for(uint32_t i = 0; i < cnt; i++) {
+    dst[i].x = -1;
+    dst[i].y = -1;
 
-  TY_PIXEL_DESC* pixels_array = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * m_distance_range);
-  TY_PIXEL_DESC* pixels_mapped_array = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * m_distance_range);
-  TY_VECT_3F* p3d_array = (TY_VECT_3F*)malloc(sizeof(TY_VECT_3F) * m_distance_range);
-	for (uint32_t i = 0; i < cnt; i++) {
-		for (uint32_t m = 0; m < m_distance_range; m++) {
-      pixels_array[m].x = src[i].x;
-      pixels_array[m].y = src[i].y;
-      pixels_array[m].depth = m + min_distance;
+    // depth pixel (X / W, Y / W) with depth W / f_scale_unit for color depth d,
+    // X = d * a[0] + t[0], Y = d * a[1] + t[1], W = d * a[2] + t[2]
+    float a[3];
+    for(int r = 0; r < 3; r++) a[r] = proj->c0[r] + src[i].x * proj->du[r] + src[i].y * proj->dv[r];
+
+    // keep points in front of the depth camera
+    double d0 = min_distance, d1 = (double)max_distance - 1;
+    if(a[2] > 0) {
+      d0 = std::max(d0, floor(-(double)t[2] / a[2]) + 1);
+    } else if(a[2] < 0) {
+      d1 = std::min(d1, ceil(-(double)t[2] / a[2]) - 1);
+    } else if(t[2] <= 0) {
+      continue;
     }
 
-    TYMapDepthToPoint3d(color_calib, rgbW, rgbH, pixels_array, m_distance_range, &p3d_array[0], f_scale_unit);
-    TYMapPoint3dToPoint3d(&extri, &p3d_array[0], m_distance_range, &p3d_array[0]);
+    uint32_t best = 0xffff;
+    int32_t best_x = -1, best_y = -1;
+    for(double d = d0; d <= d1 && best; ) {
+      double X = d * a[0] + t[0], Y = d * a[1] + t[1], W = d * a[2] + t[2];
+      double x = X / W, y = Y / W;
+      double px = floor(x), py = floor(y);
 
-    TYMapPoint3dToDepth(depth_calib, p3d_array, m_distance_range, depthW, depthH, pixels_mapped_array, f_scale_unit);
+      // x(d) and y(d) are monotonic, the pixel changes where x or y reaches the next integer:
+      // X - k * W = 0  =>  d = (k * t[2] - t[0]) / (a[0] - k * a[2])
+      double d_end = d1;
+      for(int c = 0; c < 2; c++) {
+        double p = c ? py : px;
+        double slope = a[c] * t[2] - a[2] * t[c];
+        if(slope == 0) continue;
+        double k = slope > 0 ? p + 1 : p;
+        double den = a[c] - k * a[2];
+        if(den == 0) continue;
+        double dk = (k * t[2] - t[c]) / den;
+        if(dk < d - 1) continue;                  // root behind us, the line never gets there
+        if(slope < 0 && dk == ceil(dk)) dk += 1;  // x == k still lies in pixel k when decreasing
+        double last = ceil(dk) - 1;
+        if(last < d_end) d_end = last;
+      }
+      if(d_end < d) d_end = d;
 
-    uint16_t m_min_delt = 0xffff;
-    dst[i].x = -1;
-    dst[i].y = -1;
-    for (uint32_t m = 0; m < m_distance_range; m++) {
-      int16_t pixel_x = pixels_mapped_array[m].x;
-      int16_t pixel_y = pixels_mapped_array[m].y;
-      uint16_t delt = abs(pixels_mapped_array[m].depth - depth[pixel_y*depthW + pixel_x]);
-      if (delt < m_min_delt) {
-        m_min_delt = delt;
-        if (m_min_delt < 10) {
-          dst[i].x = pixel_x;
-          dst[i].y = pixel_y;
-          dst[i].bgr_ch1 = src[i].bgr_ch1;
-          dst[i].bgr_ch2 = src[i].bgr_ch2;
-          dst[i].bgr_ch3 = src[i].bgr_ch3;
+      if(px >= 0 && py >= 0 && px < depthW && py < depthH) {
+        uint16_t D = depth[(uint32_t)py * depthW + (uint32_t)px];
+        // |round(W / f_scale_unit) - D| is smallest next to W(d) = D * f_scale_unit
+        double ds = a[2] != 0 ? (D * proj->f_scale_unit - t[2]) / a[2] : d;
+        double cand[2] = { floor(ds), floor(ds) + 1 };
+        uint32_t cell_best = 0xffff;
+        for(int c = 0; c < 2; c++) {
+          double dc = std::min(std::max(cand[c], d), d_end);
+          int32_t z = (int32_t)((dc * a[2] + t[2]) * inv_scale + 0.5);
+          uint32_t delt = (uint32_t)abs(z - (int32_t)D);
+          if(delt < cell_best) cell_best = delt;
+        }
+        if(cell_best < best) {
+          best = cell_best;
+          best_x = (int32_t)px;
+          best_y = (int32_t)py;
         }
       }
+      d = d_end + 1;
     }
-  }
-
-  free(pixels_array);
-  free(pixels_mapped_array);
-  free(p3d_array);
-  
 
+    if(best < 10) {
+      dst[i].x = best_x;
+      dst[i].y = best_y;
+      dst[i].bgr_ch1 = src[i].bgr_ch1;
+      dst[i].bgr_ch2 = src[i].bgr_ch2;
+      dst[i].bgr_ch3 = src[i].bgr_ch3;
+    }
+  }
   return TY_STATUS_OK;
 }
 
@@ -394,16 +978,9 @@ static inline TY_STATUS TYCreateDepthToColorCoordinateLookupTable(
   return TY_STATUS_OK;
 }
 
-static inline void TYPixelsOverlapRemove(TY_PIXEL_DESC* lut, uint32_t count, uint32_t imageW, uint32_t imageH)
+/// Drop lut entries lying more than 10 behind the filled z-buffer mappedDepth.
+static inline void TYPixelsOverlapReject(TY_PIXEL_DESC* lut, uint32_t count, uint32_t imageW, uint32_t imageH, const uint16_t* mappedDepth)
 {
-  uint16_t* mappedDepth = (uint16_t*)calloc(imageW*imageH, sizeof(uint16_t));
-  for(size_t i = 0; i < count; i++) {
-    if(lut[i].x < 0 || lut[i].y < 0 || lut[i].x >= imageW || lut[i].y >= imageH) continue;
-    uint32_t offset = lut[i].y * imageW + lut[i].x;
-    if(lut[i].depth && (mappedDepth[offset] == 0 || mappedDepth[offset] >= lut[i].depth)) 
-      mappedDepth[offset] = lut[i].depth;
-  }
-  TYDepthImageFillEmptyRegion(mappedDepth, imageW, imageH);
   for(size_t i = 0; i < count; i++) {
     if(lut[i].x < 0 || lut[i].y < 0 || lut[i].x >= imageW || lut[i].y >= imageH) {
       continue;
@@ -417,47 +994,686 @@ static inline void TYPixelsOverlapRemove(TY_PIXEL_DESC* lut, uint32_t count, uin
       }
     }
   }
+}
+
+static inline void TYPixelsOverlapRemove(TY_PIXEL_DESC* lut, uint32_t count, uint32_t imageW, uint32_t imageH, uint16_t* mappedDepth)
+{
+  memset(mappedDepth, 0, sizeof(uint16_t) * imageW * imageH);
+  for(size_t i = 0; i < count; i++) {
+    if(lut[i].x < 0 || lut[i].y < 0 || lut[i].x >= imageW || lut[i].y >= imageH) continue;
+    uint32_t offset = lut[i].y * imageW + lut[i].x;
+    if(lut[i].depth && (mappedDepth[offset] == 0 || mappedDepth[offset] >= lut[i].depth)) 
+      mappedDepth[offset] = lut[i].depth;
+  }
+  TYDepthImageFillEmptyRegion(mappedDepth, imageW, imageH);
+  TYPixelsOverlapReject(lut, count, imageW, imageH, mappedDepth);
+}
+
+static inline void TYPixelsOverlapRemove(TY_PIXEL_DESC* lut, uint32_t count, uint32_t imageW, uint32_t imageH)
+{
+  uint16_t* mappedDepth = (uint16_t*)malloc(imageW*imageH*sizeof(uint16_t));
+  TYPixelsOverlapRemove(lut, count, imageW, imageH, mappedDepth);
   free(mappedDepth);
 }
 
-static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
-                  const TY_CAMERA_CALIB_INFO* depth_calib,
-                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
-                  const TY_CAMERA_CALIB_INFO* color_calib,
-                  uint32_t rgbW, uint32_t rgbH, const uint8_t* inRgb,
-                  uint8_t* mappedRgb, float f_scale_unit)
+// ------------------------------
+//  lookup table sampling kernels
+// ------------------------------
+
+enum TYMapperSimdLevel
 {
-  TY_PIXEL_DESC* lut = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * depthW * depthH);
-  TYMAP_CHECKRET(TYCreateDepthToColorCoordinateLookupTable(
-                    depth_calib, depthW, depthH, depth,
-                    color_calib, depthW, depthH, lut, f_scale_unit), lut);
-  TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
+  TY_MAPPER_SIMD_NONE  = 0,
+  TY_MAPPER_SIMD_SSE41 = 1,
+  TY_MAPPER_SIMD_AVX2  = 2,
+  TY_MAPPER_SIMD_NEON  = 3,
+};
 
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
-  {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint8_t* outPtr = &mappedRgb[depthW * depthr * 3 + depthc * 3];
+static inline int TYDetectSimdLevel()
+{
+#if defined(TY_MAPPER_X86)
+#  if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  int max_leaf = info[0];
+  __cpuid(info, 1);
+  bool sse41 = (info[2] >> 19) & 1;
+  bool osxsave_avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && ((_xgetbv(0) & 6) == 6);
+  bool avx2 = false;
+  if(max_leaf >= 7 && osxsave_avx) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] >> 5) & 1;
+  }
+#  else
+  __builtin_cpu_init();
+  bool sse41 = __builtin_cpu_supports("sse4.1");
+  bool avx2 = __builtin_cpu_supports("avx2");
+#  endif
+  if(avx2) return TY_MAPPER_SIMD_AVX2;
+  if(sse41) return TY_MAPPER_SIMD_SSE41;
+  return TY_MAPPER_SIMD_NONE;
+#elif defined(TY_MAPPER_NEON)
+  return TY_MAPPER_SIMD_NEON;
+#else
+  return TY_MAPPER_SIMD_NONE;
+#endif
+}
+
+/// Best instruction set available on the running cpu, detected once.
+static inline int TYGetSimdLevel()
+{
+  static const int level = TYDetectSimdLevel();
+  return level;
+}
+
+/// Convert lookup table entries to element offsets into a srcW x srcH image, -1 for
+/// entries out of the depthW x depthH lut range. Same rounding and clamping as the
+/// scalar registration loop: (uint16_t)(1.f * x * srcW / depthW + 0.5), clamped to srcW - 1.
+static inline void TYLookupTableToOffsetsC(const TY_PIXEL_DESC* lut, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, uint32_t srcW, uint32_t srcH, int32_t* offsets)
+{
+  for(uint32_t i = 0; i < count; i++) {
+    const TY_PIXEL_DESC* plut = &lut[i];
     if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = outPtr[1] = outPtr[2] = 0;
+      offsets[i] = -1;
     } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * rgbW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * rgbH / depthH + 0.5);
-      if(scale_x >= rgbW) scale_x = rgbW - 1;
-      if(scale_y >= rgbH) scale_y = rgbH - 1;
-      const uint8_t* inPtr = &inRgb[rgbW * scale_y * 3 + scale_x * 3];
-      outPtr[0] = inPtr[0];
-      outPtr[1] = inPtr[1];
-      outPtr[2] = inPtr[2];
+      uint16_t scale_x =  (uint16_t)(1.f * plut->x * srcW / depthW + 0.5);
+      uint16_t scale_y =  (uint16_t)(1.f * plut->y * srcH / depthH + 0.5);
+      if(scale_x >= srcW) scale_x = srcW - 1;
+      if(scale_y >= srcH) scale_y = srcH - 1;
+      offsets[i] = srcW * scale_y + scale_x;
     }
   }
-  free(lut);
-  return TY_STATUS_OK;
 }
 
-static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
-                  const TY_CAMERA_CALIB_INFO* depth_calib,
-                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+// t + 0.5 truncated, in double, equals trunc(t) + (frac(t) >= 0.5) for t >= 0,
+// which keeps the vector versions bit exact without double precision math.
+#if defined(TY_MAPPER_X86)
+TY_MAPPER_TARGET("sse4.1")
+static inline void TYLookupTableToOffsetsSSE41(const TY_PIXEL_DESC* lut, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, uint32_t srcW, uint32_t srcH, int32_t* offsets)
+{
+  const __m128i dw = _mm_set1_epi32(depthW), dh = _mm_set1_epi32(depthH);
+  const __m128i sw_max = _mm_set1_epi32(srcW - 1), sh_max = _mm_set1_epi32(srcH - 1);
+  const __m128i sw = _mm_set1_epi32(srcW), minus1 = _mm_set1_epi32(-1);
+  const __m128 fdw = _mm_set1_ps((float)depthW), fdh = _mm_set1_ps((float)depthH);
+  const __m128 fsw = _mm_set1_ps((float)srcW), fsh = _mm_set1_ps((float)srcH);
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4) {
+    // 2 entries per register, x | y << 16 in the even 32bit lanes
+    __m128 a = _mm_loadu_ps((const float*)&lut[i]);
+    __m128 b = _mm_loadu_ps((const float*)&lut[i + 2]);
+    __m128i xy = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i x = _mm_srai_epi32(_mm_slli_epi32(xy, 16), 16);
+    __m128i y = _mm_srai_epi32(xy, 16);
+
+    __m128i valid = _mm_and_si128(
+          _mm_and_si128(_mm_cmpgt_epi32(x, minus1), _mm_cmpgt_epi32(dw, x)),
+          _mm_and_si128(_mm_cmpgt_epi32(y, minus1), _mm_cmpgt_epi32(dh, y)));
+
+    __m128 tx = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(x), fsw), fdw);
+    __m128 ty = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(y), fsh), fdh);
+    __m128i ix = _mm_cvttps_epi32(tx);
+    __m128i iy = _mm_cvttps_epi32(ty);
+    ix = _mm_sub_epi32(ix, _mm_castps_si128(_mm_cmpge_ps(_mm_sub_ps(tx, _mm_cvtepi32_ps(ix)), half)));
+    iy = _mm_sub_epi32(iy, _mm_castps_si128(_mm_cmpge_ps(_mm_sub_ps(ty, _mm_cvtepi32_ps(iy)), half)));
+    ix = _mm_min_epi32(ix, sw_max);
+    iy = _mm_min_epi32(iy, sh_max);
+
+    __m128i off = _mm_add_epi32(_mm_mullo_epi32(iy, sw), ix);
+    _mm_storeu_si128((__m128i*)&offsets[i], _mm_blendv_epi8(minus1, off, valid));
+  }
+  TYLookupTableToOffsetsC(lut + i, count - i, depthW, depthH, srcW, srcH, offsets + i);
+}
+
+TY_MAPPER_TARGET("avx2")
+static inline void TYLookupTableToOffsetsAVX2(const TY_PIXEL_DESC* lut, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, uint32_t srcW, uint32_t srcH, int32_t* offsets)
+{
+  const __m256i dw = _mm256_set1_epi32(depthW), dh = _mm256_set1_epi32(depthH);
+  const __m256i sw_max = _mm256_set1_epi32(srcW - 1), sh_max = _mm256_set1_epi32(srcH - 1);
+  const __m256i sw = _mm256_set1_epi32(srcW), minus1 = _mm256_set1_epi32(-1);
+  const __m256 fdw = _mm256_set1_ps((float)depthW), fdh = _mm256_set1_ps((float)depthH);
+  const __m256 fsw = _mm256_set1_ps((float)srcW), fsh = _mm256_set1_ps((float)srcH);
+  const __m256 half = _mm256_set1_ps(0.5f);
+
+  uint32_t i = 0;
+  for(; i + 8 <= count; i += 8) {
+    // lanes come out as entries 0 1 4 5 | 2 3 6 7, fixed up by the 64bit permute
+    __m256 a = _mm256_loadu_ps((const float*)&lut[i]);
+    __m256 b = _mm256_loadu_ps((const float*)&lut[i + 4]);
+    __m256i xy = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    xy = _mm256_permute4x64_epi64(xy, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i x = _mm256_srai_epi32(_mm256_slli_epi32(xy, 16), 16);
+    __m256i y = _mm256_srai_epi32(xy, 16);
+
+    __m256i valid = _mm256_and_si256(
+          _mm256_and_si256(_mm256_cmpgt_epi32(x, minus1), _mm256_cmpgt_epi32(dw, x)),
+          _mm256_and_si256(_mm256_cmpgt_epi32(y, minus1), _mm256_cmpgt_epi32(dh, y)));
+
+    __m256 tx = _mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(x), fsw), fdw);
+    __m256 ty = _mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(y), fsh), fdh);
+    __m256i ix = _mm256_cvttps_epi32(tx);
+    __m256i iy = _mm256_cvttps_epi32(ty);
+    ix = _mm256_sub_epi32(ix, _mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(tx, _mm256_cvtepi32_ps(ix)), half, _CMP_GE_OQ)));
+    iy = _mm256_sub_epi32(iy, _mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(ty, _mm256_cvtepi32_ps(iy)), half, _CMP_GE_OQ)));
+    ix = _mm256_min_epi32(ix, sw_max);
+    iy = _mm256_min_epi32(iy, sh_max);
+
+    __m256i off = _mm256_add_epi32(_mm256_mullo_epi32(iy, sw), ix);
+    _mm256_storeu_si256((__m256i*)&offsets[i], _mm256_blendv_epi8(minus1, off, valid));
+  }
+  TYLookupTableToOffsetsC(lut + i, count - i, depthW, depthH, srcW, srcH, offsets + i);
+}
+#endif
+
+#if defined(TY_MAPPER_NEON)
+static inline void TYLookupTableToOffsetsNEON(const TY_PIXEL_DESC* lut, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, uint32_t srcW, uint32_t srcH, int32_t* offsets)
+{
+  const int32x4_t dw = vdupq_n_s32(depthW), dh = vdupq_n_s32(depthH);
+  const int32x4_t sw_max = vdupq_n_s32(srcW - 1), sh_max = vdupq_n_s32(srcH - 1);
+  const int32x4_t sw = vdupq_n_s32(srcW), zero = vdupq_n_s32(0), minus1 = vdupq_n_s32(-1);
+  const float32x4_t fdw = vdupq_n_f32((float)depthW), fdh = vdupq_n_f32((float)depthH);
+  const float32x4_t fsw = vdupq_n_f32((float)srcW), fsh = vdupq_n_f32((float)srcH);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+
+  uint32_t i = 0;
+  for(; i + 8 <= count; i += 8) {
+    // de-interleave x, y, depth, rsvd of 8 entries
+    int16x8x4_t e = vld4q_s16((const int16_t*)&lut[i]);
+    for(int h = 0; h < 2; h++) {
+      int32x4_t x = vmovl_s16(h ? vget_high_s16(e.val[0]) : vget_low_s16(e.val[0]));
+      int32x4_t y = vmovl_s16(h ? vget_high_s16(e.val[1]) : vget_low_s16(e.val[1]));
+
+      uint32x4_t valid = vandq_u32(
+            vandq_u32(vcgeq_s32(x, zero), vcltq_s32(x, dw)),
+            vandq_u32(vcgeq_s32(y, zero), vcltq_s32(y, dh)));
+
+      float32x4_t tx = vdivq_f32(vmulq_f32(vcvtq_f32_s32(x), fsw), fdw);
+      float32x4_t ty = vdivq_f32(vmulq_f32(vcvtq_f32_s32(y), fsh), fdh);
+      int32x4_t ix = vcvtq_s32_f32(tx);
+      int32x4_t iy = vcvtq_s32_f32(ty);
+      ix = vsubq_s32(ix, vreinterpretq_s32_u32(vcgeq_f32(vsubq_f32(tx, vcvtq_f32_s32(ix)), half)));
+      iy = vsubq_s32(iy, vreinterpretq_s32_u32(vcgeq_f32(vsubq_f32(ty, vcvtq_f32_s32(iy)), half)));
+      ix = vminq_s32(ix, sw_max);
+      iy = vminq_s32(iy, sh_max);
+
+      int32x4_t off = vmlaq_s32(ix, iy, sw);
+      vst1q_s32(&offsets[i + h * 4], vbslq_s32(valid, off, minus1));
+    }
+  }
+  TYLookupTableToOffsetsC(lut + i, count - i, depthW, depthH, srcW, srcH, offsets + i);
+}
+#endif
+
+/// Dispatch to the kernel matching simd, TY_MAPPER_SIMD_NONE forces the scalar version.
+static inline void TYLookupTableToOffsets(const TY_PIXEL_DESC* lut, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, uint32_t srcW, uint32_t srcH, int32_t* offsets,
+                  int simd = TYGetSimdLevel())
+{
+  switch(simd) {
+#if defined(TY_MAPPER_X86)
+    case TY_MAPPER_SIMD_AVX2:
+      TYLookupTableToOffsetsAVX2(lut, count, depthW, depthH, srcW, srcH, offsets);
+      return;
+    case TY_MAPPER_SIMD_SSE41:
+      TYLookupTableToOffsetsSSE41(lut, count, depthW, depthH, srcW, srcH, offsets);
+      return;
+#endif
+#if defined(TY_MAPPER_NEON)
+    case TY_MAPPER_SIMD_NEON:
+      TYLookupTableToOffsetsNEON(lut, count, depthW, depthH, srcW, srcH, offsets);
+      return;
+#endif
+    default:
+      TYLookupTableToOffsetsC(lut, count, depthW, depthH, srcW, srcH, offsets);
+      return;
+  }
+}
+
+/// Fetch src pixels for lut entries [begin, end) of a depthW x depthH lookup table built at
+/// depth resolution, rescaling lut coordinates to the srcW x srcH image. Pixels without
+/// a valid lut entry are set to 0.
+template<typename T, int CN>
+static inline void TYSampleImageRangeByLookupTable(const TY_PIXEL_DESC* lut, uint32_t begin, uint32_t end,
+                  uint32_t depthW, uint32_t depthH, uint32_t srcW, uint32_t srcH, const T* src, T* dst,
+                  int simd = TYGetSimdLevel())
+{
+  if(simd == TY_MAPPER_SIMD_NONE) {
+    for(uint32_t i = begin; i < end; i++)
+    {
+      const TY_PIXEL_DESC* plut = &lut[i];
+      T* outPtr = &dst[i * CN];
+      if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
+        for(int ch = 0; ch < CN; ch++) outPtr[ch] = 0;
+      } else {
+        uint16_t scale_x =  (uint16_t)(1.f * plut->x * srcW / depthW + 0.5);
+        uint16_t scale_y =  (uint16_t)(1.f * plut->y * srcH / depthH + 0.5);
+        if(scale_x >= srcW) scale_x = srcW - 1;
+        if(scale_y >= srcH) scale_y = srcH - 1;
+        const T* inPtr = &src[srcW * scale_y * CN + scale_x * CN];
+        for(int ch = 0; ch < CN; ch++) outPtr[ch] = inPtr[ch];
+      }
+    }
+    return;
+  }
+
+  // vector kernels resolve a block of lut entries to offsets, then copy
+  const uint32_t kBlock = 256;
+  int32_t offsets[kBlock];
+  for(uint32_t i = begin; i < end; i += kBlock) {
+    uint32_t n = (end - i < kBlock) ? end - i : kBlock;
+    TYLookupTableToOffsets(lut + i, n, depthW, depthH, srcW, srcH, offsets, simd);
+    T* outPtr = &dst[i * CN];
+    for(uint32_t k = 0; k < n; k++, outPtr += CN) {
+      if(offsets[k] < 0) {
+        for(int ch = 0; ch < CN; ch++) outPtr[ch] = 0;
+      } else {
+        const T* inPtr = &src[offsets[k] * CN];
+        for(int ch = 0; ch < CN; ch++) outPtr[ch] = inPtr[ch];
+      }
+    }
+  }
+}
+
+/// Whole image version of TYSampleImageRangeByLookupTable.
+template<typename T, int CN>
+static inline void TYSampleImageByLookupTable(const TY_PIXEL_DESC* lut, uint32_t depthW, uint32_t depthH,
+                  uint32_t srcW, uint32_t srcH, const T* src, T* dst,
+                  int simd = TYGetSimdLevel())
+{
+  TYSampleImageRangeByLookupTable<T, CN>(lut, 0, depthW * depthH, depthW, depthH, srcW, srcH, src, dst, simd);
+}
+
+// ------------------------------
+//  sub-pixel sampling kernels
+// ------------------------------
+
+/// Source camera intrinsic at srcW x srcH: fx, cx, fy, cy.
+static inline void TYScaledIntrinsic(const TY_CAMERA_CALIB_INFO* calib, uint32_t srcW, uint32_t srcH, float* k)
+{
+  float sx = 1.f * srcW / calib->intrinsicWidth;
+  float sy = 1.f * srcH / calib->intrinsicHeight;
+  k[0] = calib->intrinsic.data[0] * sx;
+  k[1] = calib->intrinsic.data[2] * sx;
+  k[2] = calib->intrinsic.data[4] * sy;
+  k[3] = calib->intrinsic.data[5] * sy;
+}
+
+/// Project color camera points p3d to a srcW x srcH image (srcW, srcH >= 2) and turn each into the
+/// offset of its top left neighbour plus 7 bit x / y weights, packed as wx | wy << 8.
+/// Entries whose lut entry is outside depthW x depthH get offset -1.
+static inline void TYProjectToBilinearC(const TY_PIXEL_DESC* lut, const TY_VECT_3F* p3d, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, const float* k, uint32_t srcW, uint32_t srcH,
+                  int32_t* offsets, int32_t* weights)
+{
+  const float maxX = (float)(srcW - 1), maxY = (float)(srcH - 1);
+  for(uint32_t i = 0; i < count; i++) {
+    if(lut[i].x < 0 || lut[i].x >= (int)depthW || lut[i].y < 0 || lut[i].y >= (int)depthH) {
+      offsets[i] = -1;
+      continue;
+    }
+    float x = k[0] * (p3d[i].x / p3d[i].z) + k[1];
+    float y = k[2] * (p3d[i].y / p3d[i].z) + k[3];
+    x = std::min(std::max(x, 0.f), maxX);
+    y = std::min(std::max(y, 0.f), maxY);
+    int32_t x0 = std::min((int32_t)x, (int32_t)srcW - 2);
+    int32_t y0 = std::min((int32_t)y, (int32_t)srcH - 2);
+    int32_t wx = (int32_t)((x - (float)x0) * 128.f + 0.5f);
+    int32_t wy = (int32_t)((y - (float)y0) * 128.f + 0.5f);
+    offsets[i] = y0 * (int32_t)srcW + x0;
+    weights[i] = wx | (wy << 8);
+  }
+}
+
+#if defined(TY_MAPPER_X86)
+/// De-interleave x y z of 4 TY_VECT_3F.
+TY_MAPPER_TARGET("sse4.1")
+static inline void TYLoadPoint3dSSE41(const TY_VECT_3F* p3d, __m128& px, __m128& py, __m128& pz)
+{
+  const float* p = (const float*)p3d;
+  __m128 p0 = _mm_loadu_ps(p), p1 = _mm_loadu_ps(p + 4), p2 = _mm_loadu_ps(p + 8);
+  px = _mm_shuffle_ps(p0, _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+  py = _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(0, 0, 1, 1)),
+                      _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+  pz = _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(1, 1, 2, 2)),
+                      _mm_shuffle_ps(p2, p2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+TY_MAPPER_TARGET("sse4.1")
+static inline void TYProjectToBilinearSSE41(const TY_PIXEL_DESC* lut, const TY_VECT_3F* p3d, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, const float* k, uint32_t srcW, uint32_t srcH,
+                  int32_t* offsets, int32_t* weights)
+{
+  const __m128i dw = _mm_set1_epi32(depthW), dh = _mm_set1_epi32(depthH), minus1 = _mm_set1_epi32(-1);
+  const __m128i x0_max = _mm_set1_epi32(srcW - 2), y0_max = _mm_set1_epi32(srcH - 2), sw = _mm_set1_epi32(srcW);
+  const __m128 fx = _mm_set1_ps(k[0]), cx = _mm_set1_ps(k[1]), fy = _mm_set1_ps(k[2]), cy = _mm_set1_ps(k[3]);
+  const __m128 maxX = _mm_set1_ps((float)(srcW - 1)), maxY = _mm_set1_ps((float)(srcH - 1));
+  const __m128 zero = _mm_setzero_ps(), w128 = _mm_set1_ps(128.f), half = _mm_set1_ps(0.5f);
+
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4) {
+    __m128 a = _mm_loadu_ps((const float*)&lut[i]);
+    __m128 b = _mm_loadu_ps((const float*)&lut[i + 2]);
+    __m128i xy = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i lx = _mm_srai_epi32(_mm_slli_epi32(xy, 16), 16);
+    __m128i ly = _mm_srai_epi32(xy, 16);
+    __m128i valid = _mm_and_si128(
+          _mm_and_si128(_mm_cmpgt_epi32(lx, minus1), _mm_cmpgt_epi32(dw, lx)),
+          _mm_and_si128(_mm_cmpgt_epi32(ly, minus1), _mm_cmpgt_epi32(dh, ly)));
+
+    __m128 px, py, pz;
+    TYLoadPoint3dSSE41(&p3d[i], px, py, pz);
+
+    __m128 x = _mm_add_ps(_mm_mul_ps(fx, _mm_div_ps(px, pz)), cx);
+    __m128 y = _mm_add_ps(_mm_mul_ps(fy, _mm_div_ps(py, pz)), cy);
+    x = _mm_min_ps(_mm_max_ps(x, zero), maxX);
+    y = _mm_min_ps(_mm_max_ps(y, zero), maxY);
+    __m128i x0 = _mm_min_epi32(_mm_cvttps_epi32(x), x0_max);
+    __m128i y0 = _mm_min_epi32(_mm_cvttps_epi32(y), y0_max);
+    __m128i wx = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(x0)), w128), half));
+    __m128i wy = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(y0)), w128), half));
+
+    __m128i off = _mm_add_epi32(_mm_mullo_epi32(y0, sw), x0);
+    _mm_storeu_si128((__m128i*)&offsets[i], _mm_blendv_epi8(minus1, off, valid));
+    _mm_storeu_si128((__m128i*)&weights[i], _mm_or_si128(wx, _mm_slli_epi32(wy, 8)));
+  }
+  TYProjectToBilinearC(lut + i, p3d + i, count - i, depthW, depthH, k, srcW, srcH, offsets + i, weights + i);
+}
+
+TY_MAPPER_TARGET("avx2")
+static inline void TYProjectToBilinearAVX2(const TY_PIXEL_DESC* lut, const TY_VECT_3F* p3d, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, const float* k, uint32_t srcW, uint32_t srcH,
+                  int32_t* offsets, int32_t* weights)
+{
+  const __m256i dw = _mm256_set1_epi32(depthW), dh = _mm256_set1_epi32(depthH), minus1 = _mm256_set1_epi32(-1);
+  const __m256i x0_max = _mm256_set1_epi32(srcW - 2), y0_max = _mm256_set1_epi32(srcH - 2);
+  const __m256i sw = _mm256_set1_epi32(srcW);
+  const __m256 fx = _mm256_set1_ps(k[0]), cx = _mm256_set1_ps(k[1]), fy = _mm256_set1_ps(k[2]), cy = _mm256_set1_ps(k[3]);
+  const __m256 maxX = _mm256_set1_ps((float)(srcW - 1)), maxY = _mm256_set1_ps((float)(srcH - 1));
+  const __m256 zero = _mm256_setzero_ps(), w128 = _mm256_set1_ps(128.f), half = _mm256_set1_ps(0.5f);
+
+  uint32_t i = 0;
+  for(; i + 8 <= count; i += 8) {
+    __m256 a = _mm256_loadu_ps((const float*)&lut[i]);
+    __m256 b = _mm256_loadu_ps((const float*)&lut[i + 4]);
+    __m256i xy = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    xy = _mm256_permute4x64_epi64(xy, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i lx = _mm256_srai_epi32(_mm256_slli_epi32(xy, 16), 16);
+    __m256i ly = _mm256_srai_epi32(xy, 16);
+    __m256i valid = _mm256_and_si256(
+          _mm256_and_si256(_mm256_cmpgt_epi32(lx, minus1), _mm256_cmpgt_epi32(dw, lx)),
+          _mm256_and_si256(_mm256_cmpgt_epi32(ly, minus1), _mm256_cmpgt_epi32(dh, ly)));
+
+    // two 128 bit de-interleaves, cheaper than gathers
+    __m128 ax, ay, az, bx, by, bz;
+    TYLoadPoint3dSSE41(&p3d[i], ax, ay, az);
+    TYLoadPoint3dSSE41(&p3d[i + 4], bx, by, bz);
+    __m256 px = _mm256_insertf128_ps(_mm256_castps128_ps256(ax), bx, 1);
+    __m256 py = _mm256_insertf128_ps(_mm256_castps128_ps256(ay), by, 1);
+    __m256 pz = _mm256_insertf128_ps(_mm256_castps128_ps256(az), bz, 1);
+
+    __m256 x = _mm256_add_ps(_mm256_mul_ps(fx, _mm256_div_ps(px, pz)), cx);
+    __m256 y = _mm256_add_ps(_mm256_mul_ps(fy, _mm256_div_ps(py, pz)), cy);
+    x = _mm256_min_ps(_mm256_max_ps(x, zero), maxX);
+    y = _mm256_min_ps(_mm256_max_ps(y, zero), maxY);
+    __m256i x0 = _mm256_min_epi32(_mm256_cvttps_epi32(x), x0_max);
+    __m256i y0 = _mm256_min_epi32(_mm256_cvttps_epi32(y), y0_max);
+    __m256i wx = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(x, _mm256_cvtepi32_ps(x0)), w128), half));
+    __m256i wy = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(y, _mm256_cvtepi32_ps(y0)), w128), half));
+
+    __m256i off = _mm256_add_epi32(_mm256_mullo_epi32(y0, sw), x0);
+    _mm256_storeu_si256((__m256i*)&offsets[i], _mm256_blendv_epi8(minus1, off, valid));
+    _mm256_storeu_si256((__m256i*)&weights[i], _mm256_or_si256(wx, _mm256_slli_epi32(wy, 8)));
+  }
+  TYProjectToBilinearC(lut + i, p3d + i, count - i, depthW, depthH, k, srcW, srcH, offsets + i, weights + i);
+}
+#endif
+
+#if defined(TY_MAPPER_NEON)
+static inline void TYProjectToBilinearNEON(const TY_PIXEL_DESC* lut, const TY_VECT_3F* p3d, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, const float* k, uint32_t srcW, uint32_t srcH,
+                  int32_t* offsets, int32_t* weights)
+{
+  const int32x4_t dw = vdupq_n_s32(depthW), dh = vdupq_n_s32(depthH), izero = vdupq_n_s32(0), minus1 = vdupq_n_s32(-1);
+  const int32x4_t x0_max = vdupq_n_s32(srcW - 2), y0_max = vdupq_n_s32(srcH - 2), sw = vdupq_n_s32(srcW);
+  const float32x4_t fx = vdupq_n_f32(k[0]), cx = vdupq_n_f32(k[1]), fy = vdupq_n_f32(k[2]), cy = vdupq_n_f32(k[3]);
+  const float32x4_t maxX = vdupq_n_f32((float)(srcW - 1)), maxY = vdupq_n_f32((float)(srcH - 1));
+  const float32x4_t zero = vdupq_n_f32(0.f), w128 = vdupq_n_f32(128.f), half = vdupq_n_f32(0.5f);
+
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4) {
+    int16x4x4_t e = vld4_s16((const int16_t*)&lut[i]);
+    int32x4_t lx = vmovl_s16(e.val[0]);
+    int32x4_t ly = vmovl_s16(e.val[1]);
+    uint32x4_t valid = vandq_u32(
+          vandq_u32(vcgeq_s32(lx, izero), vcltq_s32(lx, dw)),
+          vandq_u32(vcgeq_s32(ly, izero), vcltq_s32(ly, dh)));
+
+    float32x4x3_t p = vld3q_f32((const float*)&p3d[i]);
+    float32x4_t x = vaddq_f32(vmulq_f32(fx, vdivq_f32(p.val[0], p.val[2])), cx);
+    float32x4_t y = vaddq_f32(vmulq_f32(fy, vdivq_f32(p.val[1], p.val[2])), cy);
+    x = vminq_f32(vmaxq_f32(x, zero), maxX);
+    y = vminq_f32(vmaxq_f32(y, zero), maxY);
+    int32x4_t x0 = vminq_s32(vcvtq_s32_f32(x), x0_max);
+    int32x4_t y0 = vminq_s32(vcvtq_s32_f32(y), y0_max);
+    int32x4_t wx = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vsubq_f32(x, vcvtq_f32_s32(x0)), w128), half));
+    int32x4_t wy = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vsubq_f32(y, vcvtq_f32_s32(y0)), w128), half));
+
+    vst1q_s32(&offsets[i], vbslq_s32(valid, vmlaq_s32(x0, y0, sw), minus1));
+    vst1q_s32(&weights[i], vorrq_s32(wx, vshlq_n_s32(wy, 8)));
+  }
+  TYProjectToBilinearC(lut + i, p3d + i, count - i, depthW, depthH, k, srcW, srcH, offsets + i, weights + i);
+}
+#endif
+
+static inline void TYProjectToBilinear(const TY_PIXEL_DESC* lut, const TY_VECT_3F* p3d, uint32_t count,
+                  uint32_t depthW, uint32_t depthH, const float* k, uint32_t srcW, uint32_t srcH,
+                  int32_t* offsets, int32_t* weights, int simd = TYGetSimdLevel())
+{
+  switch(simd) {
+#if defined(TY_MAPPER_X86)
+    case TY_MAPPER_SIMD_AVX2:
+      TYProjectToBilinearAVX2(lut, p3d, count, depthW, depthH, k, srcW, srcH, offsets, weights);
+      return;
+    case TY_MAPPER_SIMD_SSE41:
+      TYProjectToBilinearSSE41(lut, p3d, count, depthW, depthH, k, srcW, srcH, offsets, weights);
+      return;
+#endif
+#if defined(TY_MAPPER_NEON)
+    case TY_MAPPER_SIMD_NEON:
+      TYProjectToBilinearNEON(lut, p3d, count, depthW, depthH, k, srcW, srcH, offsets, weights);
+      return;
+#endif
+    default:
+      TYProjectToBilinearC(lut, p3d, count, depthW, depthH, k, srcW, srcH, offsets, weights);
+      return;
+  }
+}
+
+/// Scalar 2x2 blend of 8 bit RGB, weights as from TYProjectToBilinear.
+static inline void TYBilinearBlendRGB8Pixel(const uint8_t* p00, uint32_t stride, int32_t weight, uint8_t* out)
+{
+  const uint8_t* p10 = p00 + stride;
+  uint32_t wx = weight & 0xff, wy = weight >> 8;
+  for(int ch = 0; ch < 3; ch++) {
+    uint32_t top = p00[ch] * 128 + (p00[3 + ch] - p00[ch]) * wx;
+    uint32_t bottom = p10[ch] * 128 + (p10[3 + ch] - p10[ch]) * wx;
+    out[ch] = (uint8_t)((top * 128 + (bottom - top) * wy + (1 << 13)) >> 14);
+  }
+}
+
+#if defined(TY_MAPPER_X86)
+/// 8 bit RGB blend, 16 bit multiply-adds with the same rounding as the scalar version.
+/// Reads 8 bytes per row, so pixels of the last image row go through the scalar version.
+TY_MAPPER_TARGET("sse4.1")
+static inline void TYBilinearBlendRGB8SSE41(const uint8_t* src, uint32_t srcW, uint32_t srcH,
+                  const int32_t* offsets, const int32_t* weights, uint32_t n, uint8_t* dst)
+{
+  const uint32_t stride = srcW * 3;
+  const int64_t last = (int64_t)srcW * srcH * 3 - stride - 8;  // keeps p00 + stride + 8 in the image
+  const __m128i pairs = _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1);
+  const __m128i rows = _mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, -1, -1, -1, -1);
+  const __m128i round = _mm_set1_epi32(1 << 13);
+  for(uint32_t j = 0; j < n; j++, dst += 3) {
+    if(offsets[j] < 0) {
+      dst[0] = dst[1] = dst[2] = 0;
+      continue;
+    }
+    const uint8_t* p00 = src + offsets[j] * 3;
+    if(offsets[j] * 3 > last) {
+      TYBilinearBlendRGB8Pixel(p00, stride, weights[j], dst);
+      continue;
+    }
+    int32_t wx = weights[j] & 0xff, wy = weights[j] >> 8;
+    __m128i wxv = _mm_set1_epi32((wx << 16) | (128 - wx));
+    __m128i wyv = _mm_set1_epi32((wy << 16) | (128 - wy));
+    // (p00, p01) pairs per channel, then rows: top c0 c1 c2, bottom c0 c1 c2
+    __m128i top = _mm_madd_epi16(_mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)p00), pairs), wxv);
+    __m128i bottom = _mm_madd_epi16(_mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)(p00 + stride)), pairs), wxv);
+    __m128i tb = _mm_shuffle_epi8(_mm_packs_epi32(top, bottom), rows);
+    __m128i r = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(tb, wyv), round), 14);
+    r = _mm_packus_epi16(_mm_packus_epi32(r, r), r);
+    int32_t v = _mm_cvtsi128_si32(r);
+    memcpy(dst, &v, 3);
+  }
+}
+#endif
+
+#if defined(TY_MAPPER_NEON)
+static inline void TYBilinearBlendRGB8NEON(const uint8_t* src, uint32_t srcW, uint32_t srcH,
+                  const int32_t* offsets, const int32_t* weights, uint32_t n, uint8_t* dst)
+{
+  const uint32_t stride = srcW * 3;
+  const int64_t last = (int64_t)srcW * srcH * 3 - stride - 8;
+  for(uint32_t j = 0; j < n; j++, dst += 3) {
+    if(offsets[j] < 0) {
+      dst[0] = dst[1] = dst[2] = 0;
+      continue;
+    }
+    const uint8_t* p00 = src + offsets[j] * 3;
+    if(offsets[j] * 3 > last) {
+      TYBilinearBlendRGB8Pixel(p00, stride, weights[j], dst);
+      continue;
+    }
+    uint16_t wx = weights[j] & 0xff, wy = weights[j] >> 8;
+    uint16x8_t a = vmovl_u8(vld1_u8(p00));
+    uint16x8_t b = vmovl_u8(vld1_u8(p00 + stride));
+    uint16x8_t top = vmlaq_n_u16(vmulq_n_u16(a, 128 - wx), vextq_u16(a, a, 3), wx);
+    uint16x8_t bottom = vmlaq_n_u16(vmulq_n_u16(b, 128 - wx), vextq_u16(b, b, 3), wx);
+    uint32x4_t acc = vmlal_n_u16(vmull_n_u16(vget_low_u16(top), 128 - wy), vget_low_u16(bottom), wy);
+    uint8x8_t r = vmovn_u16(vcombine_u16(vrshrn_n_u32(acc, 14), vdup_n_u16(0)));
+    uint32_t v = vget_lane_u32(vreinterpret_u32_u8(r), 0);
+    memcpy(dst, &v, 3);
+  }
+}
+#endif
+
+/// Vector blend for 8 bit RGB, false when simd has none.
+static inline bool TYBilinearBlendRGB8(const uint8_t* src, uint32_t srcW, uint32_t srcH,
+                  const int32_t* offsets, const int32_t* weights, uint32_t n, uint8_t* dst, int simd)
+{
+  switch(simd) {
+#if defined(TY_MAPPER_X86)
+    case TY_MAPPER_SIMD_AVX2:
+    case TY_MAPPER_SIMD_SSE41:
+      TYBilinearBlendRGB8SSE41(src, srcW, srcH, offsets, weights, n, dst);
+      return true;
+#endif
+#if defined(TY_MAPPER_NEON)
+    case TY_MAPPER_SIMD_NEON:
+      TYBilinearBlendRGB8NEON(src, srcW, srcH, offsets, weights, n, dst);
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+/// Bilinear fetch for lut entries [begin, end), p3d holding the matching points in color camera
+/// space. A neighbour whose channels differ from the nearest neighbour by more than edge_threshold
+/// is left out of the blend, edge_threshold < 0 blends all four. Invalid entries are set to 0.
+template<typename T, int CN>
+static inline void TYSampleImageRangeBilinear(const TY_PIXEL_DESC* lut, const TY_VECT_3F* p3d,
+                  uint32_t begin, uint32_t end, uint32_t depthW, uint32_t depthH,
+                  const float* k, uint32_t srcW, uint32_t srcH, const T* src, T* dst,
+                  int32_t edge_threshold, int simd = TYGetSimdLevel())
+{
+  const uint32_t kBlock = 256;
+  int32_t offsets[kBlock];
+  int32_t weights[kBlock];
+  const int32_t stride = srcW * CN;
+  for(uint32_t i = begin; i < end; i += kBlock) {
+    uint32_t n = (end - i < kBlock) ? end - i : kBlock;
+    TYProjectToBilinear(lut + i, p3d + i, n, depthW, depthH, k, srcW, srcH, offsets, weights, simd);
+    T* outPtr = &dst[i * CN];
+    if(sizeof(T) == 1 && CN == 3 && edge_threshold < 0
+          && TYBilinearBlendRGB8((const uint8_t*)src, srcW, srcH, offsets, weights, n, (uint8_t*)outPtr, simd)) {
+      continue;
+    }
+    for(uint32_t j = 0; j < n; j++, outPtr += CN) {
+      if(offsets[j] < 0) {
+        for(int ch = 0; ch < CN; ch++) outPtr[ch] = 0;
+        continue;
+      }
+      const T* p00 = &src[offsets[j] * CN];
+      const T* p10 = p00 + stride;
+      uint32_t wx = weights[j] & 0xff, wy = weights[j] >> 8;
+
+      if(edge_threshold >= 0) {
+        const T* p[4] = { p00, p00 + CN, p10, p10 + CN };
+        const T* nearest = p[(wx >= 64 ? 1 : 0) + (wy >= 64 ? 2 : 0)];
+        int64_t w[4] = { (128 - wx) * (128 - wy), wx * (128 - wy), (128 - wx) * wy, wx * wy };
+        int64_t wsum = 0;
+        for(int q = 0; q < 4; q++) {
+          for(int ch = 0; ch < CN; ch++) {
+            if(abs((int32_t)p[q][ch] - (int32_t)nearest[ch]) > edge_threshold) {
+              w[q] = 0;
+              break;
+            }
+          }
+          wsum += w[q];
+        }
+        if(wsum != 128 * 128) {
+          for(int ch = 0; ch < CN; ch++) {
+            int64_t acc = w[0] * p[0][ch] + w[1] * p[1][ch] + w[2] * p[2][ch] + w[3] * p[3][ch];
+            outPtr[ch] = (T)((acc + wsum / 2) / wsum);
+          }
+          continue;
+        }
+      }
+      // rows first, then columns, total weight 1 << 14 fits 32 bit for 16 bit sources
+      for(int ch = 0; ch < CN; ch++) {
+        uint32_t top = p00[ch] * 128 + (p00[CN + ch] - p00[ch]) * wx;
+        uint32_t bottom = p10[ch] * 128 + (p10[CN + ch] - p10[ch]) * wx;
+        outPtr[ch] = (T)((top * 128 + (bottom - top) * wy + (1 << 13)) >> 14);
+      }
+    }
+  }
+}
+
+static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t rgbW, uint32_t rgbH, const uint8_t* inRgb,
+                  uint8_t* mappedRgb, float f_scale_unit)
+{
+  TY_PIXEL_DESC* lut = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * depthW * depthH);
+  TYMAP_CHECKRET(TYCreateDepthToColorCoordinateLookupTable(
+                    depth_calib, depthW, depthH, depth,
+                    color_calib, depthW, depthH, lut, f_scale_unit), lut);
+  TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
+  TYSampleImageByLookupTable<uint8_t, 3>(lut, depthW, depthH, rgbW, rgbH, inRgb, mappedRgb);
+  free(lut);
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
                   const TY_CAMERA_CALIB_INFO* color_calib,
                   uint32_t rgbW, uint32_t rgbH, const uint16_t* inRgb,
                   uint16_t* mappedRgb, float f_scale_unit)
@@ -467,25 +1683,7 @@ static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
                     depth_calib, depthW, depthH, depth,
                     color_calib, depthW, depthH, lut, f_scale_unit), lut);
   TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
-
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
-  {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint16_t* outPtr = &mappedRgb[depthW * depthr * 3 + depthc * 3];
-    if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = outPtr[1] = outPtr[2] = 0;
-    } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * rgbW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * rgbH / depthH + 0.5);
-      if(scale_x >= rgbW) scale_x = rgbW - 1;
-      if(scale_y >= rgbH) scale_y = rgbH - 1;
-      const uint16_t* inPtr = &inRgb[rgbW * scale_y * 3 + scale_x * 3];
-      outPtr[0] = inPtr[0];
-      outPtr[1] = inPtr[1];
-      outPtr[2] = inPtr[2];
-    }
-  }
+  TYSampleImageByLookupTable<uint16_t, 3>(lut, depthW, depthH, rgbW, rgbH, inRgb, mappedRgb);
   free(lut);
   return TY_STATUS_OK;
 }
@@ -502,23 +1700,7 @@ static inline TY_STATUS TYMapMono16ImageToDepthCoordinate(
                     depth_calib, depthW, depthH, depth,
                     color_calib, depthW, depthH, lut, f_scale_unit), lut);
   TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
-
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
-  {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint16_t* outPtr = &mappedGray[depthW * depthr + depthc];
-    if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = 0;
-    } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * rgbW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * rgbH / depthH + 0.5);
-      if(scale_x >= rgbW) scale_x = rgbW - 1;
-      if(scale_y >= rgbH) scale_y = rgbH - 1;
-      const uint16_t* inPtr = &gray[rgbW * scale_y + scale_x];
-      outPtr[0] = inPtr[0];
-    }
-  }
+  TYSampleImageByLookupTable<uint16_t, 1>(lut, depthW, depthH, rgbW, rgbH, gray, mappedGray);
   free(lut);
   return TY_STATUS_OK;
 }
@@ -535,26 +1717,870 @@ static inline TY_STATUS TYMapMono8ImageToDepthCoordinate(
                     depth_calib, depthW, depthH, depth,
                     color_calib, depthW, depthH, lut, f_scale_unit), lut);
   TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
+  TYSampleImageByLookupTable<uint8_t, 1>(lut, depthW, depthH, monoW, monoH, inMono, mappedMono);
+  free(lut);
+  return TY_STATUS_OK;
+}
+
+// ------------------------------
+//  occlusion z-buffer
+// ------------------------------
+
+// The occlusion z-buffer keeps depth - 1, so empty pixels are 0xffff and a plain
+// min merges points and spreads them over the radius.
+
+/// Min depth splat of lut entries landing in zbuffer rows [row0, row1).
+static inline void TYPixelsOcclusionScatter(const TY_PIXEL_DESC* lut, uint32_t count,
+                  int32_t imageW, int32_t row0, int32_t row1, uint16_t* zbuffer)
+{
+  for(uint32_t i = 0; i < count; i++) {
+    const TY_PIXEL_DESC& p = lut[i];
+    if(!p.depth || p.x < 0 || p.x >= imageW || p.y < row0 || p.y >= row1) continue;
+    uint16_t* z = &zbuffer[p.y * imageW + p.x];
+    *z = std::min<uint16_t>(*z, p.depth - 1);
+  }
+}
+
+/// One round of the 3 pixel min along a row, scalar from pixel x on, left is the original z[x - 1].
+static inline void TYOcclusionSpreadRowC(uint16_t* z, int32_t imageW, int32_t x, uint16_t left)
+{
+  for(; x < imageW - 1; x++) {
+    uint16_t cur = z[x];
+    z[x] = std::min(std::min(left, cur), z[x + 1]);
+    left = cur;
+  }
+  if(x == imageW - 1) z[x] = std::min(left, z[x]);
+}
+
+#if defined(TY_MAPPER_X86)
+TY_MAPPER_TARGET("sse4.1")
+static inline void TYOcclusionSpreadRowSSE41(uint16_t* z, int32_t imageW)
+{
+  __m128i prev = _mm_set1_epi16(-1);
+  int32_t x = 0;
+  // next reads one pixel ahead, not yet overwritten
+  for(; x + 9 <= imageW; x += 8) {
+    __m128i cur = _mm_loadu_si128((const __m128i*)&z[x]);
+    __m128i next = _mm_loadu_si128((const __m128i*)&z[x + 1]);
+    __m128i left = _mm_alignr_epi8(cur, prev, 14);
+    _mm_storeu_si128((__m128i*)&z[x], _mm_min_epu16(_mm_min_epu16(left, cur), next));
+    prev = cur;
+  }
+  TYOcclusionSpreadRowC(z, imageW, x, (uint16_t)_mm_extract_epi16(prev, 7));
+}
+#endif
+
+#if defined(TY_MAPPER_NEON)
+static inline void TYOcclusionSpreadRowNEON(uint16_t* z, int32_t imageW)
+{
+  uint16x8_t prev = vdupq_n_u16(0xffff);
+  int32_t x = 0;
+  for(; x + 9 <= imageW; x += 8) {
+    uint16x8_t cur = vld1q_u16(&z[x]);
+    uint16x8_t next = vld1q_u16(&z[x + 1]);
+    uint16x8_t left = vextq_u16(prev, cur, 7);
+    vst1q_u16(&z[x], vminq_u16(vminq_u16(left, cur), next));
+    prev = cur;
+  }
+  TYOcclusionSpreadRowC(z, imageW, x, vgetq_lane_u16(prev, 7));
+}
+#endif
+
+/// Min over [x - r, x + r] for zbuffer rows [row0, row1), in place.
+/// Each round widens the window by one pixel on both sides.
+static inline void TYOcclusionSpreadRows(uint16_t* zbuffer, int32_t imageW,
+                  int32_t row0, int32_t row1, int32_t r, int simd = TYGetSimdLevel())
+{
+  for(int32_t y = row0; y < row1; y++) {
+    uint16_t* z = &zbuffer[y * imageW];
+    for(int32_t k = 0; k < r; k++) {
+      switch(simd) {
+#if defined(TY_MAPPER_X86)
+        case TY_MAPPER_SIMD_AVX2:
+        case TY_MAPPER_SIMD_SSE41:
+          TYOcclusionSpreadRowSSE41(z, imageW);
+          break;
+#endif
+#if defined(TY_MAPPER_NEON)
+        case TY_MAPPER_SIMD_NEON:
+          TYOcclusionSpreadRowNEON(z, imageW);
+          break;
+#endif
+        default:
+          TYOcclusionSpreadRowC(z, imageW, 0, 0xffff);
+          break;
+      }
+    }
+  }
+}
+
+/// Min over [y - r, y + r] for zbuffer columns [col0, col1), in place.
+static inline void TYOcclusionSpreadColumns(uint16_t* zbuffer, int32_t imageW, int32_t imageH,
+                  int32_t col0, int32_t col1, int32_t r)
+{
+  for(int32_t k = 0; k < r; k++) {
+    for(int32_t y = 0; y < imageH - 1; y++) {
+      uint16_t* z = &zbuffer[y * imageW];
+      const uint16_t* below = z + imageW;
+      for(int32_t x = col0; x < col1; x++) z[x] = std::min(z[x], below[x]);
+    }
+    for(int32_t y = imageH - 1; y > 0; y--) {
+      uint16_t* z = &zbuffer[y * imageW];
+      const uint16_t* above = z - imageW;
+      for(int32_t x = col0; x < col1; x++) z[x] = std::min(z[x], above[x]);
+    }
+  }
+}
+
+/// Reject lut entries lying behind the z-buffer by more than the params threshold.
+static inline void TYPixelsOcclusionCheck(TY_PIXEL_DESC* lut, uint32_t count,
+                  int32_t imageW, int32_t imageH,
+                  const TYOcclusionParams* params, const uint16_t* zbuffer)
+{
+  // threshold + relative * depth in 16.16 fixed point
+  const int64_t base = (int64_t)(params->threshold * 65536.f);
+  const int64_t slope = (int64_t)(params->relative * 65536.f);
+  for(uint32_t i = 0; i < count; i++) {
+    TY_PIXEL_DESC& p = lut[i];
+    if(!p.depth || p.x < 0 || p.y < 0 || p.x >= imageW || p.y >= imageH) continue;
+    int64_t behind = p.depth - 1 - zbuffer[p.y * imageW + p.x];
+    if(behind * 65536 > base + slope * p.depth) {
+      p.x = -1;
+      p.y = -1;
+      p.depth = 0;
+    }
+  }
+}
+
+static inline void TYPixelsOcclusionResolve(TY_PIXEL_DESC* lut, uint32_t count,
+                  uint32_t imageW, uint32_t imageH,
+                  const TYOcclusionParams* params, uint16_t* zbuffer)
+{
+  memset(zbuffer, 0xff, sizeof(uint16_t) * imageW * imageH);
+  TYPixelsOcclusionScatter(lut, count, imageW, 0, imageH, zbuffer);
+  TYOcclusionSpreadRows(zbuffer, imageW, 0, imageH, params->radius);
+  TYOcclusionSpreadColumns(zbuffer, imageW, imageH, 0, imageW, params->radius);
+  TYPixelsOcclusionCheck(lut, count, imageW, imageH, params, zbuffer);
+}
+
+// ------------------------------
+//  registration worker pool
+// ------------------------------
 
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
+/// Fixed set of threads running indexed tasks for the registration context.
+/// The calling thread of run() takes tasks too, so a pool of n - 1 workers
+/// gives n way parallelism. Workers sleep between calls.
+class TYMapperWorkerPool
+{
+public:
+  /// Throws like std::thread when a worker can not be started, the ones already
+  /// running are joined first.
+  explicit TYMapperWorkerPool(uint32_t workers)
+    : m_next(0), m_fn(NULL), m_arg(NULL), m_tasks(0), m_pending(0), m_generation(0), m_exit(false)
   {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint8_t* outPtr = &mappedMono[depthW * depthr + depthc];
-    if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = 0;
+    try {
+      m_threads.reserve(workers);
+      for(uint32_t i = 0; i < workers; i++) {
+        m_threads.push_back(std::thread(&TYMapperWorkerPool::workerLoop, this));
+      }
+    } catch(...) {
+      stop();
+      throw;
+    }
+  }
+
+  ~TYMapperWorkerPool()
+  {
+    stop();
+  }
+
+  /// Call fn(arg, 0) .. fn(arg, tasks - 1) over the pool and the calling thread, return once all finished.
+  void run(uint32_t tasks, void (*fn)(void*, uint32_t), void* arg)
+  {
+    uint32_t generation;
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      generation = ++m_generation;
+      m_fn = fn;
+      m_arg = arg;
+      m_tasks = tasks;
+      m_pending = tasks;
+      m_next = (uint64_t)generation << 32;
+    }
+    m_wake.notify_all();
+    runTasks(generation, fn, arg, tasks);
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_done.wait(lock, [this]() { return m_pending == 0; });
+    m_fn = NULL;
+    m_arg = NULL;
+  }
+
+  /// Call f(0) .. f(tasks - 1), f stays with the caller so nothing is allocated.
+  template<typename F>
+  void run(uint32_t tasks, const F& f)
+  {
+    run(tasks, &TYMapperWorkerPool::invoke<F>, (void*)&f);
+  }
+
+private:
+  template<typename F>
+  static void invoke(void* f, uint32_t task)
+  {
+    (*(const F*)f)(task);
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_exit = true;
+    }
+    m_wake.notify_all();
+    for(size_t i = 0; i < m_threads.size(); i++) {
+      m_threads[i].join();
+    }
+    m_threads.clear();
+  }
+
+  // m_next holds the generation in its high half, so a worker waking up late
+  // can never claim a task of a later run() with the function of an older one.
+  void runTasks(uint32_t generation, void (*fn)(void*, uint32_t), void* arg, uint32_t tasks)
+  {
+    uint32_t finished = 0;
+    uint64_t cur = m_next.load();
+    while((uint32_t)(cur >> 32) == generation && (uint32_t)cur < tasks) {
+      if(!m_next.compare_exchange_weak(cur, cur + 1)) continue;
+      fn(arg, (uint32_t)cur);
+      finished++;
+      cur = m_next.load();
+    }
+    if(finished) {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_pending -= finished;
+      if(m_pending == 0) m_done.notify_one();
+    }
+  }
+
+  void workerLoop()
+  {
+    uint32_t seen = 0;
+    while(true) {
+      void (*fn)(void*, uint32_t);
+      void* arg;
+      uint32_t tasks;
+      {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_wake.wait(lock, [&]() { return m_exit || m_generation != seen; });
+        if(m_exit) return;
+        seen = m_generation;
+        fn = m_fn;
+        arg = m_arg;
+        tasks = m_tasks;
+      }
+      if(fn) runTasks(seen, fn, arg, tasks);
+    }
+  }
+
+  std::vector<std::thread>                  m_threads;
+  std::mutex                                m_lock;
+  std::condition_variable                   m_wake;
+  std::condition_variable                   m_done;
+  std::atomic<uint64_t>                     m_next;
+  void                                      (*m_fn)(void*, uint32_t);
+  void*                                     m_arg;
+  uint32_t                                  m_tasks;
+  uint32_t                                  m_pending;
+  uint32_t                                  m_generation;
+  bool                                      m_exit;
+};
+
+static inline TY_STATUS TYCreateRegistrationContext(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  TYRegistrationContext** ctx,
+                  float f_scale_unit)
+{
+  if(!depth_calib || !color_calib || !ctx) return TY_STATUS_NULL_POINTER;
+  if(!depthW || !depthH) return TY_STATUS_INVALID_PARAMETER;
+
+  TYRegistrationContext* c = (TYRegistrationContext*)calloc(1, sizeof(TYRegistrationContext));
+  if(!c) return TY_STATUS_OUT_OF_MEMORY;
+  c->depth_calib = *depth_calib;
+  c->color_calib = *color_calib;
+  c->depthW = depthW;
+  c->depthH = depthH;
+  c->f_scale_unit = f_scale_unit;
+  c->threads = 1;
+  c->sample_mode = TY_REGISTRATION_SAMPLE_NEAREST;
+  c->edge_threshold = 24;
+  c->zbuffer_occlusion = false;
+  c->occlusion.radius = 1;
+  c->occlusion.threshold = 5.f;
+  c->occlusion.relative = 0.005f;
+
+  TY_STATUS err = TYInvertExtrinsic(&color_calib->extrinsic, &c->extri_inv);
+  if(err) {
+    free(c);
+    return err;
+  }
+
+  c->p3d = (TY_VECT_3F*)malloc(sizeof(TY_VECT_3F) * depthW * depthH);
+  c->lut = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * depthW * depthH);
+  c->zbuffer = (uint16_t*)malloc(sizeof(uint16_t) * depthW * depthH);
+  if(!c->p3d || !c->lut || !c->zbuffer) {
+    TYDestroyRegistrationContext(c);
+    return TY_STATUS_OUT_OF_MEMORY;
+  }
+
+  *ctx = c;
+  return TY_STATUS_OK;
+}
+
+static inline void TYDestroyRegistrationContext(TYRegistrationContext* ctx)
+{
+  if(!ctx) return;
+  delete ctx->pool;
+  free(ctx->spill);
+  free(ctx->spill_count);
+  free(ctx->band_status);
+  free(ctx->p3d);
+  free(ctx->lut);
+  free(ctx->zbuffer);
+  free(ctx);
+}
+
+/// Back to one thread, drop the pool and the band buffers.
+static inline void TYRegistrationReleaseBands(TYRegistrationContext* ctx)
+{
+  delete ctx->pool;
+  free(ctx->spill);
+  free(ctx->spill_count);
+  free(ctx->band_status);
+  ctx->pool = NULL;
+  ctx->spill = NULL;
+  ctx->spill_count = NULL;
+  ctx->band_status = NULL;
+  ctx->threads = 1;
+}
+
+static inline TY_STATUS TYRegistrationSetThreadCount(
+                  TYRegistrationContext* ctx, uint32_t threads)
+{
+  if(!ctx) return TY_STATUS_NULL_POINTER;
+  if(threads == 0) threads = std::thread::hardware_concurrency();
+  if(threads > ctx->depthH) threads = ctx->depthH;
+  if(threads == 0) threads = 1;
+  if(threads == ctx->threads) return TY_STATUS_OK;
+
+  TYRegistrationReleaseBands(ctx);
+  if(threads == 1) return TY_STATUS_OK;
+
+  ctx->spill = (uint32_t*)malloc(sizeof(uint32_t) * ctx->depthW * ctx->depthH);
+  ctx->spill_count = (uint32_t*)calloc(threads, sizeof(uint32_t));
+  ctx->band_status = (TY_STATUS*)calloc(threads, sizeof(TY_STATUS));
+  if(ctx->spill && ctx->spill_count && ctx->band_status) {
+    // thread creation failures must not leave this C interface as exceptions
+    try {
+      ctx->pool = new TYMapperWorkerPool(threads - 1);
+    } catch(...) {
+      ctx->pool = NULL;
+    }
+  }
+  if(!ctx->pool) {
+    TYRegistrationReleaseBands(ctx);
+    return TY_STATUS_OUT_OF_MEMORY;
+  }
+  ctx->threads = threads;
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYRegistrationSetSampleMode(
+                  TYRegistrationContext* ctx, int mode,
+                  uint32_t edge_threshold)
+{
+  if(!ctx) return TY_STATUS_NULL_POINTER;
+  if(mode != TY_REGISTRATION_SAMPLE_NEAREST && mode != TY_REGISTRATION_SAMPLE_BILINEAR
+        && mode != TY_REGISTRATION_SAMPLE_EDGE_AWARE) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  ctx->sample_mode = mode;
+  ctx->edge_threshold = edge_threshold;
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYRegistrationSetOcclusion(
+                  TYRegistrationContext* ctx, const TYOcclusionParams* params)
+{
+  if(!ctx) return TY_STATUS_NULL_POINTER;
+  ctx->zbuffer_occlusion = params != NULL;
+  if(params) ctx->occlusion = *params;
+  return TY_STATUS_OK;
+}
+
+/// First lut index of row band b when the image is split in ctx->threads bands.
+static inline uint32_t TYRegistrationBandBegin(const TYRegistrationContext* ctx, uint32_t b)
+{
+  return (uint32_t)((uint64_t)ctx->depthH * b / ctx->threads) * ctx->depthW;
+}
+
+/// Band part of the lookup table update. Each band owns the same rows of the
+/// z-buffer, so it only writes the points landing there and keeps the others
+/// in its spill list for the serial merge.
+static inline TY_STATUS TYRegistrationUpdateBand(TYRegistrationContext* ctx, const uint16_t* depth, uint32_t b)
+{
+  uint32_t W = ctx->depthW, H = ctx->depthH;
+  uint32_t begin = TYRegistrationBandBegin(ctx, b);
+  uint32_t end = TYRegistrationBandBegin(ctx, b + 1);
+  uint32_t n = end - begin;
+  TY_PIXEL_DESC* lut = ctx->lut + begin;
+  TY_VECT_3F* p3d = ctx->p3d + begin;
+
+  // depth pixels of the band, lut doubles as input buffer
+  for(uint32_t i = 0; i < n; i++) {
+    lut[i].x = (int16_t)((begin + i) % W);
+    lut[i].y = (int16_t)((begin + i) / W);
+    lut[i].depth = depth[begin + i];
+    lut[i].rsvd = 0;
+  }
+  TY_STATUS err;
+  err = TYMapDepthToPoint3d(&ctx->depth_calib, W, H, lut, n, p3d, ctx->f_scale_unit);
+  if(err) return err;
+  err = TYMapPoint3dToPoint3d(&ctx->extri_inv, p3d, n, p3d);
+  if(err) return err;
+  err = TYMapPoint3dToDepth(&ctx->color_calib, p3d, n, W, H, lut, ctx->f_scale_unit);
+  if(err) return err;
+
+  int32_t row0 = (int32_t)(begin / W), row1 = (int32_t)(end / W);
+  uint16_t* zbuffer = ctx->zbuffer;
+  uint32_t* spill = ctx->spill + begin;
+  uint32_t spilled = 0;
+  bool occlusion = ctx->zbuffer_occlusion;
+  memset(zbuffer + begin, occlusion ? 0xff : 0, sizeof(uint16_t) * n);
+  for(uint32_t i = 0; i < n; i++) {
+    if(lut[i].x < 0 || lut[i].y < 0 || lut[i].x >= (int32_t)W || lut[i].y >= (int32_t)H || !lut[i].depth) continue;
+    if(lut[i].y < row0 || lut[i].y >= row1) {
+      spill[spilled++] = begin + i;
+      continue;
+    }
+    uint16_t* z = &zbuffer[lut[i].y * W + lut[i].x];
+    if(occlusion) {
+      *z = std::min<uint16_t>(*z, lut[i].depth - 1);
+    } else if(*z == 0 || *z >= lut[i].depth) {
+      *z = lut[i].depth;
+    }
+  }
+  ctx->spill_count[b] = spilled;
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYRegistrationUpdateLookupTableParallel(
+                  TYRegistrationContext* ctx, const uint16_t* depth)
+{
+  uint32_t W = ctx->depthW, H = ctx->depthH;
+  ctx->pool->run(ctx->threads, [&](uint32_t b) {
+    ctx->band_status[b] = TYRegistrationUpdateBand(ctx, depth, b);
+  });
+  for(uint32_t b = 0; b < ctx->threads; b++) {
+    if(ctx->band_status[b]) return ctx->band_status[b];
+  }
+
+  // merge points crossing band borders, min of depths does not depend on order
+  for(uint32_t b = 0; b < ctx->threads; b++) {
+    const uint32_t* spill = ctx->spill + TYRegistrationBandBegin(ctx, b);
+    for(uint32_t k = 0; k < ctx->spill_count[b]; k++) {
+      const TY_PIXEL_DESC& p = ctx->lut[spill[k]];
+      uint16_t* z = &ctx->zbuffer[p.y * W + p.x];
+      if(ctx->zbuffer_occlusion) {
+        *z = std::min<uint16_t>(*z, p.depth - 1);
+      } else if(*z == 0 || *z >= p.depth) {
+        *z = p.depth;
+      }
+    }
+  }
+  if(ctx->zbuffer_occlusion) {
+    int32_t r = ctx->occlusion.radius;
+    ctx->pool->run(ctx->threads, [&](uint32_t b) {
+      TYOcclusionSpreadRows(ctx->zbuffer, W, TYRegistrationBandBegin(ctx, b) / W, TYRegistrationBandBegin(ctx, b + 1) / W, r);
+    });
+    ctx->pool->run(ctx->threads, [&](uint32_t b) {
+      TYOcclusionSpreadColumns(ctx->zbuffer, W, H, (uint64_t)W * b / ctx->threads, (uint64_t)W * (b + 1) / ctx->threads, r);
+    });
+  } else {
+    TYDepthImageFillEmptyRegion(ctx->zbuffer, W, H);
+  }
+
+  ctx->pool->run(ctx->threads, [&](uint32_t b) {
+    uint32_t begin = TYRegistrationBandBegin(ctx, b);
+    uint32_t end = TYRegistrationBandBegin(ctx, b + 1);
+    if(ctx->zbuffer_occlusion) {
+      TYPixelsOcclusionCheck(ctx->lut + begin, end - begin, W, H, &ctx->occlusion, ctx->zbuffer);
     } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * monoW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * monoH / depthH + 0.5);
-      if(scale_x >= monoW) scale_x = monoW - 1;
-      if(scale_y >= monoH) scale_y = monoH - 1;
-      const uint8_t* inPtr = &inMono[monoW * scale_y + scale_x];
-      outPtr[0] = inPtr[0];
+      TYPixelsOverlapReject(ctx->lut + begin, end - begin, W, H, ctx->zbuffer);
     }
+  });
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYRegistrationUpdateLookupTable(
+                  TYRegistrationContext* ctx, const uint16_t* depth)
+{
+  if(ctx->pool) return TYRegistrationUpdateLookupTableParallel(ctx, depth);
+
+  uint32_t count = ctx->depthW * ctx->depthH;
+  TY_STATUS err;
+  err = TYMapDepthImageToPoint3d(&ctx->depth_calib, ctx->depthW, ctx->depthH, depth, ctx->p3d, ctx->f_scale_unit);
+  if(err) return err;
+  err = TYMapPoint3dToPoint3d(&ctx->extri_inv, ctx->p3d, count, ctx->p3d);
+  if(err) return err;
+  err = TYMapPoint3dToDepth(&ctx->color_calib, ctx->p3d, count, ctx->depthW, ctx->depthH, ctx->lut, ctx->f_scale_unit);
+  if(err) return err;
+  if(ctx->zbuffer_occlusion) {
+    TYPixelsOcclusionResolve(ctx->lut, count, ctx->depthW, ctx->depthH, &ctx->occlusion, ctx->zbuffer);
+  } else {
+    TYPixelsOverlapRemove(ctx->lut, count, ctx->depthW, ctx->depthH, ctx->zbuffer);
   }
-  free(lut);
   return TY_STATUS_OK;
 }
 
+/// Sample src through ctx->lut with ctx->sample_mode, split over the context threads.
+template<typename T, int CN>
+static inline void TYRegistrationSampleImage(TYRegistrationContext* ctx,
+                  uint32_t srcW, uint32_t srcH, const T* src, T* dst)
+{
+  // bilinear needs a 2x2 neighbourhood
+  bool bilinear = ctx->sample_mode != TY_REGISTRATION_SAMPLE_NEAREST && srcW >= 2 && srcH >= 2;
+  float k[4];
+  int32_t edge_threshold = -1;
+  if(bilinear) {
+    TYScaledIntrinsic(&ctx->color_calib, srcW, srcH, k);
+    if(ctx->sample_mode == TY_REGISTRATION_SAMPLE_EDGE_AWARE) {
+      edge_threshold = (int32_t)std::min<uint64_t>(ctx->edge_threshold * (sizeof(T) > 1 ? 257ull : 1ull), 0x7fffffff);
+    }
+  }
+  // a plain lambda, std::function would allocate for its captures every frame
+  auto sample = [&](uint32_t begin, uint32_t end) {
+    if(bilinear) {
+      TYSampleImageRangeBilinear<T, CN>(ctx->lut, ctx->p3d, begin, end, ctx->depthW, ctx->depthH,
+            k, srcW, srcH, src, dst, edge_threshold);
+    } else {
+      TYSampleImageRangeByLookupTable<T, CN>(ctx->lut, begin, end,
+            ctx->depthW, ctx->depthH, srcW, srcH, src, dst);
+    }
+  };
+
+  if(!ctx->pool) {
+    sample(0, ctx->depthW * ctx->depthH);
+    return;
+  }
+  ctx->pool->run(ctx->threads, [&](uint32_t b) {
+    sample(TYRegistrationBandBegin(ctx, b), TYRegistrationBandBegin(ctx, b + 1));
+  });
+}
+
+static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t rgbW, uint32_t rgbH, const uint8_t* inRgb,
+                  uint8_t* mappedRgb)
+{
+  TY_STATUS err = TYRegistrationUpdateLookupTable(ctx, depth);
+  if(err) return err;
+  TYRegistrationSampleImage<uint8_t, 3>(ctx, rgbW, rgbH, inRgb, mappedRgb);
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t rgbW, uint32_t rgbH, const uint16_t* inRgb,
+                  uint16_t* mappedRgb)
+{
+  TY_STATUS err = TYRegistrationUpdateLookupTable(ctx, depth);
+  if(err) return err;
+  TYRegistrationSampleImage<uint16_t, 3>(ctx, rgbW, rgbH, inRgb, mappedRgb);
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYMapMono16ImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t rgbW, uint32_t rgbH, const uint16_t* gray,
+                  uint16_t* mappedGray)
+{
+  TY_STATUS err = TYRegistrationUpdateLookupTable(ctx, depth);
+  if(err) return err;
+  TYRegistrationSampleImage<uint16_t, 1>(ctx, rgbW, rgbH, gray, mappedGray);
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYMapMono8ImageToDepthCoordinate(
+                  TYRegistrationContext* ctx, const uint16_t* depth,
+                  uint32_t monoW, uint32_t monoH, const uint8_t* inMono,
+                  uint8_t* mappedMono)
+{
+  TY_STATUS err = TYRegistrationUpdateLookupTable(ctx, depth);
+  if(err) return err;
+  TYRegistrationSampleImage<uint8_t, 1>(ctx, monoW, monoH, inMono, mappedMono);
+  return TY_STATUS_OK;
+}
+
+/// Color position (x, y), depth w before f_scale_unit and footprint half size (hx, hy)
+/// of depth sample d at (u, v). False when the point is behind the color camera.
+static inline bool TYDepthToColorProjectSample(const TYDepthToColorProjection& p,
+                  float u, float v, float d,
+                  float& x, float& y, float& w, float& hx, float& hy)
+{
+  w = d * (p.c0[2] + u * p.du[2] + v * p.dv[2]) + p.t[2];
+  if(w <= 0.f) return false;
+  float iw = 1.f / w;
+  x = (d * (p.c0[0] + u * p.du[0] + v * p.dv[0]) + p.t[0]) * iw;
+  y = (d * (p.c0[1] + u * p.du[1] + v * p.dv[1]) + p.t[1]) * iw;
+  // bounding box of the parallelogram one depth pixel covers, from the derivatives along u and v
+  float s = 0.5f * d * iw;
+  hx = s * (fabsf(p.du[0] - x * p.du[2]) + fabsf(p.dv[0] - x * p.dv[2]));
+  hy = s * (fabsf(p.du[1] - y * p.du[2]) + fabsf(p.dv[1] - y * p.dv[2]));
+  return true;
+}
+
+static inline TY_STATUS TYCreateDepthToColorContext(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t depthW, uint32_t depthH,
+                  uint32_t mappedW, uint32_t mappedH,
+                  TYDepthToColorContext** ctx,
+                  float f_scale_unit)
+{
+  if(!depth_calib || !color_calib || !ctx) return TY_STATUS_NULL_POINTER;
+  if(!depthW || !depthH || !mappedW || !mappedH) return TY_STATUS_INVALID_PARAMETER;
+
+  TYDepthToColorContext* c = (TYDepthToColorContext*)calloc(1, sizeof(TYDepthToColorContext));
+  if(!c) return TY_STATUS_OUT_OF_MEMORY;
+  TY_STATUS err = TYInitDepthToColorProjection(depth_calib, depthW, depthH,
+                    color_calib, mappedW, mappedH, &c->proj, f_scale_unit);
+  if(err) {
+    free(c);
+    return err;
+  }
+  c->depthW = depthW;
+  c->depthH = depthH;
+  c->mappedW = mappedW;
+  c->mappedH = mappedH;
+  c->f_scale_unit = f_scale_unit;
+  c->min_depth = 200.f / f_scale_unit;
+  c->max_depth = 10000.f / f_scale_unit;
+
+  // nominal footprint at the image center, the per sample footprint grows at most 2x
+  // from it, beyond that the sample is on a surface seen edge on
+  float x, y, w, hx = 0.5f, hy = 0.5f;
+  TYDepthToColorProjectSample(c->proj, 0.5f * depthW, 0.5f * depthH, 1000.f / f_scale_unit, x, y, w, hx, hy);
+  float size = 2.f * std::max(std::max(hx, hy), 0.5f);
+  c->footprint_limit = size + 1.f;
+  c->max_hole = std::max(2u, 2 * (uint32_t)ceilf(size));
+
+  *ctx = c;
+  return TY_STATUS_OK;
+}
+
+static inline void TYDestroyDepthToColorContext(TYDepthToColorContext* ctx)
+{
+  if(!ctx) return;
+  free(ctx);
+}
+
+static inline TY_STATUS TYDepthToColorSetDepthRange(
+                  TYDepthToColorContext* ctx,
+                  uint32_t min_distance, uint32_t max_distance)
+{
+  if(!ctx) return TY_STATUS_NULL_POINTER;
+  if(!min_distance || min_distance > max_distance) return TY_STATUS_INVALID_PARAMETER;
+  ctx->min_depth = min_distance / ctx->f_scale_unit;
+  ctx->max_depth = max_distance / ctx->f_scale_unit;
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYDepthToColorSetHoleFill(
+                  TYDepthToColorContext* ctx, uint32_t max_hole)
+{
+  if(!ctx) return TY_STATUS_NULL_POINTER;
+  ctx->max_hole = max_hole;
+  return TY_STATUS_OK;
+}
+
+/// First color row reachable from depth rows [v, depthH) with depth in the context range.
+static inline uint32_t TYDepthToColorRowBound(const TYDepthToColorContext* ctx, uint32_t v)
+{
+  if(v >= ctx->depthH) return ctx->mappedH;
+  // w is multilinear in (u, v, d), so positive at the 8 corners means positive in the box,
+  // and y, a ratio of two such functions, is then monotonic along each axis: its minimum
+  // is at a corner
+  const float us[2] = { 0.f, ctx->depthW - 1.f };
+  const float vs[2] = { (float)v, ctx->depthH - 1.f };
+  const float ds[2] = { ctx->min_depth, ctx->max_depth };
+  float lo = (float)ctx->mappedH;
+  for(int i = 0; i < 8; i++) {
+    float x, y, w, hx, hy;
+    if(!TYDepthToColorProjectSample(ctx->proj, us[i & 1], vs[(i >> 1) & 1], ds[i >> 2], x, y, w, hx, hy)) {
+      return ctx->final_rows;
+    }
+    lo = std::min(lo, y);
+  }
+  // footprints reach footprint_limit above the center, one more row for float rounding
+  lo -= ctx->footprint_limit + 1.f;
+  if(lo <= (float)ctx->final_rows) return ctx->final_rows;
+  return std::min((uint32_t)ceilf(lo), ctx->mappedH);
+}
+
+/// floorf and ceilf are library calls without SSE4.1, truncation is enough in range.
+static inline int32_t TYFloorToInt(float a)
+{
+  int32_t i = (int32_t)a;
+  return a < i ? i - 1 : i;
+}
+
+static inline int32_t TYCeilToInt(float a)
+{
+  int32_t i = (int32_t)a;
+  return a > i ? i + 1 : i;
+}
+
+/// Z-buffer the footprint of every sample of depth row v, above row ctx->final_rows.
+static inline void TYDepthToColorSplatRow(TYDepthToColorContext* ctx, const uint16_t* row, uint32_t v)
+{
+  const int32_t W = ctx->mappedW, H = ctx->mappedH;
+  const int32_t top = ctx->final_rows;
+  const float lim = ctx->footprint_limit;
+  for(uint32_t u = 0; u < ctx->depthW; u++) {
+    if(!row[u]) continue;
+    float x, y, w, hx, hy;
+    if(!TYDepthToColorProjectSample(ctx->proj, (float)u, (float)v, row[u], x, y, w, hx, hy)) continue;
+    hx = std::min(hx, lim);
+    hy = std::min(hy, lim);
+    if(x + hx < -0.5f || y + hy < -0.5f || x - hx > W - 0.5f || y - hy > H - 0.5f) continue;
+
+    float z = w / ctx->f_scale_unit + 0.5f;
+    if(z >= 65536.f) continue;
+    uint16_t zv = (uint16_t)z;
+    if(!zv) continue;
+
+    // pixel centers inside the footprint, at least the nearest one
+    int32_t x0 = TYCeilToInt(x - hx), x1 = TYFloorToInt(x + hx);
+    int32_t y0 = TYCeilToInt(y - hy), y1 = TYFloorToInt(y + hy);
+    if(x0 > x1) x0 = x1 = TYFloorToInt(x + 0.5f);
+    if(y0 > y1) y0 = y1 = TYFloorToInt(y + 0.5f);
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, top);
+    x1 = std::min(x1, W - 1);
+    y1 = std::min(y1, H - 1);
+    for(int32_t yy = y0; yy <= y1; yy++) {
+      uint16_t* dst = &ctx->out[yy * W];
+      for(int32_t xx = x0; xx <= x1; xx++) {
+        // empty pixels wrap to 0xffff and always take the sample
+        if((uint16_t)(dst[xx] - 1) >= zv) dst[xx] = zv;
+      }
+    }
+  }
+}
+
+/// True if any of the 4 pixels at p is 0.
+static inline bool TYHasZero16x4(const uint16_t* p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return ((v - 0x0001000100010001ull) & ~v & 0x8000800080008000ull) != 0;
+}
+
+/// Fill holes of color rows [ctx->final_rows, end) and mark them final. Holes along a
+/// column are filled when the row closing them is reached, so rows keep changing up to
+/// max_hole rows after they are final.
+static inline void TYDepthToColorFinishRows(TYDepthToColorContext* ctx, uint32_t end)
+{
+  const int32_t W = ctx->mappedW;
+  const int32_t max_hole = ctx->max_hole;
+  for(int32_t r = ctx->final_rows; r < (int32_t)end && max_hole; r++) {
+    uint16_t* row = &ctx->out[r * W];
+    int32_t last = -1;
+    for(int32_t x = 0; x < W; x++) {
+      // skip 4 pixels at once while there is no hole
+      if(last == x - 1 && x + 4 <= W && !TYHasZero16x4(&row[x])) {
+        last = x + 3;
+        x += 3;
+        continue;
+      }
+      if(!row[x]) continue;
+      if(x - last > 1 && last >= 0 && x - last - 1 <= max_hole) {
+        uint16_t fill = std::max(row[last], row[x]);
+        for(int32_t k = last + 1; k < x; k++) row[k] = fill;
+      }
+      last = x;
+    }
+    if(r == 0) continue;
+    // a pixel under an empty one closes a column hole, look up for its top
+    const uint16_t* prev = row - W;
+    for(int32_t x = 0; x < W; x++) {
+      if(x + 4 <= W && !TYHasZero16x4(&prev[x])) {
+        x += 3;
+        continue;
+      }
+      if(!row[x] || prev[x]) continue;
+      int32_t top = r - 2;
+      while(top >= 0 && r - top - 1 <= max_hole && !ctx->out[top * W + x]) top--;
+      if(top < 0 || r - top - 1 > max_hole) continue;
+      uint16_t fill = std::max(ctx->out[top * W + x], row[x]);
+      for(int32_t k = top + 1; k < r; k++) ctx->out[k * W + x] = fill;
+    }
+  }
+  ctx->final_rows = std::max(ctx->final_rows, end);
+}
+
+static inline TY_STATUS TYDepthToColorBegin(
+                  TYDepthToColorContext* ctx, uint16_t* mappedDepth)
+{
+  if(!ctx || !mappedDepth) return TY_STATUS_NULL_POINTER;
+  memset(mappedDepth, 0, sizeof(uint16_t) * ctx->mappedW * ctx->mappedH);
+  ctx->out = mappedDepth;
+  ctx->next_row = 0;
+  ctx->final_rows = 0;
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYDepthToColorPushRows(
+                  TYDepthToColorContext* ctx,
+                  const uint16_t* rows, uint32_t rowCount,
+                  uint32_t* readyRows)
+{
+  if(!ctx || !rows) return TY_STATUS_NULL_POINTER;
+  if(!ctx->out) return TY_STATUS_WRONG_MODE;
+  if(rowCount > ctx->depthH - ctx->next_row) return TY_STATUS_INVALID_PARAMETER;
+
+  for(uint32_t i = 0; i < rowCount; i++) {
+    TYDepthToColorSplatRow(ctx, &rows[i * ctx->depthW], ctx->next_row + i);
+  }
+  ctx->next_row += rowCount;
+  TYDepthToColorFinishRows(ctx, TYDepthToColorRowBound(ctx, ctx->next_row));
+  if(readyRows) {
+    *readyRows = ctx->final_rows > ctx->max_hole ? ctx->final_rows - ctx->max_hole : 0;
+  }
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYDepthToColorEnd(TYDepthToColorContext* ctx)
+{
+  if(!ctx) return TY_STATUS_NULL_POINTER;
+  if(!ctx->out) return TY_STATUS_WRONG_MODE;
+  TYDepthToColorFinishRows(ctx, ctx->mappedH);
+  ctx->out = NULL;
+  return TY_STATUS_OK;
+}
+
+static inline TY_STATUS TYMapDepthImageToColorCoordinate(
+                  TYDepthToColorContext* ctx, const uint16_t* depth,
+                  uint16_t* mappedDepth)
+{
+  TY_STATUS err = TYDepthToColorBegin(ctx, mappedDepth);
+  if(err) return err;
+  err = TYDepthToColorPushRows(ctx, depth, ctx->depthH);
+  if(err) return err;
+  return TYDepthToColorEnd(ctx);
+}
+
 
 #endif
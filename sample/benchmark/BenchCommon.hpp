@@ -0,0 +1,303 @@
+#ifndef SAMPLE_BENCHMARK_BENCHCOMMON_HPP_
+#define SAMPLE_BENCHMARK_BENCHCOMMON_HPP_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#include "TYCoordinateMapper.h"
+#include "RawUnpack.hpp"
+
+/**
+ * Synthetic inputs and timing helpers shared by benchmarks.
+ * Nothing here talks to a device, calibration and frames are generated.
+ */
+
+static inline void benchIdentityExtrinsic(TY_CAMERA_EXTRINSIC* extri)
+{
+    memset(extri, 0, sizeof(*extri));
+    extri->data[0] = extri->data[5] = extri->data[10] = extri->data[15] = 1.f;
+}
+
+/// Depth camera plus an RGB camera mounted next to it, close to a real
+/// stereo module: ~25mm baseline and a small rotation between the two.
+static inline void benchMakeCalibPair(TY_CAMERA_CALIB_INFO* depth_calib, TY_CAMERA_CALIB_INFO* color_calib)
+{
+    memset(depth_calib, 0, sizeof(*depth_calib));
+    depth_calib->intrinsicWidth = 1280;
+    depth_calib->intrinsicHeight = 960;
+    float kd[9] = { 1048.6f, 0.f, 641.3f, 0.f, 1048.2f, 478.9f, 0.f, 0.f, 1.f };
+    memcpy(depth_calib->intrinsic.data, kd, sizeof(kd));
+    benchIdentityExtrinsic(&depth_calib->extrinsic);
+
+    memset(color_calib, 0, sizeof(*color_calib));
+    color_calib->intrinsicWidth = 1280;
+    color_calib->intrinsicHeight = 960;
+    float kc[9] = { 1112.4f, 0.f, 652.7f, 0.f, 1111.9f, 471.2f, 0.f, 0.f, 1.f };
+    memcpy(color_calib->intrinsic.data, kc, sizeof(kc));
+
+    // color to depth: rotation of ~0.5 degree around y and ~0.2 degree around x
+    float ay = 0.0087f, ax = 0.0035f;
+    float cy = cosf(ay), sy = sinf(ay), cx = cosf(ax), sx = sinf(ax);
+    float extri[16] = {
+        cy,       0.f,  sy,       -24.8f,
+        sx * sy,  cx,  -sx * cy,   0.6f,
+        -cx * sy, sx,   cx * cy,   1.3f,
+        0.f,      0.f,  0.f,       1.f };
+    memcpy(color_calib->extrinsic.data, extri, sizeof(extri));
+
+    float dist[12] = { -0.081f, 0.112f, 0.0004f, -0.0007f, -0.031f };
+    memcpy(color_calib->distortion.data, dist, sizeof(dist));
+}
+
+/// Slanted plane from ~800mm to ~1600mm with a box standing in front of it.
+static inline void benchMakeDepthScene(uint16_t* depth, uint32_t w, uint32_t h)
+{
+    for(uint32_t y = 0; y < h; y++) {
+        for(uint32_t x = 0; x < w; x++) {
+            uint16_t d = (uint16_t)(800 + 800 * x / w + 100 * y / h);
+            if(x > w * 3 / 8 && x < w * 5 / 8 && y > h / 3 && y < h * 2 / 3) d = 600;
+            depth[y * w + x] = d;
+        }
+    }
+}
+
+/// Small deterministic generator, scenes are identical on every platform.
+static inline uint32_t benchRand(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+enum BenchScene
+{
+    BENCH_SCENE_BOX = 0,    // benchMakeDepthScene
+    BENCH_SCENE_PLANE,      // slanted plane only
+    BENCH_SCENE_SPHERES,    // spheres in front of a wall
+    BENCH_SCENE_STEPS,      // vertical step edges 200mm apart
+    BENCH_SCENE_NOISE,      // plane with ~1% depth noise
+    BENCH_SCENE_HOLES,      // box scene with 20% pixels missing in blobs
+    BENCH_SCENE_COUNT
+};
+
+static inline const char* benchSceneName(int scene)
+{
+    static const char* names[BENCH_SCENE_COUNT] = { "box", "plane", "spheres", "steps", "noise", "holes" };
+    return scene >= 0 && scene < BENCH_SCENE_COUNT ? names[scene] : "unknown";
+}
+
+/// Depth scenes in mm, sized relative to the image so every resolution sees the same geometry.
+static inline void benchMakeScene(int scene, uint16_t* depth, uint32_t w, uint32_t h)
+{
+    uint32_t state = 12345;
+    switch(scene) {
+    case BENCH_SCENE_PLANE:
+        for(uint32_t y = 0; y < h; y++)
+            for(uint32_t x = 0; x < w; x++)
+                depth[y * w + x] = (uint16_t)(800 + 800 * x / w + 100 * y / h);
+        break;
+    case BENCH_SCENE_SPHERES: {
+        const float sx[3] = { 0.25f, 0.55f, 0.8f }, sy[3] = { 0.4f, 0.6f, 0.3f };
+        const float sr[3] = { 0.15f, 0.2f, 0.1f }, sz[3] = { 700.f, 1000.f, 1300.f };
+        for(uint32_t y = 0; y < h; y++) {
+            for(uint32_t x = 0; x < w; x++) {
+                float d = 2000.f;
+                for(int k = 0; k < 3; k++) {
+                    float dx = (1.f * x / w - sx[k]) * w / h, dy = 1.f * y / h - sy[k];
+                    float r2 = sr[k] * sr[k] - dx * dx - dy * dy;
+                    // radius in image units scaled to ~1m of depth
+                    if(r2 > 0.f) d = std::min(d, sz[k] - 1000.f * sqrtf(r2));
+                }
+                depth[y * w + x] = (uint16_t)d;
+            }
+        }
+        break;
+    }
+    case BENCH_SCENE_STEPS:
+        for(uint32_t y = 0; y < h; y++)
+            for(uint32_t x = 0; x < w; x++)
+                depth[y * w + x] = (uint16_t)(600 + 200 * (8 * x / w));
+        break;
+    case BENCH_SCENE_NOISE:
+        for(uint32_t y = 0; y < h; y++) {
+            for(uint32_t x = 0; x < w; x++) {
+                float d = 800.f + 800.f * x / w + 100.f * y / h;
+                float n = ((benchRand(state) & 0xffff) / 32768.f - 1.f) * 0.01f;
+                depth[y * w + x] = (uint16_t)(d * (1.f + n));
+            }
+        }
+        break;
+    case BENCH_SCENE_HOLES: {
+        benchMakeDepthScene(depth, w, h);
+        // square blobs of ~1% of the width until 20% of the pixels are gone
+        uint32_t r = std::max(1u, w / 100), removed = 0;
+        while(removed < w * h / 5) {
+            uint32_t cx = benchRand(state) % w, cy = benchRand(state) % h;
+            for(uint32_t y = cy; y < std::min(h, cy + r); y++) {
+                for(uint32_t x = cx; x < std::min(w, cx + r); x++) {
+                    if(depth[y * w + x]) removed++;
+                    depth[y * w + x] = 0;
+                }
+            }
+        }
+        break;
+    }
+    default:
+        benchMakeDepthScene(depth, w, h);
+        break;
+    }
+}
+
+static inline void benchMakeColorImage(uint8_t* rgb, uint32_t w, uint32_t h, int channels)
+{
+    for(uint32_t i = 0; i < w * h * channels; i++) {
+        rgb[i] = (uint8_t)((i * 2654435761u) >> 24);
+    }
+}
+
+/// Frame k of a depth + color sequence: scenes taking turns, a few mm of sensor
+/// noise and holes, so frames differ like real ones. buf holds the depth then
+/// the color pixels, frame points into it.
+static inline void benchMakeFrame(uint32_t k, uint32_t w, uint32_t h, std::vector<uint8_t>& buf, TY_FRAME_DATA& frame)
+{
+    size_t depth_size = w * h * 2, color_size = w * h * 3;
+    buf.resize(depth_size + color_size);
+    uint16_t* depth = reinterpret_cast<uint16_t*>(buf.data());
+    benchMakeScene(k % 3, depth, w, h);
+    uint32_t seed = k + 1;
+    for(uint32_t i = 0; i < w * h; i++) {
+        uint32_t r = benchRand(seed);
+        depth[i] = (r % 64 == 0) ? 0 : (uint16_t)(depth[i] + r % 4);
+    }
+    benchMakeColorImage(buf.data() + depth_size, w, h, 3);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.userBuffer = buf.data();
+    frame.bufferSize = (int32_t)buf.size();
+    frame.validCount = 2;
+    TY_IMAGE_DATA& d = frame.image[0];
+    d.componentID = TY_COMPONENT_DEPTH_CAM;
+    d.timestamp = 1000000 + k * 33333ull;
+    d.imageIndex = (int32_t)k;
+    d.width = w;
+    d.height = h;
+    d.size = (int32_t)depth_size;
+    d.pixelFormat = TYPixelFormatCoord3D_C16;
+    d.buffer = buf.data();
+    TY_IMAGE_DATA& c = frame.image[1];
+    c = d;
+    c.componentID = TY_COMPONENT_RGB_CAM;
+    c.size = (int32_t)color_size;
+    c.pixelFormat = TYPixelFormatRGB8;
+    c.buffer = buf.data() + depth_size;
+}
+
+/// Content hash to compare images read back with the ones written.
+static inline uint64_t benchChecksum(const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t sum = 0;
+    for(size_t i = 0; i < size; i++) sum = sum * 31 + p[i];
+    return sum;
+}
+
+/// Pack 16 bit samples, pixels a multiple of the group size, into a TY_RAW_* layout.
+static inline void benchPackRaw(int packing, const uint16_t* v, size_t pixels, uint8_t* dst)
+{
+    int group = TYRawGroupPixels(packing);
+    for(size_t i = 0; i < pixels; i += group, dst += TYRawGroupBytes(packing)) {
+        const uint16_t* p = v + i;
+        switch(packing) {
+        case TY_RAW_CSI10:
+            for(int k = 0; k < 4; k++) dst[k] = (uint8_t)(p[k] >> 2);
+            dst[4] = (uint8_t)((p[0] & 3) | (p[1] & 3) << 2 | (p[2] & 3) << 4 | (p[3] & 3) << 6);
+            break;
+        case TY_RAW_CSI12:
+            dst[0] = (uint8_t)(p[0] >> 4);
+            dst[1] = (uint8_t)(p[1] >> 4);
+            dst[2] = (uint8_t)((p[0] & 0xf) | (p[1] & 0xf) << 4);
+            break;
+        case TY_RAW_CSI14: {
+            uint32_t lo = 0;
+            for(int k = 0; k < 4; k++) {
+                dst[k] = (uint8_t)(p[k] >> 6);
+                lo |= (uint32_t)(p[k] & 0x3f) << (6 * k);
+            }
+            for(int k = 0; k < 3; k++) dst[4 + k] = (uint8_t)(lo >> (8 * k));
+            break;
+        }
+        case TY_RAW_PACKET10: {
+            uint64_t w = p[0] | (uint64_t)p[1] << 10 | (uint64_t)p[2] << 20 | (uint64_t)p[3] << 30;
+            for(int k = 0; k < 5; k++) dst[k] = (uint8_t)(w >> (8 * k));
+            break;
+        }
+        case TY_RAW_PACKET12: {
+            uint32_t w = p[0] | (uint32_t)p[1] << 12;
+            for(int k = 0; k < 3; k++) dst[k] = (uint8_t)(w >> (8 * k));
+            break;
+        }
+        }
+    }
+}
+
+/// Mean of every scale x scale block of a BGR image, rounded, the reference
+/// for fused downscaling; out is (w / scale) x (h / scale).
+static inline void benchBoxShrink(const uint8_t* bgr, int32_t w, int32_t h, int scale, uint8_t* out)
+{
+    int32_t dw = w / scale, dh = h / scale;
+    for(int32_t y = 0; y < dh; y++) {
+        for(int32_t x = 0; x < dw; x++) {
+            for(int c = 0; c < 3; c++) {
+                int sum = 0;
+                for(int j = 0; j < scale; j++)
+                    for(int i = 0; i < scale; i++) sum += bgr[((size_t)(y * scale + j) * w + x * scale + i) * 3 + c];
+                out[((size_t)y * dw + x) * 3 + c] = (uint8_t)((sum + scale * scale / 2) / (scale * scale));
+            }
+        }
+    }
+}
+
+/// Run fn iters times after one warm up call, return the mean time in ms.
+static inline double benchRun(int iters, const std::function<void()>& fn)
+{
+    fn();
+    auto t0 = std::chrono::steady_clock::now();
+    for(int i = 0; i < iters; i++) fn();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count() / iters;
+}
+
+struct BenchStats
+{
+    double mean;
+    double median;
+    double min;
+};
+
+/// Time each of iters calls of fn after one warm up call, in ms.
+static inline BenchStats benchRunStats(int iters, const std::function<void()>& fn)
+{
+    std::vector<double> t(std::max(iters, 1));
+    fn();
+    for(size_t i = 0; i < t.size(); i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        t[i] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    }
+    BenchStats s;
+    s.mean = 0;
+    for(size_t i = 0; i < t.size(); i++) s.mean += t[i];
+    s.mean /= t.size();
+    std::sort(t.begin(), t.end());
+    s.median = t[t.size() / 2];
+    s.min = t[0];
+    return s;
+}
+
+#endif
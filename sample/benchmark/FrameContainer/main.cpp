@@ -0,0 +1,166 @@
+#include "BenchCommon.hpp"
+#include "Container.hpp"
+#include "Recorder.hpp"
+
+using namespace percipio_layer;
+
+// Random access to single frames of a long recording.
+// The same synthetic depth + color sequence is written as a frame container,
+// raw and zlib compressed, and as a TYFrameRecorder stream. Reading the depth
+// of frame N from the container is one index lookup into the mapping, the
+// stream has to be replayed up to N. Every depth read is checked, and so is
+// the recovery of a container whose writer died before close().
+
+static std::shared_ptr<TYFrame> makeFrame(uint32_t k, uint32_t w, uint32_t h, uint64_t& depth_sum)
+{
+    std::shared_ptr<std::vector<uint8_t>> buf = std::make_shared<std::vector<uint8_t>>();
+    TY_FRAME_DATA frame;
+    benchMakeFrame(k, w, h, *buf, frame);
+    depth_sum = benchChecksum(frame.image[0].buffer, frame.image[0].size);
+    return std::shared_ptr<TYFrame>(new TYFrame(frame, buf));
+}
+
+static long fileSize(const std::string& path)
+{
+    std::ifstream f(path.c_str(), std::ios::binary | std::ios::ate);
+    return static_cast<long>(f.tellg());
+}
+
+//a writer that died: the flushed file, cut inside the last frame
+static int checkRecovery(const std::string& dir, const std::vector<std::shared_ptr<TYFrame>>& sequence,
+                         const std::vector<uint64_t>& sums)
+{
+    std::string path = dir + "/bench_container_live.tycf";
+    std::string crashed = dir + "/bench_container_crashed.tycf";
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+    TYFrameContainerWriter writer;
+    if(writer.open(path.c_str()) != TY_STATUS_OK) return 1;
+    writer.writeCalibration(TY_COMPONENT_RGB_CAM, color_calib);
+    writer.writeScaleUnit(0.25f);
+    for(auto& frame : sequence) writer.write(frame);
+    writer.flush();
+    {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream out(crashed.c_str(), std::ios::binary);
+        out.write(data.data(), data.size() - 100);
+    }
+    writer.close();
+    remove(path.c_str());
+
+    TYFrameContainer container;
+    std::cout.setstate(std::ios::failbit);
+    auto t0 = std::chrono::steady_clock::now();
+    bool opened = container.open(crashed.c_str()) == TY_STATUS_OK;
+    double open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout.clear();
+    uint32_t frames = static_cast<uint32_t>(sequence.size());
+    uint32_t bad = 0;
+    for(uint32_t k = 0; opened && k < container.frameCount(); k++) {
+        std::shared_ptr<TYImage> depth = container.image(k, TY_COMPONENT_DEPTH_CAM);
+        if(!depth || benchChecksum(depth->buffer(), depth->size()) != sums[k]) bad++;
+    }
+    TY_CAMERA_CALIB_INFO calib;
+    bool info = opened && container.calibration(TY_COMPONENT_RGB_CAM, calib) &&
+                memcmp(&calib, &color_calib, sizeof(calib)) == 0 && container.scaleUnit() == 0.25f;
+    bool ok = opened && container.frameCount() == frames - 1 && bad == 0 && info;
+    printf("unclosed container  %u of %u frames recovered  scan %6.3f ms  calibration %s  %s\n",
+           container.frameCount(), frames, open_ms, info ? "ok" : "lost", ok ? "ok" : "FAIL");
+    container.close();
+    remove(crashed.c_str());
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t frames = 100;
+    uint32_t w = 640, h = 480;
+    uint32_t reads = 200;
+    std::string dir = ".";
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            frames = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-reads") == 0 && i + 1 < argc) {
+            reads = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <frames>] [-reads <N>] [-dir <scratch dir>]\n", argv[0]);
+            printf("    defaults: 100 frames of 640x480 depth + color, 200 random reads, files in the current dir\n");
+            return 0;
+        }
+    }
+
+    std::vector<std::shared_ptr<TYFrame>> sequence;
+    std::vector<uint64_t> sums(frames);
+    for(uint32_t k = 0; k < frames; k++) sequence.push_back(makeFrame(k, w, h, sums[k]));
+    std::vector<uint32_t> order(reads);
+    uint32_t seed = 777;
+    for(uint32_t i = 0; i < reads; i++) order[i] = benchRand(seed) % frames;
+
+    int failures = 0;
+    const char* names[] = { "raw", "zlib" };
+    TYContainerCompression modes[] = { TYContainerCompressionNone, TYContainerCompressionZlib };
+    for(int m = 0; m < 2; m++) {
+        std::string path = dir + "/bench_container_" + names[m] + ".tycf";
+        TYFrameContainerWriter writer;
+        if(writer.open(path.c_str(), modes[m]) != TY_STATUS_OK) {
+            printf("%-6s not available\n", names[m]);
+            continue;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        for(auto& frame : sequence) writer.write(frame);
+        writer.close();
+        double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        TYFrameContainer container;
+        t0 = std::chrono::steady_clock::now();
+        container.open(path.c_str());
+        double open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        uint32_t bad = 0, next = 0;
+        BenchStats st = benchRunStats(reads, [&]() {
+            uint32_t k = order[next++ % reads];
+            std::shared_ptr<TYImage> depth = container.image(k, TY_COMPONENT_DEPTH_CAM);
+            if(!depth || benchChecksum(depth->buffer(), depth->size()) != sums[k]) bad++;
+        });
+        printf("%-6s container  %7.1f MB  write %7.1f ms  open %6.3f ms  depth of a random frame %7.3f ms (median %7.3f)  %s\n",
+               names[m], fileSize(path) / 1e6, write_ms, open_ms, st.mean, st.median, bad ? "FAIL" : "ok");
+        if(bad) failures++;
+        container.close();
+        remove(path.c_str());
+    }
+
+    failures += checkRecovery(dir, sequence, sums);
+
+    //the stream has no index, frame N costs a replay of the N frames before it
+    std::string path = dir + "/bench_container_stream.tyrf";
+    {
+        TYFrameRecorder recorder;
+        recorder.open(path.c_str(), false);
+        for(auto& frame : sequence) recorder.write(frame);
+        recorder.close();
+    }
+    TYReplayCamera replay;
+    replay.setRate(TYReplayRateMax);
+    std::cout.setstate(std::ios::failbit);
+    replay.open(path.c_str());
+    replay.stream_enable(FastCamera::stream_depth);
+    uint32_t played = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    replay.start();
+    while(replay.tryGetFrames(0)) played++;
+    replay.stop();
+    std::cout.clear();
+    double pass_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    printf("stream replay       %7.1f MB  %u frames in %7.1f ms, a random frame costs ~%7.3f ms\n",
+           fileSize(path) / 1e6, played, pass_ms, pass_ms / 2);
+    remove(path.c_str());
+
+    if(failures) {
+        printf("%d configuration(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
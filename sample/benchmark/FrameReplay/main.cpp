@@ -0,0 +1,175 @@
+#include <fstream>
+#include <thread>
+
+#include "BenchCommon.hpp"
+#include "Recorder.hpp"
+#include "Scheduler.hpp"
+
+using namespace percipio_layer;
+
+// Record -> replay round trip of TYFrameRecorder and TYReplayCamera.
+// A depth + color sequence is recorded in two sessions appended to one file,
+// with the calibration and scale unit, then played back as fast as it is read
+// and at the recorded rate through the scheduler. Every frame has to come
+// back in order with its content, the second session right after the first.
+// Appending to a file that is not a recording has to fail.
+
+static std::shared_ptr<TYFrame> makeFrame(uint32_t k, uint32_t w, uint32_t h, uint64_t& sum)
+{
+    std::shared_ptr<std::vector<uint8_t>> buf = std::make_shared<std::vector<uint8_t>>();
+    TY_FRAME_DATA frame;
+    benchMakeFrame(k, w, h, *buf, frame);
+    sum = benchChecksum(buf->data(), buf->size());
+    return std::shared_ptr<TYFrame>(new TYFrame(frame, buf));
+}
+
+//the frame holds image k of the sequence
+static bool sameFrame(const std::shared_ptr<TYFrame>& frame, uint32_t k, uint64_t sum)
+{
+    if(!frame || !frame->depthImage() || !frame->colorImage()) return false;
+    std::shared_ptr<TYImage> depth = frame->depthImage();
+    std::shared_ptr<TYImage> color = frame->colorImage();
+    if(depth->imageIndex() != static_cast<int32_t>(k) || depth->timestamp() != 1000000 + k * 33333ull) return false;
+    std::vector<uint8_t> data(depth->size() + color->size());
+    memcpy(data.data(), depth->buffer(), depth->size());
+    memcpy(data.data() + depth->size(), color->buffer(), color->size());
+    return benchChecksum(data.data(), data.size()) == sum;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t frames = 60;
+    uint32_t w = 320, h = 240;
+    uint32_t interval_ms = 5;
+    std::string dir = ".";
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            frames = std::max(2, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-interval") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <frames>] [-interval <ms>] [-dir <scratch dir>]\n", argv[0]);
+            printf("    defaults: 60 frames of 320x240 depth + color recorded 5 ms apart, files in the current dir\n");
+            return 0;
+        }
+    }
+
+    std::vector<std::shared_ptr<TYFrame>> sequence;
+    std::vector<uint64_t> sums(frames);
+    for(uint32_t k = 0; k < frames; k++) sequence.push_back(makeFrame(k, w, h, sums[k]));
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    int failures = 0;
+    std::string path = dir + "/bench_replay.tyrf";
+    remove(path.c_str());
+    //quiet library messages, the results are printed below
+    std::cout.setstate(std::ios::failbit);
+
+    //two sessions, the second one appended
+    auto t0 = std::chrono::steady_clock::now();
+    for(uint32_t session = 0; session < 2; session++) {
+        TYFrameRecorder recorder;
+        if(recorder.open(path.c_str(), false) != TY_STATUS_OK) {
+            std::cout.clear();
+            printf("open %s failed\n", path.c_str());
+            return 1;
+        }
+        if(session == 0) {
+            recorder.writeCalibration(TY_COMPONENT_DEPTH_CAM, depth_calib);
+            recorder.writeCalibration(TY_COMPONENT_RGB_CAM, color_calib);
+            recorder.writeScaleUnit(0.25f);
+        }
+        for(uint32_t k = session * frames / 2; k < (session + 1) * frames / 2 + (session ? frames % 2 : 0); k++) {
+            recorder.write(sequence[k]);
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        }
+        recorder.close();
+    }
+    double record_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    //appending to something else leaves it alone
+    std::string other = dir + "/bench_replay.txt";
+    const std::string text = "not a recording, long enough for a header";
+    {
+        std::ofstream f(other.c_str(), std::ios::binary);
+        f << text;
+    }
+    TYFrameRecorder bad;
+    bool rejected = bad.open(other.c_str(), false) != TY_STATUS_OK;
+    std::ifstream check(other.c_str(), std::ios::binary | std::ios::ate);
+    rejected = rejected && check.tellg() == static_cast<std::streamoff>(text.size());
+    check.close();
+    remove(other.c_str());
+
+    //as fast as it is read
+    TYReplayCamera replay;
+    replay.setRate(TYReplayRateMax);
+    bool opened = replay.open(path.c_str()) == TY_STATUS_OK && replay.frameCount() == frames;
+    TY_CAMERA_CALIB_INFO calib;
+    bool info = replay.calibration(TY_COMPONENT_RGB_CAM, calib) && memcmp(&calib, &color_calib, sizeof(calib)) == 0 &&
+                replay.scaleUnit() == 0.25f;
+    uint32_t played = 0, bad_frames = 0;
+    t0 = std::chrono::steady_clock::now();
+    replay.start();
+    while(std::shared_ptr<TYFrame> frame = replay.tryGetFrames(0)) {
+        if(played >= frames || !sameFrame(frame, played, sums[played])) bad_frames++;
+        played++;
+    }
+    replay.stop();
+    double max_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    //at the recorded rate through the scheduler, the second session follows the first
+    TYSchedulerConfig config;
+    config.queue_size = frames;
+    TYMultiDeviceScheduler scheduler(config);
+    std::shared_ptr<TYReplayCamera> camera = std::make_shared<TYReplayCamera>(path.c_str());
+    std::mutex lock;
+    std::vector<std::shared_ptr<TYFrame>> scheduled;
+    bool added = scheduler.addCamera(camera, [&](int, const std::shared_ptr<TYFrame>& frame) {
+        std::unique_lock<std::mutex> l(lock);
+        scheduled.push_back(frame);
+    }) >= 0;
+    t0 = std::chrono::steady_clock::now();
+    if(added) {
+        camera->start();
+        scheduler.start();
+        //the recording took record_ms, a lost session gap would take ages
+        auto deadline = t0 + std::chrono::milliseconds(static_cast<int64_t>(record_ms * 2 + 1000));
+        while(std::chrono::steady_clock::now() < deadline) {
+            {
+                std::unique_lock<std::mutex> l(lock);
+                if(scheduled.size() >= frames) break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        scheduler.stop();
+        camera->stop();
+    }
+    double rate_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    uint32_t bad_scheduled = 0;
+    for(uint32_t k = 0; k < scheduled.size(); k++) {
+        if(!sameFrame(scheduled[k], k, sums[k])) bad_scheduled++;
+    }
+    std::cout.clear();
+
+    bool ok = opened && info && played == frames && bad_frames == 0;
+    printf("record  2 sessions  %u frames  %7.1f ms  append to a foreign file %s\n",
+           frames, record_ms, rejected ? "refused" : "ACCEPTED");
+    printf("replay  max rate    %u/%u frames  %7.1f ms  %7.0f frames/s  calibration %s  %s\n",
+           played, frames, max_ms, played / (max_ms / 1000.0), info ? "ok" : "lost", ok ? "ok" : "FAIL");
+    if(!ok || !rejected) failures++;
+    ok = added && scheduled.size() == frames && bad_scheduled == 0;
+    printf("replay  recorded    %u/%u frames  %7.1f ms through the scheduler  %s\n",
+           static_cast<uint32_t>(scheduled.size()), frames, rate_ms, ok ? "ok" : "FAIL");
+    if(!ok) failures++;
+    remove(path.c_str());
+
+    if(failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "BenchCommon.hpp"
+#include "Synchronizer.hpp"
+
+using namespace percipio_layer;
+
+// Cost and accuracy of TYFrameSynchronizer on a simulated trigger setup.
+// Every camera stamps the trigger with a little clock jitter, drops a frame
+// now and then and reaches the host with its own delay, so frames of up to
+// delay_frames triggers are interleaved and that many sets stay open.
+// Every complete set has to hold the same trigger on all cameras.
+
+struct Event {
+    uint64_t arrival;
+    uint32_t camera;
+    std::shared_ptr<TYFrame> frame;
+};
+
+static std::shared_ptr<TYFrame> makeFrame(uint64_t timestamp, int32_t trigger)
+{
+    static uint16_t pixels[16];
+    TY_FRAME_DATA frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.userBuffer = pixels;
+    frame.bufferSize = sizeof(pixels);
+    frame.validCount = 1;
+    TY_IMAGE_DATA& img = frame.image[0];
+    img.componentID = TY_COMPONENT_DEPTH_CAM;
+    img.status = TY_STATUS_OK;
+    img.timestamp = timestamp;
+    img.imageIndex = trigger;
+    img.width = 4;
+    img.height = 4;
+    img.size = sizeof(pixels);
+    img.pixelFormat = TYPixelFormatCoord3D_C16;
+    img.buffer = pixels;
+    return std::shared_ptr<TYFrame>(new TYFrame(frame));
+}
+
+static int benchOne(uint32_t cameras, uint32_t triggers, uint32_t fps, uint32_t delay_frames,
+                    uint32_t drop_permille, uint32_t jitter_us)
+{
+    const uint64_t period = 1000000 / fps;
+    uint32_t seed = 12345 + cameras * 7 + delay_frames;
+    std::vector<Event> events;
+    events.reserve(cameras * triggers);
+    uint32_t expected = 0;
+    for(uint32_t k = 0; k < triggers; k++) {
+        bool all = true;
+        for(uint32_t c = 0; c < cameras; c++) {
+            if(benchRand(seed) % 1000 < drop_permille) {
+                all = false;
+                continue;
+            }
+            uint64_t trigger_time = 1000000 + k * period;
+            uint64_t ts = trigger_time + benchRand(seed) % (jitter_us + 1);
+            //each camera has a fixed transfer delay, its own frames stay in order
+            uint64_t arrival = trigger_time + (delay_frames * period * c) / cameras + benchRand(seed) % (period / 4);
+            Event ev = { arrival, c, makeFrame(ts, static_cast<int32_t>(k)) };
+            events.push_back(ev);
+        }
+        if(all) expected++;
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.arrival < b.arrival; });
+
+    uint64_t mismatched = 0, complete = 0;
+    TYSyncConfig config;
+    config.cameras = cameras;
+    config.tolerance = jitter_us + 100;
+    config.max_pending_sets = delay_frames + 4;
+    TYFrameSynchronizer sync(config, [&](const std::shared_ptr<TYFrameSet>& set) {
+        complete++;
+        int32_t k = set->frames[0]->imageIndex();
+        for(auto& f : set->frames) {
+            if(f->imageIndex() != k) {
+                mismatched++;
+                break;
+            }
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for(auto& ev : events) sync.push(ev.camera, ev.frame);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    sync.flush();
+
+    TYSyncStats st = sync.stats();
+    bool ok = mismatched == 0 && complete == expected;
+    printf("cameras %2u  open sets ~%3u  pushes %7zu  %7.1f ns/push  %6.0f frames/s capacity  complete %6llu/%-6u incomplete %5llu evicted %4llu late %4llu  %s\n",
+           cameras, delay_frames + 1, events.size(), ms * 1e6 / events.size(), events.size() / (ms / 1000.0),
+           (unsigned long long)complete, expected, (unsigned long long)st.incomplete,
+           (unsigned long long)st.evicted, (unsigned long long)st.late, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+// without a callback, sets nobody reads are dropped from the queue and counted
+static int checkQueue()
+{
+    TYSyncConfig config;
+    config.cameras = 2;
+    config.max_pending_sets = 4;
+    TYFrameSynchronizer sync(config);
+    const uint32_t sets = 20, capacity = 2 * config.max_pending_sets;
+    for(uint32_t k = 0; k < sets; k++) {
+        for(uint32_t c = 0; c < config.cameras; c++) sync.push(c, makeFrame(1000000 + k * 33333, k));
+    }
+    TYSyncStats st = sync.stats();
+    uint32_t read = 0;
+    std::shared_ptr<TYFrameSet> set;
+    while((set = sync.tryGetFrameSet(0))) {
+        //the newest sets are the ones kept
+        if(set->frames[0]->imageIndex() != static_cast<int32_t>(sets - capacity + read)) break;
+        read++;
+    }
+    bool ok = st.complete == sets && st.overwritten == sets - capacity && read == capacity;
+    printf("queue of %u  sets %u  read %u  overwritten %llu  %s\n",
+           capacity, sets, read, (unsigned long long)st.overwritten, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t triggers = 3000;
+    uint32_t fps = 30;
+    uint32_t drop = 10;
+    uint32_t jitter = 500;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            triggers = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-fps") == 0 && i + 1 < argc) {
+            fps = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-drop") == 0 && i + 1 < argc) {
+            drop = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-jitter") == 0 && i + 1 < argc) {
+            jitter = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <triggers>] [-fps <fps>] [-drop <permille>] [-jitter <us>]\n", argv[0]);
+            printf("    defaults: 3000 triggers at 30 fps, 10 permille dropped frames, 500 us timestamp jitter\n");
+            return 0;
+        }
+    }
+
+    int failures = checkQueue();
+    uint32_t cameras[] = { 2, 4, 12, 16 };
+    uint32_t delays[] = { 0, 4, 64 };
+    for(size_t c = 0; c < sizeof(cameras) / sizeof(cameras[0]); c++) {
+        for(size_t d = 0; d < sizeof(delays) / sizeof(delays[0]); d++) {
+            failures += benchOne(cameras[c], triggers, fps, delays[d], drop, jitter);
+        }
+    }
+    if(failures) {
+        printf("%d configuration(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <cmath>
+
+#include "BenchCommon.hpp"
+#include "Jpeg.hpp"
+
+using namespace percipio_layer;
+
+// JPEG color frames to BGR: full size against the reduced size IDCT, and a
+// batch of frames from several cameras on one thread against a decode pool.
+// Correctness: output sizes follow libjpeg for odd frame sizes, a full decode
+// is close to the encoded scene, a scaled decode is close to the block means
+// of it, pooled outputs are identical to the single decoder and broken data
+// fails instead of crashing.
+
+// smooth shading with edges and a little sensor noise, compresses like a camera frame
+static std::shared_ptr<TYImage> makeScene(uint32_t seed, int32_t w, int32_t h)
+{
+    std::shared_ptr<TYImage> bgr(new TYImage(w, h, TY_COMPONENT_RGB_CAM, TYPixelFormatBGR8, w * h * 3));
+    uint8_t* p = static_cast<uint8_t*>(bgr->buffer());
+    int32_t cx = w / 3 + (int32_t)(seed * 37 % (w / 3 + 1)), cy = h / 2, r = h / 4;
+    for(int32_t y = 0; y < h; y++) {
+        for(int32_t x = 0; x < w; x++) {
+            bool disc = (x - cx) * (x - cx) + (y - cy) * (y - cy) < r * r;
+            int noise = (int)(benchRand(seed) % 7) - 3;
+            int b = disc ? 200 : 40 + 150 * x / w;
+            int g = disc ? 60 : 30 + 180 * y / h;
+            int rr = ((x / 64 + y / 64) % 2) ? 170 : 90;
+            uint8_t* px = p + (y * w + x) * 3;
+            px[0] = (uint8_t)std::min(255, std::max(0, b + noise));
+            px[1] = (uint8_t)std::min(255, std::max(0, g + noise));
+            px[2] = (uint8_t)std::min(255, std::max(0, rr + noise));
+        }
+    }
+    return bgr;
+}
+
+static bool check(TYJpegDecodePool& pool)
+{
+    TYJpegDecoder decoder;
+    // odd sizes round up like libjpeg
+    const int32_t w = 203, h = 117;
+    std::shared_ptr<TYImage> scene = makeScene(1, w, h);
+    std::shared_ptr<TYImage> jpeg = TYJpegEncode(scene, 95);
+    if(!jpeg) {
+        printf("encode failed\n");
+        return false;
+    }
+    const uint8_t* src = static_cast<const uint8_t*>(scene->buffer());
+    for(int scale = 1; scale <= 8; scale *= 2) {
+        std::shared_ptr<TYImage> out = decoder.decode(jpeg, scale);
+        if(!out || out->width() != (w + scale - 1) / scale || out->height() != (h + scale - 1) / scale) {
+            printf("scale %d: wrong output size\n", scale);
+            return false;
+        }
+        // against the block means of the scene, whole blocks only
+        std::vector<uint8_t> ref((w / scale) * (h / scale) * 3);
+        benchBoxShrink(src, w, h, scale, ref.data());
+        const uint8_t* dst = static_cast<const uint8_t*>(out->buffer());
+        double err = 0;
+        for(int32_t y = 0; y < h / scale; y++)
+            for(int32_t x = 0; x < (w / scale) * 3; x++) {
+                double d = (double)dst[y * out->width() * 3 + x] - ref[y * (w / scale) * 3 + x];
+                err += d * d;
+            }
+        double psnr = 10 * std::log10(255.0 * 255.0 * ref.size() / std::max(err, 1.0));
+        if(psnr < 30) {
+            printf("scale %d: psnr %.1f dB against the scene\n", scale, psnr);
+            return false;
+        }
+    }
+    int32_t sw, sh;
+    if(TYJpegDecoder::outputSize(jpeg->buffer(), jpeg->size(), 3, sw, sh) != TY_STATUS_INVALID_PARAMETER) {
+        printf("scale 3 accepted\n");
+        return false;
+    }
+
+    // a caller buffer with padded rows
+    int32_t qw = (w + 3) / 4, qh = (h + 3) / 4;
+    size_t step = qw * 3 + 17;
+    std::vector<uint8_t> padded(step * qh, 0xA5);
+    std::shared_ptr<TYImage> quarter = decoder.decode(jpeg, 4);
+    if(decoder.decode(jpeg->buffer(), jpeg->size(), 4, padded.data(), step, qw, qh) != TY_STATUS_OK) {
+        printf("padded decode failed\n");
+        return false;
+    }
+    for(int32_t y = 0; y < qh; y++) {
+        if(memcmp(&padded[y * step], static_cast<uint8_t*>(quarter->buffer()) + y * qw * 3, qw * 3) != 0 ||
+           padded[y * step + qw * 3] != 0xA5) {
+            printf("padded row %d differs\n", y);
+            return false;
+        }
+    }
+    if(decoder.decode(jpeg->buffer(), jpeg->size(), 4, padded.data(), step, qw + 1, qh) != TY_STATUS_WRONG_SIZE) {
+        printf("wrong size accepted\n");
+        return false;
+    }
+
+    // pooled decodes are the single decoder ones
+    std::vector<std::shared_ptr<TYImage>> jpegs;
+    for(uint32_t k = 0; k < 6; k++) jpegs.push_back(TYJpegEncode(makeScene(k + 2, w, h), 80));
+    std::vector<std::shared_ptr<TYImage>> pooled = pool.decodeAll(jpegs);
+    for(size_t k = 0; k < jpegs.size(); k++) {
+        std::shared_ptr<TYImage> one = decoder.decode(jpegs[k], pool.scale());
+        if(!one || !pooled[k] || one->size() != pooled[k]->size() || memcmp(one->buffer(), pooled[k]->buffer(), one->size()) != 0) {
+            printf("pooled image %zu differs\n", k);
+            return false;
+        }
+    }
+
+    // broken data fails or decodes, a cut off frame keeps its size
+    std::vector<uint8_t> garbage(4096);
+    uint32_t seed = 9;
+    for(size_t i = 0; i < garbage.size(); i++) garbage[i] = (uint8_t)benchRand(seed);
+    std::vector<uint8_t> out(w * h * 3);
+    if(decoder.decode(garbage.data(), garbage.size(), 1, out.data(), 0, w, h) == TY_STATUS_OK) {
+        printf("garbage decoded\n");
+        return false;
+    }
+    if(decoder.decode(jpeg->buffer(), jpeg->size() / 2, 1, out.data(), 0, w, h) != TY_STATUS_OK) {
+        printf("cut off frame failed\n");
+        return false;
+    }
+    // and the decoder still works afterwards
+    std::shared_ptr<TYImage> again = decoder.decode(jpeg, 2);
+    return again && again->width() == (w + 1) / 2;
+}
+
+int main(int argc, char* argv[])
+{
+    int32_t width = 1920, height = 1080;
+    int iters = 10;
+    int cams = 4;
+    int quality = 90;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-cams") == 0 && i + 1 < argc) {
+            cams = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            quality = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>] [-t <threads>] [-cams <cameras>] [-q <quality>] [-size <width> <height>]\n", argv[0]);
+            printf("    defaults: 1920x1080 quality 90, 4 cameras, 10 iterations, every cpu thread\n");
+            return 0;
+        }
+    }
+
+    std::shared_ptr<TYImage> probe = TYJpegEncode(makeScene(0, 16, 16));
+    if(!probe || !TYJpegDecoder::available()) {
+        printf("built without libjpeg, nothing to decode\n");
+        return 0;
+    }
+
+    // the caller decodes along with the pool threads
+    TYJpegDecodePool pool(threads > 1 ? threads - 1 : 1);
+    bool ok = check(pool);
+
+    std::vector<std::shared_ptr<TYImage>> jpegs;
+    for(int k = 0; k < cams; k++) jpegs.push_back(TYJpegEncode(makeScene(k, width, height), quality));
+    std::shared_ptr<TYImage> jpeg = jpegs[0];
+    TYJpegDecoder decoder;
+
+    printf("%dx%d quality %d, %d KB per frame\n", width, height, quality, jpeg->size() / 1024);
+    std::shared_ptr<TYImage> full;
+    double full_ms = benchRun(iters, [&]() { full = decoder.decode(jpeg, 1); });
+    printf("  full decode      %7.2f ms\n", full_ms);
+    for(int scale = 2; scale <= 8; scale *= 2) {
+        std::vector<uint8_t> small((width / scale) * (height / scale) * 3);
+        double shrink = benchRun(iters, [&]() {
+            full = decoder.decode(jpeg, 1);
+            benchBoxShrink(static_cast<uint8_t*>(full->buffer()), width, height, scale, small.data());
+        });
+        std::shared_ptr<TYImage> reduced;
+        double idct = benchRun(iters, [&]() { reduced = decoder.decode(jpeg, scale); });
+        printf("  1/%d  full+shrink %7.2f ms  reduced idct %dx%d %7.2f ms  %.1fx\n",
+               scale, shrink, reduced->width(), reduced->height(), idct, shrink / idct);
+    }
+
+    double serial = benchRun(iters, [&]() {
+        for(size_t k = 0; k < jpegs.size(); k++) decoder.decode(jpegs[k], 1);
+    });
+    double pooled = benchRun(iters, [&]() { pool.decodeAll(jpegs); });
+    printf("  %d cameras        one thread %7.2f ms  pool of %u %7.2f ms  %.1fx  %s\n",
+           cams, serial, threads, pooled, serial / pooled, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
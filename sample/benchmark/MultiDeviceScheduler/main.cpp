@@ -0,0 +1,264 @@
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include "BenchCommon.hpp"
+#include "Scheduler.hpp"
+
+using namespace percipio_layer;
+
+// Frame delivery from many simulated cameras, one of them slow:
+//   roundrobin  one thread, blocking fetch on every camera in turn (SimpleView_MultiDevice)
+//   threads     one thread per camera with a blocking fetch (MultiDeviceOfflineReconnection)
+//   scheduler   TYMultiDeviceScheduler, one poller plus a shared worker pool
+// Latency is measured from the moment a frame is ready in the simulated driver
+// to the start of its consumer, for the cameras running at full rate.
+
+static inline uint64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Camera producing a frame every period_us, the driver keeps the newest 3
+/// undelivered frames like the default FastCamera buffer pool.
+class SimCamera
+{
+  public:
+    SimCamera(uint32_t period_us, uint32_t w, uint32_t h) :
+        _period_us(period_us), _w(w), _h(h), _pixels(w * h, 1000)
+    {
+        _start_us = nowUs();
+    }
+
+    std::shared_ptr<TYFrame> poll()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        uint64_t ready = (nowUs() - _start_us) / _period_us;
+        if(ready <= _fetched) return std::shared_ptr<TYFrame>();
+        if(ready - _fetched > kBuffers) {
+            _dropped += ready - _fetched - kBuffers;
+            _fetched = ready - kBuffers;
+        }
+        _fetched++;
+
+        TY_FRAME_DATA frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.userBuffer = &_pixels[0];
+        frame.bufferSize = static_cast<int32_t>(_pixels.size() * sizeof(uint16_t));
+        frame.validCount = 1;
+        TY_IMAGE_DATA& img = frame.image[0];
+        img.componentID = TY_COMPONENT_DEPTH_CAM;
+        img.status = TY_STATUS_OK;
+        img.timestamp = _start_us + _fetched * _period_us;
+        img.imageIndex = static_cast<int32_t>(_fetched);
+        img.width = _w;
+        img.height = _h;
+        img.size = frame.bufferSize;
+        img.pixelFormat = TYPixelFormatCoord3D_C16;
+        img.buffer = frame.userBuffer;
+        return std::shared_ptr<TYFrame>(new TYFrame(frame));
+    }
+
+    /// Blocking fetch like TYFetchFrame, sleeps until the next frame or the timeout.
+    std::shared_ptr<TYFrame> fetch(uint32_t timeout_ms)
+    {
+        uint64_t deadline = nowUs() + timeout_ms * 1000ull;
+        for(;;) {
+            std::shared_ptr<TYFrame> frame = poll();
+            if(frame) return frame;
+            uint64_t now = nowUs();
+            if(now >= deadline) return frame;
+            uint64_t next;
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                next = _start_us + (_fetched + 1) * _period_us;
+            }
+            uint64_t wake = std::min(std::max(next, now + 1), deadline);
+            std::this_thread::sleep_for(std::chrono::microseconds(wake - now));
+        }
+    }
+
+    uint64_t dropped()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        return _dropped;
+    }
+
+  private:
+    static const uint64_t kBuffers = 3;
+    uint32_t _period_us, _w, _h;
+    uint64_t _start_us;
+    uint64_t _fetched = 0;
+    uint64_t _dropped = 0;
+    std::vector<uint16_t> _pixels;
+    std::mutex _lock;
+};
+
+/// Consumer shared by every strategy: latency sample plus work_us of busy work.
+class Sink
+{
+  public:
+    Sink(uint32_t work_us) : _work_us(work_us) {}
+
+    void consume(int cam, const std::shared_ptr<TYFrame>& frame)
+    {
+        uint64_t now = nowUs();
+        std::shared_ptr<TYImage> depth = frame->depthImage();
+        if(!depth) return;
+        uint64_t start = nowUs();
+        uint32_t sum = 0;
+        const uint16_t* px = static_cast<const uint16_t*>(depth->buffer());
+        do {
+            for(int32_t i = 0; i < depth->width() * depth->height(); i += 64) sum += px[i];
+        } while(nowUs() - start < _work_us);
+        _checksum += sum;
+
+        std::unique_lock<std::mutex> lock(_lock);
+        _frames++;
+        //camera 0 is the slow one
+        if(cam != 0) _latency_ms.push_back((now - frame->timestamp()) / 1000.0);
+    }
+
+    uint64_t frames() const { return _frames; }
+    std::vector<double>& latency() { return _latency_ms; }
+
+  private:
+    uint32_t _work_us;
+    std::mutex _lock;
+    uint64_t _frames = 0;
+    std::atomic<uint32_t> _checksum{0};
+    std::vector<double> _latency_ms;
+};
+
+struct Options {
+    uint32_t cameras = 16;
+    uint32_t fps = 30;
+    uint32_t slow_fps = 2;
+    uint32_t seconds = 3;
+    uint32_t workers = 2;
+    uint32_t work_us = 200;
+    uint32_t timeout_ms = 1000;
+};
+
+static void report(const char* name, uint32_t threads, const Options& opt,
+                   std::vector<std::shared_ptr<SimCamera>>& cams, Sink& sink, double wall_s, double cpu_s)
+{
+    uint64_t dropped = 0;
+    for(auto& cam : cams) dropped += cam->dropped();
+    std::vector<double>& lat = sink.latency();
+    std::sort(lat.begin(), lat.end());
+    double avg = 0;
+    for(double v : lat) avg += v;
+    avg = lat.empty() ? 0 : avg / lat.size();
+    double p99 = lat.empty() ? 0 : lat[std::min(lat.size() - 1, lat.size() * 99 / 100)];
+    double mx = lat.empty() ? 0 : lat.back();
+    double expected = ((opt.cameras - 1) * opt.fps + opt.slow_fps) * wall_s;
+    printf("%-10s threads %3u  frames %6llu (%5.1f%%)  dropped %6llu  latency avg %7.2f p99 %7.2f max %7.2f ms  cpu %5.1f%%\n",
+           name, threads, (unsigned long long)sink.frames(), 100.0 * sink.frames() / expected,
+           (unsigned long long)dropped, avg, p99, mx, 100.0 * cpu_s / wall_s);
+}
+
+static std::vector<std::shared_ptr<SimCamera>> makeCameras(const Options& opt)
+{
+    std::vector<std::shared_ptr<SimCamera>> cams;
+    for(uint32_t i = 0; i < opt.cameras; i++) {
+        uint32_t fps = i == 0 ? opt.slow_fps : opt.fps;
+        cams.push_back(std::make_shared<SimCamera>(1000000 / fps, 160, 120));
+    }
+    return cams;
+}
+
+static void runRoundRobin(const Options& opt)
+{
+    std::vector<std::shared_ptr<SimCamera>> cams = makeCameras(opt);
+    Sink sink(opt.work_us);
+    std::clock_t cpu = std::clock();
+    uint64_t start = nowUs(), end = start + opt.seconds * 1000000ull;
+    while(nowUs() < end) {
+        for(size_t i = 0; i < cams.size(); i++) {
+            std::shared_ptr<TYFrame> frame = cams[i]->fetch(opt.timeout_ms);
+            if(frame) sink.consume(static_cast<int>(i), frame);
+        }
+    }
+    double wall = (nowUs() - start) / 1e6;
+    report("roundrobin", 1, opt, cams, sink, wall, double(std::clock() - cpu) / CLOCKS_PER_SEC);
+}
+
+static void runThreads(const Options& opt)
+{
+    std::vector<std::shared_ptr<SimCamera>> cams = makeCameras(opt);
+    Sink sink(opt.work_us);
+    std::atomic<bool> running(true);
+    std::clock_t cpu = std::clock();
+    uint64_t start = nowUs();
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < cams.size(); i++) {
+        threads.push_back(std::thread([&, i]() {
+            while(running) {
+                //short timeout so the thread notices the end of the run
+                std::shared_ptr<TYFrame> frame = cams[i]->fetch(100);
+                if(frame) sink.consume(static_cast<int>(i), frame);
+            }
+        }));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+    running = false;
+    for(auto& t : threads) t.join();
+    double wall = (nowUs() - start) / 1e6;
+    report("threads", opt.cameras, opt, cams, sink, wall, double(std::clock() - cpu) / CLOCKS_PER_SEC);
+}
+
+static void runScheduler(const Options& opt)
+{
+    std::vector<std::shared_ptr<SimCamera>> cams = makeCameras(opt);
+    Sink sink(opt.work_us);
+    TYSchedulerConfig config;
+    config.workers = opt.workers;
+    TYMultiDeviceScheduler scheduler(config);
+    for(size_t i = 0; i < cams.size(); i++) {
+        std::shared_ptr<SimCamera> cam = cams[i];
+        scheduler.addSource("sim" + std::to_string(i), [cam]() { return cam->poll(); },
+                            [&sink](int device, const std::shared_ptr<TYFrame>& frame) { sink.consume(device, frame); });
+    }
+    std::clock_t cpu = std::clock();
+    uint64_t start = nowUs();
+    scheduler.start();
+    std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+    scheduler.stop();
+    double wall = (nowUs() - start) / 1e6;
+    report("scheduler", config.pollers + opt.workers, opt, cams, sink, wall, double(std::clock() - cpu) / CLOCKS_PER_SEC);
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            opt.cameras = std::max(2, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-fps") == 0 && i + 1 < argc) {
+            opt.fps = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-slow") == 0 && i + 1 < argc) {
+            opt.slow_fps = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            opt.seconds = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            opt.workers = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-work") == 0 && i + 1 < argc) {
+            opt.work_us = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-c <cameras>] [-fps <fps>] [-slow <fps>] [-d <seconds>] [-w <workers>] [-work <us>]\n", argv[0]);
+            printf("    defaults: 16 cameras at 30 fps, camera 0 at 2 fps, 3 s per strategy, 2 workers, 200 us per frame\n");
+            return 0;
+        }
+    }
+
+    printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    printf("%u cameras, %u at %u fps and 1 at %u fps, %u us of work per frame, %u s per strategy\n",
+           opt.cameras, opt.cameras - 1, opt.fps, opt.slow_fps, opt.work_us, opt.seconds);
+    runRoundRobin(opt);
+    runThreads(opt);
+    runScheduler(opt);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "BenchCommon.hpp"
+#include "RawDemosaic.hpp"
+
+// Fused unpack + bilinear demosaic of packed raw bayer frames to BGR.
+// Correctness: color ramps, which bilinear interpolation reproduces exactly
+// away from the border, are mosaiced, packed and demosaiced for every layout
+// and pattern; the single thread, pooled and scalar outputs must be identical.
+// Timing at 5 MP against the plain unpack of the same frame.
+
+static uint32_t ramp(int channel, int x, int y)
+{
+    switch(channel) {
+    case 0:  return 100 + 2 * x;       // blue
+    case 1:  return 400 + 2 * y;       // green
+    default: return 50 + x + y;        // red
+    }
+}
+
+static bool check(int packing, int pattern, TYMapperWorkerPool* pool)
+{
+    const int w = 256, h = 96;
+    std::vector<uint16_t> mosaic(w * h);
+    for(int y = 0; y < h; y++)
+        for(int x = 0; x < w; x++) mosaic[y * w + x] = (uint16_t)ramp(TYBayerChannel(pattern, x, y), x, y);
+    std::vector<uint8_t> packed(w * h / TYRawGroupPixels(packing) * TYRawGroupBytes(packing));
+    benchPackRaw(packing, mosaic.data(), mosaic.size(), packed.data());
+
+    std::vector<uint16_t> bgr16(w * h * 3), pooled(w * h * 3), scalar(w * h * 3);
+    std::vector<uint8_t> bgr8(w * h * 3);
+    TYDemosaicRaw(packing, pattern, packed.data(), w, h, bgr16.data(), 0, 16);
+    TYDemosaicRaw(packing, pattern, packed.data(), w, h, pooled.data(), 0, 16, pool);
+    TYDemosaicRaw(packing, pattern, packed.data(), w, h, scalar.data(), 0, 16, NULL, TY_MAPPER_SIMD_NONE);
+    TYDemosaicRaw(packing, pattern, packed.data(), w, h, bgr8.data(), 0, 8, pool);
+    if(bgr16 != pooled || bgr16 != scalar) {
+        printf("pooled or scalar output differs\n");
+        return false;
+    }
+    int shift = TYRawBits(packing) - 8;
+    for(int y = 1; y < h - 1; y++) {
+        for(int x = 1; x < w - 1; x++) {
+            for(int c = 0; c < 3; c++) {
+                uint32_t expect = ramp(c, x, y);
+                size_t i = (y * w + x) * 3 + c;
+                if(bgr16[i] != expect || bgr8[i] != (expect >> shift)) {
+                    printf("pattern %d at %d,%d channel %d: %u/%u expected %u\n", pattern, x, y, c, bgr16[i], bgr8[i], expect);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 2592, height = 1944;
+    int iters = 10;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>] [-t <threads>] [-size <width> <height>]\n", argv[0]);
+            printf("    defaults: 2592x1944, 10 iterations, every cpu thread\n");
+            return 0;
+        }
+    }
+
+    TYMapperWorkerPool pool(threads - 1);
+    const char* names[] = { "csi10", "csi12", "csi14", "packet10", "packet12" };
+    int packings[] = { TY_RAW_CSI10, TY_RAW_CSI12, TY_RAW_CSI14, TY_RAW_PACKET10, TY_RAW_PACKET12 };
+    int failures = 0;
+    for(size_t p = 0; p < sizeof(packings) / sizeof(packings[0]); p++) {
+        int packing = packings[p];
+        bool ok = true;
+        for(int pattern = TY_BAYER_RGGB; pattern <= TY_BAYER_BGGR; pattern++) ok = ok && check(packing, pattern, &pool);
+        if(!ok) failures++;
+
+        size_t pixels = (size_t)width * height;
+        std::vector<uint8_t> packed(pixels / TYRawGroupPixels(packing) * TYRawGroupBytes(packing));
+        uint32_t seed = 5;
+        for(size_t i = 0; i < packed.size(); i++) packed[i] = (uint8_t)benchRand(seed);
+        std::vector<uint8_t> raw8(pixels), bgr8(pixels * 3);
+        std::vector<uint16_t> bgr16(pixels * 3);
+
+        double unpack = benchRun(iters, [&]() { TYUnpackRaw8(packing, packed.data(), raw8.data(), width, height); });
+        double one8 = benchRun(iters, [&]() { TYDemosaicRaw(packing, TY_BAYER_RGGB, packed.data(), width, height, bgr8.data(), 0, 8); });
+        double one16 = benchRun(iters, [&]() { TYDemosaicRaw(packing, TY_BAYER_RGGB, packed.data(), width, height, bgr16.data(), 0, 16); });
+        double par8 = benchRun(iters, [&]() { TYDemosaicRaw(packing, TY_BAYER_RGGB, packed.data(), width, height, bgr8.data(), 0, 8, &pool); });
+        printf("%-8s %dx%d  unpack only %6.2f ms  demosaic bgr8 %6.2f ms  bgr16 %6.2f ms  bgr8 %u threads %6.2f ms  %s\n",
+               names[packing], width, height, unpack, one8, one16, threads, par8, ok ? "ok" : "FAIL");
+    }
+    if(failures) {
+        printf("%d layout(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
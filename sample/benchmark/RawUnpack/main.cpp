@@ -0,0 +1,93 @@
+#include "BenchCommon.hpp"
+#include "RawUnpack.hpp"
+
+// Packed raw unpacking at 5 MP for every layout, 16 bit full precision and
+// 8 bit output, scalar reference against the vector versions this cpu runs.
+// Random values are packed, unpacked by every version and compared first,
+// on the bench size and on sizes leaving a scalar tail.
+
+static const char* simdName(int simd)
+{
+    switch(simd) {
+    case TY_MAPPER_SIMD_SSE41: return "ssse3";
+    case TY_MAPPER_SIMD_AVX2:  return "avx2";
+    case TY_MAPPER_SIMD_NEON:  return "neon";
+    default:                   return "scalar";
+    }
+}
+
+static bool check(int packing, int width, int height, const std::vector<int>& levels)
+{
+    size_t pixels = (size_t)width * height;
+    int bits = TYRawBits(packing);
+    std::vector<uint16_t> values(pixels), out16(pixels);
+    std::vector<uint8_t> packed(pixels / TYRawGroupPixels(packing) * TYRawGroupBytes(packing)), out8(pixels);
+    uint32_t seed = 99 + packing * 13 + width;
+    for(size_t i = 0; i < pixels; i++) values[i] = (uint16_t)(benchRand(seed) & ((1u << bits) - 1));
+    benchPackRaw(packing, values.data(), pixels, packed.data());
+
+    for(size_t l = 0; l < levels.size(); l++) {
+        std::fill(out16.begin(), out16.end(), 0xffff);
+        std::fill(out8.begin(), out8.end(), 0);
+        TYUnpackRaw16(packing, packed.data(), out16.data(), width, height, levels[l]);
+        TYUnpackRaw8(packing, packed.data(), out8.data(), width, height, levels[l]);
+        for(size_t i = 0; i < pixels; i++) {
+            if(out16[i] != values[i] || out8[i] != (values[i] >> (bits - 8))) {
+                printf("%s %dx%d mismatch at %zu: %u/%u expected %u\n", simdName(levels[l]), width, height, i,
+                       out16[i], out8[i], values[i]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 2592, height = 1944;
+    int iters = 20;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>] [-size <width> <height>]\n", argv[0]);
+            printf("    defaults: 2592x1944, 20 iterations, width has to be a multiple of 4\n");
+            return 0;
+        }
+    }
+
+    std::vector<int> levels(1, TY_MAPPER_SIMD_NONE);
+    int best = TYGetSimdLevel();
+#if defined(TY_MAPPER_X86)
+    if(best == TY_MAPPER_SIMD_SSE41 || best == TY_MAPPER_SIMD_AVX2) levels.push_back(TY_MAPPER_SIMD_SSE41);
+#endif
+    if(best != TY_MAPPER_SIMD_NONE && best != TY_MAPPER_SIMD_SSE41) levels.push_back(best);
+
+    const char* names[] = { "csi10", "csi12", "csi14", "packet10", "packet12" };
+    int failures = 0;
+    for(int packing = TY_RAW_CSI10; packing <= TY_RAW_PACKET12; packing++) {
+        bool ok = check(packing, width, height, levels) && check(packing, 4, 1, levels) &&
+                  check(packing, 20, 3, levels) && check(packing, 36, 7, levels);
+        if(!ok) failures++;
+
+        size_t pixels = (size_t)width * height;
+        std::vector<uint8_t> packed(pixels / TYRawGroupPixels(packing) * TYRawGroupBytes(packing), 0x5a);
+        std::vector<uint16_t> out16(pixels);
+        std::vector<uint8_t> out8(pixels);
+        printf("%-8s %dx%d", names[packing], width, height);
+        for(size_t l = 0; l < levels.size(); l++) {
+            double ms16 = benchRun(iters, [&]() { TYUnpackRaw16(packing, packed.data(), out16.data(), width, height, levels[l]); });
+            double ms8 = benchRun(iters, [&]() { TYUnpackRaw8(packing, packed.data(), out8.data(), width, height, levels[l]); });
+            printf("  %s 16bit %6.3f ms 8bit %6.3f ms", simdName(levels[l]), ms16, ms8);
+        }
+        printf("  %s\n", ok ? "ok" : "FAIL");
+    }
+    if(failures) {
+        printf("%d layout(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
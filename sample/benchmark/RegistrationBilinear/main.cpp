@@ -0,0 +1,130 @@
+#include "BenchCommon.hpp"
+
+// Nearest, bilinear and edge aware sampling of the registration context:
+// sampling cost, agreement of the vector kernels with the scalar one, and
+// error against the exact value of a smooth synthetic color image.
+static float colorField(float x, float y, int ch)
+{
+    return 128.f + 100.f * sinf(0.21f * x + ch) * cosf(0.17f * y - ch);
+}
+
+static const char* modeName(int mode)
+{
+    switch(mode) {
+        case TY_REGISTRATION_SAMPLE_BILINEAR:   return "bilinear";
+        case TY_REGISTRATION_SAMPLE_EDGE_AWARE: return "edge";
+        default:                                return "nearest";
+    }
+}
+
+static int benchOne(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                    uint32_t depthW, uint32_t depthH, uint32_t rgbW, uint32_t rgbH, int iters)
+{
+    std::vector<uint16_t> depth(depthW * depthH);
+    benchMakeDepthScene(&depth[0], depthW, depthH);
+    std::vector<uint8_t> rgb(rgbW * rgbH * 3);
+    for(uint32_t y = 0; y < rgbH; y++)
+    for(uint32_t x = 0; x < rgbW; x++)
+    for(int ch = 0; ch < 3; ch++) {
+        rgb[(y * rgbW + x) * 3 + ch] = (uint8_t)(colorField((float)x, (float)y, ch) + 0.5f);
+    }
+
+    TYRegistrationContext* ctx = NULL;
+    if(TYCreateRegistrationContext(&depth_calib, &color_calib, depthW, depthH, &ctx) != TY_STATUS_OK) {
+        printf("create context failed\n");
+        return 1;
+    }
+    TYRegistrationUpdateLookupTable(ctx, &depth[0]);
+
+    // exact color at the sub-pixel projection of every valid point
+    float k[4];
+    TYScaledIntrinsic(&color_calib, rgbW, rgbH, k);
+    std::vector<float> truth(depthW * depthH * 3, -1.f);
+    for(uint32_t i = 0; i < depthW * depthH; i++) {
+        const TY_PIXEL_DESC& p = ctx->lut[i];
+        if(p.x < 0 || p.y < 0 || p.x >= (int)depthW || p.y >= (int)depthH) continue;
+        float x = k[0] * ctx->p3d[i].x / ctx->p3d[i].z + k[1];
+        float y = k[2] * ctx->p3d[i].y / ctx->p3d[i].z + k[3];
+        if(x < 0 || y < 0 || x > rgbW - 1 || y > rgbH - 1) continue;
+        for(int ch = 0; ch < 3; ch++) truth[i * 3 + ch] = colorField(x, y, ch);
+    }
+
+    std::vector<uint8_t> out(depthW * depthH * 3);
+    int modes[] = { TY_REGISTRATION_SAMPLE_NEAREST, TY_REGISTRATION_SAMPLE_BILINEAR, TY_REGISTRATION_SAMPLE_EDGE_AWARE };
+    double t_nearest = 0;
+    for(int m = 0; m < 3; m++) {
+        TYRegistrationSetSampleMode(ctx, modes[m]);
+        double t = benchRun(iters, [&]() {
+            TYRegistrationSampleImage<uint8_t, 3>(ctx, rgbW, rgbH, &rgb[0], &out[0]);
+        });
+        if(m == 0) t_nearest = t;
+        double err = 0;
+        uint32_t n = 0;
+        for(size_t i = 0; i < truth.size(); i++) {
+            if(truth[i] < 0) continue;
+            err += fabs(out[i] - truth[i]);
+            n++;
+        }
+        printf("%4ux%-4u <- %4ux%-4u  %-8s  sample %7.3f ms  cost %5.2fx  mean abs error %6.3f\n",
+               depthW, depthH, rgbW, rgbH, modeName(modes[m]), t, t / t_nearest, n ? err / n : 0.);
+    }
+
+    // every vector level against the scalar kernel
+    int failures = 0;
+    std::vector<uint8_t> ref(out.size());
+    TYSampleImageRangeBilinear<uint8_t, 3>(ctx->lut, ctx->p3d, 0, depthW * depthH, depthW, depthH,
+            k, rgbW, rgbH, &rgb[0], &ref[0], -1, TY_MAPPER_SIMD_NONE);
+    int levels[] = { TY_MAPPER_SIMD_SSE41, TY_MAPPER_SIMD_AVX2, TY_MAPPER_SIMD_NEON };
+    for(int l = 0; l < 3; l++) {
+        int simd = levels[l];
+        if(simd != TYGetSimdLevel() && !(simd == TY_MAPPER_SIMD_SSE41 && TYGetSimdLevel() == TY_MAPPER_SIMD_AVX2)) continue;
+        double t_c = benchRun(iters, [&]() {
+            TYSampleImageRangeBilinear<uint8_t, 3>(ctx->lut, ctx->p3d, 0, depthW * depthH, depthW, depthH,
+                    k, rgbW, rgbH, &rgb[0], &ref[0], -1, TY_MAPPER_SIMD_NONE);
+        });
+        double t_v = benchRun(iters, [&]() {
+            TYSampleImageRangeBilinear<uint8_t, 3>(ctx->lut, ctx->p3d, 0, depthW * depthH, depthW, depthH,
+                    k, rgbW, rgbH, &rgb[0], &out[0], -1, simd);
+        });
+        size_t diff = 0;
+        int max_diff = 0;
+        for(size_t i = 0; i < out.size(); i++) {
+            int d = abs((int)out[i] - (int)ref[i]);
+            if(d) diff++;
+            if(d > max_diff) max_diff = d;
+        }
+        // float division order may move a weight by one step, never more than one level
+        if(max_diff > 1) failures++;
+        printf("%4ux%-4u <- %4ux%-4u  bilinear %-6s  scalar %7.3f ms  vector %7.3f ms  speedup %5.2fx  differ %zu max %d %s\n",
+               depthW, depthH, rgbW, rgbH, simd == TY_MAPPER_SIMD_AVX2 ? "avx2" : simd == TY_MAPPER_SIMD_SSE41 ? "sse4.1" : "neon",
+               t_c, t_v, t_c / t_v, diff, max_diff, max_diff > 1 ? "FAIL" : "ok");
+    }
+    TYDestroyRegistrationContext(ctx);
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 20;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    int failures = 0;
+    failures += benchOne(depth_calib, color_calib, 640, 480, 1280, 960, iters);
+    failures += benchOne(depth_calib, color_calib, 1280, 960, 1280, 960, iters);
+    failures += benchOne(depth_calib, color_calib, 1280, 960, 2560, 1920, iters);
+    if(failures) {
+        printf("%d configuration(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "BenchCommon.hpp"
+
+// Compare TYMapDepthImageToColorCoordinate with its fused single pass version.
+static void benchOne(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                     uint32_t depthW, uint32_t depthH, uint32_t mappedW, uint32_t mappedH, int iters)
+{
+    std::vector<uint16_t> depth(depthW * depthH);
+    benchMakeDepthScene(&depth[0], depthW, depthH);
+
+    std::vector<uint16_t> ref(mappedW * mappedH), fused(mappedW * mappedH);
+    double t_ref = benchRun(iters, [&]() {
+        memset(&ref[0], 0, ref.size() * sizeof(uint16_t));
+        TYMapDepthImageToColorCoordinate(&depth_calib, depthW, depthH, &depth[0],
+                &color_calib, mappedW, mappedH, &ref[0]);
+    });
+    double t_fused = benchRun(iters, [&]() {
+        memset(&fused[0], 0, fused.size() * sizeof(uint16_t));
+        TYMapDepthImageToColorCoordinateFused(&depth_calib, depthW, depthH, &depth[0],
+                &color_calib, mappedW, mappedH, &fused[0]);
+    });
+
+    uint32_t diff = 0, valid = 0;
+    for(size_t i = 0; i < ref.size(); i++) {
+        if(ref[i]) valid++;
+        if(ref[i] != fused[i]) diff++;
+    }
+    printf("%4ux%-4u -> %4ux%-4u  inline %8.3f ms  fused %8.3f ms  speedup %5.2fx  mismatch %u/%u\n",
+           depthW, depthH, mappedW, mappedH, t_ref, t_fused, t_ref / t_fused, diff, valid);
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 20;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    benchOne(depth_calib, color_calib, 640, 480, 640, 480, iters);
+    benchOne(depth_calib, color_calib, 1280, 960, 1280, 960, iters);
+    benchOne(depth_calib, color_calib, 640, 480, 1280, 960, iters);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "BenchCommon.hpp"
+
+// Occlusion removal on the depth to color lookup table: fill-and-compare
+// TYPixelsOverlapRemove against the single pass TYPixelsOcclusionResolve,
+// then the whole context update with each of them.
+static int benchOne(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                    uint32_t depthW, uint32_t depthH, int iters)
+{
+    uint32_t count = depthW * depthH;
+    std::vector<uint16_t> depth(count), zbuffer(count);
+    benchMakeDepthScene(&depth[0], depthW, depthH);
+
+    std::vector<TY_PIXEL_DESC> lut(count), legacy(count), fast(count);
+    TYCreateDepthToColorCoordinateLookupTable(&depth_calib, depthW, depthH, &depth[0],
+            &color_calib, depthW, depthH, &lut[0]);
+
+    TYOcclusionParams params;
+    params.radius = 1;
+    params.threshold = 5.f;
+    params.relative = 0.005f;
+
+    double t_legacy = benchRun(iters, [&]() {
+        legacy = lut;
+        TYPixelsOverlapRemove(&legacy[0], count, depthW, depthH, &zbuffer[0]);
+    });
+    double t_fast = benchRun(iters, [&]() {
+        fast = lut;
+        TYPixelsOcclusionResolve(&fast[0], count, depthW, depthH, &params, &zbuffer[0]);
+    });
+    double t_copy = benchRun(iters, [&]() {
+        fast = lut;
+    });
+    fast = lut;
+    TYPixelsOcclusionResolve(&fast[0], count, depthW, depthH, &params, &zbuffer[0]);
+
+    // the legacy fill leaves the z-buffer border empty, points landing there are all rejected
+    uint32_t rejected_legacy = 0, rejected_fast = 0, legacy_only = 0, legacy_border = 0, fast_only = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        if(!lut[i].depth) continue;
+        bool a = legacy[i].depth == 0, b = fast[i].depth == 0;
+        rejected_legacy += a;
+        rejected_fast += b;
+        legacy_only += a && !b;
+        legacy_border += a && !b && (lut[i].x == 0 || lut[i].y == 0
+                || lut[i].x == (int32_t)depthW - 1 || lut[i].y == (int32_t)depthH - 1);
+        fast_only += b && !a;
+    }
+    printf("%4ux%-4u  overlap remove %7.3f ms  occlusion resolve %7.3f ms  speedup %5.2fx  rejected %u / %u  legacy only %u (border %u)  resolve only %u\n",
+           depthW, depthH, t_legacy - t_copy, t_fast - t_copy, (t_legacy - t_copy) / (t_fast - t_copy),
+           rejected_legacy, rejected_fast, legacy_only, legacy_border, fast_only);
+
+    // whole context update, and thread count independence of the new test
+    TYRegistrationContext* ctx = NULL;
+    if(TYCreateRegistrationContext(&depth_calib, &color_calib, depthW, depthH, &ctx) != TY_STATUS_OK) {
+        printf("create context failed\n");
+        return 1;
+    }
+    double t_ctx_legacy = benchRun(iters, [&]() {
+        TYRegistrationUpdateLookupTable(ctx, &depth[0]);
+    });
+    TYRegistrationSetOcclusion(ctx, &params);
+    double t_ctx_fast = benchRun(iters, [&]() {
+        TYRegistrationUpdateLookupTable(ctx, &depth[0]);
+    });
+    std::vector<TY_PIXEL_DESC> single(ctx->lut, ctx->lut + count);
+    uint32_t differ = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        if(memcmp(&single[i], &fast[i], sizeof(TY_PIXEL_DESC))) differ++;
+    }
+    uint32_t threads[] = { 2, 4, 7 };
+    for(int k = 0; k < 3; k++) {
+        TYRegistrationSetThreadCount(ctx, threads[k]);
+        TYRegistrationUpdateLookupTable(ctx, &depth[0]);
+        for(uint32_t i = 0; i < count; i++) {
+            if(memcmp(&single[i], &ctx->lut[i], sizeof(TY_PIXEL_DESC))) differ++;
+        }
+    }
+    TYDestroyRegistrationContext(ctx);
+    printf("%4ux%-4u  context update  legacy %7.3f ms  resolve %7.3f ms  speedup %5.2fx  thread mismatch %u %s\n",
+           depthW, depthH, t_ctx_legacy, t_ctx_fast, t_ctx_legacy / t_ctx_fast, differ, differ ? "FAIL" : "ok");
+    return differ ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 20;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    int failures = 0;
+    failures += benchOne(depth_calib, color_calib, 640, 480, iters);
+    failures += benchOne(depth_calib, color_calib, 1280, 960, iters);
+    return failures;
+}
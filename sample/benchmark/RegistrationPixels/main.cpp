@@ -0,0 +1,123 @@
+#include "BenchCommon.hpp"
+
+// Sparse RGB -> depth lookups: brute force depth scan against the epipolar
+// walk of TYMapRGBPixelsToDepthCoordinate with a precomputed projection.
+// Depth scan TYMapRGBPixelsToDepthCoordinate used before the epipolar walk,
+// kept as the reference: one projection per depth value and input pixel.
+static void referenceScan(const TY_CAMERA_CALIB_INFO* depth_calib,
+                          uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                          const TY_CAMERA_CALIB_INFO* color_calib,
+                          uint32_t rgbW, uint32_t rgbH,
+                          const TY_PIXEL_COLOR_DESC* src, uint32_t cnt,
+                          uint32_t min_distance, uint32_t max_distance,
+                          TY_PIXEL_COLOR_DESC* dst)
+{
+    uint32_t range = max_distance - min_distance;
+    std::vector<TY_PIXEL_DESC> pixels(range), mapped(range);
+    std::vector<TY_VECT_3F> p3d(range);
+    for(uint32_t i = 0; i < cnt; i++) {
+        for(uint32_t m = 0; m < range; m++) {
+            pixels[m].x = src[i].x;
+            pixels[m].y = src[i].y;
+            pixels[m].depth = m + min_distance;
+        }
+        TYMapDepthToPoint3d(color_calib, rgbW, rgbH, &pixels[0], range, &p3d[0]);
+        TYMapPoint3dToPoint3d(&color_calib->extrinsic, &p3d[0], range, &p3d[0]);
+        TYMapPoint3dToDepth(depth_calib, &p3d[0], range, depthW, depthH, &mapped[0]);
+
+        uint16_t min_delt = 0xffff;
+        dst[i].x = -1;
+        dst[i].y = -1;
+        for(uint32_t m = 0; m < range; m++) {
+            int16_t x = mapped[m].x;
+            int16_t y = mapped[m].y;
+            uint16_t delt = abs(mapped[m].depth - depth[y * depthW + x]);
+            if(delt < min_delt) {
+                min_delt = delt;
+                if(min_delt < 10) {
+                    dst[i] = src[i];
+                    dst[i].x = x;
+                    dst[i].y = y;
+                }
+            }
+        }
+    }
+}
+
+static int benchOne(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                    uint32_t depthW, uint32_t depthH, uint32_t rgbW, uint32_t rgbH,
+                    uint32_t min_distance, uint32_t max_distance, uint32_t count, int iters)
+{
+    std::vector<uint16_t> depth(depthW * depthH);
+    benchMakeDepthScene(&depth[0], depthW, depthH);
+
+    // keep away from the border, the reference does not check bounds
+    std::vector<TY_PIXEL_COLOR_DESC> src(count);
+    uint32_t seed = 2024;
+    for(uint32_t i = 0; i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        src[i].x = (int16_t)(rgbW / 8 + (seed >> 8) % (rgbW * 3 / 4));
+        seed = seed * 1664525u + 1013904223u;
+        src[i].y = (int16_t)(rgbH / 8 + (seed >> 8) % (rgbH * 3 / 4));
+        src[i].bgr_ch1 = (uint8_t)i;
+        src[i].bgr_ch2 = (uint8_t)(i >> 8);
+        src[i].bgr_ch3 = 0x5a;
+        src[i].rsvd = 0;
+    }
+
+    std::vector<TY_PIXEL_COLOR_DESC> ref(count), out(count);
+    double t_ref = benchRun(iters, [&]() {
+        referenceScan(&depth_calib, depthW, depthH, &depth[0],
+                &color_calib, rgbW, rgbH, &src[0], count, min_distance, max_distance, &ref[0]);
+    });
+
+    TYColorToDepthProjection proj;
+    TYInitColorToDepthProjection(&color_calib, rgbW, rgbH, &depth_calib, depthW, depthH, &proj);
+    double t_new = benchRun(iters, [&]() {
+        TYMapRGBPixelsToDepthCoordinate(&proj, depthW, depthH, &depth[0],
+                &src[0], count, min_distance, max_distance, &out[0]);
+    });
+
+    uint32_t found = 0, same = 0, near = 0, lost = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        if(ref[i].x >= 0) found++;
+        if(ref[i].x == out[i].x && ref[i].y == out[i].y) {
+            same++;
+        } else if(ref[i].x >= 0 && out[i].x >= 0 && abs(ref[i].x - out[i].x) <= 1 && abs(ref[i].y - out[i].y) <= 1) {
+            near++;
+        } else {
+            lost++;
+        }
+    }
+    printf("%4ux%-4u <- %4ux%-4u  %4u..%-4u  %u px  scan %9.3f ms  epipolar %7.3f ms  speedup %7.1fx  "
+           "found %u same %u near %u other %u\n",
+           depthW, depthH, rgbW, rgbH, min_distance, max_distance, count,
+           t_ref, t_new, t_ref / t_new, found, same, near, lost);
+    return lost * 100 > count ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 5;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    int failures = 0;
+    failures += benchOne(depth_calib, color_calib, 640, 480, 1280, 960, 200, 5000, 200, iters);
+    failures += benchOne(depth_calib, color_calib, 1280, 960, 1280, 960, 200, 5000, 200, iters);
+    failures += benchOne(depth_calib, color_calib, 1280, 960, 1920, 1080, 400, 2000, 500, iters);
+    if(failures) {
+        printf("%d configuration(s) disagree with the depth scan on more than 1%% of the pixels\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "BenchCommon.hpp"
+
+// Scalar loop of TYMapRGBImageToDepthCoordinate before the vector kernels,
+// kept verbatim as the reference output.
+template<typename T, int CN>
+static void referenceSample(const TY_PIXEL_DESC* lut, uint32_t depthW, uint32_t depthH,
+                            uint32_t srcW, uint32_t srcH, const T* src, T* dst)
+{
+    for(uint32_t depthr = 0; depthr < depthH; depthr++)
+    for(uint32_t depthc = 0; depthc < depthW; depthc++)
+    {
+        const TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
+        T* outPtr = &dst[depthW * depthr * CN + depthc * CN];
+        if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
+            for(int ch = 0; ch < CN; ch++) outPtr[ch] = 0;
+        } else {
+            uint16_t scale_x = (uint16_t)(1.f * plut->x * srcW / depthW + 0.5);
+            uint16_t scale_y = (uint16_t)(1.f * plut->y * srcH / depthH + 0.5);
+            if(scale_x >= srcW) scale_x = srcW - 1;
+            if(scale_y >= srcH) scale_y = srcH - 1;
+            const T* inPtr = &src[srcW * scale_y * CN + scale_x * CN];
+            for(int ch = 0; ch < CN; ch++) outPtr[ch] = inPtr[ch];
+        }
+    }
+}
+
+/// Lookup table with every pixel valid, plus ~10% invalid or out of range entries.
+static void makeLookupTable(std::vector<TY_PIXEL_DESC>& lut, uint32_t depthW, uint32_t depthH)
+{
+    uint32_t seed = 12345;
+    for(size_t i = 0; i < lut.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        memset(&lut[i], 0, sizeof(TY_PIXEL_DESC));
+        lut[i].x = (int16_t)(i % depthW);
+        lut[i].y = (int16_t)(i / depthW);
+        switch((seed >> 24) % 20) {
+            case 0: lut[i].x = -1; lut[i].y = -1; break;
+            case 1: lut[i].x = (int16_t)depthW; break;
+            case 2: lut[i].y = (int16_t)(depthH + (seed & 0xff)); break;
+            case 3: lut[i].x = (int16_t)(-(int)(seed & 0xff)); break;
+            default: break;
+        }
+    }
+}
+
+static const char* simdName(int simd)
+{
+    switch(simd) {
+        case TY_MAPPER_SIMD_SSE41: return "sse4.1";
+        case TY_MAPPER_SIMD_AVX2:  return "avx2";
+        case TY_MAPPER_SIMD_NEON:  return "neon";
+        default:                   return "scalar";
+    }
+}
+
+template<typename T, int CN>
+static int benchOne(const char* name, uint32_t depthW, uint32_t depthH, uint32_t srcW, uint32_t srcH, int iters)
+{
+    std::vector<TY_PIXEL_DESC> lut(depthW * depthH);
+    makeLookupTable(lut, depthW, depthH);
+    std::vector<T> src(srcW * srcH * CN);
+    for(size_t i = 0; i < src.size(); i++) src[i] = (T)(i * 2654435761u >> 13);
+
+    std::vector<T> ref(depthW * depthH * CN), out(ref.size());
+    double t_ref = benchRun(iters, [&]() {
+        referenceSample<T, CN>(&lut[0], depthW, depthH, srcW, srcH, &src[0], &ref[0]);
+    });
+
+    int failures = 0;
+    int levels[] = { TY_MAPPER_SIMD_NONE, TY_MAPPER_SIMD_SSE41, TY_MAPPER_SIMD_AVX2, TY_MAPPER_SIMD_NEON };
+    for(size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        int simd = levels[l];
+        if(simd != TY_MAPPER_SIMD_NONE && simd != TYGetSimdLevel()
+                && !(simd == TY_MAPPER_SIMD_SSE41 && TYGetSimdLevel() == TY_MAPPER_SIMD_AVX2)) {
+            continue;
+        }
+        memset(&out[0], 0xa5, out.size() * sizeof(T));
+        double t = benchRun(iters, [&]() {
+            TYSampleImageByLookupTable<T, CN>(&lut[0], depthW, depthH, srcW, srcH, &src[0], &out[0], simd);
+        });
+        size_t diff = 0;
+        for(size_t i = 0; i < ref.size(); i++) {
+            if(ref[i] != out[i]) diff++;
+        }
+        if(diff) failures++;
+        printf("%-7s %4ux%-4u <- %4ux%-4u  %-6s  ref %7.3f ms  new %7.3f ms  speedup %5.2fx  mismatch %zu %s\n",
+               name, depthW, depthH, srcW, srcH, simdName(simd), t_ref, t, t_ref / t, diff, diff ? "FAIL" : "ok");
+    }
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 20;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    printf("detected simd level: %s\n", simdName(TYGetSimdLevel()));
+    int failures = 0;
+    failures += benchOne<uint8_t, 3>("rgb", 1280, 960, 1280, 960, iters);
+    failures += benchOne<uint8_t, 3>("rgb", 640, 480, 1280, 960, iters);
+    failures += benchOne<uint8_t, 3>("rgb", 1280, 960, 2560, 1920, iters);
+    failures += benchOne<uint8_t, 3>("rgb", 1280, 960, 1920, 1080, iters);
+    failures += benchOne<uint16_t, 3>("rgb48", 640, 480, 1280, 960, iters);
+    failures += benchOne<uint16_t, 1>("mono16", 1280, 960, 640, 480, iters);
+    failures += benchOne<uint8_t, 1>("mono8", 1280, 960, 1280, 960, iters);
+    failures += benchOne<uint8_t, 1>("mono8", 1279, 957, 1283, 961, iters);
+    if(failures) {
+        printf("%d configuration(s) differ from the reference\n", failures);
+        return 1;
+    }
+    return 0;
+}
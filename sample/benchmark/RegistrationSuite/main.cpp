@@ -0,0 +1,373 @@
+#include "BenchCommon.hpp"
+#include <string>
+#include <thread>
+
+// Every mapping entry point of TYCoordinateMapper.h on synthetic calibration and
+// depth scenes, at several resolutions. Text, CSV or JSON output, to keep track of
+// regressions across SDK releases without a camera.
+
+struct SuiteSize
+{
+    const char* name;
+    uint32_t w;
+    uint32_t h;
+};
+
+struct SuiteResult
+{
+    std::string bench;
+    std::string scene;
+    std::string size;
+    uint32_t w;
+    uint32_t h;
+    int iters;
+    BenchStats stats;
+};
+
+/// Buffers for one resolution, depth and color images share the size.
+struct SuiteFrame
+{
+    uint32_t w, h;
+    std::vector<uint16_t> depth, mapped;
+    std::vector<TY_VECT_3F> p3d, p3d_color;
+    std::vector<TY_PIXEL_DESC> pixels, lut, lut_work;
+    std::vector<uint8_t> rgb, mono8, rgb_out, mono8_out;
+    std::vector<uint16_t> rgb48, mono16, rgb48_out, mono16_out, zbuffer;
+    std::vector<TY_PIXEL_COLOR_DESC> queries, answers;
+};
+
+static const char* suiteArch()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    return "x64";
+#elif defined(__i386__) || defined(_M_IX86)
+    return "i686";
+#elif defined(__aarch64__)
+    return "aarch64";
+#elif defined(__arm__)
+    return "armv7hf";
+#else
+    return "unknown";
+#endif
+}
+
+static const char* suiteCompiler()
+{
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc";
+#else
+    return "unknown";
+#endif
+}
+
+static const char* suiteSimd()
+{
+    switch(TYGetSimdLevel()) {
+    case TY_MAPPER_SIMD_SSE41: return "sse4.1";
+    case TY_MAPPER_SIMD_AVX2: return "avx2";
+    case TY_MAPPER_SIMD_NEON: return "neon";
+    default: return "none";
+    }
+}
+
+/// Comma separated filter, empty matches everything.
+static bool suiteMatch(const std::string& filter, const std::string& name)
+{
+    if(filter.empty()) return true;
+    size_t begin = 0;
+    while(begin <= filter.size()) {
+        size_t end = filter.find(',', begin);
+        if(end == std::string::npos) end = filter.size();
+        if(name.find(filter.substr(begin, end - begin)) != std::string::npos) return true;
+        begin = end + 1;
+    }
+    return false;
+}
+
+static void suiteAlloc(SuiteFrame& f, uint32_t w, uint32_t h)
+{
+    size_t n = (size_t)w * h;
+    f.w = w;
+    f.h = h;
+    f.depth.resize(n);
+    f.mapped.resize(n);
+    f.zbuffer.resize(n);
+    f.p3d.resize(n);
+    f.p3d_color.resize(n);
+    f.pixels.resize(n);
+    f.lut.resize(n);
+    f.lut_work.resize(n);
+    f.rgb.resize(n * 3);
+    f.rgb_out.resize(n * 3);
+    f.rgb48.resize(n * 3);
+    f.rgb48_out.resize(n * 3);
+    f.mono8.resize(n);
+    f.mono8_out.resize(n);
+    f.mono16.resize(n);
+    f.mono16_out.resize(n);
+    benchMakeColorImage(&f.rgb[0], w, h, 3);
+    benchMakeColorImage(&f.mono8[0], w, h, 1);
+    for(size_t i = 0; i < n * 3; i++) f.rgb48[i] = (uint16_t)(f.rgb[i] * 257);
+    for(size_t i = 0; i < n; i++) f.mono16[i] = (uint16_t)(f.mono8[i] * 257);
+
+    // color pixel queries on a regular grid
+    f.queries.clear();
+    for(uint32_t y = h / 64; y < h; y += h / 32) {
+        for(uint32_t x = w / 64; x < w; x += w / 32) {
+            TY_PIXEL_COLOR_DESC q;
+            memset(&q, 0, sizeof(q));
+            q.x = (int16_t)x;
+            q.y = (int16_t)y;
+            f.queries.push_back(q);
+        }
+    }
+    f.answers.resize(f.queries.size());
+}
+
+static void suiteScene(SuiteFrame& f, int scene, const TY_CAMERA_CALIB_INFO& depth_calib,
+                       const TY_CAMERA_CALIB_INFO& color_calib)
+{
+    benchMakeScene(scene, &f.depth[0], f.w, f.h);
+    for(uint32_t i = 0; i < f.w * f.h; i++) {
+        f.pixels[i].x = (int16_t)(i % f.w);
+        f.pixels[i].y = (int16_t)(i / f.w);
+        f.pixels[i].depth = f.depth[i];
+        f.pixels[i].rsvd = 0;
+    }
+    TYMapDepthImageToPoint3d(&depth_calib, f.w, f.h, &f.depth[0], &f.p3d[0]);
+    TY_CAMERA_EXTRINSIC extri_inv;
+    TYInvertExtrinsic(&color_calib.extrinsic, &extri_inv);
+    TYMapPoint3dToPoint3d(&extri_inv, &f.p3d[0], f.w * f.h, &f.p3d_color[0]);
+    TYCreateDepthToColorCoordinateLookupTable(&depth_calib, f.w, f.h, &f.depth[0],
+            &color_calib, f.w, f.h, &f.lut[0]);
+}
+
+static void suiteRun(std::vector<SuiteResult>& results, const std::string& filter,
+                     const char* bench, const char* scene, const SuiteSize& size, int iters,
+                     const std::function<void()>& fn)
+{
+    if(!suiteMatch(filter, bench)) return;
+    SuiteResult r;
+    r.bench = bench;
+    r.scene = scene;
+    r.size = size.name;
+    r.w = size.w;
+    r.h = size.h;
+    r.iters = iters;
+    r.stats = benchRunStats(iters, fn);
+    results.push_back(r);
+    fprintf(stderr, "%-48s %-8s %-9s %9.3f ms\n", bench, scene, size.name, r.stats.median);
+}
+
+static void suiteBenchAll(std::vector<SuiteResult>& results, const std::string& filter,
+                          SuiteFrame& f, int scene, const SuiteSize& size, int iters,
+                          const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib)
+{
+    const char* sn = benchSceneName(scene);
+    uint32_t w = f.w, h = f.h, n = w * h;
+    TY_CAMERA_EXTRINSIC extri_inv;
+    TYInvertExtrinsic(&color_calib.extrinsic, &extri_inv);
+
+    suiteRun(results, filter, "TYMapDepthImageToPoint3d", sn, size, iters, [&]() {
+        TYMapDepthImageToPoint3d(&depth_calib, w, h, &f.depth[0], &f.p3d[0]);
+    });
+    suiteRun(results, filter, "TYMapDepthToPoint3d", sn, size, iters, [&]() {
+        TYMapDepthToPoint3d(&depth_calib, w, h, &f.pixels[0], n, &f.p3d[0]);
+    });
+    suiteRun(results, filter, "TYMapPoint3dToPoint3d", sn, size, iters, [&]() {
+        TYMapPoint3dToPoint3d(&extri_inv, &f.p3d[0], n, &f.p3d_color[0]);
+    });
+    suiteRun(results, filter, "TYMapPoint3dToDepthImage", sn, size, iters, [&]() {
+        memset(&f.mapped[0], 0, n * sizeof(uint16_t));
+        TYMapPoint3dToDepthImage(&color_calib, &f.p3d_color[0], n, w, h, &f.mapped[0]);
+    });
+    suiteRun(results, filter, "TYMapPoint3dToDepth", sn, size, iters, [&]() {
+        TYMapPoint3dToDepth(&color_calib, &f.p3d_color[0], n, w, h, &f.lut_work[0]);
+    });
+    suiteRun(results, filter, "TYDepthImageFillEmptyRegion", sn, size, iters, [&]() {
+        memcpy(&f.mapped[0], &f.depth[0], n * sizeof(uint16_t));
+        TYDepthImageFillEmptyRegion(&f.mapped[0], w, h);
+    });
+    suiteRun(results, filter, "TYMapDepthToColorCoordinate", sn, size, iters, [&]() {
+        TYMapDepthToColorCoordinate(&depth_calib, w, h, &f.pixels[0], n, &color_calib, w, h, &f.lut_work[0]);
+    });
+    suiteRun(results, filter, "TYMapDepthImageToColorCoordinate", sn, size, iters, [&]() {
+        memset(&f.mapped[0], 0, n * sizeof(uint16_t));
+        TYMapDepthImageToColorCoordinate(&depth_calib, w, h, &f.depth[0], &color_calib, w, h, &f.mapped[0]);
+    });
+    suiteRun(results, filter, "TYMapDepthImageToColorCoordinateFused", sn, size, iters, [&]() {
+        memset(&f.mapped[0], 0, n * sizeof(uint16_t));
+        TYMapDepthImageToColorCoordinateFused(&depth_calib, w, h, &f.depth[0], &color_calib, w, h, &f.mapped[0]);
+    });
+    TYDepthToColorContext* d2c = NULL;
+    if(TYCreateDepthToColorContext(&depth_calib, &color_calib, w, h, w, h, &d2c) == TY_STATUS_OK) {
+        suiteRun(results, filter, "TYMapDepthImageToColorCoordinate(ctx)", sn, size, iters, [&]() {
+            TYMapDepthImageToColorCoordinate(d2c, &f.depth[0], &f.mapped[0]);
+        });
+        TYDestroyDepthToColorContext(d2c);
+    }
+    suiteRun(results, filter, "TYCreateDepthToColorCoordinateLookupTable", sn, size, iters, [&]() {
+        TYCreateDepthToColorCoordinateLookupTable(&depth_calib, w, h, &f.depth[0], &color_calib, w, h, &f.lut_work[0]);
+    });
+    suiteRun(results, filter, "TYPixelsOverlapRemove", sn, size, iters, [&]() {
+        memcpy(&f.lut_work[0], &f.lut[0], n * sizeof(TY_PIXEL_DESC));
+        TYPixelsOverlapRemove(&f.lut_work[0], n, w, h, &f.zbuffer[0]);
+    });
+    TYOcclusionParams occlusion;
+    occlusion.radius = 1;
+    occlusion.threshold = 5.f;
+    occlusion.relative = 0.005f;
+    suiteRun(results, filter, "TYPixelsOcclusionResolve", sn, size, iters, [&]() {
+        memcpy(&f.lut_work[0], &f.lut[0], n * sizeof(TY_PIXEL_DESC));
+        TYPixelsOcclusionResolve(&f.lut_work[0], n, w, h, &occlusion, &f.zbuffer[0]);
+    });
+    suiteRun(results, filter, "TYMapRGBImageToDepthCoordinate", sn, size, iters, [&]() {
+        TYMapRGBImageToDepthCoordinate(&depth_calib, w, h, &f.depth[0], &color_calib, w, h, &f.rgb[0], &f.rgb_out[0]);
+    });
+    suiteRun(results, filter, "TYMapRGB48ImageToDepthCoordinate", sn, size, iters, [&]() {
+        TYMapRGB48ImageToDepthCoordinate(&depth_calib, w, h, &f.depth[0], &color_calib, w, h, &f.rgb48[0], &f.rgb48_out[0]);
+    });
+    suiteRun(results, filter, "TYMapMono16ImageToDepthCoordinate", sn, size, iters, [&]() {
+        TYMapMono16ImageToDepthCoordinate(&depth_calib, w, h, &f.depth[0], &color_calib, w, h, &f.mono16[0], &f.mono16_out[0]);
+    });
+    suiteRun(results, filter, "TYMapMono8ImageToDepthCoordinate", sn, size, iters, [&]() {
+        TYMapMono8ImageToDepthCoordinate(&depth_calib, w, h, &f.depth[0], &color_calib, w, h, &f.mono8[0], &f.mono8_out[0]);
+    });
+
+    TYRegistrationContext* ctx = NULL;
+    if(TYCreateRegistrationContext(&depth_calib, &color_calib, w, h, &ctx) == TY_STATUS_OK) {
+        suiteRun(results, filter, "TYRegistrationUpdateLookupTable", sn, size, iters, [&]() {
+            TYRegistrationUpdateLookupTable(ctx, &f.depth[0]);
+        });
+        suiteRun(results, filter, "TYMapRGBImageToDepthCoordinate(ctx)", sn, size, iters, [&]() {
+            TYMapRGBImageToDepthCoordinate(ctx, &f.depth[0], w, h, &f.rgb[0], &f.rgb_out[0]);
+        });
+        suiteRun(results, filter, "TYMapMono16ImageToDepthCoordinate(ctx)", sn, size, iters, [&]() {
+            TYMapMono16ImageToDepthCoordinate(ctx, &f.depth[0], w, h, &f.mono16[0], &f.mono16_out[0]);
+        });
+        TYRegistrationSetSampleMode(ctx, TY_REGISTRATION_SAMPLE_BILINEAR);
+        suiteRun(results, filter, "TYMapRGBImageToDepthCoordinate(ctx,bilinear)", sn, size, iters, [&]() {
+            TYMapRGBImageToDepthCoordinate(ctx, &f.depth[0], w, h, &f.rgb[0], &f.rgb_out[0]);
+        });
+        TYRegistrationSetSampleMode(ctx, TY_REGISTRATION_SAMPLE_NEAREST);
+        TYRegistrationSetOcclusion(ctx, &occlusion);
+        suiteRun(results, filter, "TYRegistrationUpdateLookupTable(occlusion)", sn, size, iters, [&]() {
+            TYRegistrationUpdateLookupTable(ctx, &f.depth[0]);
+        });
+        TYDestroyRegistrationContext(ctx);
+    }
+
+    uint32_t cnt = (uint32_t)f.queries.size();
+    suiteRun(results, filter, "TYMapRGBPixelsToDepthCoordinate", sn, size, iters, [&]() {
+        TYMapRGBPixelsToDepthCoordinate(&depth_calib, w, h, &f.depth[0], &color_calib, w, h,
+                &f.queries[0], cnt, 100, 10000, &f.answers[0]);
+    });
+    TYColorToDepthProjection proj;
+    TYInitColorToDepthProjection(&color_calib, w, h, &depth_calib, w, h, &proj);
+    suiteRun(results, filter, "TYMapRGBPixelsToDepthCoordinate(proj)", sn, size, iters, [&]() {
+        TYMapRGBPixelsToDepthCoordinate(&proj, w, h, &f.depth[0], &f.queries[0], cnt, 100, 10000, &f.answers[0]);
+    });
+}
+
+static void suiteWrite(FILE* out, const std::string& format, const std::vector<SuiteResult>& results)
+{
+    TY_VERSION_INFO version;
+    memset(&version, 0, sizeof(version));
+    TYLibVersion(&version);
+    if(format == "json") {
+        fprintf(out, "{\n  \"meta\": {\"lib_version\": \"%d.%d.%d\", \"arch\": \"%s\", \"compiler\": \"%s\", "
+                     "\"simd\": \"%s\", \"hardware_threads\": %u},\n  \"results\": [\n",
+                version.major, version.minor, version.patch, suiteArch(), suiteCompiler(), suiteSimd(),
+                std::thread::hardware_concurrency());
+        for(size_t i = 0; i < results.size(); i++) {
+            const SuiteResult& r = results[i];
+            fprintf(out, "    {\"bench\": \"%s\", \"scene\": \"%s\", \"size\": \"%s\", \"width\": %u, \"height\": %u, "
+                         "\"iters\": %d, \"mean_ms\": %.4f, \"median_ms\": %.4f, \"min_ms\": %.4f}%s\n",
+                    r.bench.c_str(), r.scene.c_str(), r.size.c_str(), r.w, r.h, r.iters,
+                    r.stats.mean, r.stats.median, r.stats.min, i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    } else if(format == "csv") {
+        fprintf(out, "bench,scene,size,width,height,iters,mean_ms,median_ms,min_ms,lib_version,arch,simd\n");
+        for(size_t i = 0; i < results.size(); i++) {
+            const SuiteResult& r = results[i];
+            fprintf(out, "\"%s\",%s,%s,%u,%u,%d,%.4f,%.4f,%.4f,%d.%d.%d,%s,%s\n",
+                    r.bench.c_str(), r.scene.c_str(), r.size.c_str(), r.w, r.h, r.iters,
+                    r.stats.mean, r.stats.median, r.stats.min,
+                    version.major, version.minor, version.patch, suiteArch(), suiteSimd());
+        }
+    } else {
+        fprintf(out, "lib %d.%d.%d  %s  %s  simd %s\n", version.major, version.minor, version.patch,
+                suiteArch(), suiteCompiler(), suiteSimd());
+        fprintf(out, "%-48s %-8s %-9s %10s %10s %10s\n", "bench", "scene", "size", "mean ms", "median ms", "min ms");
+        for(size_t i = 0; i < results.size(); i++) {
+            const SuiteResult& r = results[i];
+            fprintf(out, "%-48s %-8s %-9s %10.3f %10.3f %10.3f\n", r.bench.c_str(), r.scene.c_str(),
+                    r.size.c_str(), r.stats.mean, r.stats.median, r.stats.min);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 5;
+    std::string format = "text", output, bench_filter, scene_filter, size_filter;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            bench_filter = argv[++i];
+        } else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            scene_filter = argv[++i];
+        } else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            size_filter = argv[++i];
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>] [-f text|csv|json] [-o <file>]\n", argv[0]);
+            printf("          [-b <bench,...>] [-c <scene,...>] [-s <size,...>]\n");
+            printf("    filters match substrings, scenes: ");
+            for(int k = 0; k < BENCH_SCENE_COUNT; k++) printf("%s ", benchSceneName(k));
+            printf("\n    sizes: vga 1280x960 4k\n");
+            return 0;
+        }
+    }
+    if(format != "text" && format != "csv" && format != "json") {
+        fprintf(stderr, "unknown format %s\n", format.c_str());
+        return 1;
+    }
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    const SuiteSize sizes[] = { { "vga", 640, 480 }, { "1280x960", 1280, 960 }, { "4k", 3840, 2160 } };
+    std::vector<SuiteResult> results;
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if(!suiteMatch(size_filter, sizes[s].name)) continue;
+        SuiteFrame frame;
+        suiteAlloc(frame, sizes[s].w, sizes[s].h);
+        for(int scene = 0; scene < BENCH_SCENE_COUNT; scene++) {
+            if(!suiteMatch(scene_filter, benchSceneName(scene))) continue;
+            suiteScene(frame, scene, depth_calib, color_calib);
+            suiteBenchAll(results, bench_filter, frame, scene, sizes[s], iters, depth_calib, color_calib);
+        }
+    }
+
+    FILE* out = stdout;
+    if(!output.empty()) {
+        out = fopen(output.c_str(), "w");
+        if(!out) {
+            fprintf(stderr, "cannot open %s\n", output.c_str());
+            return 1;
+        }
+    }
+    suiteWrite(out, format, results);
+    if(out != stdout) fclose(out);
+    return 0;
+}
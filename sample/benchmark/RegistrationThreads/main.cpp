@@ -0,0 +1,88 @@
+#include "BenchCommon.hpp"
+
+// Thread scaling of the context registration path, output of every thread
+// count is checked against the single thread context and the legacy call.
+static int benchOne(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                    uint32_t depthW, uint32_t depthH, uint32_t rgbW, uint32_t rgbH,
+                    const std::vector<uint32_t>& threads, int iters)
+{
+    std::vector<uint16_t> depth(depthW * depthH);
+    benchMakeDepthScene(&depth[0], depthW, depthH);
+    std::vector<uint8_t> rgb(rgbW * rgbH * 3);
+    benchMakeColorImage(&rgb[0], rgbW, rgbH, 3);
+
+    std::vector<uint8_t> legacy(depthW * depthH * 3), ref(legacy.size()), out(legacy.size());
+    TYMapRGBImageToDepthCoordinate(&depth_calib, depthW, depthH, &depth[0],
+            &color_calib, rgbW, rgbH, &rgb[0], &legacy[0]);
+
+    TYRegistrationContext* ctx = NULL;
+    if(TYCreateRegistrationContext(&depth_calib, &color_calib, depthW, depthH, &ctx) != TY_STATUS_OK) {
+        printf("create context failed\n");
+        return 1;
+    }
+
+    int failures = 0;
+    double t1 = 0;
+    for(size_t k = 0; k < threads.size(); k++) {
+        if(TYRegistrationSetThreadCount(ctx, threads[k]) != TY_STATUS_OK) {
+            printf("set %u threads failed\n", threads[k]);
+            failures++;
+            continue;
+        }
+        memset(&out[0], 0, out.size());
+        double t = benchRun(iters, [&]() {
+            TYMapRGBImageToDepthCoordinate(ctx, &depth[0], rgbW, rgbH, &rgb[0], &out[0]);
+        });
+        if(k == 0) {
+            t1 = t;
+            ref = out;
+        }
+
+        size_t diff = 0, diff_legacy = 0;
+        for(size_t i = 0; i < out.size(); i++) {
+            if(out[i] != ref[i]) diff++;
+            if(out[i] != legacy[i]) diff_legacy++;
+        }
+        if(diff || diff_legacy) failures++;
+        printf("%4ux%-4u <- %4ux%-4u  threads %2u  %8.3f ms  scaling %5.2fx  mismatch %zu legacy %zu %s\n",
+               depthW, depthH, rgbW, rgbH, ctx->threads, t, t1 / t, diff, diff_legacy,
+               (diff || diff_legacy) ? "FAIL" : "ok");
+    }
+    TYDestroyRegistrationContext(ctx);
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 20;
+    std::vector<uint32_t> threads;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads.push_back(atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>] [-t <threads> ...]\n", argv[0]);
+            printf("    default thread counts are 1 2 4 8\n");
+            return 0;
+        }
+    }
+    if(threads.empty()) {
+        uint32_t defaults[] = { 1, 2, 4, 8 };
+        threads.assign(defaults, defaults + 4);
+    }
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    int failures = 0;
+    failures += benchOne(depth_calib, color_calib, 640, 480, 1280, 960, threads, iters);
+    failures += benchOne(depth_calib, color_calib, 1280, 960, 1280, 960, threads, iters);
+    failures += benchOne(depth_calib, color_calib, 1280, 960, 2560, 1920, threads, iters);
+    if(failures) {
+        printf("%d configuration(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
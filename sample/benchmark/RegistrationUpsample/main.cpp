@@ -0,0 +1,92 @@
+#include "BenchCommon.hpp"
+
+// Color resolution depth: TYMapDepthImageToColorCoordinate against the footprint
+// splatting context, one shot and streamed in row bands.
+static int benchOne(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                    uint32_t depthW, uint32_t depthH, uint32_t mappedW, uint32_t mappedH,
+                    uint32_t bands, int iters)
+{
+    std::vector<uint16_t> depth(depthW * depthH);
+    benchMakeDepthScene(&depth[0], depthW, depthH);
+
+    TYDepthToColorContext* ctx = NULL;
+    if(TYCreateDepthToColorContext(&depth_calib, &color_calib, depthW, depthH, mappedW, mappedH, &ctx) != TY_STATUS_OK) {
+        printf("context creation failed\n");
+        return 1;
+    }
+    TYDepthToColorSetDepthRange(ctx, 500, 2000);
+
+    std::vector<uint16_t> ref(mappedW * mappedH), once(mappedW * mappedH), streamed(mappedW * mappedH);
+    double t_ref = benchRun(iters, [&]() {
+        memset(&ref[0], 0, ref.size() * sizeof(uint16_t));
+        TYMapDepthImageToColorCoordinate(&depth_calib, depthW, depthH, &depth[0],
+                &color_calib, mappedW, mappedH, &ref[0]);
+    });
+    double t_once = benchRun(iters, [&]() {
+        TYMapDepthImageToColorCoordinate(ctx, &depth[0], &once[0]);
+    });
+
+    // rows reported ready must not change any more, keep a copy to check
+    std::vector<uint16_t> snapshot(mappedW * mappedH);
+    uint32_t first_ready = 0, changed = 0;
+    double t_stream = benchRun(iters, [&]() {
+        uint32_t rows = depthH / bands, ready = 0, copied = 0;
+        first_ready = 0;
+        TYDepthToColorBegin(ctx, &streamed[0]);
+        for(uint32_t v = 0; v < depthH; v += rows) {
+            TYDepthToColorPushRows(ctx, &depth[v * depthW], std::min(rows, depthH - v), &ready);
+            if(ready && !first_ready) first_ready = v + rows;
+            memcpy(&snapshot[copied * mappedW], &streamed[copied * mappedW], (ready - copied) * mappedW * sizeof(uint16_t));
+            copied = ready;
+        }
+        TYDepthToColorEnd(ctx);
+        changed = 0;
+        for(uint32_t i = 0; i < copied * mappedW; i++) {
+            if(snapshot[i] != streamed[i]) changed++;
+        }
+    });
+
+    uint32_t ref_valid = 0, once_valid = 0, both = 0, differ = 0;
+    double err = 0;
+    for(size_t i = 0; i < ref.size(); i++) {
+        if(ref[i]) ref_valid++;
+        if(once[i]) once_valid++;
+        if(ref[i] && once[i]) {
+            both++;
+            err += abs((int)ref[i] - (int)once[i]);
+        }
+        if(once[i] != streamed[i]) differ++;
+    }
+    printf("%4ux%-4u -> %4ux%-4u  inline %8.3f ms  context %8.3f ms  speedup %5.2fx  valid %5.1f%% -> %5.1f%%  mean abs diff %5.2f\n",
+           depthW, depthH, mappedW, mappedH, t_ref, t_once, t_ref / t_once,
+           100.0 * ref_valid / ref.size(), 100.0 * once_valid / once.size(), both ? err / both : 0.0);
+    printf("%4ux%-4u -> %4ux%-4u  %u bands  streamed %8.3f ms  first rows ready after %u/%u depth rows  differ %u  changed after ready %u %s\n",
+           depthW, depthH, mappedW, mappedH, bands, t_stream, first_ready, depthH, differ, changed,
+           differ || changed ? "FAILED" : "ok");
+
+    TYDestroyDepthToColorContext(ctx);
+    return differ || changed ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = 10;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    benchMakeCalibPair(&depth_calib, &color_calib);
+
+    int failed = 0;
+    failed |= benchOne(depth_calib, color_calib, 640, 480, 1280, 960, 16, iters);
+    failed |= benchOne(depth_calib, color_calib, 640, 480, 2560, 1920, 16, iters);
+    failed |= benchOne(depth_calib, color_calib, 640, 480, 3840, 2160, 16, iters);
+    failed |= benchOne(depth_calib, color_calib, 1280, 960, 1280, 960, 16, iters);
+    return failed;
+}
@@ -0,0 +1,173 @@
+#include <thread>
+#include <atomic>
+
+#include "BenchCommon.hpp"
+#include "RingQueue.hpp"
+
+using namespace percipio_layer;
+
+// TYRingQueue with one producer and N consumers, the way the capture queues
+// use it. The producer pushes a counter, consumers pop until the queue is
+// closed and drained:
+//   blocking   overwrite off, the producer retries a full ring, every item
+//              has to come out exactly once
+//   overwrite  a full ring drops its oldest item, every item has to come out
+//              at most once, the received plus dropped add up to the pushed
+//              and the last one always arrives
+// Each consumer has to see its items in push order. Consumers sleeping on an
+// empty ring have to wake on a push and on close, long before their timeout.
+
+static const uint32_t kTimeoutMs = 5000;
+
+struct RunResult
+{
+    double ms;
+    uint64_t received;
+    uint64_t dropped;
+    uint64_t duplicated;
+    uint64_t lost;
+    uint64_t reordered;
+    uint32_t timeouts;
+    bool newest;
+};
+
+static RunResult runQueue(bool overwrite, uint32_t items, uint32_t consumers, uint32_t capacity)
+{
+    TYRingQueue<uint32_t> queue(capacity, overwrite);
+    std::vector<std::vector<uint32_t>> seen(consumers);
+    std::atomic<bool> finished(false);
+    std::atomic<uint32_t> timeouts(0);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(uint32_t c = 0; c < consumers; c++) {
+        threads.push_back(std::thread([&, c]() {
+            uint32_t item;
+            for(;;) {
+                if(queue.pop(item, kTimeoutMs)) {
+                    seen[c].push_back(item);
+                    continue;
+                }
+                //the producer never pauses for the timeout, running into it means a lost wake up
+                if(!finished) timeouts++;
+                break;
+            }
+        }));
+    }
+    for(uint32_t i = 0; i < items; i++) {
+        while(!queue.push(i)) std::this_thread::yield();
+    }
+    finished = true;
+    queue.close();
+    for(auto& t : threads) t.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    RunResult r;
+    memset(&r, 0, sizeof(r));
+    r.ms = ms;
+    r.dropped = queue.dropped();
+    r.timeouts = timeouts;
+    std::vector<bool> out(items, false);
+    for(auto& s : seen) {
+        for(size_t i = 0; i < s.size(); i++) {
+            if(i && s[i] <= s[i - 1]) r.reordered++;
+            if(s[i] >= items || out[s[i]]) r.duplicated++;
+            else out[s[i]] = true;
+        }
+        r.received += s.size();
+    }
+    for(uint32_t i = 0; i < items; i++) {
+        if(!out[i]) r.lost++;
+    }
+    //nothing comes after the last push to overwrite it
+    r.newest = out[items - 1];
+    return r;
+}
+
+//consumers asleep on an empty ring, one push wakes one of them, close wakes the rest
+static bool checkWake(uint32_t consumers, double& push_ms, double& close_ms)
+{
+    TYRingQueue<uint32_t> queue(4, false);
+    std::atomic<uint32_t> got(0), empty(0);
+    std::vector<std::chrono::steady_clock::time_point> woke(consumers);
+    std::vector<uint32_t> popped(consumers, 0);
+    std::vector<std::thread> threads;
+    for(uint32_t c = 0; c < consumers; c++) {
+        threads.push_back(std::thread([&, c]() {
+            uint32_t item;
+            bool ok = queue.pop(item, kTimeoutMs);
+            woke[c] = std::chrono::steady_clock::now();
+            popped[c] = ok;
+            if(ok) got++;
+            else empty++;
+        }));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto pushed = std::chrono::steady_clock::now();
+    queue.push(7);
+    //the others keep sleeping until close
+    while(got + empty == 0 && std::chrono::steady_clock::now() - pushed < std::chrono::milliseconds(kTimeoutMs))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bool others_slept = got + empty == 1;
+    auto closed = std::chrono::steady_clock::now();
+    queue.close();
+    for(auto& t : threads) t.join();
+
+    push_ms = close_ms = 0;
+    for(uint32_t c = 0; c < consumers; c++) {
+        if(popped[c]) push_ms = std::chrono::duration<double, std::milli>(woke[c] - pushed).count();
+        else close_ms = std::max(close_ms, std::chrono::duration<double, std::milli>(woke[c] - closed).count());
+    }
+    return got == 1 && empty == consumers - 1 && others_slept && push_ms < kTimeoutMs / 2 && close_ms < kTimeoutMs / 2;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t items = 1000000;
+    uint32_t consumers = 4;
+    uint32_t capacity = 64;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            items = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            consumers = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-capacity") == 0 && i + 1 < argc) {
+            capacity = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <items>] [-c <consumers>] [-capacity <slots>]\n", argv[0]);
+            printf("    defaults: 1000000 items, 4 consumers, 64 slots\n");
+            return 0;
+        }
+    }
+
+    int failures = 0;
+    std::vector<uint32_t> counts(1, 1);
+    if(consumers > 1) counts.push_back(consumers);
+    for(int overwrite = 0; overwrite < 2; overwrite++) {
+        for(uint32_t c : counts) {
+            RunResult r = runQueue(overwrite != 0, items, c, capacity);
+            bool ok = r.duplicated == 0 && r.reordered == 0 && r.timeouts == 0 && r.newest &&
+                      r.received + r.dropped == items && (overwrite ? r.lost == r.dropped : r.lost == 0);
+            printf("%-9s 1 -> %2u  %u items  %8.1f ms  %6.2f M items/s  received %llu dropped %llu  "
+                   "lost %llu duplicated %llu out of order %llu  %s\n",
+                   overwrite ? "overwrite" : "blocking", c, items, r.ms, items / r.ms / 1000.0,
+                   (unsigned long long)r.received, (unsigned long long)r.dropped, (unsigned long long)r.lost,
+                   (unsigned long long)r.duplicated, (unsigned long long)r.reordered, ok ? "ok" : "FAIL");
+            if(!ok) failures++;
+        }
+    }
+
+    double push_ms = 0, close_ms = 0;
+    bool ok = checkWake(consumers, push_ms, close_ms);
+    printf("wake up   %u sleeping  on push %6.2f ms  on close %6.2f ms  %s\n",
+           consumers, push_ms, close_ms, ok ? "ok" : "FAIL");
+    if(!ok) failures++;
+
+    if(failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
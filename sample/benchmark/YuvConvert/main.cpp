@@ -0,0 +1,179 @@
+#include <cmath>
+
+#include "BenchCommon.hpp"
+#include "YuvConvert.hpp"
+
+// YUV to BGR with roi and downscale in one pass against converting the whole
+// frame and shrinking the result afterwards.
+// Correctness: vector, pooled and scalar outputs must be identical for every
+// layout and scale, the full size conversion stays within 1 of a floating point
+// BT.601 reference, a roi without scaling is the crop of the full conversion and
+// a flat color survives every scale.
+// Timing: a 4K frame to a 640x480 detector input.
+
+static size_t yuvSize(int layout, int w, int h)
+{
+    return layout == TY_YUV_YUYV ? (size_t)w * h * 2 : (size_t)w * h * 3 / 2;
+}
+
+// every sample of a layout set from y, u and v at luma position x, y
+static void fillYuv(int layout, uint8_t* buf, int w, int h, const std::function<void(int, int, uint8_t*)>& yuv)
+{
+    TYYuvPlanes p;
+    TYYuvPlanesOf(layout, buf, w, h, p);
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            uint8_t s[3];
+            yuv(x, y, s);
+            ((uint8_t*)p.y)[y * p.y_stride + x * p.y_step] = s[0];
+            if(x % 2 == 0 && (y % 2 == 0 || p.c_shift_y == 0)) {
+                size_t c = (y >> p.c_shift_y) * p.c_stride + (x >> 1) * p.c_step;
+                ((uint8_t*)p.u)[c] = s[1];
+                ((uint8_t*)p.v)[c] = s[2];
+            }
+        }
+    }
+}
+
+static bool check(int layout, TYMapperWorkerPool* pool)
+{
+    const int w = 96, h = 64;
+    std::vector<uint8_t> src(yuvSize(layout, w, h));
+    uint32_t seed = 11;
+    for(size_t i = 0; i < src.size(); i++) src[i] = (uint8_t)benchRand(seed);
+
+    // vector, pooled and scalar
+    struct Case { int x, y, w, h, dw, dh, scale; } cases[] = {
+        { 0, 0, w, h, w, h, TY_YUV_SCALE_BILINEAR },
+        { 5, 3, 41, 30, 41, 30, TY_YUV_SCALE_NEAREST },
+        { 0, 0, w, h, 32, 16, TY_YUV_SCALE_BOX },
+        { 6, 2, 60, 45, 20, 15, TY_YUV_SCALE_BOX },
+        { 0, 0, w, h, 37, 23, TY_YUV_SCALE_NEAREST },
+        { 3, 1, 80, 61, 50, 29, TY_YUV_SCALE_BILINEAR },
+    };
+    for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const Case& k = cases[c];
+        for(int rgb = 0; rgb < 2; rgb++) {
+            std::vector<uint8_t> a(k.dw * k.dh * 3), b(a.size()), s(a.size());
+            TYYuvToBgr(layout, src.data(), w, h, k.x, k.y, k.w, k.h, a.data(), k.dw, k.dh, 0, k.scale, rgb != 0);
+            TYYuvToBgr(layout, src.data(), w, h, k.x, k.y, k.w, k.h, b.data(), k.dw, k.dh, 0, k.scale, rgb != 0, pool);
+            TYYuvToBgr(layout, src.data(), w, h, k.x, k.y, k.w, k.h, s.data(), k.dw, k.dh, 0, k.scale, rgb != 0, NULL, TY_MAPPER_SIMD_NONE);
+            if(a != b || a != s) {
+                printf("case %zu: pooled or scalar output differs\n", c);
+                return false;
+            }
+        }
+    }
+
+    // full size against floating point, and a roi is a crop of it
+    std::vector<uint8_t> full(w * h * 3), crop(20 * 10 * 3);
+    TYYuvToBgr(layout, src.data(), w, h, 0, 0, 0, 0, full.data(), w, h, 0);
+    TYYuvToBgr(layout, src.data(), w, h, 7, 5, 20, 10, crop.data(), 20, 10, 0);
+    TYYuvPlanes p;
+    TYYuvPlanesOf(layout, src.data(), w, h, p);
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            size_t c = (y >> p.c_shift_y) * p.c_stride + (x >> 1) * p.c_step;
+            double Y = 1.164383 * (p.y[y * p.y_stride + x * p.y_step] - 16);
+            double U = p.u[c] - 128.0, V = p.v[c] - 128.0;
+            double ref[3] = { Y + 2.017232 * U, Y - 0.391762 * U - 0.812968 * V, Y + 1.596027 * V };
+            for(int ch = 0; ch < 3; ch++) {
+                double e = std::min(255.0, std::max(0.0, ref[ch]));
+                if(std::fabs(full[(y * w + x) * 3 + ch] - e) > 1.0) {
+                    printf("at %d,%d channel %d: %u expected %.2f\n", x, y, ch, full[(y * w + x) * 3 + ch], e);
+                    return false;
+                }
+            }
+        }
+    }
+    for(int y = 0; y < 10; y++) {
+        if(memcmp(&crop[y * 20 * 3], &full[((y + 5) * w + 7) * 3], 20 * 3) != 0) {
+            printf("roi row %d is not a crop\n", y);
+            return false;
+        }
+    }
+
+    // a flat color stays the same at every scale
+    fillYuv(layout, src.data(), w, h, [](int, int, uint8_t* s) { s[0] = 120; s[1] = 90; s[2] = 170; });
+    uint8_t flat[3];
+    TYYuvToBgr(layout, src.data(), w, h, 0, 0, 2, 1, flat, 1, 1, 0, TY_YUV_SCALE_BOX);
+    for(int scale = TY_YUV_SCALE_NEAREST; scale <= TY_YUV_SCALE_BILINEAR; scale++) {
+        std::vector<uint8_t> small(24 * 16 * 3);
+        TYYuvToBgr(layout, src.data(), w, h, 0, 0, 0, 0, small.data(), 24, 16, 0, scale);
+        for(size_t i = 0; i < small.size(); i++) {
+            if(small[i] != flat[i % 3]) {
+                printf("scale %d: flat color changed at %zu\n", scale, i / 3);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 3840, height = 2160;
+    int out_w = 640, out_h = 480;
+    int iters = 10;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iters = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-out") == 0 && i + 2 < argc) {
+            out_w = atoi(argv[++i]);
+            out_h = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [-h] [-n <iterations>] [-t <threads>] [-size <width> <height>] [-out <width> <height>]\n", argv[0]);
+            printf("    defaults: 3840x2160 to 640x480, 10 iterations, every cpu thread\n");
+            return 0;
+        }
+    }
+
+    TYMapperWorkerPool pool(threads - 1);
+    const char* names[] = { "yuyv", "i420", "yv12", "nv12", "nv21" };
+    // the box output keeps the aspect, an integer factor of the frame or of its top left part
+    int k = std::max(1, std::min(width / out_w, height / out_h));
+    int box_w = width / k, box_h = height / k;
+    int failures = 0;
+    for(int layout = TY_YUV_YUYV; layout <= TY_YUV_NV21; layout++) {
+        bool ok = check(layout, &pool);
+        if(!ok) failures++;
+
+        std::vector<uint8_t> src(yuvSize(layout, width, height));
+        uint32_t seed = 3;
+        for(size_t i = 0; i < src.size(); i++) src[i] = (uint8_t)benchRand(seed);
+        std::vector<uint8_t> full((size_t)width * height * 3), small((size_t)std::max(out_w * out_h, box_w * box_h) * 3);
+
+        double whole = benchRun(iters, [&]() { TYYuvToBgr(layout, src.data(), width, height, 0, 0, 0, 0, full.data(), width, height, 0); });
+        double unfused = benchRun(iters, [&]() {
+            TYYuvToBgr(layout, src.data(), width, height, 0, 0, 0, 0, full.data(), width, height, 0);
+            benchBoxShrink(full.data(), width, height, k, small.data());
+        });
+        double box = benchRun(iters, [&]() {
+            TYYuvToBgr(layout, src.data(), width, height, 0, 0, box_w * k, box_h * k, small.data(), box_w, box_h, 0, TY_YUV_SCALE_BOX);
+        });
+        double bilinear = benchRun(iters, [&]() {
+            TYYuvToBgr(layout, src.data(), width, height, 0, 0, 0, 0, small.data(), out_w, out_h, 0, TY_YUV_SCALE_BILINEAR);
+        });
+        double nearest = benchRun(iters, [&]() {
+            TYYuvToBgr(layout, src.data(), width, height, 0, 0, 0, 0, small.data(), out_w, out_h, 0, TY_YUV_SCALE_NEAREST);
+        });
+        double pooled = benchRun(iters, [&]() {
+            TYYuvToBgr(layout, src.data(), width, height, 0, 0, 0, 0, small.data(), out_w, out_h, 0, TY_YUV_SCALE_BILINEAR, false, &pool);
+        });
+        printf("%-4s %dx%d  full %6.2f ms  full+box %6.2f ms  | fused box %dx%d %5.2f ms  to %dx%d bilinear %5.2f ms  "
+               "nearest %5.2f ms  bilinear %u threads %5.2f ms  %s\n",
+               names[layout], width, height, whole, unfused, box_w, box_h, box, out_w, out_h, bilinear,
+               nearest, threads, pooled, ok ? "ok" : "FAIL");
+    }
+    if(failures) {
+        printf("%d layout(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,315 @@
+#ifndef SAMPLE_COMMON_RAWDEMOSAIC_HPP_
+#define SAMPLE_COMMON_RAWDEMOSAIC_HPP_
+
+#include "RawUnpack.hpp"
+
+/**
+ * Bilinear demosaic straight from packed raw bayer data to BGR.
+ * A band of rows is unpacked one row at a time into a window of three 16 bit
+ * rows, which stays in cache, and interpolated from there at full precision,
+ * so the packed image is read once and no full size intermediate is written.
+ * Bands run in parallel on a TYMapperWorkerPool. Borders are mirrored.
+ */
+
+enum TYBayerPattern
+{
+  // colors of the top left 2x2 block, row by row
+  TY_BAYER_RGGB = 0,
+  TY_BAYER_GRBG = 1,
+  TY_BAYER_GBRG = 2,
+  TY_BAYER_BGGR = 3,
+};
+
+/// Bayer pattern of a pixel format, -1 for formats that are not bayer.
+static inline int TYBayerPatternOf(TY_PIXEL_FORMAT fmt)
+{
+  switch(fmt) {
+    case TYPixelFormatBayerRGGB8:
+    case TYPixelFormatBayerRGGB10:
+    case TYPixelFormatBayerRGGB12:
+    case TYPixelFormatBayerRGGB14:
+    case TYPixelFormatBayerRGGB16:
+    case TYPixelFormatPacketBayerRGGB10:
+    case TYPixelFormatPacketBayerRGGB12:
+      return TY_BAYER_RGGB;
+    case TYPixelFormatBayerGRBG8:
+    case TYPixelFormatBayerGRBG10:
+    case TYPixelFormatBayerGRBG12:
+    case TYPixelFormatBayerGRBG14:
+    case TYPixelFormatBayerGRBG16:
+    case TYPixelFormatPacketBayerGRBG10:
+    case TYPixelFormatPacketBayerGRBG12:
+      return TY_BAYER_GRBG;
+    case TYPixelFormatBayerGBRG8:
+    case TYPixelFormatBayerGBRG10:
+    case TYPixelFormatBayerGBRG12:
+    case TYPixelFormatBayerGBRG14:
+    case TYPixelFormatBayerGBRG16:
+    case TYPixelFormatPacketBayerGBRG10:
+    case TYPixelFormatPacketBayerGBRG12:
+      return TY_BAYER_GBRG;
+    case TYPixelFormatBayerBGGR8:
+    case TYPixelFormatBayerBGGR10:
+    case TYPixelFormatBayerBGGR12:
+    case TYPixelFormatBayerBGGR14:
+    case TYPixelFormatBayerBGGR16:
+    case TYPixelFormatPacketBayerBGGR10:
+    case TYPixelFormatPacketBayerBGGR12:
+      return TY_BAYER_BGGR;
+    default:
+      return -1;
+  }
+}
+
+/// BGR channel (0 blue, 1 green, 2 red) of the pixel at (x & 1, y & 1).
+static inline int TYBayerChannel(int pattern, int x, int y)
+{
+  static const int channels[4][2][2] = {
+    { { 2, 1 }, { 1, 0 } },   // RGGB
+    { { 1, 2 }, { 0, 1 } },   // GRBG
+    { { 1, 0 }, { 2, 1 } },   // GBRG
+    { { 0, 1 }, { 1, 2 } },   // BGGR
+  };
+  return channels[pattern & 3][y & 1][x & 1];
+}
+
+/// Interpolate one row of BGR from the row above, the row itself and the row below.
+/// Rows are padded by one mirrored pixel on each side, index 0 is x = -1.
+/// c0 and c1 are the channels of the even and odd pixels of the row.
+template<class T>
+static inline void TYDemosaicRowC(const uint16_t* up, const uint16_t* mid, const uint16_t* down,
+                  int width, int c0, int c1, T* out, int shift)
+{
+  // every pair of pixels is one green and one red or blue site
+  const bool green_first = (c0 == 1);
+  const int rb = green_first ? c1 : c0;
+  for(int x = 0; x < width; x += 2) {
+    for(int k = 0; k < 2 && x + k < width; k++) {
+      int i = x + k + 1;
+      uint32_t px[3];
+      if(green_first == (k == 0)) {
+        // green site, rb is left and right of it, the other color above and below
+        px[1] = mid[i];
+        px[rb] = (mid[i - 1] + mid[i + 1] + 1) >> 1;
+        px[2 - rb] = (up[i] + down[i] + 1) >> 1;
+      } else {
+        px[rb] = mid[i];
+        px[1] = (up[i] + down[i] + mid[i - 1] + mid[i + 1] + 2) >> 2;
+        px[2 - rb] = (up[i - 1] + up[i + 1] + down[i - 1] + down[i + 1] + 2) >> 2;
+      }
+      T* o = out + 3 * (x + k);
+      o[0] = (T)(px[0] >> shift);
+      o[1] = (T)(px[1] >> shift);
+      o[2] = (T)(px[2] >> shift);
+    }
+  }
+}
+
+#if defined(TY_MAPPER_X86)
+/// pshufb masks scattering 16 bytes of b, g and r into 48 bytes of bgr:
+/// [output register][channel][byte], elem is 1 for 8 bit and 2 for 16 bit channels.
+static inline const int8_t* TYBgrInterleaveMask(int elem)
+{
+  struct Masks {
+    int8_t m[2][3][3][16];
+    Masks() {
+      for(int e = 0; e < 2; e++)
+        for(int k = 0; k < 3; k++)
+          for(int c = 0; c < 3; c++)
+            for(int j = 0; j < 16; j++) {
+              int byte = 16 * k + j, size = e + 1;
+              int element = byte / size, pixel = element / 3;
+              m[e][k][c][j] = (int8_t)((element % 3 == c) ? pixel * size + byte % size : -1);
+            }
+    }
+  };
+  static const Masks masks;
+  return &masks.m[elem - 1][0][0][0];
+}
+
+TY_MAPPER_TARGET("ssse3")
+static inline void TYBgrInterleaveSSSE3(__m128i b, __m128i g, __m128i r, const int8_t* mask, void* out)
+{
+  __m128i* o = (__m128i*)out;
+  for(int k = 0; k < 3; k++) {
+    const __m128i* m = (const __m128i*)(mask + 48 * k);
+    __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, _mm_loadu_si128(m)),
+                                          _mm_shuffle_epi8(g, _mm_loadu_si128(m + 1))),
+                             _mm_shuffle_epi8(r, _mm_loadu_si128(m + 2)));
+    _mm_storeu_si128(o + k, v);
+  }
+}
+
+// 8 pixels starting at padded index i, the red or blue channel, green and the other one
+TY_MAPPER_TARGET("ssse3")
+static inline void TYDemosaic8PixelsSSSE3(const uint16_t* up, const uint16_t* mid, const uint16_t* down, int i,
+                  __m128i green, __m128i shift, __m128i& rb, __m128i& g, __m128i& other)
+{
+  const __m128i two = _mm_set1_epi16(2);
+  __m128i uc = _mm_loadu_si128((const __m128i*)(up + i));
+  __m128i dc = _mm_loadu_si128((const __m128i*)(down + i));
+  __m128i ml = _mm_loadu_si128((const __m128i*)(mid + i - 1));
+  __m128i mc = _mm_loadu_si128((const __m128i*)(mid + i));
+  __m128i mr = _mm_loadu_si128((const __m128i*)(mid + i + 1));
+  __m128i diag = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(up + i - 1)), _mm_loadu_si128((const __m128i*)(up + i + 1))),
+                               _mm_add_epi16(_mm_loadu_si128((const __m128i*)(down + i - 1)), _mm_loadu_si128((const __m128i*)(down + i + 1))));
+  // at most 4 * 16383, the sums fit in 16 bits
+  __m128i cross = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(uc, dc), _mm_add_epi16(ml, mr)), two), 2);
+  diag = _mm_srli_epi16(_mm_add_epi16(diag, two), 2);
+  __m128i h = _mm_avg_epu16(ml, mr);
+  __m128i v = _mm_avg_epu16(uc, dc);
+  rb = _mm_srl_epi16(_mm_or_si128(_mm_and_si128(green, h), _mm_andnot_si128(green, mc)), shift);
+  g = _mm_srl_epi16(_mm_or_si128(_mm_and_si128(green, mc), _mm_andnot_si128(green, cross)), shift);
+  other = _mm_srl_epi16(_mm_or_si128(_mm_and_si128(green, v), _mm_andnot_si128(green, diag)), shift);
+}
+
+/// TYDemosaicRowC on 16 pixels per step, same results.
+template<class T>
+TY_MAPPER_TARGET("ssse3")
+static inline int TYDemosaicRowSSSE3(const uint16_t* up, const uint16_t* mid, const uint16_t* down,
+                  int width, int c0, int c1, T* out, int shift)
+{
+  const bool green_first = (c0 == 1);
+  const bool red = (green_first ? c1 : c0) == 2;
+  const __m128i green = green_first ? _mm_set1_epi32(0x0000ffff) : _mm_set1_epi32((int)0xffff0000);
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const int8_t* mask = TYBgrInterleaveMask((int)sizeof(T));
+
+  int x = 0;
+  for(; x + 16 <= width; x += 16) {
+    __m128i rb0, g0, o0, rb1, g1, o1;
+    TYDemosaic8PixelsSSSE3(up, mid, down, x + 1, green, sh, rb0, g0, o0);
+    TYDemosaic8PixelsSSSE3(up, mid, down, x + 9, green, sh, rb1, g1, o1);
+    if(sizeof(T) == 1) {
+      __m128i rb = _mm_packus_epi16(rb0, rb1), g = _mm_packus_epi16(g0, g1), o = _mm_packus_epi16(o0, o1);
+      TYBgrInterleaveSSSE3(red ? o : rb, g, red ? rb : o, mask, out + 3 * x);
+    } else {
+      TYBgrInterleaveSSSE3(red ? o0 : rb0, g0, red ? rb0 : o0, mask, out + 3 * x);
+      TYBgrInterleaveSSSE3(red ? o1 : rb1, g1, red ? rb1 : o1, mask, out + 3 * x + 24);
+    }
+  }
+  return x;
+}
+#endif
+
+#if defined(TY_MAPPER_NEON)
+template<class T>
+static inline int TYDemosaicRowNEON(const uint16_t* up, const uint16_t* mid, const uint16_t* down,
+                  int width, int c0, int c1, T* out, int shift)
+{
+  const bool green_first = (c0 == 1);
+  const bool red = (green_first ? c1 : c0) == 2;
+  const uint16x8_t green = vreinterpretq_u16_u32(vdupq_n_u32(green_first ? 0x0000ffff : 0xffff0000));
+  const int16x8_t sh = vdupq_n_s16((int16_t)-shift);
+  const uint16x8_t two = vdupq_n_u16(2);
+
+  int x = 0;
+  for(; x + 8 <= width; x += 8) {
+    int i = x + 1;
+    uint16x8_t uc = vld1q_u16(up + i), dc = vld1q_u16(down + i);
+    uint16x8_t ml = vld1q_u16(mid + i - 1), mc = vld1q_u16(mid + i), mr = vld1q_u16(mid + i + 1);
+    uint16x8_t diag = vaddq_u16(vaddq_u16(vld1q_u16(up + i - 1), vld1q_u16(up + i + 1)),
+                                vaddq_u16(vld1q_u16(down + i - 1), vld1q_u16(down + i + 1)));
+    uint16x8_t cross = vshrq_n_u16(vaddq_u16(vaddq_u16(vaddq_u16(uc, dc), vaddq_u16(ml, mr)), two), 2);
+    diag = vshrq_n_u16(vaddq_u16(diag, two), 2);
+    uint16x8_t rb = vshlq_u16(vbslq_u16(green, vrhaddq_u16(ml, mr), mc), sh);
+    uint16x8_t g = vshlq_u16(vbslq_u16(green, mc, cross), sh);
+    uint16x8_t o = vshlq_u16(vbslq_u16(green, vrhaddq_u16(uc, dc), diag), sh);
+    if(sizeof(T) == 1) {
+      uint8x8x3_t bgr = { { vmovn_u16(red ? o : rb), vmovn_u16(g), vmovn_u16(red ? rb : o) } };
+      vst3_u8((uint8_t*)(out + 3 * x), bgr);
+    } else {
+      uint16x8x3_t bgr = { { red ? o : rb, g, red ? rb : o } };
+      vst3q_u16((uint16_t*)(out + 3 * x), bgr);
+    }
+  }
+  return x;
+}
+#endif
+
+template<class T>
+static inline void TYDemosaicRow(const uint16_t* up, const uint16_t* mid, const uint16_t* down,
+                  int width, int c0, int c1, T* out, int shift, int simd)
+{
+  int x = 0;
+#if defined(TY_MAPPER_X86)
+  if(simd == TY_MAPPER_SIMD_SSE41 || simd == TY_MAPPER_SIMD_AVX2) {
+    x = TYDemosaicRowSSSE3<T>(up, mid, down, width, c0, c1, out, shift);
+  }
+#elif defined(TY_MAPPER_NEON)
+  if(simd == TY_MAPPER_SIMD_NEON) {
+    x = TYDemosaicRowNEON<T>(up, mid, down, width, c0, c1, out, shift);
+  }
+#endif
+  // the rest starts on an even pixel, the rows shift by x
+  TYDemosaicRowC<T>(up + x, mid + x, down + x, width - x, c0, c1, out + 3 * x, shift);
+}
+
+/// Rows [y0, y1) of the image into dst, the rows around the band are read as well.
+template<class T>
+static inline void TYDemosaicRawBand(int packing, int pattern, const uint8_t* src, int width, int height,
+                  uint8_t* dst, size_t dst_step, int shift, int y0, int y1, int simd)
+{
+  const size_t row_bytes = (size_t)width / TYRawGroupPixels(packing) * TYRawGroupBytes(packing);
+  const size_t stride = (size_t)width + 2;
+  // reused by every call on this thread
+  static thread_local std::vector<uint16_t> window;
+  if(window.size() < 3 * stride) window.resize(3 * stride);
+
+  uint16_t* rows[3] = { &window[0], &window[stride], &window[2 * stride] };
+  auto load = [&](uint16_t* row, int y) {
+    if(y < 0) y = 1;
+    if(y >= height) y = height - 2;
+    TYUnpackRaw16(packing, src + y * row_bytes, row + 1, width, 1, simd);
+    row[0] = row[2];
+    row[width + 1] = row[width - 1];
+  };
+
+  load(rows[0], y0 - 1);
+  load(rows[1], y0);
+  for(int y = y0; y < y1; y++) {
+    load(rows[2], y + 1);
+    TYDemosaicRow<T>(rows[0], rows[1], rows[2], width, TYBayerChannel(pattern, 0, y), TYBayerChannel(pattern, 1, y),
+                     (T*)(dst + y * dst_step), shift, simd);
+    uint16_t* oldest = rows[0];
+    rows[0] = rows[1];
+    rows[1] = rows[2];
+    rows[2] = oldest;
+  }
+}
+
+/// Demosaic width x height packed raw pixels of packing into dst, BGR with 8 bit
+/// (the high bits) or 16 bit (the full value, 0 .. 2^bits - 1) channels as dst_bits
+/// says. dst_step is the byte distance between dst rows, 0 for tightly packed rows.
+/// With a pool the image is split into bands of 32 rows run over the pool.
+/// @retval 0 on success, -1 for an unknown packing or pattern or a bad size.
+static inline int TYDemosaicRaw(int packing, int pattern, const void* src, int width, int height,
+                  void* dst, size_t dst_step, int dst_bits, TYMapperWorkerPool* pool = NULL,
+                  int simd = TYGetSimdLevel())
+{
+  int group = TYRawGroupPixels(packing);
+  if(group == 0 || pattern < 0 || pattern > TY_BAYER_BGGR) return -1;
+  if(width < 2 || height < 2 || width % group || (dst_bits != 8 && dst_bits != 16)) return -1;
+  if(dst_step == 0) dst_step = (size_t)width * 3 * (dst_bits / 8);
+
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  const int shift = dst_bits == 8 ? TYRawBits(packing) - 8 : 0;
+  auto band = [&](int y0, int y1) {
+    if(dst_bits == 8) TYDemosaicRawBand<uint8_t>(packing, pattern, in, width, height, out, dst_step, shift, y0, y1, simd);
+    else TYDemosaicRawBand<uint16_t>(packing, pattern, in, width, height, out, dst_step, shift, y0, y1, simd);
+  };
+
+  if(!pool) {
+    band(0, height);
+    return 0;
+  }
+  const int rows = 32;
+  uint32_t bands = (uint32_t)((height + rows - 1) / rows);
+  pool->run(bands, [&](uint32_t b) {
+    band((int)b * rows, std::min(height, (int)(b + 1) * rows));
+  });
+  return 0;
+}
+
+#endif
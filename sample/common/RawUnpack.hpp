@@ -0,0 +1,339 @@
+#ifndef SAMPLE_COMMON_RAWUNPACK_HPP_
+#define SAMPLE_COMMON_RAWUNPACK_HPP_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "TYApi.h"
+#include "TYCoordinateMapper.h"
+
+/**
+ * Unpackers for the packed raw layouts of mono and bayer images.
+ * Output is either the full value in 16 bits (0..1023 for 10 bit data) or its
+ * high 8 bits. Rows are not padded, an image is one stream of pixel groups.
+ * The vector versions pick 2 bytes per 16 bit lane with one byte shuffle and
+ * bring each lane's bits into place with a multiply, they match the scalar
+ * reference bit for bit.
+ */
+
+enum TYRawPacking
+{
+  // MIPI CSI-2, the high 8 bits of every pixel, then the low bits of the group
+  TY_RAW_CSI10    = 0,  // [A9-A2] [B9-B2] [C9-C2] [D9-D2] [D1D0 C1C0 B1B0 A1A0]
+  TY_RAW_CSI12    = 1,  // [A11-A4] [B11-B4] [B3-B0 A3-A0]
+  TY_RAW_CSI14    = 2,  // [A13-A6] [B13-B6] [C13-C6] [D13-D6] [B1B0 A5-A0] [C3-C0 B5-B2] [D5-D0 C5C4]
+  // GenICam packed, one little endian bit stream starting with the low bits of A
+  TY_RAW_PACKET10 = 3,  // [A7-A0] [B5-B0 A9A8] [C3-C0 B9-B6] [D1D0 C9-C4] [D9-D2]
+  TY_RAW_PACKET12 = 4,  // [A7-A0] [B3-B0 A11-A8] [B11-B4]
+};
+
+/// Packing of a pixel format, -1 for formats that are not packed raw.
+static inline int TYRawPackingOf(TY_PIXEL_FORMAT fmt)
+{
+  switch(fmt) {
+    case TYPixelFormatMono10:
+    case TYPixelFormatBayerGBRG10:
+    case TYPixelFormatBayerBGGR10:
+    case TYPixelFormatBayerGRBG10:
+    case TYPixelFormatBayerRGGB10:
+      return TY_RAW_CSI10;
+    case TYPixelFormatMono12:
+    case TYPixelFormatBayerGBRG12:
+    case TYPixelFormatBayerBGGR12:
+    case TYPixelFormatBayerGRBG12:
+    case TYPixelFormatBayerRGGB12:
+      return TY_RAW_CSI12;
+    case TYPixelFormatMono14:
+    case TYPixelFormatBayerGBRG14:
+    case TYPixelFormatBayerBGGR14:
+    case TYPixelFormatBayerGRBG14:
+    case TYPixelFormatBayerRGGB14:
+      return TY_RAW_CSI14;
+    case TYPixelFormatPacketMono10:
+    case TYPixelFormatPacketBayerGBRG10:
+    case TYPixelFormatPacketBayerBGGR10:
+    case TYPixelFormatPacketBayerGRBG10:
+    case TYPixelFormatPacketBayerRGGB10:
+      return TY_RAW_PACKET10;
+    case TYPixelFormatPacketMono12:
+    case TYPixelFormatPacketBayerGBRG12:
+    case TYPixelFormatPacketBayerBGGR12:
+    case TYPixelFormatPacketBayerGRBG12:
+    case TYPixelFormatPacketBayerRGGB12:
+      return TY_RAW_PACKET12;
+    default:
+      return -1;
+  }
+}
+
+static inline int TYRawBits(int packing)
+{
+  static const int bits[] = { 10, 12, 14, 10, 12 };
+  return (packing >= 0 && packing <= TY_RAW_PACKET12) ? bits[packing] : 0;
+}
+
+/// Pixels and bytes of one group, the smallest unit of a packing.
+static inline int TYRawGroupPixels(int packing)
+{
+  static const int pixels[] = { 4, 2, 4, 4, 2 };
+  return (packing >= 0 && packing <= TY_RAW_PACKET12) ? pixels[packing] : 0;
+}
+
+static inline int TYRawGroupBytes(int packing)
+{
+  static const int bytes[] = { 5, 3, 7, 5, 3 };
+  return (packing >= 0 && packing <= TY_RAW_PACKET12) ? bytes[packing] : 0;
+}
+
+/// Scalar reference, unpacks groups of packing into dst, every value shifted right by shift.
+template<class T>
+static inline void TYUnpackRawC(int packing, const uint8_t* src, size_t groups, T* dst, int shift)
+{
+  switch(packing) {
+    case TY_RAW_CSI10:
+      for(size_t g = 0; g < groups; g++, src += 5, dst += 4) {
+        uint32_t lo = src[4];
+        dst[0] = (T)((((uint32_t)src[0] << 2) | ((lo >> 0) & 0x3)) >> shift);
+        dst[1] = (T)((((uint32_t)src[1] << 2) | ((lo >> 2) & 0x3)) >> shift);
+        dst[2] = (T)((((uint32_t)src[2] << 2) | ((lo >> 4) & 0x3)) >> shift);
+        dst[3] = (T)((((uint32_t)src[3] << 2) | ((lo >> 6) & 0x3)) >> shift);
+      }
+      break;
+    case TY_RAW_CSI12:
+      for(size_t g = 0; g < groups; g++, src += 3, dst += 2) {
+        uint32_t lo = src[2];
+        dst[0] = (T)((((uint32_t)src[0] << 4) | (lo & 0xf)) >> shift);
+        dst[1] = (T)((((uint32_t)src[1] << 4) | (lo >> 4)) >> shift);
+      }
+      break;
+    case TY_RAW_CSI14:
+      for(size_t g = 0; g < groups; g++, src += 7, dst += 4) {
+        uint32_t lo = src[4] | ((uint32_t)src[5] << 8) | ((uint32_t)src[6] << 16);
+        dst[0] = (T)((((uint32_t)src[0] << 6) | ((lo >> 0) & 0x3f)) >> shift);
+        dst[1] = (T)((((uint32_t)src[1] << 6) | ((lo >> 6) & 0x3f)) >> shift);
+        dst[2] = (T)((((uint32_t)src[2] << 6) | ((lo >> 12) & 0x3f)) >> shift);
+        dst[3] = (T)((((uint32_t)src[3] << 6) | ((lo >> 18) & 0x3f)) >> shift);
+      }
+      break;
+    case TY_RAW_PACKET10:
+      for(size_t g = 0; g < groups; g++, src += 5, dst += 4) {
+        uint64_t v = src[0] | ((uint64_t)src[1] << 8) | ((uint64_t)src[2] << 16) |
+                     ((uint64_t)src[3] << 24) | ((uint64_t)src[4] << 32);
+        dst[0] = (T)(((v >> 0) & 0x3ff) >> shift);
+        dst[1] = (T)(((v >> 10) & 0x3ff) >> shift);
+        dst[2] = (T)(((v >> 20) & 0x3ff) >> shift);
+        dst[3] = (T)(((v >> 30) & 0x3ff) >> shift);
+      }
+      break;
+    case TY_RAW_PACKET12:
+      for(size_t g = 0; g < groups; g++, src += 3, dst += 2) {
+        uint32_t v = src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16);
+        dst[0] = (T)(((v >> 0) & 0xfff) >> shift);
+        dst[1] = (T)(((v >> 12) & 0xfff) >> shift);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Per packing, for 8 pixels in a 16 byte load: the byte holding the high bits of
+// each 16 bit lane, the 2 bytes holding its low bits, the multiplier moving those
+// low bits to the top of the lane, and the shift bringing them back down.
+// value = hi << hi_shift | ((lo * mul) >> lo_shift) & lo_mask
+struct TYRawSimdTable
+{
+  int8_t   hi[16];
+  int8_t   lo[16];
+  uint16_t mul[8];
+  int      hi_shift;
+  int      lo_shift;
+  uint16_t lo_mask;
+  int      bytes;     // input bytes of 8 pixels
+};
+
+static inline const TYRawSimdTable& TYRawSimdTableOf(int packing)
+{
+  static const TYRawSimdTable tables[] = {
+    // CSI10, low bits of pixel k at bit 2k of byte 4
+    { { 0, -1, 1, -1, 2, -1, 3, -1, 5, -1, 6, -1, 7, -1, 8, -1 },
+      { 4, -1, 4, -1, 4, -1, 4, -1, 9, -1, 9, -1, 9, -1, 9, -1 },
+      { 64, 16, 4, 1, 64, 16, 4, 1 }, 2, 6, 0x3, 10 },
+    // CSI12, low bits of pixel k at bit 4k of byte 2
+    { { 0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1 },
+      { 2, -1, 2, -1, 5, -1, 5, -1, 8, -1, 8, -1, 11, -1, 11, -1 },
+      { 16, 1, 16, 1, 16, 1, 16, 1 }, 4, 4, 0xf, 12 },
+    // CSI14, low bits of pixel k at bit 6k of bytes 4-6
+    { { 0, -1, 1, -1, 2, -1, 3, -1, 7, -1, 8, -1, 9, -1, 10, -1 },
+      { 4, 5, 4, 5, 5, 6, 6, 7, 11, 12, 11, 12, 12, 13, 13, 14 },
+      { 1024, 16, 64, 256, 1024, 16, 64, 256 }, 6, 10, 0x3f, 14 },
+    // PACKET10, pixel i at bit 10i
+    { { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+      { 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9 },
+      { 64, 16, 4, 1, 64, 16, 4, 1 }, 0, 6, 0x3ff, 10 },
+    // PACKET12, pixel i at bit 12i
+    { { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+      { 0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11 },
+      { 16, 1, 16, 1, 16, 1, 16, 1 }, 0, 4, 0xfff, 12 },
+  };
+  return tables[packing];
+}
+
+#if defined(TY_MAPPER_X86)
+TY_MAPPER_TARGET("ssse3")
+static inline __m128i TYUnpackRaw8PixelsSSSE3(const uint8_t* src, __m128i hi, __m128i lo, __m128i mul,
+                  __m128i hi_shift, __m128i lo_shift, __m128i lo_mask)
+{
+  __m128i v = _mm_loadu_si128((const __m128i*)src);
+  __m128i h = _mm_sll_epi16(_mm_shuffle_epi8(v, hi), hi_shift);
+  __m128i l = _mm_and_si128(_mm_srl_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(v, lo), mul), lo_shift), lo_mask);
+  return _mm_or_si128(h, l);
+}
+
+/// Unpacks whole 8 pixel blocks while 16 bytes can be loaded, returns the pixels done.
+TY_MAPPER_TARGET("ssse3")
+static inline size_t TYUnpackRawSSSE3(int packing, const uint8_t* src, size_t pixels,
+                  uint16_t* dst16, uint8_t* dst8, int shift)
+{
+  const TYRawSimdTable& t = TYRawSimdTableOf(packing);
+  const __m128i hi = _mm_loadu_si128((const __m128i*)t.hi);
+  const __m128i lo = _mm_loadu_si128((const __m128i*)t.lo);
+  const __m128i mul = _mm_loadu_si128((const __m128i*)t.mul);
+  const __m128i hi_shift = _mm_cvtsi32_si128(t.hi_shift);
+  const __m128i lo_shift = _mm_cvtsi32_si128(t.lo_shift);
+  const __m128i lo_mask = _mm_set1_epi16((short)t.lo_mask);
+  const __m128i out_shift = _mm_cvtsi32_si128(shift);
+  const size_t bytes = pixels / TYRawGroupPixels(packing) * TYRawGroupBytes(packing);
+
+  size_t i = 0, in = 0;
+  if(dst8) {
+    for(; i + 16 <= pixels && in + t.bytes + 16 <= bytes; i += 16, in += 2 * t.bytes) {
+      __m128i a = TYUnpackRaw8PixelsSSSE3(src + in, hi, lo, mul, hi_shift, lo_shift, lo_mask);
+      __m128i b = TYUnpackRaw8PixelsSSSE3(src + in + t.bytes, hi, lo, mul, hi_shift, lo_shift, lo_mask);
+      _mm_storeu_si128((__m128i*)(dst8 + i), _mm_packus_epi16(_mm_srl_epi16(a, out_shift), _mm_srl_epi16(b, out_shift)));
+    }
+  } else {
+    for(; i + 8 <= pixels && in + 16 <= bytes; i += 8, in += t.bytes) {
+      __m128i a = TYUnpackRaw8PixelsSSSE3(src + in, hi, lo, mul, hi_shift, lo_shift, lo_mask);
+      _mm_storeu_si128((__m128i*)(dst16 + i), _mm_srl_epi16(a, out_shift));
+    }
+  }
+  return i;
+}
+
+TY_MAPPER_TARGET("avx2")
+static inline size_t TYUnpackRawAVX2(int packing, const uint8_t* src, size_t pixels,
+                  uint16_t* dst16, uint8_t* dst8, int shift)
+{
+  const TYRawSimdTable& t = TYRawSimdTableOf(packing);
+  const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.hi));
+  const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.lo));
+  const __m256i mul = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.mul));
+  const __m128i hi_shift = _mm_cvtsi32_si128(t.hi_shift);
+  const __m128i lo_shift = _mm_cvtsi32_si128(t.lo_shift);
+  const __m256i lo_mask = _mm256_set1_epi16((short)t.lo_mask);
+  const __m128i out_shift = _mm_cvtsi32_si128(shift);
+  const size_t bytes = pixels / TYRawGroupPixels(packing) * TYRawGroupBytes(packing);
+
+  // 8 pixels in each 128 bit lane, the byte shuffle does not cross lanes
+  size_t i = 0, in = 0;
+  for(; i + 16 <= pixels && in + t.bytes + 16 <= bytes; i += 16, in += 2 * t.bytes) {
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src + in))),
+                                        _mm_loadu_si128((const __m128i*)(src + in + t.bytes)), 1);
+    __m256i h = _mm256_sll_epi16(_mm256_shuffle_epi8(v, hi), hi_shift);
+    __m256i l = _mm256_and_si256(_mm256_srl_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(v, lo), mul), lo_shift), lo_mask);
+    __m256i px = _mm256_srl_epi16(_mm256_or_si256(h, l), out_shift);
+    if(dst8) {
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(px, px), _MM_SHUFFLE(3, 1, 2, 0));
+      _mm_storeu_si128((__m128i*)(dst8 + i), _mm256_castsi256_si128(packed));
+    } else {
+      _mm256_storeu_si256((__m256i*)(dst16 + i), px);
+    }
+  }
+  return i;
+}
+#endif
+
+#if defined(TY_MAPPER_NEON)
+static inline uint16x8_t TYUnpackRaw8PixelsNEON(const uint8_t* src, uint8x16_t hi, uint8x16_t lo, uint16x8_t mul,
+                  int16x8_t hi_shift, int16x8_t lo_shift, uint16x8_t lo_mask)
+{
+  uint8x16_t v = vld1q_u8(src);
+  uint16x8_t h = vshlq_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, hi)), hi_shift);
+  uint16x8_t l = vandq_u16(vshlq_u16(vmulq_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, lo)), mul), lo_shift), lo_mask);
+  return vorrq_u16(h, l);
+}
+
+static inline size_t TYUnpackRawNEON(int packing, const uint8_t* src, size_t pixels,
+                  uint16_t* dst16, uint8_t* dst8, int shift)
+{
+  const TYRawSimdTable& t = TYRawSimdTableOf(packing);
+  // table entries of -1 are out of range for vqtbl1q_u8 and read as 0
+  const uint8x16_t hi = vld1q_u8((const uint8_t*)t.hi);
+  const uint8x16_t lo = vld1q_u8((const uint8_t*)t.lo);
+  const uint16x8_t mul = vld1q_u16(t.mul);
+  const int16x8_t hi_shift = vdupq_n_s16((int16_t)t.hi_shift);
+  const int16x8_t lo_shift = vdupq_n_s16((int16_t)-t.lo_shift);
+  const uint16x8_t lo_mask = vdupq_n_u16(t.lo_mask);
+  const int16x8_t out_shift = vdupq_n_s16((int16_t)-shift);
+  const size_t bytes = pixels / TYRawGroupPixels(packing) * TYRawGroupBytes(packing);
+
+  size_t i = 0, in = 0;
+  for(; i + 8 <= pixels && in + 16 <= bytes; i += 8, in += t.bytes) {
+    uint16x8_t px = vshlq_u16(TYUnpackRaw8PixelsNEON(src + in, hi, lo, mul, hi_shift, lo_shift, lo_mask), out_shift);
+    if(dst8) vst1_u8(dst8 + i, vmovn_u16(px));
+    else vst1q_u16(dst16 + i, px);
+  }
+  return i;
+}
+#endif
+
+static inline size_t TYUnpackRawSimd(int packing, const uint8_t* src, size_t pixels,
+                  uint16_t* dst16, uint8_t* dst8, int shift, int simd)
+{
+  switch(simd) {
+#if defined(TY_MAPPER_X86)
+    case TY_MAPPER_SIMD_AVX2:
+      return TYUnpackRawAVX2(packing, src, pixels, dst16, dst8, shift);
+    case TY_MAPPER_SIMD_SSE41:
+      return TYUnpackRawSSSE3(packing, src, pixels, dst16, dst8, shift);
+#endif
+#if defined(TY_MAPPER_NEON)
+    case TY_MAPPER_SIMD_NEON:
+      return TYUnpackRawNEON(packing, src, pixels, dst16, dst8, shift);
+#endif
+    default:
+      return 0;
+  }
+}
+
+/// Unpack width x height pixels of packing to their full value, 0 .. 2^bits - 1.
+/// simd TY_MAPPER_SIMD_NONE runs the scalar reference.
+/// @retval 0 on success, -1 for an unknown packing or a width that splits a group.
+static inline int TYUnpackRaw16(int packing, const void* src, uint16_t* dst, int width, int height,
+                  int simd = TYGetSimdLevel())
+{
+  int group = TYRawGroupPixels(packing);
+  if(group == 0 || width % group) return -1;
+  size_t pixels = (size_t)width * height;
+  const uint8_t* in = (const uint8_t*)src;
+  size_t done = TYUnpackRawSimd(packing, in, pixels, dst, NULL, 0, simd);
+  TYUnpackRawC(packing, in + done / group * TYRawGroupBytes(packing), (pixels - done) / group, dst + done, 0);
+  return 0;
+}
+
+/// Unpack width x height pixels of packing to their high 8 bits.
+static inline int TYUnpackRaw8(int packing, const void* src, uint8_t* dst, int width, int height,
+                  int simd = TYGetSimdLevel())
+{
+  int group = TYRawGroupPixels(packing);
+  if(group == 0 || width % group) return -1;
+  size_t pixels = (size_t)width * height;
+  const uint8_t* in = (const uint8_t*)src;
+  int shift = TYRawBits(packing) - 8;
+  size_t done = TYUnpackRawSimd(packing, in, pixels, NULL, dst, shift, simd);
+  TYUnpackRawC(packing, in + done / group * TYRawGroupBytes(packing), (pixels - done) / group, dst + done, shift);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,479 @@
+#ifndef SAMPLE_COMMON_YUVCONVERT_HPP_
+#define SAMPLE_COMMON_YUVCONVERT_HPP_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "RawDemosaic.hpp"
+
+/**
+ * YUV 4:2:2 and 4:2:0 to BGR or RGB in one pass, with an optional region of
+ * interest and downscale, so a detector that wants 640x480 out of a 4K stream
+ * only converts the pixels it gets.
+ * Every output row is first sampled into Y, U and V rows of the output width,
+ * nearest, box (integer factors) or bilinear, and then converted with BT.601
+ * limited range coefficients in 13 bit fixed point. The vector conversion
+ * matches the scalar reference bit for bit. Chroma is centered between its two
+ * luma pixels. Bands of output rows run in parallel on a TYMapperWorkerPool.
+ */
+
+enum TYYuvLayout
+{
+  TY_YUV_YUYV = 0,    // Y0 U Y1 V, 4:2:2 interleaved
+  TY_YUV_I420 = 1,    // Y plane, U plane, V plane, 4:2:0
+  TY_YUV_YV12 = 2,    // Y plane, V plane, U plane, 4:2:0
+  TY_YUV_NV12 = 3,    // Y plane, interleaved UV plane, 4:2:0
+  TY_YUV_NV21 = 4,    // Y plane, interleaved VU plane, 4:2:0
+};
+
+enum TYYuvScale
+{
+  TY_YUV_SCALE_NEAREST  = 0,
+  TY_YUV_SCALE_BOX      = 1,  // mean of each block, the roi must be a multiple of the output
+  TY_YUV_SCALE_BILINEAR = 2,
+};
+
+/// YUV layout of a pixel format, -1 for formats that are not YUV.
+static inline int TYYuvLayoutOf(TY_PIXEL_FORMAT fmt)
+{
+  switch(fmt) {
+    case TYPixelFormatYUV422_8:                     return TY_YUV_YUYV;
+    case TYPixelFormatYCbCr420_8_YY_CbCr_Planar:    return TY_YUV_I420;
+    case TYPixelFormatYCbCr420_8_YY_CrCb_Planar:    return TY_YUV_YV12;
+    case TYPixelFormatYCbCr420_8_YY_CbCr_Semiplanar:return TY_YUV_NV12;
+    case TYPixelFormatYCbCr420_8_YY_CrCb_Semiplanar:return TY_YUV_NV21;
+    default:                                        return -1;
+  }
+}
+
+// BT.601 limited range, scaled by 2^13
+#define TY_YUV_SHIFT  13
+#define TY_YUV_CY     9539
+#define TY_YUV_CVR    13075
+#define TY_YUV_CVG    (-6660)
+#define TY_YUV_CUG    (-3209)
+#define TY_YUV_CUB    16525
+
+/// Where the samples of an image are: byte distance between rows and between
+/// neighbouring samples of a row, chroma rows are shared by 1 << c_shift_y luma rows.
+struct TYYuvPlanes
+{
+  const uint8_t* y;
+  const uint8_t* u;
+  const uint8_t* v;
+  size_t y_stride, c_stride;
+  int    y_step, c_step;
+  int    c_shift_y;
+};
+
+static inline bool TYYuvPlanesOf(int layout, const void* src, int width, int height, TYYuvPlanes& p)
+{
+  const uint8_t* base = (const uint8_t*)src;
+  const size_t luma = (size_t)width * height;
+  memset(&p, 0, sizeof(p));
+  if(width % 2) return false;
+  if(layout != TY_YUV_YUYV && height % 2) return false;
+  p.y = base;
+  p.y_step = 1;
+  p.y_stride = width;
+  p.c_shift_y = 1;
+  switch(layout) {
+    case TY_YUV_YUYV:
+      p.u = base + 1;
+      p.v = base + 3;
+      p.y_step = 2;
+      p.y_stride = p.c_stride = (size_t)width * 2;
+      p.c_step = 4;
+      p.c_shift_y = 0;
+      return true;
+    case TY_YUV_I420:
+    case TY_YUV_YV12:
+      p.u = base + luma;
+      p.v = p.u + luma / 4;
+      if(layout == TY_YUV_YV12) std::swap(p.u, p.v);
+      p.c_stride = width / 2;
+      p.c_step = 1;
+      return true;
+    case TY_YUV_NV12:
+    case TY_YUV_NV21:
+      p.u = base + luma;
+      p.v = p.u + 1;
+      if(layout == TY_YUV_NV21) std::swap(p.u, p.v);
+      p.c_stride = width;
+      p.c_step = 2;
+      return true;
+    default:
+      return false;
+  }
+}
+
+static inline uint8_t TYYuvClamp(int v)
+{
+  return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/// Convert one row of full resolution Y, U and V to BGR, or RGB with rgb set.
+static inline void TYYuvRowToBgrC(const uint8_t* y, const uint8_t* u, const uint8_t* v, int width,
+                  uint8_t* out, bool rgb)
+{
+  const int round = 1 << (TY_YUV_SHIFT - 1);
+  const int b_at = rgb ? 2 : 0;
+  for(int x = 0; x < width; x++) {
+    int c = TY_YUV_CY * (y[x] - 16) + round;
+    int du = u[x] - 128, dv = v[x] - 128;
+    uint8_t* o = out + 3 * x;
+    o[b_at] = TYYuvClamp((c + TY_YUV_CUB * du) >> TY_YUV_SHIFT);
+    o[1] = TYYuvClamp((c + TY_YUV_CUG * du + TY_YUV_CVG * dv) >> TY_YUV_SHIFT);
+    o[2 - b_at] = TYYuvClamp((c + TY_YUV_CVR * dv) >> TY_YUV_SHIFT);
+  }
+}
+
+#if defined(TY_MAPPER_X86)
+// 4 pixels in the low 16 bit lanes of y, u, v to 32 bit b, g, r
+TY_MAPPER_TARGET("ssse3")
+static inline void TYYuv4PixelsSSSE3(__m128i y, __m128i u, __m128i v, __m128i& b, __m128i& g, __m128i& r)
+{
+  const __m128i y_vr = _mm_setr_epi16(TY_YUV_CY, TY_YUV_CVR, TY_YUV_CY, TY_YUV_CVR, TY_YUV_CY, TY_YUV_CVR, TY_YUV_CY, TY_YUV_CVR);
+  const __m128i y_vg = _mm_setr_epi16(TY_YUV_CY, TY_YUV_CVG, TY_YUV_CY, TY_YUV_CVG, TY_YUV_CY, TY_YUV_CVG, TY_YUV_CY, TY_YUV_CVG);
+  const __m128i y_ub = _mm_setr_epi16(TY_YUV_CY, TY_YUV_CUB, TY_YUV_CY, TY_YUV_CUB, TY_YUV_CY, TY_YUV_CUB, TY_YUV_CY, TY_YUV_CUB);
+  const __m128i ug = _mm_setr_epi16(TY_YUV_CUG, 0, TY_YUV_CUG, 0, TY_YUV_CUG, 0, TY_YUV_CUG, 0);
+  const __m128i round = _mm_set1_epi32(1 << (TY_YUV_SHIFT - 1));
+  __m128i yv = _mm_unpacklo_epi16(y, v);
+  __m128i yu = _mm_unpacklo_epi16(y, u);
+  __m128i u0 = _mm_unpacklo_epi16(u, _mm_setzero_si128());
+  r = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv, y_vr), round), TY_YUV_SHIFT);
+  g = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(yv, y_vg), _mm_madd_epi16(u0, ug)), round), TY_YUV_SHIFT);
+  b = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu, y_ub), round), TY_YUV_SHIFT);
+}
+
+// 8 pixels, 16 bit lanes in, saturated 16 bit b, g, r out
+TY_MAPPER_TARGET("ssse3")
+static inline void TYYuv8PixelsSSSE3(__m128i y, __m128i u, __m128i v, __m128i& b, __m128i& g, __m128i& r)
+{
+  __m128i b0, g0, r0, b1, g1, r1;
+  TYYuv4PixelsSSSE3(y, u, v, b0, g0, r0);
+  TYYuv4PixelsSSSE3(_mm_srli_si128(y, 8), _mm_srli_si128(u, 8), _mm_srli_si128(v, 8), b1, g1, r1);
+  b = _mm_packs_epi32(b0, b1);
+  g = _mm_packs_epi32(g0, g1);
+  r = _mm_packs_epi32(r0, r1);
+}
+
+/// TYYuvRowToBgrC on 16 pixels per step, returns the pixels done.
+TY_MAPPER_TARGET("ssse3")
+static inline int TYYuvRowToBgrSSSE3(const uint8_t* y, const uint8_t* u, const uint8_t* v, int width,
+                  uint8_t* out, bool rgb)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i y_off = _mm_set1_epi16(16);
+  const __m128i c_off = _mm_set1_epi16(128);
+  const int8_t* mask = TYBgrInterleaveMask(1);
+  int x = 0;
+  for(; x + 16 <= width; x += 16) {
+    __m128i yy = _mm_loadu_si128((const __m128i*)(y + x));
+    __m128i uu = _mm_loadu_si128((const __m128i*)(u + x));
+    __m128i vv = _mm_loadu_si128((const __m128i*)(v + x));
+    __m128i b0, g0, r0, b1, g1, r1;
+    TYYuv8PixelsSSSE3(_mm_sub_epi16(_mm_unpacklo_epi8(yy, zero), y_off), _mm_sub_epi16(_mm_unpacklo_epi8(uu, zero), c_off),
+                      _mm_sub_epi16(_mm_unpacklo_epi8(vv, zero), c_off), b0, g0, r0);
+    TYYuv8PixelsSSSE3(_mm_sub_epi16(_mm_unpackhi_epi8(yy, zero), y_off), _mm_sub_epi16(_mm_unpackhi_epi8(uu, zero), c_off),
+                      _mm_sub_epi16(_mm_unpackhi_epi8(vv, zero), c_off), b1, g1, r1);
+    __m128i b = _mm_packus_epi16(b0, b1), g = _mm_packus_epi16(g0, g1), r = _mm_packus_epi16(r0, r1);
+    TYBgrInterleaveSSSE3(rgb ? r : b, g, rgb ? b : r, mask, out + 3 * x);
+  }
+  return x;
+}
+#endif
+
+#if defined(TY_MAPPER_NEON)
+static inline int TYYuvRowToBgrNEON(const uint8_t* y, const uint8_t* u, const uint8_t* v, int width,
+                  uint8_t* out, bool rgb)
+{
+  const int16x8_t y_off = vdupq_n_s16(16);
+  const int16x8_t c_off = vdupq_n_s16(128);
+  int x = 0;
+  for(; x + 8 <= width; x += 8) {
+    int16x8_t yy = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + x))), y_off);
+    int16x8_t uu = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x))), c_off);
+    int16x8_t vv = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x))), c_off);
+    int32x4_t cl = vmull_n_s16(vget_low_s16(yy), TY_YUV_CY);
+    int32x4_t ch = vmull_n_s16(vget_high_s16(yy), TY_YUV_CY);
+    int32x4_t rl = vmlal_n_s16(cl, vget_low_s16(vv), TY_YUV_CVR);
+    int32x4_t rh = vmlal_n_s16(ch, vget_high_s16(vv), TY_YUV_CVR);
+    int32x4_t gl = vmlal_n_s16(vmlal_n_s16(cl, vget_low_s16(uu), TY_YUV_CUG), vget_low_s16(vv), TY_YUV_CVG);
+    int32x4_t gh = vmlal_n_s16(vmlal_n_s16(ch, vget_high_s16(uu), TY_YUV_CUG), vget_high_s16(vv), TY_YUV_CVG);
+    int32x4_t bl = vmlal_n_s16(cl, vget_low_s16(uu), TY_YUV_CUB);
+    int32x4_t bh = vmlal_n_s16(ch, vget_high_s16(uu), TY_YUV_CUB);
+    uint8x8_t r = vqmovun_s16(vcombine_s16(vqrshrn_n_s32(rl, TY_YUV_SHIFT), vqrshrn_n_s32(rh, TY_YUV_SHIFT)));
+    uint8x8_t g = vqmovun_s16(vcombine_s16(vqrshrn_n_s32(gl, TY_YUV_SHIFT), vqrshrn_n_s32(gh, TY_YUV_SHIFT)));
+    uint8x8_t b = vqmovun_s16(vcombine_s16(vqrshrn_n_s32(bl, TY_YUV_SHIFT), vqrshrn_n_s32(bh, TY_YUV_SHIFT)));
+    uint8x8x3_t bgr = { { rgb ? r : b, g, rgb ? b : r } };
+    vst3_u8(out + 3 * x, bgr);
+  }
+  return x;
+}
+#endif
+
+static inline void TYYuvRowToBgr(const uint8_t* y, const uint8_t* u, const uint8_t* v, int width,
+                  uint8_t* out, bool rgb, int simd)
+{
+  int x = 0;
+#if defined(TY_MAPPER_X86)
+  if(simd == TY_MAPPER_SIMD_SSE41 || simd == TY_MAPPER_SIMD_AVX2) {
+    x = TYYuvRowToBgrSSSE3(y, u, v, width, out, rgb);
+  }
+#elif defined(TY_MAPPER_NEON)
+  if(simd == TY_MAPPER_SIMD_NEON) {
+    x = TYYuvRowToBgrNEON(y, u, v, width, out, rgb);
+  }
+#endif
+  TYYuvRowToBgrC(y + x, u + x, v + x, width - x, out + 3 * x, rgb);
+}
+
+/// Source sample of one output coordinate: two neighbours and the 8 bit weight
+/// of the second, nearest sampling has both on the same sample. Row taps index
+/// rows, column taps become byte offsets into the part of a row the output reads.
+struct TYYuvTap
+{
+  int i0, i1;
+  int w;
+};
+
+/// Taps of size outputs over [start, start + length) of an axis of n luma samples,
+/// for luma and for chroma subsampled by 1 << c_shift.
+static inline void TYYuvTaps(int start, int length, int size, int n, int c_shift, bool bilinear,
+                  std::vector<TYYuvTap>& luma, std::vector<TYYuvTap>& chroma)
+{
+  luma.resize(size);
+  chroma.resize(size);
+  const int cn = n >> c_shift;
+  const double scale = (double)length / size;
+  for(int o = 0; o < size; o++) {
+    // luma position of the output center
+    double f = start + (o + 0.5) * scale - 0.5;
+    if(!bilinear) {
+      int i = std::min(start + length - 1, std::max(start, (int)std::floor(f + 0.5)));
+      luma[o].i0 = luma[o].i1 = i;
+      luma[o].w = 0;
+      chroma[o].i0 = chroma[o].i1 = i >> c_shift;
+      chroma[o].w = 0;
+      continue;
+    }
+    double c = c_shift ? (f - 0.5) / 2 : f;
+    f = std::min((double)n - 1, std::max(0.0, f));
+    c = std::min((double)cn - 1, std::max(0.0, c));
+    int i = (int)f, ci = (int)c;
+    luma[o].i0 = i;
+    luma[o].i1 = std::min(i + 1, n - 1);
+    luma[o].w = (int)((f - i) * 256 + 0.5);
+    chroma[o].i0 = ci;
+    chroma[o].i1 = std::min(ci + 1, cn - 1);
+    chroma[o].w = (int)((c - ci) * 256 + 0.5);
+  }
+}
+
+/// Shared setup of one conversion, read by every band.
+struct TYYuvJob
+{
+  TYYuvPlanes           planes;
+  int                   roi_x, roi_y, roi_w, roi_h;
+  int                   dst_w, dst_h;
+  uint8_t*              dst;
+  size_t                dst_step;
+  int                   scale;
+  bool                  rgb;
+  int                   simd;
+  std::vector<TYYuvTap> luma_x, chroma_x, luma_y, chroma_y;
+  // first byte and byte count of the part of a luma or chroma row the output reads
+  size_t                y_first, y_span, c_first, c_span;
+};
+
+// blend two rows, 8 bit weight of the second, the sums keep 16 bits
+static inline void TYYuvBlendRows(const uint8_t* r0, const uint8_t* r1, int w1, size_t n, uint16_t* out)
+{
+  const int w0 = 256 - w1;
+  for(size_t i = 0; i < n; i++) out[i] = (uint16_t)(r0[i] * w0 + r1[i] * w1);
+}
+
+// one sample between two blended samples
+static inline uint8_t TYYuvLerp(const uint16_t* row, const TYYuvTap& tx)
+{
+  return (uint8_t)((row[tx.i0] * (256 - tx.w) + row[tx.i1] * tx.w + 32768) >> 16);
+}
+
+/// Output rows [y0, y1) of job.
+static inline void TYYuvBand(const TYYuvJob& job, int y0, int y1)
+{
+  const TYYuvPlanes& p = job.planes;
+  const int w = job.dst_w;
+  // reused by every call on this thread
+  static thread_local std::vector<uint8_t> rows;
+  static thread_local std::vector<uint32_t> sums;
+  static thread_local std::vector<uint16_t> blend;
+  if(rows.size() < 3 * (size_t)w) rows.resize(3 * (size_t)w);
+  uint8_t* yr = &rows[0];
+  uint8_t* ur = yr + w;
+  uint8_t* vr = ur + w;
+
+  for(int oy = y0; oy < y1; oy++) {
+    uint8_t* out = job.dst + oy * job.dst_step;
+    if(job.dst_w == job.roi_w && job.dst_h == job.roi_h) {
+      // no scaling, chroma is shared by pixel pairs
+      int sy = job.roi_y + oy;
+      const uint8_t* ys = p.y + sy * p.y_stride + job.roi_x * p.y_step;
+      const uint8_t* us = p.u + (sy >> p.c_shift_y) * p.c_stride;
+      const uint8_t* vs = p.v + (sy >> p.c_shift_y) * p.c_stride;
+      const uint8_t* yp = ys;
+      if(p.y_step != 1) {
+        for(int x = 0; x < w; x++) yr[x] = ys[x * p.y_step];
+        yp = yr;
+      }
+      for(int x = 0; x < w; x++) {
+        size_t c = ((job.roi_x + x) >> 1) * p.c_step;
+        ur[x] = us[c];
+        vr[x] = vs[c];
+      }
+      TYYuvRowToBgr(yp, ur, vr, w, out, job.rgb, job.simd);
+      continue;
+    }
+
+    if(job.scale == TY_YUV_SCALE_BOX) {
+      // column sums over the rows of the block, then the blocks of a row
+      const int kx = job.roi_w / w, ky = job.roi_h / job.dst_h;
+      const int sy = job.roi_y + oy * ky;
+      const int cy0 = sy >> p.c_shift_y, cy1 = (sy + ky - 1) >> p.c_shift_y;
+      const int cx_first = job.roi_x >> 1;
+      const int cw = ((job.roi_x + job.roi_w - 1) >> 1) - cx_first + 1;
+      if(sums.size() < (size_t)job.roi_w + 2 * cw) sums.resize(job.roi_w + 2 * cw);
+      uint32_t* ys = &sums[0];
+      uint32_t* us = ys + job.roi_w;
+      uint32_t* vs = us + cw;
+      memset(ys, 0, sizeof(uint32_t) * (job.roi_w + 2 * cw));
+      for(int j = 0; j < ky; j++) {
+        const uint8_t* row = p.y + (sy + j) * p.y_stride + job.roi_x * p.y_step;
+        if(p.y_step == 1) {
+          for(int i = 0; i < job.roi_w; i++) ys[i] += row[i];
+        } else {
+          for(int i = 0; i < job.roi_w; i++) ys[i] += row[i * p.y_step];
+        }
+      }
+      for(int j = cy0; j <= cy1; j++) {
+        const uint8_t* ur0 = p.u + j * p.c_stride + cx_first * p.c_step;
+        const uint8_t* vr0 = p.v + j * p.c_stride + cx_first * p.c_step;
+        for(int i = 0; i < cw; i++) {
+          us[i] += ur0[i * p.c_step];
+          vs[i] += vr0[i * p.c_step];
+        }
+      }
+      const uint32_t area = kx * ky;
+      for(int x = 0; x < w; x++) {
+        uint32_t ysum = 0, usum = 0, vsum = 0;
+        for(int i = 0; i < kx; i++) ysum += ys[x * kx + i];
+        const int sx = job.roi_x + x * kx;
+        const int cx0 = (sx >> 1) - cx_first, cx1 = ((sx + kx - 1) >> 1) - cx_first;
+        for(int i = cx0; i <= cx1; i++) {
+          usum += us[i];
+          vsum += vs[i];
+        }
+        const uint32_t carea = (cx1 - cx0 + 1) * (cy1 - cy0 + 1);
+        yr[x] = (uint8_t)((ysum + area / 2) / area);
+        ur[x] = (uint8_t)((usum + carea / 2) / carea);
+        vr[x] = (uint8_t)((vsum + carea / 2) / carea);
+      }
+    } else if(job.scale == TY_YUV_SCALE_NEAREST) {
+      const uint8_t* ys = p.y + job.luma_y[oy].i0 * p.y_stride + job.y_first;
+      const uint8_t* us = p.u + job.chroma_y[oy].i0 * p.c_stride + job.c_first;
+      const uint8_t* vs = p.v + job.chroma_y[oy].i0 * p.c_stride + job.c_first;
+      for(int x = 0; x < w; x++) {
+        yr[x] = ys[job.luma_x[x].i0];
+        ur[x] = us[job.chroma_x[x].i0];
+        vr[x] = vs[job.chroma_x[x].i0];
+      }
+    } else {
+      // rows first, over the bytes the output reads, then two samples per pixel
+      const TYYuvTap& ty = job.luma_y[oy];
+      const TYYuvTap& tc = job.chroma_y[oy];
+      if(blend.size() < job.y_span + 2 * job.c_span) blend.resize(job.y_span + 2 * job.c_span);
+      uint16_t* yb = &blend[0];
+      uint16_t* ub = yb + job.y_span;
+      uint16_t* vb = ub + job.c_span;
+      TYYuvBlendRows(p.y + ty.i0 * p.y_stride + job.y_first, p.y + ty.i1 * p.y_stride + job.y_first, ty.w, job.y_span, yb);
+      TYYuvBlendRows(p.u + tc.i0 * p.c_stride + job.c_first, p.u + tc.i1 * p.c_stride + job.c_first, tc.w, job.c_span, ub);
+      TYYuvBlendRows(p.v + tc.i0 * p.c_stride + job.c_first, p.v + tc.i1 * p.c_stride + job.c_first, tc.w, job.c_span, vb);
+      for(int x = 0; x < w; x++) {
+        yr[x] = TYYuvLerp(yb, job.luma_x[x]);
+        ur[x] = TYYuvLerp(ub, job.chroma_x[x]);
+        vr[x] = TYYuvLerp(vb, job.chroma_x[x]);
+      }
+    }
+    TYYuvRowToBgr(yr, ur, vr, w, out, job.rgb, job.simd);
+  }
+}
+
+/// Convert the roi (roi_x, roi_y, roi_w, roi_h) of a width x height image of layout
+/// to a dst_w x dst_h BGR8 image, RGB8 with rgb set. A roi of 0 x 0 is the whole
+/// image. dst_step is the byte distance between dst rows, 0 for tightly packed rows.
+/// An output of the roi size converts without scaling, whatever scale says.
+/// With a pool the output is split into bands of 16 rows run over the pool.
+/// @retval 0 on success, -1 for an unknown layout, an odd size, a roi outside the
+///         image or a box scale that is not an integer factor.
+static inline int TYYuvToBgr(int layout, const void* src, int width, int height,
+                  int roi_x, int roi_y, int roi_w, int roi_h,
+                  void* dst, int dst_w, int dst_h, size_t dst_step,
+                  int scale = TY_YUV_SCALE_BILINEAR, bool rgb = false,
+                  TYMapperWorkerPool* pool = NULL, int simd = TYGetSimdLevel())
+{
+  TYYuvJob job;
+  if(!TYYuvPlanesOf(layout, src, width, height, job.planes)) return -1;
+  if(roi_w == 0 && roi_h == 0) {
+    roi_x = roi_y = 0;
+    roi_w = width;
+    roi_h = height;
+  }
+  if(roi_x < 0 || roi_y < 0 || roi_w <= 0 || roi_h <= 0 || roi_x + roi_w > width || roi_y + roi_h > height) return -1;
+  if(dst_w <= 0 || dst_h <= 0) return -1;
+  if(scale == TY_YUV_SCALE_BOX && (roi_w % dst_w || roi_h % dst_h)) return -1;
+
+  job.roi_x = roi_x;
+  job.roi_y = roi_y;
+  job.roi_w = roi_w;
+  job.roi_h = roi_h;
+  job.dst_w = dst_w;
+  job.dst_h = dst_h;
+  job.dst = (uint8_t*)dst;
+  job.dst_step = dst_step ? dst_step : (size_t)dst_w * 3;
+  job.scale = scale;
+  job.rgb = rgb;
+  job.simd = simd;
+  if(scale != TY_YUV_SCALE_BOX && (dst_w != roi_w || dst_h != roi_h)) {
+    bool bilinear = (scale == TY_YUV_SCALE_BILINEAR);
+    TYYuvTaps(roi_x, roi_w, dst_w, width, 1, bilinear, job.luma_x, job.chroma_x);
+    TYYuvTaps(roi_y, roi_h, dst_h, height, job.planes.c_shift_y, bilinear, job.luma_y, job.chroma_y);
+    // taps only grow along a row
+    job.y_first = (size_t)job.luma_x[0].i0 * job.planes.y_step;
+    job.c_first = (size_t)job.chroma_x[0].i0 * job.planes.c_step;
+    for(int x = 0; x < dst_w; x++) {
+      TYYuvTap& l = job.luma_x[x];
+      TYYuvTap& c = job.chroma_x[x];
+      l.i0 = (int)(l.i0 * job.planes.y_step - job.y_first);
+      l.i1 = (int)(l.i1 * job.planes.y_step - job.y_first);
+      c.i0 = (int)(c.i0 * job.planes.c_step - job.c_first);
+      c.i1 = (int)(c.i1 * job.planes.c_step - job.c_first);
+    }
+    job.y_span = job.luma_x[dst_w - 1].i1 + 1;
+    job.c_span = job.chroma_x[dst_w - 1].i1 + 1;
+  }
+
+  if(!pool) {
+    TYYuvBand(job, 0, dst_h);
+    return 0;
+  }
+  const int rows = 16;
+  uint32_t bands = (uint32_t)((dst_h + rows - 1) / rows);
+  pool->run(bands, [&](uint32_t b) {
+    TYYuvBand(job, (int)b * rows, std::min(dst_h, (int)(b + 1) * rows));
+  });
+  return 0;
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <iterator>
 
+#include <map>
 #include <memory>
 #include <iostream>
 #include <typeinfo>
@@ -18,141 +19,67 @@
 #endif
 
 #include "TYThread.hpp"
+#include "RawUnpack.hpp"
+#include "RawDemosaic.hpp"
+#include "YuvConvert.hpp"
 #include "CommandLineParser.hpp"
 #include "CommandLineFeatureHelper.hpp"
 
+//8 bit output keeps the high bits, see RawUnpack.hpp for full precision
 static inline int decodeCsiRaw10(unsigned char* src, unsigned char* dst, int width, int height)
 {
-    if(width & 0x3) {
-        return -1;
-    }
-    int raw10_line_size = 5 * width / 4;
-    for(size_t i = 0, j = 0; i < raw10_line_size * height; i+=5, j+=4)
-    {
-        //[A9 - A2] | [B9 - B2] | [C9 - C2] | [D9 - D2] | [D1D0-C1C0-B1B0-A1A0]
-        dst[j + 0] = src[i + 0];
-        dst[j + 1] = src[i + 1];
-        dst[j + 2] = src[i + 2];
-        dst[j + 3] = src[i + 3];
-    }
-    return 0;
+    return TYUnpackRaw8(TY_RAW_CSI10, src, dst, width, height);
 }
 
 static inline int decodeCsiRaw12(unsigned char* src, unsigned char* dst, int width, int height)
 {
-    if(width & 0x1) {
-        return -1;
-    }
-    int raw12_line_size = 3 * width / 2;
-    for(size_t i = 0, j = 0; i < raw12_line_size * height; i+=3, j+=2)
-    {
-        //[A11 - A4] | [B11 - B4] | [B3B2B1B0-A3A2A1A0]
-        dst[j + 0] = src[i + 0];
-        dst[j + 1] = src[i + 1];
-    }
-    return 0;
+    return TYUnpackRaw8(TY_RAW_CSI12, src, dst, width, height);
 }
 
 static inline int decodeCsiRaw14(unsigned char* src, unsigned char* dst, int width, int height)
 {
-    if(width & 0x3) {
-        return -1;
-    }
-    int raw14_line_size = 7 * width / 4;
-    for(size_t i = 0, j = 0; i < raw14_line_size * height; i+=7, j+=4)
-    {
-        //[A13 - A6] | [B13 - B6] | [C13 - C6] | [D13 - D6] | [D5D4D3D2D1D0-C5C4] | [C3C2C1C0-B5B4B3B2] | [B1B0-A5A4A3A2A1A0]
-        dst[j + 0] = src[i + 0];
-        dst[j + 1] = src[i + 1];
-        dst[j + 2] = src[i + 2];
-        dst[j + 3] = src[i + 3];
-    }
-    return 0;
+    return TYUnpackRaw8(TY_RAW_CSI14, src, dst, width, height);
 }
 
 static inline int decodePacketRaw10(unsigned char* src, unsigned char* dst, int width, int height)
 {
-    if(width & 0x3) {
-        return -1;
-    }
-
-    int raw10_line_size = 5 * width / 4;
-    //    byte0  -        byte1    -      byte2     -     byte3      -  byte4
-    // | A7 - A0 | B5 - B0 A9 - A8 | C3 -C0 B9 - B6 | D1 - D0 C9 -C4 | D9 -D2|
-    for(size_t i = 0; i < raw10_line_size * height; i+=5)
-    {
-        //high 8bit
-        dst[0] = (src[1] << 6) | (src[0] >> 2);
-        dst[1] = (src[2] << 4) | (src[1] >> 4);
-        dst[2] = (src[3] << 2) | (src[2] >> 6);
-        dst[3] = src[4];
-
-        src+=5;
-        dst+=4;
-    }
-    return 0;
+    return TYUnpackRaw8(TY_RAW_PACKET10, src, dst, width, height);
 }
 
 static inline int decodePacketRaw12(unsigned char* src, unsigned char* dst, int width, int height)
 {
-    //TODO...
-    return 0;
+    return TYUnpackRaw8(TY_RAW_PACKET12, src, dst, width, height);
 }
 
 #ifdef OPENCV_DEPENDENCIES
 static inline int parseCsiRaw10(unsigned char* src, cv::Mat &dst, int width, int height)
 {
-    dst = cv::Mat(height, width, CV_8U);
+    dst.create(height, width, CV_8U);
     decodeCsiRaw10(src, dst.data, width, height);
     return 0;
 }
 
 static inline int parseCsiRaw12(unsigned char* src, cv::Mat &dst, int width, int height)
 {
-    dst = cv::Mat(height, width, CV_8U);
+    dst.create(height, width, CV_8U);
     decodeCsiRaw12(src, dst.data, width, height);
     return 0;
 }
 
 static inline int parsePacketRaw10(unsigned char* src, cv::Mat &dst, int width, int height)
 {
-    //TODO...
-    dst = cv::Mat(height, width, CV_8U);
+    dst.create(height, width, CV_8U);
     decodePacketRaw10(src, dst.data, width, height);
     return 0;
 }
 
 static inline int parsePacketRaw12(unsigned char* src, cv::Mat &dst, int width, int height)
 {
-    //TODO...
-    dst = cv::Mat(height, width, CV_8U);
+    dst.create(height, width, CV_8U);
     decodePacketRaw12(src, dst.data, width, height);
     return 0;
 }
 
-static inline int parseIrFrame(const TY_IMAGE_DATA* img, cv::Mat* pIR)
-{
-    if(img->pixelFormat == TYPixelFormatMono8) {
-        *pIR = cv::Mat(img->height, img->width, CV_8U, img->buffer).clone();
-    } else if(img->pixelFormat == TYPixelFormatMono10) {
-        parseCsiRaw10((uchar*)img->buffer, *pIR, img->width, img->height);
-    } else if(img->pixelFormat == TYPixelFormatMono12) {
-        parseCsiRaw12((uchar*)img->buffer, *pIR, img->width, img->height);
-    } else if(img->pixelFormat == TYPixelFormatPacketMono10) {
-        parsePacketRaw10((uchar*)img->buffer, *pIR, img->width, img->height);
-    } else if(img->pixelFormat == TYPixelFormatPacketMono12) {
-        parsePacketRaw12((uchar*)img->buffer, *pIR, img->width, img->height);
-    } else if (img->pixelFormat == TYPixelFormatMono16){
-        *pIR = cv::Mat(img->height, img->width, CV_16U, img->buffer).clone();
-    } else if (img->pixelFormat == TYPixelFormatTofIRFourGroupMono16){
-        *pIR = cv::Mat(img->height * 2, img->width * 2, CV_16U, img->buffer).clone();
-    } else {
-        return -1;
-    }
-
-    return 0;
-}
-
 static inline int parseBayer8Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
 {
     int code = cv::COLOR_BayerGB2BGR;
@@ -180,303 +107,226 @@ static inline int parseBayer8Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
     return 0;
 }
 
-static inline int parseBayer10Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
+//packed bayer straight to BGR8, no unpacked intermediate
+//with a pool the demosaic runs in bands on it, one call at a time per pool
+static inline int parseRawBayerFrame(const TY_IMAGE_DATA* img, cv::Mat* pColor, const char* name,
+                                     TYMapperWorkerPool* pool = NULL)
 {
-    int code = cv::COLOR_BayerGB2BGR;
-    switch (img->pixelFormat)
-    {
-    case TYPixelFormatBayerGBRG10:
-        code = cv::COLOR_BayerGR2BGR;
-        break;
-    case TYPixelFormatBayerBGGR10:
-        code = cv::COLOR_BayerRG2BGR;
-        break;                
-    case TYPixelFormatBayerGRBG10:
-        code = cv::COLOR_BayerGB2BGR;
-        break;                
-    case TYPixelFormatBayerRGGB10:
-        code = cv::COLOR_BayerBG2BGR;
-        break;
-    default:
-        LOGE("Invalid bayer10 fmt!");
+    int packing = TYRawPackingOf(img->pixelFormat);
+    int pattern = TYBayerPatternOf(img->pixelFormat);
+    if (packing < 0 || pattern < 0) {
+        LOGE("Invalid %s fmt!", name);
         return -1;
     }
-    cv::Mat raw;
-    parseCsiRaw10((uchar*)img->buffer, raw, img->width, img->height);
-    cv::cvtColor(raw, *pColor, code);
-  
-    return 0;
+    pColor->create(img->height, img->width, CV_8UC3);
+    return TYDemosaicRaw(packing, pattern, img->buffer, img->width, img->height,
+                         pColor->data, pColor->step, 8, pool);
 }
 
-static inline int parseBayer12Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
+static inline int parseBayer10Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
 {
-    int code = cv::COLOR_BayerGB2BGR;
-    switch (img->pixelFormat)
-    {
-    case TYPixelFormatBayerGBRG12:
-        code = cv::COLOR_BayerGR2BGR;
-        break;
-    case TYPixelFormatBayerBGGR12:
-        code = cv::COLOR_BayerRG2BGR;
-        break;
-    case TYPixelFormatBayerGRBG12:
-        code = cv::COLOR_BayerGB2BGR;
-        break;
-    case TYPixelFormatBayerRGGB12:
-        code = cv::COLOR_BayerBG2BGR;
-        break;
-    default:
-        LOGE("Invalid bayer12 fmt!");
-        return -1;
-    }
-    cv::Mat raw;
-    parseCsiRaw12((uchar*)img->buffer, raw, img->width, img->height);
-    cv::cvtColor(raw, *pColor, code);
+    return parseRawBayerFrame(img, pColor, "bayer10");
+}
 
-    return 0;
+static inline int parseBayer12Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
+{
+    return parseRawBayerFrame(img, pColor, "bayer12");
 }
 
 static inline int parsePacketBayer10Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
 {
-    int code = cv::COLOR_BayerGB2BGR;
-    switch (img->pixelFormat)
-    {
-    case TYPixelFormatPacketBayerGBRG10:
-        code = cv::COLOR_BayerGR2BGR;
-        break;
-    case TYPixelFormatPacketBayerBGGR10:
-        code = cv::COLOR_BayerRG2BGR;
-        break;                
-    case TYPixelFormatPacketBayerGRBG10:
-        code = cv::COLOR_BayerGB2BGR;
-        break;                
-    case TYPixelFormatPacketBayerRGGB10:
-        code = cv::COLOR_BayerBG2BGR;
-        break;
-    default:
-        LOGE("Invalid packet bayer10 fmt!");
-        return -1;
-    }
-    cv::Mat raw;
-    parsePacketRaw10((uchar*)img->buffer, raw, img->width, img->height);
-    cv::cvtColor(raw, *pColor, code);
-    return 0;
+    return parseRawBayerFrame(img, pColor, "packet bayer10");
 }
 
 static inline int parsePacketBayer12Frame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
 {
-    int code = cv::COLOR_BayerGB2BGR;
+    return parseRawBayerFrame(img, pColor, "packet bayer12");
+}
+
+enum {
+    TY_DECODE_VIEW = 0,         //a header on the frame buffer, nothing copied
+    TY_DECODE_CONVERTED = 1,    //decoded or copied into the output buffer
+};
+
+//formats that already are the decoded image; -1 if img needs a conversion
+static inline int viewImage(const TY_IMAGE_DATA* img, cv::Mat* view, bool color)
+{
+    int rows = img->height, cols = img->width, type = -1;
     switch (img->pixelFormat)
     {
-    case TYPixelFormatPacketBayerGBRG12:
-        code = cv::COLOR_BayerGR2BGR;
+    case TYPixelFormatCoord3D_C16:
+    case TYPixelFormatMono16:
+        type = CV_16U;
         break;
-    case TYPixelFormatPacketBayerBGGR12:
-        code = cv::COLOR_BayerRG2BGR;
-        break;                
-    case TYPixelFormatPacketBayerGRBG12:
-        code = cv::COLOR_BayerGB2BGR;
-        break;                
-    case TYPixelFormatPacketBayerRGGB12:
-        code = cv::COLOR_BayerBG2BGR;
+    case TYPixelFormatCoord3D_ABC16:
+        type = CV_16SC3;
+        break;
+    case TYPixelFormatTofIRFourGroupMono16:
+        type = CV_16U;
+        rows *= 2;
+        cols *= 2;
+        break;
+    case TYPixelFormatBGR8:
+        type = CV_8UC3;
+        break;
+    case TYPixelFormatMono8:
+        //color frames show mono as BGR
+        if (!color) type = CV_8U;
         break;
     default:
-        LOGE("Invalid packet bayer12 fmt!");
-        return -1;
+        break;
     }
-    cv::Mat raw;
-    parsePacketRaw12((uchar*)img->buffer, raw, img->width, img->height);
-    cv::cvtColor(raw, *pColor, code);
+    if (type < 0) return -1;
+    *view = cv::Mat(rows, cols, type, img->buffer);
     return 0;
 }
 
-static inline int parseColorFrame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
+//Decodes img into dst, which keeps its buffer when size and type already match,
+//so dst must own its data rather than view another frame.
+//With view set, formats that need no conversion become a header on img->buffer,
+//valid until the frame buffer is enqueued again.
+//pool, if any, runs the packed bayer demosaic in bands.
+//Returns TY_DECODE_VIEW, TY_DECODE_CONVERTED or -1 for unsupported formats.
+static inline int decodeImage(const TY_IMAGE_DATA* img, cv::Mat* dst, bool color = false, bool view = false,
+                              TYMapperWorkerPool* pool = NULL)
 {
-    int ret = 0;
-    if (img->pixelFormat == TYPixelFormatJPEG){
-        std::vector<uchar> _v((uchar*)img->buffer, (uchar*)img->buffer + img->size);
-        *pColor = cv::imdecode(_v, cv::IMREAD_COLOR);
-        ASSERT(img->width == pColor->cols && img->height == pColor->rows);
-    }
-    else if (img->pixelFormat == TYPixelFormatYUV422_8){
-        cv::Mat yuv(img->height, img->width, CV_8UC2, img->buffer);
-        cv::cvtColor(yuv, *pColor, cv::COLOR_YUV2BGR_YUYV);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CbCr_Planar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *pColor, cv::COLOR_YUV2BGR_I420);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CrCb_Planar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *pColor, cv::COLOR_YUV420p2BGR);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CbCr_Semiplanar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *pColor, cv::COLOR_YUV2BGR_NV12);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CrCb_Semiplanar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *pColor, cv::COLOR_YUV2BGR_NV21);
-    }
-    else if (img->pixelFormat == TYPixelFormatRGB8){
-        cv::Mat rgb(img->height, img->width, CV_8UC3, img->buffer);
-        cv::cvtColor(rgb, *pColor, cv::COLOR_RGB2BGR);
-    }
-    else if (img->pixelFormat == TYPixelFormatBGR8){
-        *pColor = cv::Mat(img->height, img->width, CV_8UC3, img->buffer).clone();
+    cv::Mat src;
+    if (viewImage(img, &src, color) == 0) {
+        if (view) {
+            *dst = src;
+            return TY_DECODE_VIEW;
+        }
+        src.copyTo(*dst);
+        return TY_DECODE_CONVERTED;
     }
-    else if (img->pixelFormat == TYPixelFormatBayerGBRG8 || 
-            img->pixelFormat == TYPixelFormatBayerBGGR8 || 
-            img->pixelFormat == TYPixelFormatBayerGRBG8 || 
-            img->pixelFormat == TYPixelFormatBayerRGGB8) 
+
+    int code = -1;
+    int rows = img->height;
+    switch (img->pixelFormat)
     {
-        ret = parseBayer8Frame(img, pColor);
-    }
-    else if (img->pixelFormat == TYPixelFormatBayerGBRG10 || 
-            img->pixelFormat == TYPixelFormatBayerBGGR10 || 
-            img->pixelFormat == TYPixelFormatBayerGRBG10 || 
-            img->pixelFormat == TYPixelFormatBayerRGGB10) 
+    case TYPixelFormatJPEG:
     {
-        ret = parseBayer10Frame(img, pColor);
+        //decoded straight from the frame buffer
+        cv::Mat jpeg(1, img->size, CV_8U, img->buffer);
+        cv::imdecode(jpeg, cv::IMREAD_COLOR, dst);
+        ASSERT(img->width == dst->cols && img->height == dst->rows);
+        return TY_DECODE_CONVERTED;
     }
-    else if(img->pixelFormat == TYPixelFormatBayerGBRG12 || 
-            img->pixelFormat == TYPixelFormatBayerBGGR12 || 
-            img->pixelFormat == TYPixelFormatBayerGRBG12 || 
-            img->pixelFormat == TYPixelFormatBayerRGGB12) 
+    case TYPixelFormatYUV422_8:
     {
-        ret = parseBayer12Frame(img, pColor);
+        cv::Mat yuv(img->height, img->width, CV_8UC2, img->buffer);
+        cv::cvtColor(yuv, *dst, cv::COLOR_YUV2BGR_YUYV);
+        return TY_DECODE_CONVERTED;
     }
-    else if(img->pixelFormat == TYPixelFormatPacketBayerGBRG10 || 
-            img->pixelFormat == TYPixelFormatPacketBayerBGGR10 || 
-            img->pixelFormat == TYPixelFormatPacketBayerGRBG10 || 
-            img->pixelFormat == TYPixelFormatPacketBayerRGGB10)
+    case TYPixelFormatRGB8:
     {
-        ret = parsePacketBayer10Frame(img, pColor);
+        cv::Mat rgb(img->height, img->width, CV_8UC3, img->buffer);
+        cv::cvtColor(rgb, *dst, cv::COLOR_RGB2BGR);
+        return TY_DECODE_CONVERTED;
     }
-    else if(img->pixelFormat == TYPixelFormatPacketBayerGBRG12 || 
-        img->pixelFormat == TYPixelFormatPacketBayerBGGR12 || 
-        img->pixelFormat == TYPixelFormatPacketBayerGRBG12 || 
-        img->pixelFormat == TYPixelFormatPacketBayerRGGB12) 
+    case TYPixelFormatMono8:
     {
-        ret = parsePacketBayer12Frame(img, pColor);
-    }
-    else if (img->pixelFormat == TYPixelFormatMono8){
         cv::Mat gray(img->height, img->width, CV_8U, img->buffer);
-        cv::cvtColor(gray, *pColor, cv::COLOR_GRAY2BGR);
-    }
-    else if (img->pixelFormat == TYPixelFormatMono10){
-        parseCsiRaw10((uchar*)img->buffer, *pColor, img->width, img->height);
+        cv::cvtColor(gray, *dst, cv::COLOR_GRAY2BGR);
+        return TY_DECODE_CONVERTED;
     }
-    else if(img->pixelFormat == TYPixelFormatMono12) {
-        parseCsiRaw12((uchar*)img->buffer, *pColor, img->width, img->height);
-    }
-    else if (img->pixelFormat == TYPixelFormatPacketMono10){
-        parsePacketRaw10((uchar*)img->buffer, *pColor, img->width, img->height);
+    case TYPixelFormatBayerGBRG8:
+    case TYPixelFormatBayerBGGR8:
+    case TYPixelFormatBayerGRBG8:
+    case TYPixelFormatBayerRGGB8:
+        return parseBayer8Frame(img, dst) < 0 ? -1 : TY_DECODE_CONVERTED;
+    case TYPixelFormatYCbCr420_8_YY_CbCr_Planar:
+        code = cv::COLOR_YUV2BGR_I420;
+        rows += img->height / 2;
+        break;
+    case TYPixelFormatYCbCr420_8_YY_CrCb_Planar:
+        code = cv::COLOR_YUV420p2BGR;
+        rows += img->height / 2;
+        break;
+    case TYPixelFormatYCbCr420_8_YY_CbCr_Semiplanar:
+        code = cv::COLOR_YUV2BGR_NV12;
+        rows += img->height / 2;
+        break;
+    case TYPixelFormatYCbCr420_8_YY_CrCb_Semiplanar:
+        code = cv::COLOR_YUV2BGR_NV21;
+        rows += img->height / 2;
+        break;
+    default:
+        break;
     }
-    else if(img->pixelFormat == TYPixelFormatPacketMono12) {
-        parsePacketRaw12((uchar*)img->buffer, *pColor, img->width, img->height);
+    if (code >= 0) {
+        cv::Mat yuv420(rows, img->width, CV_8UC1, img->buffer);
+        cv::cvtColor(yuv420, *dst, code);
+        return TY_DECODE_CONVERTED;
     }
 
-    return ret;
+    //packed raw, bayer to BGR and mono to 8 bit
+    int packing = TYRawPackingOf(img->pixelFormat);
+    if (packing < 0) return -1;
+    if (TYBayerPatternOf(img->pixelFormat) >= 0)
+        return parseRawBayerFrame(img, dst, "bayer", pool) < 0 ? -1 : TY_DECODE_CONVERTED;
+    dst->create(img->height, img->width, CV_8U);
+    if (TYUnpackRaw8(packing, img->buffer, dst->data, img->width, img->height) < 0) return -1;
+    return TY_DECODE_CONVERTED;
 }
 
-static inline int parseImage(const TY_IMAGE_DATA* img, cv::Mat* image)
+static inline int parseIrFrame(const TY_IMAGE_DATA* img, cv::Mat* pIR)
 {
-    int ret = 0;
-    if (img->pixelFormat == TYPixelFormatJPEG){
-        std::vector<uchar> _v((uchar*)img->buffer, (uchar*)img->buffer + img->size);
-        *image = cv::imdecode(_v, cv::IMREAD_COLOR);
-        ASSERT(img->width == image->cols && img->height == image->rows);
-    }
-    else if (img->pixelFormat == TYPixelFormatYUV422_8){
-        cv::Mat yuv(img->height, img->width, CV_8UC2, img->buffer);
-        cv::cvtColor(yuv, *image, cv::COLOR_YUV2BGR_YUYV);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CbCr_Planar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *image, cv::COLOR_YUV2BGR_I420);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CrCb_Planar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *image, cv::COLOR_YUV420p2BGR);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CbCr_Semiplanar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *image, cv::COLOR_YUV2BGR_NV12);
-    }
-    else if(img->pixelFormat == TYPixelFormatYCbCr420_8_YY_CrCb_Semiplanar) {
-        cv::Mat yuv420(img->height + img->height/2, img->width, CV_8UC1, img->buffer);
-        cv::cvtColor(yuv420, *image, cv::COLOR_YUV2BGR_NV21);
-    }
-    else if (img->pixelFormat == TYPixelFormatRGB8){
-        cv::Mat rgb(img->height, img->width, CV_8UC3, img->buffer);
-        cv::cvtColor(rgb, *image, cv::COLOR_RGB2BGR);
-    }
-    else if (img->pixelFormat == TYPixelFormatBGR8){
-        *image = cv::Mat(img->height, img->width, CV_8UC3, img->buffer).clone();
-    }
-    else if (img->pixelFormat == TYPixelFormatBayerGBRG8 || 
-            img->pixelFormat == TYPixelFormatBayerBGGR8 || 
-            img->pixelFormat == TYPixelFormatBayerGRBG8 || 
-            img->pixelFormat == TYPixelFormatBayerRGGB8) 
-    {
-        ret = parseBayer8Frame(img, image);
-    }
-    else if (img->pixelFormat == TYPixelFormatBayerGBRG10 || 
-            img->pixelFormat == TYPixelFormatBayerBGGR10 || 
-            img->pixelFormat == TYPixelFormatBayerGRBG10 || 
-            img->pixelFormat == TYPixelFormatBayerRGGB10) 
-    {
-        ret = parseBayer10Frame(img, image);
-    }
-    else if(img->pixelFormat == TYPixelFormatBayerGBRG12 || 
-            img->pixelFormat == TYPixelFormatBayerBGGR12 || 
-            img->pixelFormat == TYPixelFormatBayerGRBG12 || 
-            img->pixelFormat == TYPixelFormatBayerRGGB12) 
-    {
-        ret = parseBayer12Frame(img, image);
-    }
-    else if (img->pixelFormat == TYPixelFormatPacketBayerGBRG10 || 
-        img->pixelFormat == TYPixelFormatPacketBayerBGGR10 || 
-        img->pixelFormat == TYPixelFormatPacketBayerGRBG10 || 
-        img->pixelFormat == TYPixelFormatPacketBayerRGGB10) 
-    {
-        ret = parsePacketBayer10Frame(img, image);
-    }
-    else if(img->pixelFormat == TYPixelFormatPacketBayerGBRG12 || 
-            img->pixelFormat == TYPixelFormatPacketBayerBGGR12 || 
-            img->pixelFormat == TYPixelFormatPacketBayerGRBG12 || 
-            img->pixelFormat == TYPixelFormatPacketBayerRGGB12) 
+    switch (img->pixelFormat)
     {
-        ret = parsePacketBayer12Frame(img, image);
-    }
-
-    else if(img->pixelFormat == TYPixelFormatMono8) {
-        *image = cv::Mat(img->height, img->width, CV_8U, img->buffer).clone();
-    }
-    else if (img->pixelFormat == TYPixelFormatMono10){
-        ret = parseCsiRaw10((uchar*)img->buffer, *image, img->width, img->height);
-    }
-    else if (img->pixelFormat == TYPixelFormatPacketMono10){
-        ret = parsePacketRaw10((uchar*)img->buffer, *image, img->width, img->height);
-    }
-    else if(img->pixelFormat == TYPixelFormatMono12) {
-        ret = parseCsiRaw12((uchar*)img->buffer, *image, img->width, img->height);
-    } 
-    else if(img->pixelFormat == TYPixelFormatPacketMono12) {
-        ret = parsePacketRaw12((uchar*)img->buffer, *image, img->width, img->height);
-    } 
-    else if (img->pixelFormat == TYPixelFormatMono16){
-        *image = cv::Mat(img->height, img->width, CV_16U, img->buffer).clone();
-    }
-    else if (img->pixelFormat == TYPixelFormatTofIRFourGroupMono16) {
-        *image = cv::Mat(img->height * 2, img->width * 2, CV_16U, img->buffer).clone();
-    }
-    else {
+    case TYPixelFormatMono8:
+    case TYPixelFormatMono10:
+    case TYPixelFormatMono12:
+    case TYPixelFormatMono14:
+    case TYPixelFormatPacketMono10:
+    case TYPixelFormatPacketMono12:
+    case TYPixelFormatMono16:
+    case TYPixelFormatTofIRFourGroupMono16:
+        break;
+    default:
         return -1;
     }
+    //a fresh image every call, TYDecodeContext reuses them
+    pIR->release();
+    return decodeImage(img, pIR) < 0 ? -1 : 0;
+}
+
+static inline int parseColorFrame(const TY_IMAGE_DATA* img, cv::Mat* pColor)
+{
+    pColor->release();
+    return decodeImage(img, pColor, true) < 0 ? -1 : 0;
+}
+
+//Color frame to a size image of roi, an empty roi is the whole frame,
+//a roi outside the frame fails.
+//YUV is cropped, scaled and converted in one pass, so a small output of a large
+//frame only converts the pixels it keeps; other formats are decoded first.
+//pColor keeps its buffer when it already has the size.
+//With a pool the YUV conversion runs in bands on it, one call at a time per pool.
+static inline int parseColorFrame(const TY_IMAGE_DATA* img, cv::Mat* pColor, cv::Rect roi, cv::Size size,
+                                  int scale = TY_YUV_SCALE_BILINEAR, TYMapperWorkerPool* pool = NULL)
+{
+    if (roi.area() == 0) roi = cv::Rect(0, 0, img->width, img->height);
+    if (roi.x < 0 || roi.y < 0 || roi.width <= 0 || roi.height <= 0 ||
+        roi.x + roi.width > img->width || roi.y + roi.height > img->height) return -1;
+    if (scale < TY_YUV_SCALE_NEAREST || scale > TY_YUV_SCALE_BILINEAR) return -1;
+    int layout = TYYuvLayoutOf(img->pixelFormat);
+    if (layout >= 0) {
+        pColor->create(size, CV_8UC3);
+        return TYYuvToBgr(layout, img->buffer, img->width, img->height, roi.x, roi.y, roi.width, roi.height,
+                          pColor->data, size.width, size.height, pColor->step, scale, false, pool) < 0 ? -1 : 0;
+    }
+    static const int interpolation[] = { cv::INTER_NEAREST, cv::INTER_AREA, cv::INTER_LINEAR };
+    cv::Mat full;
+    if (decodeImage(img, &full, true) < 0) return -1;
+    cv::resize(full(roi), *pColor, size, 0, 0, interpolation[scale]);
+    return 0;
+}
 
-    return ret;
+static inline int parseImage(const TY_IMAGE_DATA* img, cv::Mat* image)
+{
+    image->release();
+    return decodeImage(img, image) < 0 ? -1 : 0;
 }
 
 static inline int parseFrame(const TY_FRAME_DATA& frame, cv::Mat* pDepth
@@ -488,14 +338,7 @@ static inline int parseFrame(const TY_FRAME_DATA& frame, cv::Mat* pDepth
 
         // get depth image
         if (pDepth && frame.image[i].componentID == TY_COMPONENT_DEPTH_CAM){
-            if (frame.image[i].pixelFormat == TYPixelFormatCoord3D_ABC16) {
-                *pDepth = cv::Mat(frame.image[i].height, frame.image[i].width
-                              , CV_16SC3, frame.image[i].buffer).clone();
-            }
-          else {
-              *pDepth = cv::Mat(frame.image[i].height, frame.image[i].width
-                            , CV_16U, frame.image[i].buffer).clone();
-          }
+            parseImage(&frame.image[i], pDepth);
         }
         // get left ir image
         if (pLeftIR && frame.image[i].componentID == TY_COMPONENT_IR_CAM_LEFT){
@@ -514,6 +357,74 @@ static inline int parseFrame(const TY_FRAME_DATA& frame, cv::Mat* pDepth
     return 0;
 }
 
+/**
+ * parseImage and parseFrame without the allocations: every component decodes
+ * into a buffer the context keeps, so once the first frame has set them up,
+ * frames of the same size allocate nothing.
+ * Formats that need no conversion, depth and most IR, are views of the frame
+ * buffer unless zero_copy is off; a view is only valid until the buffer is
+ * enqueued again, clone() it to keep it.
+ * A decoded image is overwritten by the next frame of the same component.
+ * With a pool packed bayer frames are demosaiced in bands on it.
+ * Not thread safe, use one context per stream; a pool shared by contexts
+ * runs one frame at a time, so share it only among contexts of one thread.
+ */
+class TYDecodeContext
+{
+public:
+    explicit TYDecodeContext(bool zero_copy = true, TYMapperWorkerPool* pool = NULL)
+        : _zero_copy(zero_copy), _allocations(0), _pool(pool) {}
+
+    //TY_DECODE_VIEW, TY_DECODE_CONVERTED or -1 for unsupported formats
+    int parseImage(const TY_IMAGE_DATA* img, cv::Mat* image)
+    {
+        bool color = (img->componentID == TY_COMPONENT_RGB_CAM);
+        if (_zero_copy && viewImage(img, image, color) == 0) return TY_DECODE_VIEW;
+
+        cv::Mat& buffer = _buffers[img->componentID];
+        const uchar* data = buffer.data;
+        int ret = decodeImage(img, &buffer, color, false, _pool);
+        if (ret < 0) return -1;
+        if (buffer.data != data) _allocations++;
+        *image = buffer;
+        return ret;
+    }
+
+    //Same outputs as ::parseFrame, returns the components that were converted
+    //rather than viewed
+    TY_COMPONENT_ID parseFrame(const TY_FRAME_DATA& frame, cv::Mat* pDepth
+                               , cv::Mat* pLeftIR, cv::Mat* pRightIR
+                               , cv::Mat* pColor)
+    {
+        TY_COMPONENT_ID converted = 0;
+        for (int i = 0; i < frame.validCount; i++){
+            const TY_IMAGE_DATA& img = frame.image[i];
+            if (img.status != TY_STATUS_OK) continue;
+
+            cv::Mat* out = NULL;
+            switch (img.componentID)
+            {
+            case TY_COMPONENT_DEPTH_CAM:    out = pDepth;   break;
+            case TY_COMPONENT_IR_CAM_LEFT:  out = pLeftIR;  break;
+            case TY_COMPONENT_IR_CAM_RIGHT: out = pRightIR; break;
+            case TY_COMPONENT_RGB_CAM:      out = pColor;   break;
+            default:                                        break;
+            }
+            if (out && parseImage(&img, out) == TY_DECODE_CONVERTED) converted |= img.componentID;
+        }
+        return converted;
+    }
+
+    //buffers allocated so far, flat once the frame size settles
+    uint64_t allocations() const { return _allocations; }
+
+private:
+    bool                               _zero_copy;
+    uint64_t                           _allocations;
+    TYMapperWorkerPool*                _pool;
+    std::map<TY_COMPONENT_ID, cv::Mat> _buffers;
+};
+
 enum{
     PC_FILE_FORMAT_XYZ = 0,
 };
@@ -39,19 +39,7 @@ static inline int covertToLinear(cv::Mat &raw16, cv::Mat raw32,
 
 static inline int decodeCsiRaw10(unsigned char* src, unsigned short* dst, int width, int height)
 {
-    if(width & 0x3) {
-        return -1;
-    }
-    int raw10_line_size = 5 * width / 4;
-    for(size_t i = 0, j = 0; i < raw10_line_size * height; i+=5, j+=4)
-    {
-        //[A2 - A9] | [B2 - B9] | [C2 - C9] | [D2 - D9] | [A0A1-B0B1-C0C1-D0D1]
-        dst[j + 0] = ((uint16_t)src[i + 0] << 2) | ((src[i + 4] & 0x3)  >> 0);
-        dst[j + 1] = ((uint16_t)src[i + 1] << 2) | ((src[i + 4] & 0xc)  >> 2);
-        dst[j + 2] = ((uint16_t)src[i + 2] << 2) | ((src[i + 4] & 0x30) >> 4);
-        dst[j + 3] = ((uint16_t)src[i + 3] << 2) | ((src[i + 4] & 0xc0) >> 6);
-    }
-    return 0;
+    return TYUnpackRaw16(TY_RAW_CSI10, src, dst, width, height);
 }
 
 static inline int parseHDRRaw10(TY_FRAME_DATA& frame,
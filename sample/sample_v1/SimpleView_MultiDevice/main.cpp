@@ -10,6 +10,7 @@ struct CamInfo
     TY_FRAME_DATA       frame;
     int                 idx;
     DepthRender         render;
+    TYDecodeContext     decoder;
 
     CamInfo() : hDev(0), idx(0) {}
 };
@@ -19,8 +20,9 @@ void frameHandler(TY_FRAME_DATA* frame, void* userdata)
 {
     CamInfo* pData = (CamInfo*) userdata;
 
+    //depth and IR are views of the frame buffer, used before it is re-enqueued
     cv::Mat depth, irl, irr, color;
-    parseFrame(*frame, &depth, &irl, &irr, &color);
+    pData->decoder.parseFrame(*frame, &depth, &irl, &irr, &color);
 
     char win[64];
     if(!depth.empty()){
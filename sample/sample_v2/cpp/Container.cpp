@@ -0,0 +1,539 @@
+#include "Container.hpp"
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef ZLIB_DEPENDENCIES
+#include <zlib.h>
+#endif
+
+namespace percipio_layer {
+
+static inline uint64_t alignUp(uint64_t pos)
+{
+    return (pos + TY_CONTAINER_ALIGN - 1) / TY_CONTAINER_ALIGN * TY_CONTAINER_ALIGN;
+}
+
+TYFrameContainerWriter::~TYFrameContainerWriter()
+{
+    close();
+}
+
+TY_STATUS TYFrameContainerWriter::open(const char* path, TYContainerCompression compression, int level)
+{
+    if(_file.is_open()) return TY_STATUS_BUSY;
+#ifndef ZLIB_DEPENDENCIES
+    if(compression == TYContainerCompressionZlib) {
+        std::cout << "Built without zlib, compression is not supported!" << std::endl;
+        return TY_STATUS_NOT_PERMITTED;
+    }
+#endif
+
+    _file.open(path, std::ios::binary | std::ios::trunc);
+    if(!_file) {
+        std::cout << "Open container file " << path << " failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+
+    //the tables are filled in by close(), until then readers scan the records
+    TYContainerHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TY_CONTAINER_MAGIC, 4);
+    header.version = TY_CONTAINER_VERSION;
+    header.scale_unit = 1.f;
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _pos = sizeof(header);
+
+    _compression = compression;
+    _level = level;
+    _scale_unit = 1.f;
+    _frames.clear();
+    _chunks.clear();
+    _calibs.clear();
+    _start = std::chrono::steady_clock::now();
+    return TY_STATUS_OK;
+}
+
+bool TYFrameContainerWriter::writeAligned(const void* data, size_t size, uint64_t& offset)
+{
+    static const char padding[TY_CONTAINER_ALIGN] = { 0 };
+    size_t pad = static_cast<size_t>(alignUp(_pos) - _pos);
+    if(pad) _file.write(padding, pad);
+    offset = _pos + pad;
+    if(size) _file.write(reinterpret_cast<const char*>(data), size);
+    _pos = offset + size;
+    return _file.good();
+}
+
+bool TYFrameContainerWriter::writeRecord(uint32_t type, uint32_t count, uint64_t size, uint64_t host_time,
+                                         const void* entries, size_t entries_size)
+{
+    TYContainerRecord record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.magic, TY_CONTAINER_RECORD_MAGIC, 4);
+    record.type = type;
+    record.count = count;
+    record.size = size;
+    record.host_time = host_time;
+    uint64_t offset;
+    if(!writeAligned(&record, sizeof(record), offset)) return false;
+    if(entries_size) _file.write(reinterpret_cast<const char*>(entries), entries_size);
+    _pos += entries_size;
+    return _file.good();
+}
+
+TY_STATUS TYFrameContainerWriter::writeCalibration(TY_COMPONENT_ID comp, const TY_CAMERA_CALIB_INFO& calib)
+{
+    if(!_file.is_open()) return TY_STATUS_NOT_PERMITTED;
+    TYContainerCalib entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.componentID = comp;
+    entry.calib = calib;
+    if(!writeRecord(TYContainerRecordCalib, 1, sizeof(entry), 0, &entry, sizeof(entry))) {
+        std::cout << "Write container file failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+    for(auto& iter : _calibs) {
+        if(iter.componentID == comp) {
+            iter.calib = calib;
+            return TY_STATUS_OK;
+        }
+    }
+    _calibs.push_back(entry);
+    return TY_STATUS_OK;
+}
+
+TY_STATUS TYFrameContainerWriter::writeScaleUnit(float scale_unit)
+{
+    if(!_file.is_open()) return TY_STATUS_NOT_PERMITTED;
+    if(!writeRecord(TYContainerRecordScaleUnit, 1, sizeof(scale_unit), 0, &scale_unit, sizeof(scale_unit))) {
+        std::cout << "Write container file failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+    _scale_unit = scale_unit;
+    return TY_STATUS_OK;
+}
+
+TY_STATUS TYFrameContainerWriter::write(const std::shared_ptr<TYFrame>& frame, TY_COMPONENT_ID components)
+{
+    if(!frame) return TY_STATUS_INVALID_PARAMETER;
+    if(!_file.is_open()) return TY_STATUS_NOT_PERMITTED;
+
+    TYContainerFrame entry;
+    entry.host_time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - _start).count();
+    entry.first_chunk = static_cast<uint32_t>(_chunks.size());
+    entry.chunk_count = 0;
+
+    //chunks are laid out first, the record in front of the payloads lists them
+    std::vector<std::shared_ptr<TYImage>> images = frame->images();
+    std::vector<const void*> payloads;
+    if(_compressed.size() < images.size()) _compressed.resize(images.size());
+    for(auto& image : images) {
+        if(components && !(components & image->componentID())) continue;
+
+        TYContainerChunk chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        chunk.timestamp = image->timestamp();
+        chunk.size = image->size();
+        chunk.componentID = image->componentID();
+        chunk.pixelFormat = image->pixelFormat();
+        chunk.width = image->width();
+        chunk.height = image->height();
+        chunk.imageIndex = image->imageIndex();
+        chunk.status = image->status();
+        chunk.compression = TYContainerCompressionNone;
+
+        const void* data = image->buffer();
+        size_t stored = static_cast<size_t>(image->size());
+#ifdef ZLIB_DEPENDENCIES
+        if(_compression == TYContainerCompressionZlib) {
+            std::vector<uint8_t>& buffer = _compressed[payloads.size()];
+            uLongf packed = compressBound(static_cast<uLong>(stored));
+            if(buffer.size() < packed) buffer.resize(packed);
+            //kept raw when zlib does not win, color noise often does not shrink
+            if(compress2(&buffer[0], &packed, reinterpret_cast<const Bytef*>(data),
+                         static_cast<uLong>(stored), _level) == Z_OK && packed < stored) {
+                data = &buffer[0];
+                stored = packed;
+                chunk.compression = TYContainerCompressionZlib;
+            }
+        }
+#endif
+        chunk.stored_size = static_cast<uint32_t>(stored);
+        _chunks.push_back(chunk);
+        payloads.push_back(data);
+        entry.chunk_count++;
+    }
+
+    TYContainerChunk* chunks = entry.chunk_count ? &_chunks[entry.first_chunk] : nullptr;
+    uint64_t data = alignUp(_pos) + sizeof(TYContainerRecord);
+    uint64_t end = data + entry.chunk_count * sizeof(TYContainerChunk);
+    for(uint32_t i = 0; i < entry.chunk_count; i++) {
+        chunks[i].offset = alignUp(end);
+        end = chunks[i].offset + chunks[i].stored_size;
+    }
+    bool ok = writeRecord(TYContainerRecordFrame, entry.chunk_count, end - data, entry.host_time,
+                          chunks, entry.chunk_count * sizeof(TYContainerChunk));
+    for(uint32_t i = 0; ok && i < entry.chunk_count; i++) {
+        uint64_t offset;
+        ok = writeAligned(payloads[i], chunks[i].stored_size, offset);
+    }
+    if(!ok) {
+        _chunks.resize(entry.first_chunk);
+        std::cout << "Write container file failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+
+    _frames.push_back(entry);
+    return TY_STATUS_OK;
+}
+
+TY_STATUS TYFrameContainerWriter::flush()
+{
+    if(!_file.is_open()) return TY_STATUS_NOT_PERMITTED;
+    _file.flush();
+    return _file.good() ? TY_STATUS_OK : TY_STATUS_ERROR;
+}
+
+TY_STATUS TYFrameContainerWriter::close()
+{
+    if(!_file.is_open()) return TY_STATUS_IDLE;
+
+    TYContainerHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TY_CONTAINER_MAGIC, 4);
+    header.version = TY_CONTAINER_VERSION;
+    header.frame_count = static_cast<uint32_t>(_frames.size());
+    header.chunk_count = static_cast<uint32_t>(_chunks.size());
+    header.calib_count = static_cast<uint32_t>(_calibs.size());
+    header.scale_unit = _scale_unit;
+
+    bool ok = writeAligned(_calibs.data(), _calibs.size() * sizeof(TYContainerCalib), header.calib_offset) &&
+              writeAligned(_chunks.data(), _chunks.size() * sizeof(TYContainerChunk), header.chunk_offset) &&
+              writeAligned(_frames.data(), _frames.size() * sizeof(TYContainerFrame), header.frame_offset);
+    if(ok) {
+        _file.seekp(0);
+        _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ok = _file.good();
+    }
+    _file.close();
+    _frames.clear();
+    _chunks.clear();
+    _calibs.clear();
+    if(!ok) {
+        std::cout << "Write container index failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+    return TY_STATUS_OK;
+}
+
+static std::shared_ptr<void> mapFile(const char* path, uint64_t& length)
+{
+    length = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return std::shared_ptr<void>();
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return std::shared_ptr<void>();
+    }
+    if(static_cast<uint64_t>(size.QuadPart) > SIZE_MAX) {
+        std::cout << path << " is too large to map on this target!" << std::endl;
+        CloseHandle(file);
+        return std::shared_ptr<void>();
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if(!mapping) return std::shared_ptr<void>();
+    void* base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if(!base) return std::shared_ptr<void>();
+    length = static_cast<uint64_t>(size.QuadPart);
+    return std::shared_ptr<void>(base, [](void* p) { UnmapViewOfFile(p); });
+#else
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0) return std::shared_ptr<void>();
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return std::shared_ptr<void>();
+    }
+    if(static_cast<uint64_t>(st.st_size) > SIZE_MAX) {
+        std::cout << path << " is too large to map on this target!" << std::endl;
+        ::close(fd);
+        return std::shared_ptr<void>();
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    //private and writable, images handed out may be changed in place
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(base == MAP_FAILED) return std::shared_ptr<void>();
+    length = size;
+    return std::shared_ptr<void>(base, [size](void* p) { munmap(p, size); });
+#endif
+}
+
+TY_STATUS TYFrameContainer::open(const char* path)
+{
+    close();
+    uint64_t length = 0;
+    std::shared_ptr<void> mapping = mapFile(path, length);
+    if(!mapping) {
+        std::cout << "Open container file " << path << " failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+
+    const uint8_t* base = static_cast<const uint8_t*>(mapping.get());
+    TYContainerHeader header;
+    if(length < sizeof(header)) {
+        std::cout << path << " is not a frame container!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+    memcpy(&header, base, sizeof(header));
+    if(memcmp(header.magic, TY_CONTAINER_MAGIC, 4) != 0 || header.version > TY_CONTAINER_VERSION) {
+        std::cout << path << " is not a frame container!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+
+    if(header.frame_offset == 0) {
+        //version 1 files carry no records to index
+        if(header.version < 2) {
+            std::cout << path << " was not closed!" << std::endl;
+            return TY_STATUS_ERROR;
+        }
+        scan(base, length, header);
+        std::cout << path << " was not closed, " << header.frame_count << " frames recovered." << std::endl;
+    } else {
+        auto fits = [length](uint64_t offset, uint64_t count, uint64_t size) {
+            return offset % TY_CONTAINER_ALIGN == 0 && offset <= length && count <= (length - offset) / size;
+        };
+        if(!fits(header.calib_offset, header.calib_count, sizeof(TYContainerCalib)) ||
+           !fits(header.chunk_offset, header.chunk_count, sizeof(TYContainerChunk)) ||
+           !fits(header.frame_offset, header.frame_count, sizeof(TYContainerFrame))) {
+            std::cout << path << " has a broken index!" << std::endl;
+            return TY_STATUS_ERROR;
+        }
+    }
+
+    _mapping = mapping;
+    _base = base;
+    _length = length;
+    _header = header;
+    if(header.frame_offset == 0) {
+        _calibs = _scanned_calibs.data();
+        _chunks = _scanned_chunks.data();
+        _frames = _scanned_frames.data();
+    } else {
+        _calibs = reinterpret_cast<const TYContainerCalib*>(base + header.calib_offset);
+        _chunks = reinterpret_cast<const TYContainerChunk*>(base + header.chunk_offset);
+        _frames = reinterpret_cast<const TYContainerFrame*>(base + header.frame_offset);
+    }
+    return TY_STATUS_OK;
+}
+
+void TYFrameContainer::scan(const uint8_t* base, uint64_t length, TYContainerHeader& header)
+{
+    header.scale_unit = 1.f;
+    uint64_t pos = sizeof(TYContainerHeader);
+    for(;;) {
+        pos = alignUp(pos);
+        TYContainerRecord record;
+        if(pos > length || length - pos < sizeof(record)) break;
+        memcpy(&record, base + pos, sizeof(record));
+        uint64_t data = pos + sizeof(record);
+        //the first record cut short, or not written at all, ends the file
+        if(memcmp(record.magic, TY_CONTAINER_RECORD_MAGIC, 4) != 0 || record.size > length - data) break;
+
+        if(record.type == TYContainerRecordFrame) {
+            if(record.count > record.size / sizeof(TYContainerChunk)) break;
+            TYContainerFrame frame;
+            frame.host_time = record.host_time;
+            frame.first_chunk = static_cast<uint32_t>(_scanned_chunks.size());
+            frame.chunk_count = record.count;
+            for(uint32_t i = 0; i < record.count; i++) {
+                TYContainerChunk chunk;
+                memcpy(&chunk, base + data + i * sizeof(chunk), sizeof(chunk));
+                _scanned_chunks.push_back(chunk);
+            }
+            _scanned_frames.push_back(frame);
+        } else if(record.type == TYContainerRecordCalib && record.size >= sizeof(TYContainerCalib)) {
+            TYContainerCalib calib;
+            memcpy(&calib, base + data, sizeof(calib));
+            bool found = false;
+            for(auto& iter : _scanned_calibs) {
+                if(iter.componentID == calib.componentID) {
+                    iter = calib;
+                    found = true;
+                }
+            }
+            if(!found) _scanned_calibs.push_back(calib);
+        } else if(record.type == TYContainerRecordScaleUnit && record.size >= sizeof(float)) {
+            memcpy(&header.scale_unit, base + data, sizeof(float));
+        }
+        //unknown records are skipped
+        pos = data + record.size;
+    }
+    header.frame_count = static_cast<uint32_t>(_scanned_frames.size());
+    header.chunk_count = static_cast<uint32_t>(_scanned_chunks.size());
+    header.calib_count = static_cast<uint32_t>(_scanned_calibs.size());
+}
+
+void TYFrameContainer::close()
+{
+    //images handed out keep the mapping
+    _mapping.reset();
+    _base = nullptr;
+    _length = 0;
+    _header = TYContainerHeader();
+    _frames = nullptr;
+    _chunks = nullptr;
+    _calibs = nullptr;
+    _scanned_frames.clear();
+    _scanned_chunks.clear();
+    _scanned_calibs.clear();
+}
+
+uint64_t TYFrameContainer::hostTime(uint32_t frame) const
+{
+    if(frame >= _header.frame_count) return 0;
+    return _frames[frame].host_time;
+}
+
+TY_COMPONENT_ID TYFrameContainer::components(uint32_t frame) const
+{
+    TY_COMPONENT_ID comps = 0;
+    if(frame >= _header.frame_count) return comps;
+    const TYContainerFrame& entry = _frames[frame];
+    if(entry.first_chunk > _header.chunk_count || entry.chunk_count > _header.chunk_count - entry.first_chunk) return comps;
+    for(uint32_t i = 0; i < entry.chunk_count; i++) comps |= _chunks[entry.first_chunk + i].componentID;
+    return comps;
+}
+
+const TYContainerChunk* TYFrameContainer::findChunk(uint32_t frame, TY_COMPONENT_ID comp) const
+{
+    if(frame >= _header.frame_count) return nullptr;
+    const TYContainerFrame& entry = _frames[frame];
+    if(entry.first_chunk > _header.chunk_count || entry.chunk_count > _header.chunk_count - entry.first_chunk) return nullptr;
+    for(uint32_t i = 0; i < entry.chunk_count; i++) {
+        const TYContainerChunk& chunk = _chunks[entry.first_chunk + i];
+        if(!(chunk.componentID & comp)) continue;
+        if(chunk.offset > _length || chunk.stored_size > _length - chunk.offset || chunk.size < 0) return nullptr;
+        if(chunk.compression == TYContainerCompressionNone && chunk.stored_size != static_cast<uint32_t>(chunk.size)) return nullptr;
+        return &chunk;
+    }
+    return nullptr;
+}
+
+bool TYFrameContainer::decode(const TYContainerChunk& chunk, void* out) const
+{
+#ifdef ZLIB_DEPENDENCIES
+    if(chunk.compression == TYContainerCompressionZlib) {
+        uLongf size = static_cast<uLongf>(chunk.size);
+        return uncompress(static_cast<Bytef*>(out), &size, _base + chunk.offset, chunk.stored_size) == Z_OK &&
+               size == static_cast<uLongf>(chunk.size);
+    }
+#endif
+    std::cout << "Unsupported container compression " << chunk.compression << "!" << std::endl;
+    return false;
+}
+
+void TYFrameContainer::fillImage(const TYContainerChunk& chunk, void* buffer, TY_IMAGE_DATA& image) const
+{
+    memset(&image, 0, sizeof(image));
+    image.timestamp = chunk.timestamp;
+    image.imageIndex = chunk.imageIndex;
+    image.status = chunk.status;
+    image.componentID = chunk.componentID;
+    image.size = chunk.size;
+    image.buffer = buffer;
+    image.width = chunk.width;
+    image.height = chunk.height;
+    image.pixelFormat = chunk.pixelFormat;
+}
+
+std::shared_ptr<TYImage> TYFrameContainer::image(uint32_t frame, TY_COMPONENT_ID comp) const
+{
+    const TYContainerChunk* chunk = findChunk(frame, comp);
+    if(!chunk) return std::shared_ptr<TYImage>();
+
+    TY_IMAGE_DATA image;
+    if(chunk->compression == TYContainerCompressionNone) {
+        fillImage(*chunk, const_cast<uint8_t*>(_base) + chunk->offset, image);
+        return std::make_shared<TYImage>(image, _mapping);
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> decoded = std::make_shared<std::vector<uint8_t>>(chunk->size);
+    if(!decode(*chunk, decoded->data())) return std::shared_ptr<TYImage>();
+    fillImage(*chunk, decoded->data(), image);
+    return std::make_shared<TYImage>(image, decoded);
+}
+
+std::shared_ptr<TYFrame> TYFrameContainer::frame(uint32_t frame, TY_COMPONENT_ID components) const
+{
+    if(frame >= _header.frame_count) return std::shared_ptr<TYFrame>();
+    const TYContainerFrame& entry = _frames[frame];
+    if(entry.first_chunk > _header.chunk_count || entry.chunk_count > _header.chunk_count - entry.first_chunk) {
+        return std::shared_ptr<TYFrame>();
+    }
+
+    std::vector<const TYContainerChunk*> chunks;
+    size_t decoded_size = 0;
+    for(uint32_t i = 0; i < entry.chunk_count && chunks.size() < 10; i++) {
+        const TYContainerChunk& c = _chunks[entry.first_chunk + i];
+        if(components && !(components & c.componentID)) continue;
+        const TYContainerChunk* chunk = findChunk(frame, c.componentID);
+        if(!chunk) continue;
+        chunks.push_back(chunk);
+        if(chunk->compression != TYContainerCompressionNone) decoded_size += chunk->size;
+    }
+    if(chunks.empty()) return std::shared_ptr<TYFrame>();
+
+    //compressed images of the frame share one buffer, which also holds on to the mapping
+    typedef std::pair<std::shared_ptr<void>, std::vector<uint8_t>> Decoded;
+    std::shared_ptr<void> lease = _mapping;
+    uint8_t* out = nullptr;
+    if(decoded_size) {
+        std::shared_ptr<Decoded> decoded = std::make_shared<Decoded>(_mapping, std::vector<uint8_t>(decoded_size));
+        out = decoded->second.data();
+        lease = decoded;
+    }
+
+    TY_FRAME_DATA data;
+    memset(&data, 0, sizeof(data));
+    data.userBuffer = const_cast<uint8_t*>(_base);
+    data.bufferSize = 0;
+    for(auto chunk : chunks) {
+        void* buffer = const_cast<uint8_t*>(_base) + chunk->offset;
+        if(chunk->compression != TYContainerCompressionNone) {
+            if(!decode(*chunk, out)) continue;
+            buffer = out;
+            out += chunk->size;
+        }
+        fillImage(*chunk, buffer, data.image[data.validCount++]);
+    }
+    if(data.validCount == 0) return std::shared_ptr<TYFrame>();
+    return std::shared_ptr<TYFrame>(new TYFrame(data, lease));
+}
+
+bool TYFrameContainer::calibration(TY_COMPONENT_ID comp, TY_CAMERA_CALIB_INFO& calib) const
+{
+    for(uint32_t i = 0; i < _header.calib_count; i++) {
+        if(_calibs[i].componentID == comp) {
+            calib = _calibs[i].calib;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
@@ -1,5 +1,11 @@
 #include "Device.hpp"
 
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
 struct to_string
 {
     std::ostringstream ss;
@@ -241,6 +247,10 @@ FastCamera::~FastCamera()
 
 void FastCamera::close()
 {
+    if(onDeliveryThread()) {
+        std::cout << "Camera can not be closed from its own frame callback!" << std::endl;
+        return;
+    }
     std::unique_lock<std::mutex> lock(_dev_lock);
     if(isRuning) {
         doStop();
@@ -249,17 +259,44 @@ void FastCamera::close()
     if(device) device.reset();
 }
 
-std::shared_ptr<TYFrame> FastCamera::fetchFrames(uint32_t timeout_ms)
+std::shared_ptr<TYFrame> FastCamera::fetchFrames(uint32_t timeout_ms, bool quiet_timeout)
 {
+    if(buffer_pool) {
+        buffer_pool->refill();
+        if(zero_copy && pool_config.policy == TYBufferPolicyBlock && buffer_pool->queuedCount() == 0) {
+            //every buffer is held by a frame, nothing can arrive before one comes back
+            if(!buffer_pool->waitReturned(timeout_ms)) {
+                if(!quiet_timeout) std::cout << "Frame fetch timeout, all frame buffers are held by frames." << std::endl;
+                return std::shared_ptr<TYFrame>();
+            }
+            buffer_pool->refill();
+        }
+    }
+
     TY_FRAME_DATA tyframe;
     TY_STATUS status = TYFetchFrame(handle(), &tyframe, timeout_ms);
     if(status != TY_STATUS_OK) {
-        std::cout << "Frame fetch failed with err code: " << status << "(" << TYErrorString(status) << ")."<< std::endl;
+        if(!quiet_timeout || status != TY_STATUS_TIMEOUT)
+            std::cout << "Frame fetch failed with err code: " << status << "(" << TYErrorString(status) << ")."<< std::endl;
         return std::shared_ptr<TYFrame>();
     }
+
+    if(pool_config.policy == TYBufferPolicyDropOldest) {
+        TY_FRAME_DATA newer;
+        while(TYFetchFrame(handle(), &newer, 0) == TY_STATUS_OK) {
+            buffer_pool->requeue(tyframe.userBuffer);
+            buffer_pool->countDropped();
+            tyframe = newer;
+        }
+    }
     
-    std::shared_ptr<TYFrame> frame = std::shared_ptr<TYFrame>(new TYFrame(tyframe));
-    CHECK_RET(TYEnqueueBuffer(handle(), tyframe.userBuffer, tyframe.bufferSize));
+    std::shared_ptr<TYFrame> frame;
+    if(zero_copy) {
+        frame = std::shared_ptr<TYFrame>(new TYFrame(tyframe, buffer_pool->lease(tyframe.userBuffer)));
+    } else {
+        frame = std::shared_ptr<TYFrame>(new TYFrame(tyframe));
+        CHECK_RET(buffer_pool->requeue(tyframe.userBuffer));
+    }
     return frame;
 }
 
@@ -322,23 +359,43 @@ TY_STATUS FastCamera::start()
         return TY_STATUS_DEVICE_ERROR;
     }
 
-    for(int i = 0; i < BUF_CNT; i++) {
-        stream_buffer[i].resize(stream_buffer_size);
-        TYEnqueueBuffer(handle(), &stream_buffer[i][0], stream_buffer_size);
+    TYBufferPoolConfig config = pool_config;
+    if(!zero_copy) {
+        //copied frames give their buffer back at once, the pool never grows
+        config.max_buffer_count = config.buffer_count;
     }
+    std::shared_ptr<TYFrameBufferPool> pool = std::make_shared<TYFrameBufferPool>(handle(), stream_buffer_size, config);
+    status = pool->start();
+    if(TY_STATUS_OK != status) {
+        std::cout << "Enqueue frame buffer failed with error code: " << TY_ERROR(status) << std::endl;
+        TYClearBufferQueue(handle());
+        pool->stop();
+        return status;
+    }
+    std::atomic_store(&buffer_pool, pool);
 
     status = TYStartCapture(handle());
     if(TY_STATUS_OK != status) {
         std::cout << "Start capture failed with error code: " << TY_ERROR(status) << std::endl;
+        //take the buffers back from the driver before the pool can be freed
+        TYClearBufferQueue(handle());
+        pool->stop();
+        std::atomic_store(&buffer_pool, std::shared_ptr<TYFrameBufferPool>());
         return status;
     }
 
     isRuning = true;
+    startDelivery();
     return TY_STATUS_OK;
 }
 
 TY_STATUS FastCamera::stop()
 {
+    //before the lock, a stop() waiting for this callback may hold it
+    if(onDeliveryThread()) {
+        std::cout << "Camera can not be stopped from its own frame callback!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
     std::unique_lock<std::mutex> lock(_dev_lock);
     return doStop();
 }
@@ -348,28 +405,451 @@ TY_STATUS FastCamera::doStop()
     if(!isRuning) 
         return TY_STATUS_IDLE;
     
+    //callbacks are done with their frames before the capture stops
+    TY_STATUS status = stopDelivery();
+    if(status != TY_STATUS_OK) return status;
     isRuning = false;
     
-    TY_STATUS status = TYStopCapture(handle());
+    status = TYStopCapture(handle());
     if(TY_STATUS_OK != status) {
         std::cout << "Stop capture failed with error code: " << TY_ERROR(status) << std::endl;
     }
     //Stop will stop receive, need TYClearBufferQueue any way
     //Ignore TYClearBufferQueue ret val
     TYClearBufferQueue(handle());
-    for(int i = 0; i < BUF_CNT; i++) {
-        stream_buffer[i].clear();
-    }
+    //frames still alive keep their buffers until they are released,
+    //the pool stays for bufferPoolStats() until the next start
+    buffer_pool->stop();
 
     return status;
 }
 
+TY_STATUS FastCamera::setBufferPool(const TYBufferPoolConfig& config)
+{
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    if(isRuning) {
+        std::cout << "Device is busy!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+    if(config.buffer_count == 0 || config.alignment == 0 || (config.alignment & (config.alignment - 1))) {
+        return TY_STATUS_INVALID_PARAMETER;
+    }
+    pool_config = config;
+    return TY_STATUS_OK;
+}
+
+TYBufferPoolStats FastCamera::bufferPoolStats()
+{
+    //no device lock, tryGetFrames holds it while waiting for frames
+    std::shared_ptr<TYFrameBufferPool> pool = std::atomic_load(&buffer_pool);
+    if(!pool) return TYBufferPoolStats();
+
+    TYBufferPoolStats st = pool->stats();
+    bool has_statistics = false;
+    TYHasFeature(pool->handle(), TY_COMPONENT_DEVICE, TY_STRUCT_CAM_STATISTICS, &has_statistics);
+    TY_CAMERA_STATISTICS dev_st;
+    if(has_statistics &&
+            TYGetStruct(pool->handle(), TY_COMPONENT_DEVICE, TY_STRUCT_CAM_STATISTICS, &dev_st, sizeof(dev_st)) == TY_STATUS_OK) {
+        st.driver_dropped = dev_st.imageDropped;
+    }
+    return st;
+}
+
 std::shared_ptr<TYFrame> FastCamera::tryGetFrames(uint32_t timeout_ms)
 {
+    if(delivering) {
+        std::cout << "Frames are delivered to the frame callbacks!" << std::endl;
+        return std::shared_ptr<TYFrame>();
+    }
     std::unique_lock<std::mutex> lock(_dev_lock);
     return fetchFrames(timeout_ms);
 }
 
+TY_STATUS FastCamera::registerFrameCallback(const std::string& name, TYFrameCallback cb)
+{
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    if(isRuning) {
+        std::cout << "Device is busy!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+    if(!cb) return TY_STATUS_INVALID_PARAMETER;
+
+    for(auto& iter : frame_callbacks) {
+        if(iter->name == name) {
+            iter->cb = cb;
+            return TY_STATUS_OK;
+        }
+    }
+    std::shared_ptr<FrameCallback> callback = std::make_shared<FrameCallback>();
+    callback->name = name;
+    callback->cb = cb;
+    callback->pending = 0;
+    frame_callbacks.push_back(callback);
+    return TY_STATUS_OK;
+}
+
+TY_STATUS FastCamera::unregisterFrameCallback(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    if(isRuning) {
+        std::cout << "Device is busy!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+    for(auto iter = frame_callbacks.begin(); iter != frame_callbacks.end(); iter++) {
+        if((*iter)->name == name) {
+            frame_callbacks.erase(iter);
+            return TY_STATUS_OK;
+        }
+    }
+    return TY_STATUS_INVALID_PARAMETER;
+}
+
+TY_STATUS FastCamera::setFrameDelivery(const TYFrameDeliveryConfig& config)
+{
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    if(isRuning) {
+        std::cout << "Device is busy!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+    if(config.max_pending == 0) return TY_STATUS_INVALID_PARAMETER;
+    delivery_config = config;
+    return TY_STATUS_OK;
+}
+
+std::map<std::string, TYFrameCallbackStats> FastCamera::frameCallbackStats()
+{
+    //no device lock, callbacks are only added or removed while stopped
+    std::map<std::string, TYFrameCallbackStats> stats;
+    for(auto& iter : frame_callbacks) {
+        std::unique_lock<std::mutex> lock(iter->lock);
+        stats[iter->name] = iter->stats;
+    }
+    return stats;
+}
+
+static inline void addTiming(TYStageTiming& t, double ms)
+{
+    t.count++;
+    t.last_ms = ms;
+    t.total_ms += ms;
+    t.max_ms = std::max(t.max_ms, ms);
+}
+
+void FastCamera::startDelivery()
+{
+    if(frame_callbacks.empty()) return;
+
+    //device timestamps are host wall clock us once the device syncs its time to the host or a time server
+    uint32_t sync_type = TY_TIME_SYNC_TYPE_NONE;
+    bool has_sync = false;
+    if(device) TYHasFeature(handle(), TY_COMPONENT_DEVICE, TY_ENUM_TIME_SYNC_TYPE, &has_sync);
+    if(has_sync) TYGetEnum(handle(), TY_COMPONENT_DEVICE, TY_ENUM_TIME_SYNC_TYPE, &sync_type);
+    device_clock = sync_type == TY_TIME_SYNC_TYPE_HOST || sync_type == TY_TIME_SYNC_TYPE_NTP ||
+                   sync_type == TY_TIME_SYNC_TYPE_PTP || sync_type == TY_TIME_SYNC_TYPE_PTP_MASTER;
+
+    for(auto& iter : frame_callbacks) {
+        std::unique_lock<std::mutex> lock(iter->lock);
+        iter->stats = TYFrameCallbackStats();
+        iter->stats.device_clock = device_clock;
+        iter->pending = 0;
+    }
+
+    if(delivery_config.workers) delivery_workers = std::make_shared<TYWorkerPool>(delivery_config.workers);
+    delivering = true;
+    fetch_thread = std::thread(&FastCamera::deliveryLoop, this);
+}
+
+//camera whose frame callbacks the current thread delivers
+static thread_local const FastCamera* delivery_camera = nullptr;
+
+bool FastCamera::onDeliveryThread() const
+{
+    return delivery_camera == this;
+}
+
+std::string FastCamera::sourceName()
+{
+    return device ? device->getDeviceInfo()->id() : std::string();
+}
+
+TY_STATUS FastCamera::stopDelivery()
+{
+    if(!fetch_thread.joinable()) return TY_STATUS_OK;
+    if(onDeliveryThread()) {
+        //the fetch thread or a pool thread would have to join itself
+        std::cout << "Camera can not be stopped from its own frame callback!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+
+    //the fetch thread finishes its current fetch and delivery, at most fetch_timeout_ms
+    delivering = false;
+    fetch_thread.join();
+    //the pool runs every queued callback before its threads exit
+    delivery_workers.reset();
+    return TY_STATUS_OK;
+}
+
+void FastCamera::invokeCallback(FrameCallback& cb, const std::shared_ptr<TYFrame>& frame,
+                                const std::chrono::steady_clock::time_point& fetched)
+{
+    auto start = std::chrono::steady_clock::now();
+    double latency;
+    if(device_clock) {
+        int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        latency = (now_us - static_cast<int64_t>(frame->timestamp())) / 1000.0;
+    } else {
+        latency = std::chrono::duration<double, std::milli>(start - fetched).count();
+    }
+
+    const FastCamera* outer = delivery_camera;
+    delivery_camera = this;
+    cb.cb(frame);
+    delivery_camera = outer;
+
+    double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::unique_lock<std::mutex> lock(cb.lock);
+    addTiming(cb.stats.latency, latency);
+    addTiming(cb.stats.duration, duration);
+}
+
+void FastCamera::deliveryLoop()
+{
+    delivery_camera = this;
+    std::shared_ptr<TYWorkerPool> workers = delivery_workers;
+    while(delivering) {
+        std::shared_ptr<TYFrame> frame = fetchFrames(delivery_config.fetch_timeout_ms, true);
+        if(!frame) continue;
+
+        auto fetched = std::chrono::steady_clock::now();
+        for(auto& iter : frame_callbacks) {
+            if(!workers) {
+                invokeCallback(*iter, frame, fetched);
+                continue;
+            }
+            //a slow callback skips frames instead of queueing them, queued frames hold driver buffers
+            if(iter->pending.load() >= delivery_config.max_pending) {
+                std::unique_lock<std::mutex> lock(iter->lock);
+                iter->stats.skipped++;
+                continue;
+            }
+            iter->pending++;
+            std::shared_ptr<FrameCallback> cb = iter;
+            workers->post([this, cb, frame, fetched]() {
+                invokeCallback(*cb, frame, fetched);
+                cb->pending--;
+            });
+        }
+    }
+}
+
+static void* allocFrameBuffer(size_t size, uint32_t alignment, bool huge_pages, size_t* capacity, bool* mapped)
+{
+    *capacity = size;
+    *mapped = false;
+#ifdef _WIN32
+    //large pages need SeLockMemoryPrivilege, stay with aligned memory
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = nullptr;
+    if(huge_pages) {
+        const size_t huge_page = 2 * 1024 * 1024;
+        size_t len = (size + huge_page - 1) / huge_page * huge_page;
+#ifdef MAP_HUGETLB
+        ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(ptr != MAP_FAILED) {
+            *capacity = len;
+            *mapped = true;
+            return ptr;
+        }
+#endif
+        //no reserved huge pages, ask for transparent ones
+        if(posix_memalign(&ptr, huge_page, len) != 0) return nullptr;
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+        *capacity = len;
+        return ptr;
+    }
+    if(posix_memalign(&ptr, std::max<size_t>(alignment, sizeof(void*)), size) != 0) return nullptr;
+    return ptr;
+#endif
+}
+
+static void freeFrameBuffer(void* ptr, size_t capacity, bool mapped)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    if(mapped) munmap(ptr, capacity);
+    else free(ptr);
+#endif
+}
+
+TYFrameBufferPool::TYFrameBufferPool(TY_DEV_HANDLE handle, uint32_t buffer_size, const TYBufferPoolConfig& config) :
+    _handle(handle),
+    _buffer_size(buffer_size),
+    _config(config),
+    _enqueued(0),
+    _starved(0),
+    _dropped(0)
+{
+    _config.max_buffer_count = std::max(_config.buffer_count, _config.max_buffer_count);
+    _buffers.reserve(_config.max_buffer_count);
+}
+
+TYFrameBufferPool::~TYFrameBufferPool()
+{
+    for(size_t i = 0; i < _buffers.size(); i++) {
+        if(_buffers[i].data) freeFrameBuffer(_buffers[i].data, _buffers[i].capacity, _buffers[i].mapped);
+    }
+}
+
+bool TYFrameBufferPool::allocate()
+{
+    Buffer buf;
+    buf.leased = false;
+    buf.data = allocFrameBuffer(_buffer_size, _config.alignment, _config.huge_pages, &buf.capacity, &buf.mapped);
+    if(!buf.data) {
+        std::cout << "Frame buffer allocation of " << _buffer_size << " bytes failed!" << std::endl;
+        return false;
+    }
+    _buffers.push_back(buf);
+    return true;
+}
+
+TY_STATUS TYFrameBufferPool::start()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    _running = true;
+    for(uint32_t i = 0; i < _config.buffer_count; i++) {
+        if(!allocate()) return TY_STATUS_NO_BUFFER;
+        TY_STATUS status = enqueue(_buffers.back().data);
+        if(status != TY_STATUS_OK) return status;
+    }
+    return TY_STATUS_OK;
+}
+
+void TYFrameBufferPool::stop()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    _running = false;
+    _queued = 0;
+    _returned.clear();
+    //only buffers still held by frames survive, they are freed on release
+    for(size_t i = 0; i < _buffers.size(); i++) {
+        if(_buffers[i].data && !_buffers[i].leased) {
+            freeFrameBuffer(_buffers[i].data, _buffers[i].capacity, _buffers[i].mapped);
+            _buffers[i].data = nullptr;
+        }
+    }
+    _returned_cond.notify_all();
+}
+
+TY_STATUS TYFrameBufferPool::enqueue(void* buffer)
+{
+    TY_STATUS status = TYEnqueueBuffer(_handle, buffer, _buffer_size);
+    if(status == TY_STATUS_OK) {
+        _queued++;
+        _enqueued++;
+    }
+    return status;
+}
+
+TY_STATUS TYFrameBufferPool::refill()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    if(!_running) return TY_STATUS_IDLE;
+
+    TY_STATUS status = TY_STATUS_OK;
+    for(size_t i = 0; i < _returned.size(); i++) {
+        TY_STATUS ret = enqueue(_returned[i]);
+        if(ret != TY_STATUS_OK) status = ret;
+    }
+    _returned.clear();
+
+    while(_queued < _config.buffer_count) {
+        if(_buffers.size() >= _config.max_buffer_count || !allocate()) {
+            _starved++;
+            if(!_exhausted) {
+                std::cout << "All " << _buffers.size() << " frame buffers are held by frames, release frames earlier!" << std::endl;
+                _exhausted = true;
+            }
+            return status;
+        }
+        TY_STATUS ret = enqueue(_buffers.back().data);
+        if(ret != TY_STATUS_OK) return ret;
+    }
+    _exhausted = false;
+    return status;
+}
+
+bool TYFrameBufferPool::waitReturned(uint32_t timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    return _returned_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+            [this] { return !_returned.empty() || !_running; }) && _running;
+}
+
+std::shared_ptr<void> TYFrameBufferPool::lease(void* buffer)
+{
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        if(_queued) _queued--;
+        for(size_t i = 0; i < _buffers.size(); i++) {
+            if(_buffers[i].data == buffer) _buffers[i].leased = true;
+        }
+    }
+    std::shared_ptr<TYFrameBufferPool> pool = shared_from_this();
+    return std::shared_ptr<void>(buffer, [pool](void* p) { pool->release(p); });
+}
+
+TY_STATUS TYFrameBufferPool::requeue(void* buffer)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    if(_queued) _queued--;
+    return enqueue(buffer);
+}
+
+void TYFrameBufferPool::release(void* buffer)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    for(size_t i = 0; i < _buffers.size(); i++) {
+        Buffer& buf = _buffers[i];
+        if(buf.data != buffer) continue;
+        buf.leased = false;
+        if(_running) {
+            _returned.push_back(buffer);
+            _returned_cond.notify_one();
+        } else {
+            freeFrameBuffer(buf.data, buf.capacity, buf.mapped);
+            buf.data = nullptr;
+        }
+    }
+}
+
+uint32_t TYFrameBufferPool::queuedCount()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    return _queued;
+}
+
+TYBufferPoolStats TYFrameBufferPool::stats()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    TYBufferPoolStats st;
+    st.enqueued = _enqueued;
+    st.starved = _starved;
+    st.dropped = _dropped;
+    st.queued = _queued;
+    for(size_t i = 0; i < _buffers.size(); i++) {
+        if(!_buffers[i].data) continue;
+        st.allocated++;
+        if(_buffers[i].leased) st.in_flight++;
+    }
+    return st;
+}
+
 TYDevice::TYDevice(const TY_DEV_HANDLE handle, const TY_DEVICE_BASE_INFO& info)
 {
     _handle = handle;
@@ -1,10 +1,19 @@
+#include <algorithm>
 #include <thread>
+#include <chrono>
 
 #include "Frame.hpp"
+#include "Jpeg.hpp"
 #include "TYImageProc.h"
 
 namespace percipio_layer {
 
+static thread_local uint64_t image_allocations = 0;
+
+uint64_t TYImage::allocations()
+{
+    return image_allocations;
+}
 
 TYImage::TYImage()
 {
@@ -17,6 +26,13 @@ TYImage::TYImage(const TY_IMAGE_DATA& image) :
     memcpy(&image_data, &image, sizeof(TY_IMAGE_DATA));
 }
 
+TYImage::TYImage(const TY_IMAGE_DATA& image, const std::shared_ptr<void>& lease) :
+    m_isOwner(false),
+    m_lease(lease)
+{
+    memcpy(&image_data, &image, sizeof(TY_IMAGE_DATA));
+}
+
 TYImage::TYImage(const TYImage& src)
 {
     image_data.timestamp = src.timestamp();
@@ -30,6 +46,7 @@ TYImage::TYImage(const TYImage& src)
     if(image_data.size) {
         m_isOwner = true;
         image_data.buffer = malloc(image_data.size);
+        image_allocations++;
         memcpy(image_data.buffer, src.buffer(), image_data.size);
     }
 }
@@ -44,9 +61,29 @@ TYImage::TYImage(int32_t width, int32_t height, TY_COMPONENT_ID compID, TYPixFmt
      if(image_data.size) {
         m_isOwner = true;
         image_data.buffer = calloc(image_data.size, 1);
+        image_allocations++;
     }
 }
 
+#ifdef OPENCV_DEPENDENCIES
+TYImage::TYImage(const cv::Mat& mat, TY_COMPONENT_ID compID, TYPixFmt format) :
+    m_isOwner(false)
+{
+    memset(&image_data, 0, sizeof(image_data));
+    //a continuous mat can be used as it is, a roi needs to be packed first
+    std::shared_ptr<cv::Mat> pixels = std::make_shared<cv::Mat>(mat.isContinuous() ? mat : mat.clone());
+    //a mat owning its pixels was allocated for this image, only wrapped user memory is free
+    if(!mat.isContinuous() || mat.u) image_allocations++;
+    image_data.size = static_cast<int32_t>(pixels->total() * pixels->elemSize());
+    image_data.width = pixels->cols;
+    image_data.height = pixels->rows;
+    image_data.componentID = compID;
+    image_data.pixelFormat = format;
+    image_data.buffer = pixels->data;
+    m_lease = pixels;
+}
+#endif
+
 bool TYImage::resize(int w, int h)
 {
 #ifdef OPENCV_DEPENDENCIES
@@ -74,12 +111,17 @@ bool TYImage::resize(int w, int h)
         cv::resize(src, dst, cv::Size(w, h), 0, 0, cv::INTER_NEAREST);
     else
         cv::resize(src, dst, cv::Size(w, h));
-    image_data.size = dst.cols * dst.rows * dst.elemSize() * dst.channels();
+    image_allocations++;
+
+    //keep the resized mat as the pixel storage instead of copying it out
+    if(m_isOwner) free(image_data.buffer);
+    m_isOwner = false;
+    std::shared_ptr<cv::Mat> pixels = std::make_shared<cv::Mat>(dst);
+    image_data.size = static_cast<int32_t>(dst.total() * dst.elemSize());
     image_data.width = dst.cols;
     image_data.height = dst.rows;
-    if(m_isOwner) free(image_data.buffer);
-    image_data.buffer = malloc(image_data.size);
-    memcpy(image_data.buffer, dst.data, image_data.size);
+    image_data.buffer = pixels->data;
+    m_lease = pixels;
     return true;
 #else
     std::cout << "not support!" << std::endl;
@@ -94,6 +136,37 @@ TYImage::~TYImage()
     }
 }
 
+std::shared_ptr<TYImage> TYImagePool::acquire(int32_t width, int32_t height, TY_COMPONENT_ID compID, TYPixFmt format, int32_t size)
+{
+    int32_t evict = -1;
+    for(size_t i = 0; i < _images.size(); i++) {
+        std::shared_ptr<TYImage>& image = _images[i];
+        //still referenced by the processer, a frame or the application
+        if(image.use_count() > 1) continue;
+        if(image->width() == width && image->height() == height && image->componentID() == compID &&
+           image->pixelFormat() == format && image->size() == size) {
+            _reuses++;
+            return image;
+        }
+        evict = static_cast<int32_t>(i);
+    }
+
+    std::shared_ptr<TYImage> image = std::make_shared<TYImage>(width, height, compID, format, size);
+    _allocations++;
+    if(_images.size() < _max_images) {
+        _images.push_back(image);
+    } else if(evict >= 0) {
+        //resolution or format changed, drop a free buffer of the old layout
+        _images[evict] = image;
+    }
+    return image;
+}
+
+bool TYImagePool::holds(const std::shared_ptr<TYImage>& image) const
+{
+    return std::find(_images.begin(), _images.end(), image) != _images.end();
+}
+
 #ifdef OPENCV_DEPENDENCIES
 ImageDisplay::ImageDisplay():
     m_key(0),
@@ -182,26 +255,38 @@ int ImageProcesser::parse(const std::shared_ptr<TYImage>& image)
         */
         case TYPixelFormatCoord3D_C16:
         {
-            _image = std::shared_ptr<TYImage>(new TYImage(*image));
+            std::shared_ptr<TYImage> dst = allocImage(image->width(), image->height(), image->componentID(), format, image->size());
+            memcpy(dst->buffer(), image->buffer(), image->size());
+            _image = dst;
             return 0;
         }
         case TYPixelFormatCoord3D_ABC16:
         {
-            std::vector<int16_t> depth_data(image->width() * image->height());
+            int32_t pixels = image->width() * image->height();
+            std::shared_ptr<TYImage> dst = allocImage(image->width(), image->height(), image->componentID(), TYPixelFormatCoord3D_C16, pixels * sizeof(int16_t));
             int16_t* src = static_cast<int16_t*>(image->buffer());
-            for (int pix = 0; pix < image->width()*image->height(); pix++) {
+            int16_t* depth_data = static_cast<int16_t*>(dst->buffer());
+            for (int pix = 0; pix < pixels; pix++) {
                 depth_data[pix] = *(src + 3*pix + 2);
             }
-
-            _image = std::shared_ptr<TYImage>(new TYImage(image->width(), image->height(), image->componentID(), TYPixelFormatCoord3D_C16, depth_data.size() * sizeof(int16_t)));
-            memcpy(_image->buffer(), depth_data.data(), image->size());
+            _image = dst;
+            return 0;
+        }
+        case TYPixelFormatJPEG:
+        {
+            //decoded from the frame buffer into a recycled image
+            int32_t width, height;
+            if(TYJpegDecoder::outputSize(image->buffer(), image->size(), 1, width, height) != TY_STATUS_OK) return -1;
+            if(!_jpeg) _jpeg = std::make_shared<TYJpegDecoder>();
+            std::shared_ptr<TYImage> dst = allocImage(width, height, image->componentID(), TYPixelFormatBGR8, width * height * 3);
+            if(_jpeg->decode(image->buffer(), image->size(), 1, dst->buffer(), 0, width, height) != TY_STATUS_OK) return -1;
+            _image = dst;
             return 0;
         }
         default:
         {
 #ifdef OPENCV_DEPENDENCIES
             cv::Mat  cvImage;
-            int32_t  image_size;
             TYPixFmt image_fmt;
             TY_COMPONENT_ID comp_id;
             comp_id = image->componentID();
@@ -210,22 +295,19 @@ int ImageProcesser::parse(const std::shared_ptr<TYImage>& image)
             {
             case CV_8U:
                 //MONO8
-                image_size = cvImage.size().area();
                 image_fmt = TYPixelFormatMono8;
                 break;
             case CV_16U:
                 //MONO16
-                image_size = cvImage.size().area() * 2;
                 image_fmt = TYPixelFormatMono16;
                 break;
             default:
                 //BGR888
-                image_size = cvImage.size().area() * 3;
                 image_fmt = TYPixelFormatBGR8;
                 break;
             }
-            _image = std::shared_ptr<TYImage>(new TYImage(cvImage.cols, cvImage.rows, comp_id, image_fmt, image_size));
-            memcpy(_image->buffer(), cvImage.data, image_size);
+            //the decoded mat becomes the image storage
+            _image = std::make_shared<TYImage>(cvImage, comp_id, image_fmt);
             return 0;
 #else
             //Without the OpenCV library, image decoding is not supported yet.
@@ -246,8 +328,7 @@ int ImageProcesser::DepthImageRender()
     cv::Mat depth = cv::Mat(_image->height(), _image->width(), CV_16U, _image->buffer());
     cv::Mat bgr = render.Compute(depth);
 
-    _image = std::shared_ptr<TYImage>(new TYImage(_image->width(), _image->height(), _image->componentID(), TYPixelFormatBGR8,  bgr.size().area() * 3));
-    memcpy(_image->buffer(), bgr.data, _image->size());
+    _image = std::make_shared<TYImage>(bgr, _image->componentID(), TYPixelFormatBGR8);
     return 0;
 #else
     return -1;
@@ -267,7 +348,7 @@ TY_STATUS ImageProcesser::doUndistortion()
     TYPixFmt        image_fmt = _image->pixelFormat();
     TY_COMPONENT_ID comp_id = _image->componentID();
 
-    std::vector<uint8_t> undistort_image(image_size);
+    std::shared_ptr<TYImage> undistort_image = allocImage(_image->width(), _image->height(), comp_id, image_fmt, image_size);
 
     TY_IMAGE_DATA src;
     src.width = _image->width();
@@ -281,7 +362,7 @@ TY_STATUS ImageProcesser::doUndistortion()
     dst.height = _image->height();
     dst.size = image_size;
     dst.pixelFormat = image_fmt;
-    dst.buffer = undistort_image.data();
+    dst.buffer = undistort_image->buffer();
 
     TY_STATUS status = TYUndistortImage(&*_calib_data, &src, NULL, &dst);
     if(status != TY_STATUS_OK) {
@@ -289,8 +370,7 @@ TY_STATUS ImageProcesser::doUndistortion()
         return status;
     }
 
-    _image = std::shared_ptr<TYImage>(new TYImage(_image->width(), _image->height(), comp_id, image_fmt, image_size));
-    memcpy(_image->buffer(), undistort_image.data(), image_size);
+    _image = undistort_image;
     return TY_STATUS_OK;
 #else
     std::cout << "Image decoding failed." << std::endl;
@@ -357,9 +437,21 @@ void ImageProcesser::clear()
 TYFrame::TYFrame(const TY_FRAME_DATA& frame)
 {
     bufferSize = frame.bufferSize;
-    userBuffer.resize(bufferSize);
-    memcpy(userBuffer.data(), frame.userBuffer, bufferSize);
+    std::shared_ptr<std::vector<uint8_t>> copy = std::make_shared<std::vector<uint8_t>>(bufferSize);
+    memcpy(copy->data(), frame.userBuffer, bufferSize);
+    userBuffer = copy;
+    attachImages(frame, copy->data());
+}
+
+TYFrame::TYFrame(const TY_FRAME_DATA& frame, const std::shared_ptr<void>& lease)
+{
+    bufferSize = frame.bufferSize;
+    userBuffer = lease;
+    attachImages(frame, frame.userBuffer);
+}
 
+void TYFrame::attachImages(const TY_FRAME_DATA& frame, void* buffer)
+{
 #define TY_IMAGE_MOVE(src, dst, from, to) do { \
     (to) = (from); \
     (to.buffer) = reinterpret_cast<void*>((std::intptr_t(dst)) + (std::intptr_t(from.buffer) - std::intptr_t(src)));\
@@ -368,26 +460,30 @@ TYFrame::TYFrame(const TY_FRAME_DATA& frame)
     for (int i = 0; i < frame.validCount; i++) {
         TY_IMAGE_DATA img;
         if (frame.image[i].status != TY_STATUS_OK) continue;
+        if (_timestamp == 0 || frame.image[i].timestamp < _timestamp) {
+            _timestamp = frame.image[i].timestamp;
+            _image_index = frame.image[i].imageIndex;
+        }
     
         // get depth image
         if (frame.image[i].componentID == TY_COMPONENT_DEPTH_CAM) {  
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
-            _images[TY_COMPONENT_DEPTH_CAM] = std::shared_ptr<TYImage>(new TYImage(img));
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
+            _images[TY_COMPONENT_DEPTH_CAM] = std::shared_ptr<TYImage>(new TYImage(img, userBuffer));
         }
         // get left ir image
         if (frame.image[i].componentID == TY_COMPONENT_IR_CAM_LEFT) {
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
-            _images[TY_COMPONENT_IR_CAM_LEFT] = std::shared_ptr<TYImage>(new TYImage(img));
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
+            _images[TY_COMPONENT_IR_CAM_LEFT] = std::shared_ptr<TYImage>(new TYImage(img, userBuffer));
         }
         // get right ir image
         if (frame.image[i].componentID == TY_COMPONENT_IR_CAM_RIGHT) {
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
-            _images[TY_COMPONENT_IR_CAM_RIGHT] = std::shared_ptr<TYImage>(new TYImage(img));
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
+            _images[TY_COMPONENT_IR_CAM_RIGHT] = std::shared_ptr<TYImage>(new TYImage(img, userBuffer));
         }
         // get color image
         if (frame.image[i].componentID == TY_COMPONENT_RGB_CAM) {
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
-            _images[TY_COMPONENT_RGB_CAM] = std::shared_ptr<TYImage>(new TYImage(img));
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
+            _images[TY_COMPONENT_RGB_CAM] = std::shared_ptr<TYImage>(new TYImage(img, userBuffer));
         }
     }
 }
@@ -398,9 +494,9 @@ TYFrame::~TYFrame()
 }
 
 
-TYFrameParser::TYFrameParser(uint32_t max_queue_size)
+TYFrameParser::TYFrameParser(uint32_t max_queue_size) :
+    images(max_queue_size)
 {
-    _max_queue_size = max_queue_size;
     isRuning = true;
 
     setImageProcesser(TY_COMPONENT_DEPTH_CAM, std::shared_ptr<ImageProcesser>(new ImageProcesser("depth")));
@@ -414,6 +510,7 @@ TYFrameParser::TYFrameParser(uint32_t max_queue_size)
 TYFrameParser::~TYFrameParser()
 {
     isRuning = false;
+    images.close();
     processThread_.join();
 }
 
@@ -423,65 +520,120 @@ int TYFrameParser::setImageProcesser(TY_COMPONENT_ID id, std::shared_ptr<ImagePr
     return 0;
 }
 
-int TYFrameParser::doProcess(const std::shared_ptr<TYFrame>& img)
-{           
-    auto depth = img->depthImage();
-    auto color = img->colorImage();
-    auto left_ir = img->leftIRImage();
-    auto right_ir = img->rightIRImage();
+static inline double elapsedMs(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-    if (left_ir) {
-        stream[TY_COMPONENT_IR_CAM_LEFT]->parse(left_ir);
-    }
+void TYFrameParser::setParallel(bool enable, uint32_t threads)
+{
+    std::shared_ptr<TYWorkerPool> pool;
+    if(enable) pool = std::make_shared<TYWorkerPool>(threads);
+    std::atomic_store(&workers, pool);
+}
 
-    if (right_ir) {
-        stream[TY_COMPONENT_IR_CAM_RIGHT]->parse(right_ir);
+void TYFrameParser::runTasks(const std::vector<std::function<void()>>& tasks)
+{
+    std::shared_ptr<TYWorkerPool> pool = std::atomic_load(&workers);
+    if(pool && tasks.size() > 1) {
+        pool->run(tasks);
+    } else {
+        for(auto& task : tasks) task();
     }
+}
 
-    if (color) {
-        stream[TY_COMPONENT_RGB_CAM]->parse(color);
+void TYFrameParser::recordStage(const std::string& stage, double ms, uint64_t allocations)
+{
+    std::unique_lock<std::mutex> lock(_timing_lock);
+    TYStageTiming& t = timings[stage];
+    t.count++;
+    t.last_ms = ms;
+    t.total_ms += ms;
+    t.max_ms = std::max(t.max_ms, ms);
+    if(stage == "frame") {
+        allocations = _frame_allocations;
+        _frame_allocations = 0;
+    } else {
+        _frame_allocations += allocations;
     }
+    t.last_allocations = allocations;
+    t.allocations += allocations;
+}
+
+std::map<std::string, TYStageTiming> TYFrameParser::stageTimings()
+{
+    std::unique_lock<std::mutex> lock(_timing_lock);
+    return timings;
+}
 
-    if (depth) {
-        stream[TY_COMPONENT_DEPTH_CAM]->parse(depth);
+int TYFrameParser::processComponent(TY_COMPONENT_ID id, const std::shared_ptr<TYImage>& image)
+{
+    auto proc = stream.find(id);
+    if(proc == stream.end() || !proc->second) return -1;
+
+    uint64_t allocs = TYImage::allocations();
+    auto start = std::chrono::steady_clock::now();
+    int ret = proc->second->parse(image);
+    recordStage(proc->second->win() + ".parse", elapsedMs(start), TYImage::allocations() - allocs);
+    return ret;
+}
+
+int TYFrameParser::doProcess(const std::shared_ptr<TYFrame>& img)
+{           
+    std::vector<std::pair<TY_COMPONENT_ID, std::shared_ptr<TYImage>>> images;
+    images.push_back(std::make_pair(TY_COMPONENT_IR_CAM_LEFT, img->leftIRImage()));
+    images.push_back(std::make_pair(TY_COMPONENT_IR_CAM_RIGHT, img->rightIRImage()));
+    images.push_back(std::make_pair(TY_COMPONENT_RGB_CAM, img->colorImage()));
+    images.push_back(std::make_pair(TY_COMPONENT_DEPTH_CAM, img->depthImage()));
+
+    std::vector<std::function<void()>> tasks;
+    for(auto& iter : images) {
+        if(!iter.second) continue;
+        TY_COMPONENT_ID id = iter.first;
+        std::shared_ptr<TYImage> image = iter.second;
+        tasks.push_back([this, id, image]() { processComponent(id, image); });
     }
+    runTasks(tasks);
     return 0;
 }
 
 void TYFrameParser::display()
 {
-    int ret = 0;
     while(isRuning) {
-        if(images.size()) {
-            std::unique_lock<std::mutex> lock(_queue_lock);
-            std::shared_ptr<TYFrame> img = images.front();
-
-            if(img) {
-                images.pop();
-                doProcess(img);
-                for(auto& iter : stream) {
-                    ret = iter.second->flush();
-                    if(ret > 0) {
-                        if(func_keyboard_event) func_keyboard_event(ret, user_data);
-                    }
+        std::shared_ptr<TYFrame> img;
+        if(images.pop(img, 100) && img) {
+            auto start = std::chrono::steady_clock::now();
+            doProcess(img);
+
+            std::vector<std::shared_ptr<ImageProcesser>> procs;
+            for(auto& iter : stream) {
+                if(iter.second) procs.push_back(iter.second);
+            }
+            std::vector<int> keys(procs.size(), 0);
+            std::vector<std::function<void()>> tasks;
+            for(size_t i = 0; i < procs.size(); i++) {
+                tasks.push_back([this, &procs, &keys, i]() {
+                    uint64_t allocs = TYImage::allocations();
+                    auto flush_start = std::chrono::steady_clock::now();
+                    keys[i] = procs[i]->flush();
+                    recordStage(procs[i]->win() + ".flush", elapsedMs(flush_start), TYImage::allocations() - allocs);
+                });
+            }
+            runTasks(tasks);
+            recordStage("frame", elapsedMs(start));
+
+            for(size_t i = 0; i < keys.size(); i++) {
+                if(keys[i] > 0) {
+                    if(func_keyboard_event) func_keyboard_event(keys[i], user_data);
                 }
             }
         }
-        MSLEEP(1);
     }
 }
 
-inline void TYFrameParser::ImageQueueSizeCheck()
-{
-    while(images.size() >= _max_queue_size)
-        images.pop();
-}
-
 void TYFrameParser::update(const std::shared_ptr<TYFrame>& frame)
 {
-    std::unique_lock<std::mutex> lock(_queue_lock);
     if(frame) {
-        ImageQueueSizeCheck();
         images.push(frame);
 #ifndef OPENCV_DEPENDENCIES        
         auto depth = frame->depthImage();
@@ -0,0 +1,399 @@
+#include <string.h>
+#include <algorithm>
+
+#include "Jpeg.hpp"
+
+#ifdef JPEG_DEPENDENCIES
+#include <stdio.h>
+#include <setjmp.h>
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+namespace percipio_layer {
+
+static bool jpegScaleValid(int scale)
+{
+    return scale == 1 || scale == 2 || scale == 4 || scale == 8;
+}
+
+//image size from the first SOF marker
+static bool jpegFrameSize(const uint8_t* p, size_t size, int32_t& width, int32_t& height)
+{
+    if(size < 4 || p[0] != 0xFF || p[1] != 0xD8) return false;
+    size_t i = 2;
+    while(i + 4 <= size) {
+        if(p[i] != 0xFF) return false;
+        uint8_t marker = p[i + 1];
+        if(marker == 0xFF) {
+            //fill byte
+            i++;
+            continue;
+        }
+        if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            //no length
+            i += 2;
+            continue;
+        }
+        //SOF0..SOF15, DHT, JPG and DAC are in the same range
+        if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if(i + 9 > size) return false;
+            height = (p[i + 5] << 8) | p[i + 6];
+            width = (p[i + 7] << 8) | p[i + 8];
+            return width > 0 && height > 0;
+        }
+        //image data or the end before any frame header
+        if(marker == 0xDA || marker == 0xD9) return false;
+        i += 2 + ((p[i + 2] << 8) | p[i + 3]);
+    }
+    return false;
+}
+
+#ifdef JPEG_DEPENDENCIES
+//the default error_exit of libjpeg calls exit()
+struct TYJpegError {
+    jpeg_error_mgr mgr;
+    jmp_buf        jump;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+    TYJpegError* err = reinterpret_cast<TYJpegError*>(cinfo->err);
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    std::cout << "libjpeg: " << message << std::endl;
+    longjmp(err->jump, 1);
+}
+
+//warnings about corrupt data, the image still decodes
+static void jpegOutputMessage(j_common_ptr) {}
+
+static void jpegInitSource(j_decompress_ptr) {}
+static void jpegTermSource(j_decompress_ptr) {}
+
+//the whole image is in the buffer, running out of it ends the image
+static boolean jpegFillInput(j_decompress_ptr cinfo)
+{
+    static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+}
+
+static void jpegSkipInput(j_decompress_ptr cinfo, long bytes)
+{
+    if(bytes <= 0) return;
+    if(static_cast<size_t>(bytes) > cinfo->src->bytes_in_buffer) {
+        jpegFillInput(cinfo);
+        return;
+    }
+    cinfo->src->next_input_byte += bytes;
+    cinfo->src->bytes_in_buffer -= bytes;
+}
+
+//appends to a vector, doubling it whenever libjpeg fills it up
+struct TYJpegDest {
+    jpeg_destination_mgr  mgr;
+    std::vector<uint8_t>* out;
+};
+
+static void jpegInitDest(j_compress_ptr cinfo)
+{
+    TYJpegDest* dest = reinterpret_cast<TYJpegDest*>(cinfo->dest);
+    dest->out->resize(64 * 1024);
+    dest->mgr.next_output_byte = &(*dest->out)[0];
+    dest->mgr.free_in_buffer = dest->out->size();
+}
+
+static boolean jpegEmptyDest(j_compress_ptr cinfo)
+{
+    TYJpegDest* dest = reinterpret_cast<TYJpegDest*>(cinfo->dest);
+    size_t used = dest->out->size();
+    dest->out->resize(used * 2);
+    dest->mgr.next_output_byte = &(*dest->out)[used];
+    dest->mgr.free_in_buffer = dest->out->size() - used;
+    return TRUE;
+}
+
+static void jpegTermDest(j_compress_ptr cinfo)
+{
+    TYJpegDest* dest = reinterpret_cast<TYJpegDest*>(cinfo->dest);
+    dest->out->resize(dest->out->size() - dest->mgr.free_in_buffer);
+}
+
+static void swapRedBlue(uint8_t* row, JDIMENSION width)
+{
+    for(JDIMENSION x = 0; x < width; x++) std::swap(row[3 * x], row[3 * x + 2]);
+}
+
+struct TYJpegDecoder::Impl {
+    jpeg_decompress_struct cinfo;
+    TYJpegError            err;
+    jpeg_source_mgr        src;
+    bool                   created;
+
+    Impl() : created(false)
+    {
+        memset(&cinfo, 0, sizeof(cinfo));
+        cinfo.err = jpeg_std_error(&err.mgr);
+        err.mgr.error_exit = jpegErrorExit;
+        err.mgr.output_message = jpegOutputMessage;
+        if(setjmp(err.jump)) return;
+        jpeg_create_decompress(&cinfo);
+        src.init_source = jpegInitSource;
+        src.fill_input_buffer = jpegFillInput;
+        src.skip_input_data = jpegSkipInput;
+        src.resync_to_restart = jpeg_resync_to_restart;
+        src.term_source = jpegTermSource;
+        created = true;
+    }
+
+    ~Impl()
+    {
+        if(created) jpeg_destroy_decompress(&cinfo);
+    }
+
+    //nothing with a destructor in here, an error longjmps back to the setjmp
+    TY_STATUS decode(const uint8_t* data, size_t size, int scale, uint8_t* bgr, size_t step, int32_t width, int32_t height)
+    {
+        if(setjmp(err.jump)) {
+            jpeg_abort_decompress(&cinfo);
+            return TY_STATUS_ERROR;
+        }
+        src.next_input_byte = data;
+        src.bytes_in_buffer = size;
+        cinfo.src = &src;
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = scale;
+#ifdef JCS_EXTENSIONS
+        //libjpeg-turbo writes BGR itself
+        cinfo.out_color_space = JCS_EXT_BGR;
+#else
+        cinfo.out_color_space = JCS_RGB;
+#endif
+        jpeg_calc_output_dimensions(&cinfo);
+        if(cinfo.output_width != static_cast<JDIMENSION>(width) || cinfo.output_height != static_cast<JDIMENSION>(height)) {
+            jpeg_abort_decompress(&cinfo);
+            return TY_STATUS_WRONG_SIZE;
+        }
+
+        jpeg_start_decompress(&cinfo);
+        //scanlines go straight into the output rows
+        JSAMPROW rows[16];
+        int batch = std::min(std::max(cinfo.rec_outbuf_height, 1), 16);
+        while(cinfo.output_scanline < cinfo.output_height) {
+            JDIMENSION first = cinfo.output_scanline;
+            int count = static_cast<int>(std::min<JDIMENSION>(batch, cinfo.output_height - first));
+            for(int k = 0; k < count; k++) rows[k] = bgr + (first + k) * step;
+            JDIMENSION lines = jpeg_read_scanlines(&cinfo, rows, count);
+#ifndef JCS_EXTENSIONS
+            for(JDIMENSION k = 0; k < lines; k++) swapRedBlue(rows[k], cinfo.output_width);
+#else
+            (void)lines;
+#endif
+        }
+        jpeg_finish_decompress(&cinfo);
+        return TY_STATUS_OK;
+    }
+};
+
+//nothing with a destructor in here either
+static bool jpegCompress(const uint8_t* pixels, size_t step, int32_t width, int32_t height, int components,
+                         J_COLOR_SPACE space, bool swap, int quality, std::vector<uint8_t>& out, uint8_t* row)
+{
+    jpeg_compress_struct cinfo;
+    TYJpegError err;
+    TYJpegDest dest;
+    memset(&cinfo, 0, sizeof(cinfo));
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = jpegErrorExit;
+    err.mgr.output_message = jpegOutputMessage;
+    if(setjmp(err.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    dest.mgr.init_destination = jpegInitDest;
+    dest.mgr.empty_output_buffer = jpegEmptyDest;
+    dest.mgr.term_destination = jpegTermDest;
+    dest.out = &out;
+    cinfo.dest = &dest.mgr;
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = components;
+    cinfo.in_color_space = space;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while(cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW line = const_cast<uint8_t*>(pixels + cinfo.next_scanline * step);
+        if(swap) {
+            memcpy(row, line, width * 3);
+            swapRedBlue(row, width);
+            line = row;
+        }
+        jpeg_write_scanlines(&cinfo, &line, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
+#else
+struct TYJpegDecoder::Impl {};
+#endif
+
+TYJpegDecoder::TYJpegDecoder() : _impl(new Impl())
+{
+}
+
+TYJpegDecoder::~TYJpegDecoder()
+{
+}
+
+bool TYJpegDecoder::available()
+{
+#if defined(JPEG_DEPENDENCIES) || defined(OPENCV_DEPENDENCIES)
+    return true;
+#else
+    return false;
+#endif
+}
+
+TY_STATUS TYJpegDecoder::outputSize(const void* data, size_t size, int scale, int32_t& width, int32_t& height)
+{
+    if(!data) return TY_STATUS_NULL_POINTER;
+    if(!jpegScaleValid(scale)) return TY_STATUS_INVALID_PARAMETER;
+    int32_t w, h;
+    if(!jpegFrameSize(static_cast<const uint8_t*>(data), size, w, h)) return TY_STATUS_ERROR;
+    //what libjpeg computes for scale_num / scale_denom
+    width = (w + scale - 1) / scale;
+    height = (h + scale - 1) / scale;
+    return TY_STATUS_OK;
+}
+
+TY_STATUS TYJpegDecoder::decode(const void* data, size_t size, int scale, void* bgr, size_t step, int32_t width, int32_t height)
+{
+    if(!data || !bgr) return TY_STATUS_NULL_POINTER;
+    if(!jpegScaleValid(scale)) return TY_STATUS_INVALID_PARAMETER;
+    if(step == 0) step = static_cast<size_t>(width) * 3;
+#ifdef JPEG_DEPENDENCIES
+    if(!_impl->created) return TY_STATUS_OUT_OF_MEMORY;
+    return _impl->decode(static_cast<const uint8_t*>(data), size, scale, static_cast<uint8_t*>(bgr), step, width, height);
+#elif defined(OPENCV_DEPENDENCIES)
+    int32_t w, h;
+    TY_STATUS status = outputSize(data, size, scale, w, h);
+    if(status != TY_STATUS_OK) return status;
+    if(w != width || h != height) return TY_STATUS_WRONG_SIZE;
+    cv::Mat jpeg(1, static_cast<int>(size), CV_8U, const_cast<void*>(data));
+    cv::Mat dst(height, width, CV_8UC3, bgr, step);
+    if(scale == 1) {
+        //matching size, imdecode writes into dst
+        cv::imdecode(jpeg, cv::IMREAD_COLOR, &dst);
+        if(dst.data != bgr) return TY_STATUS_ERROR;
+        return TY_STATUS_OK;
+    }
+    cv::Mat full = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+    if(full.empty()) return TY_STATUS_ERROR;
+    cv::resize(full, dst, dst.size(), 0, 0, cv::INTER_AREA);
+    return TY_STATUS_OK;
+#else
+    //Without libjpeg or the OpenCV library, jpeg decoding is not supported.
+    return TY_STATUS_NOT_IMPLEMENTED;
+#endif
+}
+
+std::shared_ptr<TYImage> TYJpegDecoder::decode(const std::shared_ptr<TYImage>& jpeg, int scale)
+{
+    if(!jpeg || jpeg->pixelFormat() != TYPixelFormatJPEG) return std::shared_ptr<TYImage>();
+    int32_t width, height;
+    if(outputSize(jpeg->buffer(), jpeg->size(), scale, width, height) != TY_STATUS_OK) return std::shared_ptr<TYImage>();
+    std::shared_ptr<TYImage> bgr(new TYImage(width, height, jpeg->componentID(), TYPixelFormatBGR8, width * height * 3));
+    if(decode(jpeg->buffer(), jpeg->size(), scale, bgr->buffer(), 0, width, height) != TY_STATUS_OK)
+        return std::shared_ptr<TYImage>();
+    return bgr;
+}
+
+TYJpegDecodePool::TYJpegDecodePool(uint32_t threads, int scale) :
+    _scale(scale),
+    _workers(threads)
+{
+}
+
+std::shared_ptr<TYImage> TYJpegDecodePool::decode(const std::shared_ptr<TYImage>& jpeg)
+{
+    std::unique_ptr<TYJpegDecoder> decoder;
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        if(!_idle.empty()) {
+            decoder = std::move(_idle.back());
+            _idle.pop_back();
+        }
+    }
+    if(!decoder) decoder.reset(new TYJpegDecoder());
+    std::shared_ptr<TYImage> bgr = decoder->decode(jpeg, _scale);
+    std::unique_lock<std::mutex> lock(_lock);
+    _idle.push_back(std::move(decoder));
+    return bgr;
+}
+
+std::vector<std::shared_ptr<TYImage>> TYJpegDecodePool::decodeAll(const std::vector<std::shared_ptr<TYImage>>& jpegs)
+{
+    std::vector<std::shared_ptr<TYImage>> images(jpegs.size());
+    std::vector<std::function<void()>> tasks;
+    for(size_t i = 0; i < jpegs.size(); i++) {
+        tasks.push_back([this, &jpegs, &images, i]() { images[i] = decode(jpegs[i]); });
+    }
+    _workers.run(tasks);
+    return images;
+}
+
+void TYJpegDecodePool::submit(const std::shared_ptr<TYImage>& jpeg, std::function<void(const std::shared_ptr<TYImage>&)> done)
+{
+    _workers.post([this, jpeg, done]() { done(decode(jpeg)); });
+}
+
+std::shared_ptr<TYImage> TYJpegEncode(const std::shared_ptr<TYImage>& image, int quality)
+{
+    if(!image) return std::shared_ptr<TYImage>();
+#ifdef JPEG_DEPENDENCIES
+    int components = 3;
+    bool swap = false;
+    J_COLOR_SPACE space = JCS_RGB;
+    switch(image->pixelFormat()) {
+        case TYPixelFormatMono8:
+            components = 1;
+            space = JCS_GRAYSCALE;
+            break;
+        case TYPixelFormatRGB8:
+            break;
+        case TYPixelFormatBGR8:
+#ifdef JCS_EXTENSIONS
+            space = JCS_EXT_BGR;
+#else
+            swap = true;
+#endif
+            break;
+        default:
+            return std::shared_ptr<TYImage>();
+    }
+
+    std::vector<uint8_t> out, row(swap ? image->width() * 3 : 0);
+    if(!jpegCompress(static_cast<const uint8_t*>(image->buffer()), static_cast<size_t>(image->width()) * components,
+                     image->width(), image->height(), components, space, swap, std::min(std::max(quality, 1), 100),
+                     out, row.empty() ? NULL : &row[0]))
+        return std::shared_ptr<TYImage>();
+    std::shared_ptr<TYImage> jpeg(new TYImage(image->width(), image->height(), image->componentID(),
+                                              TYPixelFormatJPEG, static_cast<int32_t>(out.size())));
+    memcpy(jpeg->buffer(), &out[0], out.size());
+    return jpeg;
+#else
+    (void)quality;
+    std::cout << "Built without libjpeg, jpeg encoding is not supported!" << std::endl;
+    return std::shared_ptr<TYImage>();
+#endif
+}
+
+}
@@ -0,0 +1,467 @@
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include "Pipeline.hpp"
+#include "RawDemosaic.hpp"
+#include "YuvConvert.hpp"
+
+namespace percipio_layer {
+
+static const char* formatName(TYPixFmt format)
+{
+    switch(format) {
+        case TYPixelFormatMono8:        return "Mono8";
+        case TYPixelFormatMono16:       return "Mono16";
+        case TYPixelFormatRGB8:         return "RGB8";
+        case TYPixelFormatBGR8:         return "BGR8";
+        case TYPixelFormatCoord3D_C16:  return "Coord3D_C16";
+        case TYPixelFormatCoord3D_ABC16:return "Coord3D_ABC16";
+        default:                        return "other";
+    }
+}
+
+static std::shared_ptr<TYImage> frameImage(const std::shared_ptr<TYFrame>& frame, TY_COMPONENT_ID comp)
+{
+    switch(comp) {
+        case TY_COMPONENT_DEPTH_CAM:    return frame->depthImage();
+        case TY_COMPONENT_RGB_CAM:      return frame->colorImage();
+        case TY_COMPONENT_IR_CAM_LEFT:  return frame->leftIRImage();
+        case TY_COMPONENT_IR_CAM_RIGHT: return frame->rightIRImage();
+        default:                        return std::shared_ptr<TYImage>();
+    }
+}
+
+bool TYPipelineNode::accepts(TYPixFmt format) const
+{
+    std::vector<TYPixFmt> formats = inputFormats();
+    return formats.empty() || std::find(formats.begin(), formats.end(), format) != formats.end();
+}
+
+static bool checkInput(const TYPipelineNode& node, TYPixFmt format)
+{
+    if(node.accepts(format)) return true;
+    std::cout << "Pipeline node " << node.name() << " does not take " << formatName(format) << " images." << std::endl;
+    return false;
+}
+
+TYPipeline& TYPipeline::add(TY_COMPONENT_ID comp, const std::shared_ptr<TYPipelineNode>& node)
+{
+    for(auto& chain : _chains) {
+        if(chain.comp == comp) {
+            chain.nodes.push_back(node);
+            return *this;
+        }
+    }
+    Chain chain;
+    chain.comp = comp;
+    chain.nodes.push_back(node);
+    _chains.push_back(chain);
+    return *this;
+}
+
+bool TYPipeline::validate(const std::map<TY_COMPONENT_ID, TYPixFmt>& inputs) const
+{
+    bool ok = true;
+    for(auto& chain : _chains) {
+        auto input = inputs.find(chain.comp);
+        if(input == inputs.end()) continue;
+        TYPixFmt format = input->second;
+        for(auto& node : chain.nodes) {
+            if(!checkInput(*node, format)) {
+                ok = false;
+                break;
+            }
+            format = node->outputFormat(format);
+        }
+    }
+    return ok;
+}
+
+int TYPipeline::runChain(Chain& chain, std::shared_ptr<TYImage> image)
+{
+    //node whose pool the current image came from
+    TYPipelineNode* producer = nullptr;
+    for(auto& node : chain.nodes) {
+        TYPixFmt format = image->pixelFormat();
+        if(!checkInput(*node, format)) return -1;
+        //nobody else sees the image, let the node overwrite it, the pool holding it for later frames does not count
+        long users = image.use_count() - (producer && producer->_pool.holds(image) ? 1 : 0);
+        bool writable = node->inPlace(format) && users == 1 && image->isOwner();
+
+        uint64_t allocations = TYImage::allocations();
+        TYImage* input = image.get();
+        auto start = std::chrono::steady_clock::now();
+        int ret = node->process(image, writable, *this);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if(image.get() != input) producer = node.get();
+
+        TYStageTiming& t = node->_timing;
+        t.count++;
+        t.last_ms = ms;
+        t.total_ms += ms;
+        t.max_ms = std::max(t.max_ms, ms);
+        t.last_allocations = TYImage::allocations() - allocations;
+        t.allocations += t.last_allocations;
+        if(ret < 0 || !image) return ret < 0 ? ret : -1;
+    }
+    _results[chain.comp] = image;
+    return 0;
+}
+
+int TYPipeline::run(TY_COMPONENT_ID comp, const std::shared_ptr<TYImage>& image)
+{
+    if(!image) return -1;
+    _results[comp] = image;
+    for(auto& chain : _chains) {
+        if(chain.comp == comp) return runChain(chain, image);
+    }
+    return 0;
+}
+
+int TYPipeline::run(const std::shared_ptr<TYFrame>& frame)
+{
+    _results.clear();
+    TY_COMPONENT_ID comps[] = { TY_COMPONENT_DEPTH_CAM, TY_COMPONENT_RGB_CAM, TY_COMPONENT_IR_CAM_LEFT, TY_COMPONENT_IR_CAM_RIGHT };
+    for(auto comp : comps) {
+        std::shared_ptr<TYImage> image = frameImage(frame, comp);
+        if(image) _results[comp] = image;
+    }
+
+    //run chains once the chains they depend on are done
+    std::vector<bool> done(_chains.size(), false);
+    int ret = 0;
+    for(size_t pass = 0; pass < _chains.size(); pass++) {
+        for(size_t i = 0; i < _chains.size(); i++) {
+            if(done[i]) continue;
+            bool ready = true;
+            for(auto& node : _chains[i].nodes) {
+                TY_COMPONENT_ID dep = node->dependency();
+                if(!dep || dep == _chains[i].comp) continue;
+                for(size_t j = 0; j < _chains.size(); j++) {
+                    if(_chains[j].comp == dep && !done[j]) ready = false;
+                }
+            }
+            if(!ready) continue;
+
+            done[i] = true;
+            auto input = _results.find(_chains[i].comp);
+            if(input == _results.end()) continue;
+            int r = runChain(_chains[i], input->second);
+            if(r < 0) ret = r;
+        }
+    }
+    for(size_t i = 0; i < done.size(); i++) {
+        if(!done[i]) {
+            std::cout << "Pipeline chains depend on each other, chain skipped." << std::endl;
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+std::shared_ptr<TYImage> TYPipeline::result(TY_COMPONENT_ID comp) const
+{
+    auto iter = _results.find(comp);
+    if(iter == _results.end()) return std::shared_ptr<TYImage>();
+    return iter->second;
+}
+
+void TYPipeline::report(std::ostream& os) const
+{
+    for(auto& chain : _chains) {
+        for(auto& node : chain.nodes) {
+            const TYStageTiming& t = node->timing();
+            os << "comp 0x" << std::hex << chain.comp << std::dec << " " << node->name()
+               << ": frames " << t.count << ", avg " << t.average_ms() << " ms, max " << t.max_ms << " ms"
+               << ", allocations " << node->allocations() << " (last frame " << node->lastAllocations() << ")" << std::endl;
+        }
+    }
+}
+
+TYPixFmt TYDecodeNode::outputFormat(TYPixFmt input) const
+{
+    switch(input) {
+        case TYPixelFormatMono8:
+            return TYPixelFormatMono8;
+        case TYPixelFormatMono10:
+        case TYPixelFormatMono12:
+        case TYPixelFormatMono14:
+        case TYPixelFormatMono16:
+        case TYPixelFormatPacketMono10:
+        case TYPixelFormatPacketMono12:
+        case TYPixelFormatTofIRFourGroupMono16:
+            return TYPixelFormatMono16;
+        case TYPixelFormatCoord3D_C16:
+        case TYPixelFormatCoord3D_ABC16:
+            return TYPixelFormatCoord3D_C16;
+        default:
+            return TYPixelFormatBGR8;
+    }
+}
+
+int TYDecodeNode::process(std::shared_ptr<TYImage>& image, bool, const TYPipeline&)
+{
+    switch(image->pixelFormat()) {
+        case TYPixelFormatMono8:
+        case TYPixelFormatMono16:
+        case TYPixelFormatBGR8:
+        case TYPixelFormatCoord3D_C16:
+            return 0;
+        case TYPixelFormatCoord3D_ABC16:
+        {
+            int32_t pixels = image->width() * image->height();
+            std::shared_ptr<TYImage> depth = allocImage(image->width(), image->height(), image->componentID(),
+                                                        TYPixelFormatCoord3D_C16, pixels * sizeof(int16_t));
+            const int16_t* src = static_cast<const int16_t*>(image->buffer());
+            int16_t* dst = static_cast<int16_t*>(depth->buffer());
+            for(int32_t pix = 0; pix < pixels; pix++) {
+                dst[pix] = src[3 * pix + 2];
+            }
+            image = depth;
+            return 0;
+        }
+        case TYPixelFormatRGB8:
+        {
+            std::shared_ptr<TYImage> bgr = allocImage(image->width(), image->height(), image->componentID(),
+                                                      TYPixelFormatBGR8, image->size());
+            const uint8_t* src = static_cast<const uint8_t*>(image->buffer());
+            uint8_t* dst = static_cast<uint8_t*>(bgr->buffer());
+            for(int32_t pix = 0; pix < image->width() * image->height(); pix++) {
+                dst[3 * pix] = src[3 * pix + 2];
+                dst[3 * pix + 1] = src[3 * pix + 1];
+                dst[3 * pix + 2] = src[3 * pix];
+            }
+            image = bgr;
+            return 0;
+        }
+        case TYPixelFormatJPEG:
+        {
+            //straight from the frame buffer, reduced size IDCT when scaled
+            int32_t width, height;
+            if(TYJpegDecoder::outputSize(image->buffer(), image->size(), _jpeg_scale, width, height) != TY_STATUS_OK)
+                return -1;
+            std::shared_ptr<TYImage> bgr = allocImage(width, height, image->componentID(), TYPixelFormatBGR8, width * height * 3);
+            if(_jpeg.decode(image->buffer(), image->size(), _jpeg_scale, bgr->buffer(), 0, width, height) != TY_STATUS_OK)
+                return -1;
+            image = bgr;
+            return 0;
+        }
+        default:
+        {
+            //YUV and packed raw are converted straight into the output image
+            int layout = TYYuvLayoutOf(image->pixelFormat());
+            if(layout >= 0) {
+                std::shared_ptr<TYImage> bgr = allocImage(image->width(), image->height(), image->componentID(),
+                                                          TYPixelFormatBGR8, image->width() * image->height() * 3);
+                if(TYYuvToBgr(layout, image->buffer(), image->width(), image->height(), 0, 0, 0, 0,
+                              bgr->buffer(), image->width(), image->height(), 0,
+                              TY_YUV_SCALE_BILINEAR, false, _workers.get()) < 0)
+                    return -1;
+                image = bgr;
+                return 0;
+            }
+            int packing = TYRawPackingOf(image->pixelFormat());
+            int pattern = TYBayerPatternOf(image->pixelFormat());
+            if(packing >= 0 && pattern >= 0) {
+                std::shared_ptr<TYImage> bgr = allocImage(image->width(), image->height(), image->componentID(),
+                                                          TYPixelFormatBGR8, image->width() * image->height() * 3);
+                if(TYDemosaicRaw(packing, pattern, image->buffer(), image->width(), image->height(),
+                                 bgr->buffer(), 0, 8, _workers.get()) < 0)
+                    return -1;
+                image = bgr;
+                return 0;
+            }
+            //packed mono keeps its full range as Mono16
+            if(packing >= 0) {
+                std::shared_ptr<TYImage> mono = allocImage(image->width(), image->height(), image->componentID(),
+                                                           TYPixelFormatMono16, image->width() * image->height() * 2);
+                if(TYUnpackRaw16(packing, image->buffer(), static_cast<uint16_t*>(mono->buffer()),
+                                 image->width(), image->height()) < 0)
+                    return -1;
+                image = mono;
+                return 0;
+            }
+#ifdef OPENCV_DEPENDENCIES
+            cv::Mat cvImage;
+            parseImage(image->image(), &cvImage);
+            if(cvImage.empty()) return -1;
+            TYPixFmt format = TYPixelFormatBGR8;
+            if(cvImage.type() == CV_8U) format = TYPixelFormatMono8;
+            else if(cvImage.type() == CV_16U) format = TYPixelFormatMono16;
+            //the decoded mat becomes the image storage
+            image = std::make_shared<TYImage>(cvImage, image->componentID(), format);
+            return 0;
+#else
+            //Without the OpenCV library, image decoding is not supported yet.
+            return -1;
+#endif
+        }
+    }
+}
+
+std::vector<TYPixFmt> TYUndistortNode::inputFormats() const
+{
+    return { TYPixelFormatMono8, TYPixelFormatMono16, TYPixelFormatRGB8, TYPixelFormatBGR8, TYPixelFormatCoord3D_C16 };
+}
+
+int TYUndistortNode::process(std::shared_ptr<TYImage>& image, bool, const TYPipeline&)
+{
+    std::shared_ptr<TYImage> dst = allocImage(image->width(), image->height(), image->componentID(),
+                                              image->pixelFormat(), image->size());
+    TY_IMAGE_DATA src_data = *image->image();
+    TY_IMAGE_DATA dst_data = *dst->image();
+    TY_STATUS status = TYUndistortImage(&_calib, &src_data, NULL, &dst_data);
+    if(status != TY_STATUS_OK) {
+        std::cout << "Do image undistortion failed!" << std::endl;
+        return -1;
+    }
+    image = dst;
+    return 0;
+}
+
+TYSpeckleFilterNode::TYSpeckleFilterNode(int max_speckle_size, int max_speckle_diff) :
+    TYPipelineNode("speckle filter")
+{
+    _param.max_speckle_size = max_speckle_size;
+    _param.max_speckle_diff = max_speckle_diff;
+}
+
+std::vector<TYPixFmt> TYSpeckleFilterNode::inputFormats() const
+{
+    return { TYPixelFormatCoord3D_C16 };
+}
+
+int TYSpeckleFilterNode::process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline&)
+{
+    if(!writable) {
+        std::shared_ptr<TYImage> dst = allocImage(image->width(), image->height(), image->componentID(),
+                                                  image->pixelFormat(), image->size());
+        memcpy(dst->buffer(), image->buffer(), image->size());
+        image = dst;
+    }
+    TY_IMAGE_DATA data = *image->image();
+    return TYDepthSpeckleFilter(&data, &_param) == TY_STATUS_OK ? 0 : -1;
+}
+
+std::vector<TYPixFmt> TYLinearStretchNode::inputFormats() const
+{
+    return { TYPixelFormatMono8, TYPixelFormatMono16 };
+}
+
+template<class T>
+static void linearStretch(const T* src, uint8_t* dst, int32_t width, int32_t height, double ratio_cut)
+{
+    int32_t x0 = int32_t(width * ratio_cut), x1 = width - x0;
+    int32_t y0 = int32_t(height * ratio_cut), y1 = height - y0;
+    T min_val = std::numeric_limits<T>::max(), max_val = 0;
+    for(int32_t y = y0; y < y1; y++) {
+        for(int32_t x = x0; x < x1; x++) {
+            T v = src[y * width + x];
+            min_val = std::min(min_val, v);
+            max_val = std::max(max_val, v);
+        }
+    }
+    double scale = max_val > min_val ? 255.0 / (max_val - min_val) : 0.0;
+    for(int32_t i = 0; i < width * height; i++) {
+        double v = (double(src[i]) - min_val) * scale;
+        dst[i] = uint8_t(v < 0 ? 0 : (v > 255 ? 255 : v + 0.5));
+    }
+}
+
+int TYLinearStretchNode::process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline&)
+{
+    std::shared_ptr<TYImage> dst = image;
+    if(!writable) {
+        dst = allocImage(image->width(), image->height(), image->componentID(),
+                         TYPixelFormatMono8, image->width() * image->height());
+    }
+    if(image->pixelFormat() == TYPixelFormatMono16) {
+        linearStretch(static_cast<const uint16_t*>(image->buffer()), static_cast<uint8_t*>(dst->buffer()),
+                      image->width(), image->height(), _ratio_cut);
+    } else {
+        linearStretch(static_cast<const uint8_t*>(image->buffer()), static_cast<uint8_t*>(dst->buffer()),
+                      image->width(), image->height(), _ratio_cut);
+    }
+    image = dst;
+    return 0;
+}
+
+TYRegisterNode::TYRegisterNode(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                               float f_scale_unit, TY_COMPONENT_ID depth_comp) :
+    TYPipelineNode("register"),
+    _depth_calib(depth_calib),
+    _color_calib(color_calib),
+    _f_scale_unit(f_scale_unit),
+    _depth_comp(depth_comp)
+{
+}
+
+TYRegisterNode::~TYRegisterNode()
+{
+    TYDestroyRegistrationContext(_ctx);
+}
+
+std::vector<TYPixFmt> TYRegisterNode::inputFormats() const
+{
+    return { TYPixelFormatRGB8, TYPixelFormatBGR8, TYPixelFormatMono8, TYPixelFormatMono16 };
+}
+
+int TYRegisterNode::process(std::shared_ptr<TYImage>& image, bool, const TYPipeline& pipeline)
+{
+    std::shared_ptr<TYImage> depth = pipeline.result(_depth_comp);
+    if(!depth || depth->pixelFormat() != TYPixelFormatCoord3D_C16) {
+        std::cout << "Registration needs a Coord3D_C16 depth image." << std::endl;
+        return -1;
+    }
+
+    uint32_t depthW = depth->width(), depthH = depth->height();
+    if(!_ctx || _ctx->depthW != depthW || _ctx->depthH != depthH) {
+        TYDestroyRegistrationContext(_ctx);
+        _ctx = nullptr;
+        if(TYCreateRegistrationContext(&_depth_calib, &_color_calib, depthW, depthH, &_ctx, _f_scale_unit) != TY_STATUS_OK) {
+            return -1;
+        }
+    }
+
+    TYPixFmt format = image->pixelFormat();
+    int32_t channels = (format == TYPixelFormatRGB8 || format == TYPixelFormatBGR8) ? 3 : 1;
+    int32_t bytes = format == TYPixelFormatMono16 ? 2 : 1;
+    std::shared_ptr<TYImage> dst = allocImage(depthW, depthH, image->componentID(), format, depthW * depthH * channels * bytes);
+    const uint16_t* depth_data = static_cast<const uint16_t*>(depth->buffer());
+
+    TY_STATUS status;
+    if(channels == 3) {
+        status = TYMapRGBImageToDepthCoordinate(_ctx, depth_data, image->width(), image->height(),
+                    static_cast<const uint8_t*>(image->buffer()), static_cast<uint8_t*>(dst->buffer()));
+    } else if(bytes == 2) {
+        status = TYMapMono16ImageToDepthCoordinate(_ctx, depth_data, image->width(), image->height(),
+                    static_cast<const uint16_t*>(image->buffer()), static_cast<uint16_t*>(dst->buffer()));
+    } else {
+        status = TYMapMono8ImageToDepthCoordinate(_ctx, depth_data, image->width(), image->height(),
+                    static_cast<const uint8_t*>(image->buffer()), static_cast<uint8_t*>(dst->buffer()));
+    }
+    if(status != TY_STATUS_OK) return -1;
+    image = dst;
+    return 0;
+}
+
+std::vector<TYPixFmt> TYRenderNode::inputFormats() const
+{
+    return { TYPixelFormatCoord3D_C16 };
+}
+
+int TYRenderNode::process(std::shared_ptr<TYImage>& image, bool, const TYPipeline&)
+{
+#ifdef OPENCV_DEPENDENCIES
+    cv::Mat depth(image->height(), image->width(), CV_16U, image->buffer());
+    //the rendered mat becomes the image storage
+    image = std::make_shared<TYImage>(_render.Compute(depth), image->componentID(), TYPixelFormatBGR8);
+    return 0;
+#else
+    (void)image;
+    return -1;
+#endif
+}
+
+}
@@ -0,0 +1,526 @@
+#include "Recorder.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#endif
+
+namespace percipio_layer {
+
+TYFrameRecorder::TYFrameRecorder() :
+    _fd(-1),
+    _frames(0),
+    _bytes(0),
+    _writing(false)
+{
+}
+
+TYFrameRecorder::~TYFrameRecorder()
+{
+    close();
+}
+
+TY_STATUS TYFrameRecorder::open(const char* path, bool async, uint32_t queue_size)
+{
+    if(_fd >= 0) return TY_STATUS_BUSY;
+#ifdef _WIN32
+    _fd = _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    _fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+    if(_fd < 0) {
+        std::cout << "Open record file " << path << " failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+
+    TYRecordHeader header;
+    std::ifstream existing(path, std::ios::binary);
+    if(existing.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        //only append to a recording this version can read back
+        if(memcmp(header.magic, TY_RECORD_MAGIC, 4) != 0 || header.version != TY_RECORD_VERSION) {
+            std::cout << path << " is not a frame recording!" << std::endl;
+            close();
+            return TY_STATUS_ERROR;
+        }
+    } else if(existing.gcount() != 0) {
+        std::cout << path << " is not a frame recording!" << std::endl;
+        close();
+        return TY_STATUS_ERROR;
+    } else {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TY_RECORD_MAGIC, 4);
+        header.version = TY_RECORD_VERSION;
+        std::vector<std::pair<const void*, size_t>> parts(1, std::make_pair(&header, sizeof(header)));
+        TY_STATUS status = writeAll(parts);
+        if(status != TY_STATUS_OK) {
+            close();
+            return status;
+        }
+    }
+    //host_time starts over, replay rebases the frames after this
+    TY_STATUS status = writeChunk(TYRecordChunkSession, NULL, 0);
+    if(status != TY_STATUS_OK) {
+        close();
+        return status;
+    }
+
+    _frames = 0;
+    _bytes = 0;
+    _start = std::chrono::steady_clock::now();
+    if(async) {
+        _queue = std::make_shared<TYRingQueue<std::pair<std::shared_ptr<TYFrame>, uint64_t>>>(queue_size);
+        _writing = true;
+        _writer = std::thread(&TYFrameRecorder::writerLoop, this);
+    }
+    return TY_STATUS_OK;
+}
+
+void TYFrameRecorder::close()
+{
+    if(_writer.joinable()) {
+        _writing = false;
+        _queue->close();
+        _writer.join();
+    }
+    _queue.reset();
+    if(_fd >= 0) {
+#ifdef _WIN32
+        _close(_fd);
+#else
+        ::close(_fd);
+#endif
+        _fd = -1;
+    }
+}
+
+TY_STATUS TYFrameRecorder::writeAll(std::vector<std::pair<const void*, size_t>>& parts)
+{
+    std::unique_lock<std::mutex> lock(_write_lock);
+    if(_fd < 0) return TY_STATUS_NOT_PERMITTED;
+    size_t total = 0;
+    for(auto& part : parts) total += part.second;
+
+#ifdef _WIN32
+    for(auto& part : parts) {
+        if(_write(_fd, part.first, static_cast<unsigned int>(part.second)) != static_cast<int>(part.second)) {
+            std::cout << "Write record file failed!" << std::endl;
+            return TY_STATUS_ERROR;
+        }
+    }
+#else
+    //one gather write from the frame buffers, resumed if the kernel takes less
+    std::vector<struct iovec> iov(parts.size());
+    for(size_t i = 0; i < parts.size(); i++) {
+        iov[i].iov_base = const_cast<void*>(parts[i].first);
+        iov[i].iov_len = parts[i].second;
+    }
+    size_t first = 0;
+    while(first < iov.size()) {
+        ssize_t n = writev(_fd, &iov[first], static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX)));
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            std::cout << "Write record file failed!" << std::endl;
+            return TY_STATUS_ERROR;
+        }
+        size_t done = static_cast<size_t>(n);
+        while(first < iov.size() && done >= iov[first].iov_len) {
+            done -= iov[first].iov_len;
+            first++;
+        }
+        if(first < iov.size()) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + done;
+            iov[first].iov_len -= done;
+        }
+    }
+#endif
+    _bytes += total;
+    return TY_STATUS_OK;
+}
+
+TY_STATUS TYFrameRecorder::writeChunk(uint32_t type, const void* data, uint32_t size)
+{
+    TYRecordChunk chunk = { type, size };
+    std::vector<std::pair<const void*, size_t>> parts;
+    parts.push_back(std::make_pair(&chunk, sizeof(chunk)));
+    if(size) parts.push_back(std::make_pair(data, size));
+    return writeAll(parts);
+}
+
+TY_STATUS TYFrameRecorder::writeCalibration(TY_COMPONENT_ID comp, const TY_CAMERA_CALIB_INFO& calib)
+{
+    std::vector<uint8_t> data(sizeof(uint32_t) + sizeof(TY_CAMERA_CALIB_INFO));
+    uint32_t id = comp;
+    memcpy(&data[0], &id, sizeof(id));
+    memcpy(&data[sizeof(id)], &calib, sizeof(calib));
+    return writeChunk(TYRecordChunkCalib, &data[0], static_cast<uint32_t>(data.size()));
+}
+
+TY_STATUS TYFrameRecorder::writeScaleUnit(float scale_unit)
+{
+    return writeChunk(TYRecordChunkScaleUnit, &scale_unit, sizeof(scale_unit));
+}
+
+TY_STATUS TYFrameRecorder::writeDeviceInfo(FastCamera& camera)
+{
+    TY_DEV_HANDLE handle = camera.handle();
+    if(!handle) return TY_STATUS_INVALID_HANDLE;
+
+    TY_COMPONENT_ID comps = 0;
+    TY_STATUS status = TYGetComponentIDs(handle, &comps);
+    if(status != TY_STATUS_OK) return status;
+
+    const TY_COMPONENT_ID image_comps[] = { TY_COMPONENT_DEPTH_CAM, TY_COMPONENT_RGB_CAM,
+                                            TY_COMPONENT_IR_CAM_LEFT, TY_COMPONENT_IR_CAM_RIGHT };
+    for(auto comp : image_comps) {
+        if(!(comps & comp)) continue;
+        bool has_calib = false;
+        TYHasFeature(handle, comp, TY_STRUCT_CAM_CALIB_DATA, &has_calib);
+        if(!has_calib) continue;
+        TY_CAMERA_CALIB_INFO calib;
+        if(TYGetStruct(handle, comp, TY_STRUCT_CAM_CALIB_DATA, &calib, sizeof(calib)) != TY_STATUS_OK) continue;
+        status = writeCalibration(comp, calib);
+        if(status != TY_STATUS_OK) return status;
+    }
+
+    bool has_scale = false;
+    TYHasFeature(handle, TY_COMPONENT_DEPTH_CAM, TY_FLOAT_SCALE_UNIT, &has_scale);
+    if(has_scale) {
+        float scale_unit = 1.f;
+        if(TYGetFloat(handle, TY_COMPONENT_DEPTH_CAM, TY_FLOAT_SCALE_UNIT, &scale_unit) == TY_STATUS_OK) {
+            status = writeScaleUnit(scale_unit);
+        }
+    }
+    return status;
+}
+
+TY_STATUS TYFrameRecorder::writeFrame(const std::shared_ptr<TYFrame>& frame, uint64_t host_time)
+{
+    std::vector<std::shared_ptr<TYImage>> images = frame->images();
+    std::vector<TYRecordImage> records(images.size());
+    uint64_t offset = 0;
+    for(size_t i = 0; i < images.size(); i++) {
+        TYRecordImage& rec = records[i];
+        memset(&rec, 0, sizeof(rec));
+        rec.timestamp = images[i]->timestamp();
+        rec.offset = offset;
+        rec.imageIndex = images[i]->imageIndex();
+        rec.status = images[i]->status();
+        rec.componentID = images[i]->componentID();
+        rec.size = images[i]->size();
+        rec.width = images[i]->width();
+        rec.height = images[i]->height();
+        rec.pixelFormat = images[i]->pixelFormat();
+        offset += rec.size;
+    }
+
+    TYRecordFrame header = { host_time, static_cast<uint32_t>(images.size()), 0 };
+    TYRecordChunk chunk = { TYRecordChunkFrame,
+                            static_cast<uint32_t>(sizeof(header) + records.size() * sizeof(TYRecordImage) + offset) };
+    std::vector<std::pair<const void*, size_t>> parts;
+    parts.push_back(std::make_pair(&chunk, sizeof(chunk)));
+    parts.push_back(std::make_pair(&header, sizeof(header)));
+    if(!records.empty()) parts.push_back(std::make_pair(&records[0], records.size() * sizeof(TYRecordImage)));
+    for(auto& image : images) parts.push_back(std::make_pair(image->buffer(), static_cast<size_t>(image->size())));
+
+    TY_STATUS status = writeAll(parts);
+    if(status == TY_STATUS_OK) _frames++;
+    return status;
+}
+
+TY_STATUS TYFrameRecorder::write(const std::shared_ptr<TYFrame>& frame)
+{
+    if(!frame) return TY_STATUS_INVALID_PARAMETER;
+    if(_fd < 0) return TY_STATUS_NOT_PERMITTED;
+
+    uint64_t host_time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - _start).count();
+    if(_queue) {
+        std::unique_lock<std::mutex> lock(_push_lock);
+        _queue->push(std::make_pair(frame, host_time));
+        return TY_STATUS_OK;
+    }
+    return writeFrame(frame, host_time);
+}
+
+void TYFrameRecorder::writerLoop()
+{
+    std::pair<std::shared_ptr<TYFrame>, uint64_t> item;
+    //after close() the queue is drained before the thread ends
+    while(_queue->pop(item, 100) || _writing) {
+        if(!item.first) continue;
+        writeFrame(item.first, item.second);
+        item.first.reset();
+    }
+}
+
+static TY_COMPONENT_ID streamComponent(FastCamera::stream_idx idx)
+{
+    switch(idx) {
+    case FastCamera::stream_depth:    return TY_COMPONENT_DEPTH_CAM;
+    case FastCamera::stream_color:    return TY_COMPONENT_RGB_CAM;
+    case FastCamera::stream_ir_left:  return TY_COMPONENT_IR_CAM_LEFT;
+    case FastCamera::stream_ir_right: return TY_COMPONENT_IR_CAM_RIGHT;
+    default:                          return 0;
+    }
+}
+
+TYReplayCamera::~TYReplayCamera()
+{
+    stop();
+}
+
+TY_STATUS TYReplayCamera::open(const char* path)
+{
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    if(isRuning) {
+        std::cout << "Device is busy!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+    if(_file.is_open()) _file.close();
+    _index.clear();
+    _calib.clear();
+    _recorded = 0;
+    _enabled = 0;
+    _path = path;
+
+    _file.open(path, std::ios::binary);
+    if(!_file) {
+        std::cout << "Open record file " << path << " failed!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+    _file.seekg(0, std::ios::end);
+    uint64_t length = static_cast<uint64_t>(_file.tellg());
+    _file.seekg(0, std::ios::beg);
+
+    TYRecordHeader header;
+    if(!_file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            memcmp(header.magic, TY_RECORD_MAGIC, 4) != 0 || header.version > TY_RECORD_VERSION) {
+        std::cout << path << " is not a frame recording!" << std::endl;
+        _file.close();
+        return TY_STATUS_ERROR;
+    }
+
+    //index the frames, read calibration and scale unit on the way
+    uint64_t pos = sizeof(header);
+    TYRecordChunk chunk;
+    //host_time of every session is moved behind the sessions before it
+    int64_t rebase = 0;
+    uint64_t last_time = 0;
+    bool new_session = false;
+    while(pos + sizeof(chunk) <= length) {
+        _file.seekg(pos);
+        if(!_file.read(reinterpret_cast<char*>(&chunk), sizeof(chunk))) break;
+        uint64_t data = pos + sizeof(chunk);
+        //last chunk cut short by the recorder stopping
+        if(chunk.size > length - data) break;
+
+        if(chunk.type == TYRecordChunkCalib && chunk.size >= sizeof(uint32_t) + sizeof(TY_CAMERA_CALIB_INFO)) {
+            uint32_t comp;
+            TY_CAMERA_CALIB_INFO calib;
+            _file.read(reinterpret_cast<char*>(&comp), sizeof(comp));
+            _file.read(reinterpret_cast<char*>(&calib), sizeof(calib));
+            _calib[comp] = calib;
+        } else if(chunk.type == TYRecordChunkScaleUnit && chunk.size >= sizeof(float)) {
+            _file.read(reinterpret_cast<char*>(&_scale_unit), sizeof(float));
+        } else if(chunk.type == TYRecordChunkFrame && chunk.size >= sizeof(TYRecordFrame)) {
+            TYRecordFrame frame;
+            _file.read(reinterpret_cast<char*>(&frame), sizeof(frame));
+            //a broken count would run past the chunk
+            if(frame.count > (chunk.size - sizeof(TYRecordFrame)) / sizeof(TYRecordImage)) break;
+            std::vector<TYRecordImage> images(frame.count);
+            if(frame.count) _file.read(reinterpret_cast<char*>(&images[0]), frame.count * sizeof(TYRecordImage));
+            for(auto& image : images) _recorded |= image.componentID;
+            //files appended without session chunks show a new session as time going back
+            if(!_index.empty() && (new_session || frame.host_time < last_time)) {
+                size_t n = _index.size();
+                uint64_t interval = n > 1 ? _index[n - 1].host_time - _index[n - 2].host_time : 0;
+                rebase = static_cast<int64_t>(_index[n - 1].host_time + interval) - static_cast<int64_t>(frame.host_time);
+            }
+            new_session = false;
+            last_time = frame.host_time;
+            FrameEntry entry = { data, chunk.size, static_cast<uint64_t>(frame.host_time + rebase) };
+            _index.push_back(entry);
+        } else if(chunk.type == TYRecordChunkSession) {
+            new_session = true;
+        }
+        //unknown chunks are skipped
+        pos = data + chunk.size;
+    }
+    _file.clear();
+    std::cout << path << ": " << _index.size() << " frames" << std::endl;
+    return _index.empty() ? TY_STATUS_ERROR : TY_STATUS_OK;
+}
+
+bool TYReplayCamera::has_stream(stream_idx idx)
+{
+    return (_recorded & streamComponent(idx)) != 0;
+}
+
+TY_STATUS TYReplayCamera::stream_enable(stream_idx idx)
+{
+    if(!has_stream(idx)) return TY_STATUS_INVALID_COMPONENT;
+    _enabled |= streamComponent(idx);
+    return TY_STATUS_OK;
+}
+
+TY_STATUS TYReplayCamera::stream_disable(stream_idx idx)
+{
+    if(!has_stream(idx)) return TY_STATUS_INVALID_COMPONENT;
+    _enabled &= ~streamComponent(idx);
+    return TY_STATUS_OK;
+}
+
+bool TYReplayCamera::calibration(TY_COMPONENT_ID comp, TY_CAMERA_CALIB_INFO& calib) const
+{
+    auto iter = _calib.find(comp);
+    if(iter == _calib.end()) return false;
+    calib = iter->second;
+    return true;
+}
+
+TY_STATUS TYReplayCamera::start()
+{
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    if(isRuning) {
+        std::cout << "Device is busy!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+    if(!_file.is_open() || _index.empty()) return TY_STATUS_NOT_PERMITTED;
+
+    //nothing enabled plays every recorded stream
+    if(_enabled == 0) _enabled = _recorded;
+    _next = 0;
+    _played = 0;
+    _finished = false;
+    _start = std::chrono::steady_clock::now();
+    isRuning = true;
+    startDelivery();
+    return TY_STATUS_OK;
+}
+
+TY_STATUS TYReplayCamera::stop()
+{
+    if(onDeliveryThread()) {
+        std::cout << "Camera can not be stopped from its own frame callback!" << std::endl;
+        return TY_STATUS_BUSY;
+    }
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    if(!isRuning) return TY_STATUS_IDLE;
+    //the fetch thread reads isRuning until it is joined
+    TY_STATUS status = stopDelivery();
+    if(status != TY_STATUS_OK) return status;
+    isRuning = false;
+    return TY_STATUS_OK;
+}
+
+void TYReplayCamera::close()
+{
+    if(stop() == TY_STATUS_BUSY) return;
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    _file.close();
+    _index.clear();
+}
+
+std::chrono::steady_clock::time_point TYReplayCamera::dueTime(size_t pos) const
+{
+    switch(_rate) {
+    case TYReplayRateRecorded:
+    {
+        double speed = _rate_value > 0 ? _rate_value : 1.0;
+        uint64_t us = _index[pos].host_time - _index[0].host_time;
+        return _start + std::chrono::microseconds(static_cast<int64_t>(us / speed));
+    }
+    case TYReplayRateFixed:
+    {
+        double fps = _rate_value > 0 ? _rate_value : 1.0;
+        return _start + std::chrono::microseconds(static_cast<int64_t>(_played * 1000000.0 / fps));
+    }
+    default:
+        return std::chrono::steady_clock::time_point();
+    }
+}
+
+std::shared_ptr<TYFrame> TYReplayCamera::readFrame(const FrameEntry& entry)
+{
+    std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>(entry.size);
+    _file.seekg(entry.offset);
+    if(!_file.read(reinterpret_cast<char*>(data->data()), entry.size)) {
+        _file.clear();
+        std::cout << "Read record file failed!" << std::endl;
+        return std::shared_ptr<TYFrame>();
+    }
+
+    TYRecordFrame header;
+    memcpy(&header, data->data(), sizeof(header));
+    size_t images_size = header.count * sizeof(TYRecordImage);
+    if(sizeof(header) + images_size > entry.size) return std::shared_ptr<TYFrame>();
+    const TYRecordImage* images = reinterpret_cast<const TYRecordImage*>(data->data() + sizeof(header));
+    uint8_t* payload = data->data() + sizeof(header) + images_size;
+    size_t payload_size = entry.size - sizeof(header) - images_size;
+
+    TY_FRAME_DATA frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.userBuffer = payload;
+    frame.bufferSize = static_cast<int32_t>(payload_size);
+    for(uint32_t i = 0; i < header.count && frame.validCount < 10; i++) {
+        const TYRecordImage& rec = images[i];
+        if(!(rec.componentID & _enabled)) continue;
+        if(rec.offset + rec.size > payload_size) continue;
+        TY_IMAGE_DATA& img = frame.image[frame.validCount++];
+        img.timestamp = rec.timestamp;
+        img.imageIndex = rec.imageIndex;
+        img.status = rec.status;
+        img.componentID = rec.componentID;
+        img.size = rec.size;
+        img.buffer = payload + rec.offset;
+        img.width = rec.width;
+        img.height = rec.height;
+        img.pixelFormat = rec.pixelFormat;
+    }
+    if(frame.validCount == 0) return std::shared_ptr<TYFrame>();
+    //the frame keeps the chunk it was read into
+    return std::shared_ptr<TYFrame>(new TYFrame(frame, data));
+}
+
+std::shared_ptr<TYFrame> TYReplayCamera::fetchFrames(uint32_t timeout_ms, bool quiet_timeout)
+{
+    if(!isRuning) return std::shared_ptr<TYFrame>();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for(;;) {
+        if(_next >= _index.size()) {
+            if(!_loop) {
+                _finished = true;
+                std::this_thread::sleep_until(deadline);
+                if(!quiet_timeout) std::cout << "Replay finished." << std::endl;
+                return std::shared_ptr<TYFrame>();
+            }
+            _next = 0;
+            _played = 0;
+            _start = std::chrono::steady_clock::now();
+        }
+
+        auto due = dueTime(_next);
+        if(due > deadline) {
+            std::this_thread::sleep_until(deadline);
+            if(!quiet_timeout) std::cout << "Frame fetch timeout." << std::endl;
+            return std::shared_ptr<TYFrame>();
+        }
+        std::this_thread::sleep_until(due);
+
+        std::shared_ptr<TYFrame> frame = readFrame(_index[_next]);
+        _next++;
+        _played++;
+        //frames without an enabled stream are passed over
+        if(frame) return frame;
+    }
+}
+
+}
@@ -0,0 +1,173 @@
+#include "Scheduler.hpp"
+
+namespace percipio_layer {
+
+TYMultiDeviceScheduler::TYMultiDeviceScheduler(const TYSchedulerConfig& cfg) :
+    config(cfg),
+    running(false)
+{
+    if(config.pollers == 0) config.pollers = 1;
+    if(config.queue_size == 0) config.queue_size = 1;
+}
+
+TYMultiDeviceScheduler::~TYMultiDeviceScheduler()
+{
+    stop();
+}
+
+int TYMultiDeviceScheduler::addCamera(const std::shared_ptr<FastCamera>& camera, TYDeviceFrameCallback cb)
+{
+    if(!camera) return -1;
+    std::string name = camera->sourceName();
+    if(name.empty()) return -1;
+
+    return addSource(name, [camera]() {
+        std::unique_lock<std::mutex> lock(camera->_dev_lock);
+        if(!camera->isRuning || camera->delivering) return std::shared_ptr<TYFrame>();
+        return camera->fetchFrames(0, true);
+    }, cb);
+}
+
+int TYMultiDeviceScheduler::addSource(const std::string& name, TYFramePoll poll, TYDeviceFrameCallback cb)
+{
+    if(running) {
+        std::cout << "Scheduler is busy!" << std::endl;
+        return -1;
+    }
+    if(!poll) return -1;
+
+    std::shared_ptr<Device> dev = std::make_shared<Device>(config.queue_size);
+    dev->index = static_cast<int>(devices.size());
+    dev->name = name;
+    dev->poll = poll;
+    dev->cb = cb;
+    devices.push_back(dev);
+    return dev->index;
+}
+
+TY_STATUS TYMultiDeviceScheduler::start()
+{
+    if(running) return TY_STATUS_BUSY;
+    if(devices.empty()) return TY_STATUS_INVALID_PARAMETER;
+
+    for(auto& dev : devices) {
+        dev->queue.clear();
+        if(dev->cb && !workers) workers = std::make_shared<TYWorkerPool>(config.workers);
+    }
+
+    running = true;
+    uint32_t count = std::min<uint32_t>(config.pollers, static_cast<uint32_t>(devices.size()));
+    for(uint32_t i = 0; i < count; i++) {
+        pollers.push_back(std::thread(&TYMultiDeviceScheduler::pollLoop, this, i));
+    }
+    return TY_STATUS_OK;
+}
+
+void TYMultiDeviceScheduler::stop()
+{
+    if(!running) return;
+    running = false;
+    for(auto& poller : pollers) poller.join();
+    pollers.clear();
+    //the pool runs every queued drain before its threads exit
+    workers.reset();
+}
+
+void TYMultiDeviceScheduler::pollLoop(uint32_t first)
+{
+    uint32_t idle_us = 0;
+    while(running) {
+        bool fetched = false;
+        for(size_t i = first; i < devices.size(); i += config.pollers) {
+            const std::shared_ptr<Device>& dev = devices[i];
+            std::shared_ptr<TYFrame> frame = dev->poll();
+            if(!frame) continue;
+
+            fetched = true;
+            dev->queue.push(std::make_pair(frame, std::chrono::steady_clock::now()));
+            {
+                std::unique_lock<std::mutex> lock(dev->lock);
+                dev->frames++;
+            }
+            if(dev->cb) schedule(dev);
+        }
+
+        if(fetched) {
+            idle_us = 0;
+            continue;
+        }
+        //nothing ready anywhere, back off so idle devices do not burn a core
+        idle_us = std::min<uint32_t>(idle_us ? idle_us * 2 : 50, std::max<uint32_t>(config.max_idle_us, 50));
+        std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+    }
+}
+
+void TYMultiDeviceScheduler::schedule(const std::shared_ptr<Device>& dev)
+{
+    {
+        std::unique_lock<std::mutex> lock(dev->lock);
+        if(dev->scheduled) return;
+        dev->scheduled = true;
+    }
+    workers->post([this, dev]() { drain(dev); });
+}
+
+void TYMultiDeviceScheduler::drain(const std::shared_ptr<Device>& dev)
+{
+    for(;;) {
+        std::pair<std::shared_ptr<TYFrame>, std::chrono::steady_clock::time_point> item;
+        while(dev->queue.tryPop(item)) {
+            recordLatency(*dev, item.second);
+            dev->cb(dev->index, item.first);
+            item.first.reset();
+        }
+
+        //a frame pushed before the poller saw the flag set is still ours
+        std::unique_lock<std::mutex> lock(dev->lock);
+        if(dev->queue.size() == 0) {
+            dev->scheduled = false;
+            return;
+        }
+    }
+}
+
+void TYMultiDeviceScheduler::recordLatency(Device& dev, const std::chrono::steady_clock::time_point& fetched)
+{
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fetched).count();
+    std::unique_lock<std::mutex> lock(dev.lock);
+    dev.latency.count++;
+    dev.latency.last_ms = ms;
+    dev.latency.total_ms += ms;
+    dev.latency.max_ms = std::max(dev.latency.max_ms, ms);
+}
+
+std::shared_ptr<TYFrame> TYMultiDeviceScheduler::tryGetFrames(int device, uint32_t timeout_ms)
+{
+    if(device < 0 || device >= static_cast<int>(devices.size())) return std::shared_ptr<TYFrame>();
+    Device& dev = *devices[device];
+    if(dev.cb) {
+        std::cout << "Frames of " << dev.name << " are delivered to its callback!" << std::endl;
+        return std::shared_ptr<TYFrame>();
+    }
+
+    std::pair<std::shared_ptr<TYFrame>, std::chrono::steady_clock::time_point> item;
+    if(!dev.queue.pop(item, timeout_ms)) return std::shared_ptr<TYFrame>();
+    recordLatency(dev, item.second);
+    return item.first;
+}
+
+std::vector<TYDeviceSchedStats> TYMultiDeviceScheduler::stats()
+{
+    std::vector<TYDeviceSchedStats> st(devices.size());
+    for(size_t i = 0; i < devices.size(); i++) {
+        Device& dev = *devices[i];
+        std::unique_lock<std::mutex> lock(dev.lock);
+        st[i].name = dev.name;
+        st[i].frames = dev.frames;
+        st[i].dropped = dev.queue.dropped();
+        st[i].latency = dev.latency;
+    }
+    return st;
+}
+
+}
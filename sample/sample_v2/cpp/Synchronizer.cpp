@@ -0,0 +1,151 @@
+#include "Synchronizer.hpp"
+
+namespace percipio_layer {
+
+TYFrameSynchronizer::TYFrameSynchronizer(const TYSyncConfig& config, TYFrameSetCallback cb) :
+    _config(config),
+    _cb(cb),
+    _last_key(config.cameras, 0),
+    _seen(config.cameras, false),
+    _ready(std::max<uint32_t>(config.max_pending_sets, 1) * 2)
+{
+    if(_config.max_pending_sets == 0) _config.max_pending_sets = 1;
+}
+
+uint64_t TYFrameSynchronizer::frameKey(const std::shared_ptr<TYFrame>& frame) const
+{
+    if(_config.match == TYSyncMatchImageIndex) return static_cast<uint32_t>(frame->imageIndex());
+    return frame->timestamp();
+}
+
+bool TYFrameSynchronizer::isDead(const TYFrameSet& set) const
+{
+    //frames of a camera come in order, once it is past the window it will not fill the set
+    for(uint32_t c = 0; c < _config.cameras; c++) {
+        if(set.frames[c]) continue;
+        if(!_seen[c] || _last_key[c] <= set.timestamp + _config.tolerance) return false;
+    }
+    return true;
+}
+
+void TYFrameSynchronizer::close(set_map::iterator it, bool evicted, std::vector<std::shared_ptr<TYFrameSet>>& out)
+{
+    std::shared_ptr<TYFrameSet> set = it->second;
+    _sets.erase(it);
+    _closed_key = std::max(_closed_key, set->timestamp);
+    _any_closed = true;
+
+    if(set->complete()) {
+        _stats.complete++;
+        out.push_back(set);
+        return;
+    }
+    _stats.incomplete++;
+    if(evicted) _stats.evicted++;
+    if(_config.emit_incomplete) out.push_back(set);
+}
+
+void TYFrameSynchronizer::deliver(std::unique_lock<std::mutex>& lock, std::vector<std::shared_ptr<TYFrameSet>>& out)
+{
+    if(out.empty()) return;
+    //taken before the state lock is released, so sets leave in the order they closed
+    std::unique_lock<std::mutex> emit(_emit_lock);
+    lock.unlock();
+    for(auto& set : out) {
+        if(_cb) _cb(set);
+        else _ready.push(set);
+    }
+}
+
+int TYFrameSynchronizer::push(uint32_t camera, const std::shared_ptr<TYFrame>& frame)
+{
+    if(!frame || camera >= _config.cameras) return -1;
+
+    uint64_t key = frameKey(frame);
+    uint64_t tol = _config.tolerance;
+    std::vector<std::shared_ptr<TYFrameSet>> out;
+
+    std::unique_lock<std::mutex> lock(_lock);
+    //nearest open set inside the window that has no frame of this camera yet
+    set_map::iterator best = _sets.end();
+    uint64_t best_dist = 0;
+    for(set_map::iterator it = _sets.lower_bound(key > tol ? key - tol : 0);
+            it != _sets.end() && it->first <= key + tol; ++it) {
+        if(it->second->frames[camera]) continue;
+        uint64_t dist = it->first > key ? it->first - key : key - it->first;
+        if(best == _sets.end() || dist < best_dist) {
+            best = it;
+            best_dist = dist;
+        }
+    }
+
+    if(best == _sets.end()) {
+        if(_any_closed && key + tol < _closed_key) {
+            _stats.late++;
+            return -1;
+        }
+        std::shared_ptr<TYFrameSet> set = std::make_shared<TYFrameSet>();
+        set->timestamp = key;
+        set->frames.resize(_config.cameras);
+        best = _sets.insert(std::make_pair(key, set));
+    }
+
+    TYFrameSet& set = *best->second;
+    set.frames[camera] = frame;
+    set.count++;
+    if(!_seen[camera] || key > _last_key[camera]) _last_key[camera] = key;
+    _seen[camera] = true;
+
+    //older sets the camera has moved past go first, then this one if it is full
+    while(!_sets.empty() && _sets.begin() != best && isDead(*_sets.begin()->second)) {
+        close(_sets.begin(), false, out);
+    }
+    if(set.complete()) close(best, false, out);
+    while(!_sets.empty() && isDead(*_sets.begin()->second)) {
+        close(_sets.begin(), false, out);
+    }
+    while(_sets.size() > _config.max_pending_sets) {
+        close(_sets.begin(), true, out);
+    }
+
+    deliver(lock, out);
+    return 0;
+}
+
+void TYFrameSynchronizer::flush()
+{
+    std::vector<std::shared_ptr<TYFrameSet>> out;
+    std::unique_lock<std::mutex> lock(_lock);
+    while(!_sets.empty()) close(_sets.begin(), false, out);
+    deliver(lock, out);
+}
+
+TY_STATUS TYFrameSynchronizer::attach(uint32_t camera, FastCamera& cam)
+{
+    if(camera >= _config.cameras) return TY_STATUS_INVALID_PARAMETER;
+    return cam.registerFrameCallback("sync" + std::to_string(camera), [this, camera](const std::shared_ptr<TYFrame>& frame) {
+        push(camera, frame);
+    });
+}
+
+std::shared_ptr<TYFrameSet> TYFrameSynchronizer::tryGetFrameSet(uint32_t timeout_ms)
+{
+    std::shared_ptr<TYFrameSet> set;
+    if(_cb) {
+        std::cout << "Frame sets are delivered to the callback!" << std::endl;
+        return set;
+    }
+    _ready.pop(set, timeout_ms);
+    return set;
+}
+
+TYSyncStats TYFrameSynchronizer::stats()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    TYSyncStats st = _stats;
+    st.pending = static_cast<uint32_t>(_sets.size());
+    st.overwritten = _ready.dropped();
+    return st;
+}
+
+}
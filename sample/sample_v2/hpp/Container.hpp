@@ -0,0 +1,199 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "Device.hpp"
+
+namespace percipio_layer {
+
+/*
+ * Frame container file, little endian, for random access to long recordings:
+ *   TYContainerHeader
+ *   records, each starts on a TY_CONTAINER_ALIGN boundary
+ *     TYContainerRecordFrame       count TYContainerChunk, then the image payloads,
+ *                                  each on a TY_CONTAINER_ALIGN boundary
+ *     TYContainerRecordCalib       one TYContainerCalib
+ *     TYContainerRecordScaleUnit   one float
+ *   calibration table   calib_count TYContainerCalib
+ *   chunk table         chunk_count TYContainerChunk, grouped by frame
+ *   frame index         frame_count TYContainerFrame
+ * The tables are written by close(), the header is rewritten last. A file
+ * whose writer never closed has frame_offset 0, the reader rebuilds the
+ * tables from the records then, up to the first record cut short.
+ * Files are mapped whole, on 32-bit targets that limits them to the address
+ * space the process has left, about 2 GB.
+ */
+#define TY_CONTAINER_MAGIC        "TYCF"
+#define TY_CONTAINER_RECORD_MAGIC "TYCR"
+#define TY_CONTAINER_VERSION      (2)
+#define TY_CONTAINER_ALIGN        (64)
+
+enum TYContainerCompression {
+    TYContainerCompressionNone = 0,
+    TYContainerCompressionZlib = 1,
+};
+
+enum TYContainerRecordType {
+    TYContainerRecordFrame = 1,
+    TYContainerRecordCalib = 2,
+    TYContainerRecordScaleUnit = 3,
+};
+
+//in front of what every write call adds, so an unclosed file can be indexed
+struct TYContainerRecord {
+    char     magic[4];
+    uint32_t type;          //TYContainerRecordType
+    uint32_t count;         //entries following the record
+    uint32_t reserved;
+    uint64_t size;          //bytes from the end of the record to the end of its data
+    uint64_t host_time;     //of a frame
+};
+
+struct TYContainerHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t frame_count;
+    uint32_t chunk_count;
+    uint32_t calib_count;
+    float    scale_unit;
+    uint64_t calib_offset;
+    uint64_t chunk_offset;
+    uint64_t frame_offset;
+    uint64_t reserved[2];
+};
+
+struct TYContainerFrame {
+    uint64_t host_time;     //us since the writer opened
+    uint32_t first_chunk;   //into the chunk table
+    uint32_t chunk_count;
+};
+
+//one image, TY_IMAGE_DATA with the buffer as a file offset
+struct TYContainerChunk {
+    uint64_t offset;
+    uint64_t timestamp;
+    uint32_t stored_size;   //bytes in the file
+    int32_t  size;          //bytes of the image once decoded
+    uint32_t componentID;
+    uint32_t pixelFormat;
+    int32_t  width;
+    int32_t  height;
+    int32_t  imageIndex;
+    int32_t  status;
+    uint32_t compression;   //TYContainerCompression
+    uint32_t reserved;
+};
+
+struct TYContainerCalib {
+    uint32_t componentID;
+    uint32_t reserved;
+    TY_CAMERA_CALIB_INFO calib;
+};
+
+/*
+ * Writes a frame container.
+ * Uncompressed images are written straight from their buffers. With zlib,
+ * an image that does not shrink is stored as is, chunks decide on their own.
+ * Not thread safe.
+ */
+class TYFrameContainerWriter
+{
+  public:
+    TYFrameContainerWriter() {}
+    ~TYFrameContainerWriter();
+    TYFrameContainerWriter(TYFrameContainerWriter const&) = delete;
+    void operator=(TYFrameContainerWriter const&) = delete;
+
+    //level is the zlib level, 1 fastest to 9 smallest
+    TY_STATUS open(const char* path, TYContainerCompression compression = TYContainerCompressionNone, int level = 1);
+    //writes the tables, the file opens without a scan afterwards
+    TY_STATUS close();
+    //hands what was written to the system, it is readable even if the process dies later
+    TY_STATUS flush();
+    bool isOpen() const { return _file.is_open(); }
+
+    TY_STATUS writeCalibration(TY_COMPONENT_ID comp, const TY_CAMERA_CALIB_INFO& calib);
+    TY_STATUS writeScaleUnit(float scale_unit);
+
+    //components selects the images kept, 0 keeps all of them
+    TY_STATUS write(const std::shared_ptr<TYFrame>& frame, TY_COMPONENT_ID components = 0);
+
+    uint32_t frames() const { return static_cast<uint32_t>(_frames.size()); }
+    uint64_t bytes() const { return _pos; }
+
+  private:
+    std::ofstream                   _file;
+    uint64_t                        _pos = 0;
+    TYContainerCompression          _compression = TYContainerCompressionNone;
+    int                             _level = 1;
+    float                           _scale_unit = 1.f;
+    std::chrono::steady_clock::time_point _start;
+
+    std::vector<TYContainerFrame>   _frames;
+    std::vector<TYContainerChunk>   _chunks;
+    std::vector<TYContainerCalib>   _calibs;
+    std::vector<std::vector<uint8_t>> _compressed;  //per image of a frame
+
+    bool writeAligned(const void* data, size_t size, uint64_t& offset);
+    bool writeRecord(uint32_t type, uint32_t count, uint64_t size, uint64_t host_time,
+                     const void* entries, size_t entries_size);
+};
+
+/*
+ * Reads a frame container through a memory mapping.
+ * open() only checks the tables, nothing is read before it is asked for. A
+ * file that was not closed is indexed from its records instead, which reads
+ * one record per frame.
+ * Uncompressed images are views into the mapping, which stays mapped until
+ * the container and every image taken from it are gone; the mapping is copy
+ * on write, so changing an image in place does not touch the file.
+ * Compressed images are inflated when they are asked for.
+ * Reading is thread safe.
+ */
+class TYFrameContainer
+{
+  public:
+    TYFrameContainer() {}
+    TYFrameContainer(TYFrameContainer const&) = delete;
+    void operator=(TYFrameContainer const&) = delete;
+
+    TY_STATUS open(const char* path);
+    void close();
+    bool isOpen() const { return _base != nullptr; }
+
+    uint32_t frameCount() const { return _header.frame_count; }
+    uint64_t hostTime(uint32_t frame) const;
+    //components of every image in frame, 0 when out of range
+    TY_COMPONENT_ID components(uint32_t frame) const;
+
+    //one image of frame n, null if the frame has none of comp
+    std::shared_ptr<TYImage> image(uint32_t frame, TY_COMPONENT_ID comp) const;
+    //images of frame n selected by components, 0 selects all
+    std::shared_ptr<TYFrame> frame(uint32_t frame, TY_COMPONENT_ID components = 0) const;
+
+    bool  calibration(TY_COMPONENT_ID comp, TY_CAMERA_CALIB_INFO& calib) const;
+    float scaleUnit() const { return _header.scale_unit; }
+
+  private:
+    std::shared_ptr<void>       _mapping;
+    const uint8_t*              _base = nullptr;
+    uint64_t                    _length = 0;
+    TYContainerHeader           _header = TYContainerHeader();
+    const TYContainerFrame*     _frames = nullptr;
+    const TYContainerChunk*     _chunks = nullptr;
+    const TYContainerCalib*     _calibs = nullptr;
+    //tables rebuilt from the records of a file that was not closed
+    std::vector<TYContainerFrame> _scanned_frames;
+    std::vector<TYContainerChunk> _scanned_chunks;
+    std::vector<TYContainerCalib> _scanned_calibs;
+
+    void  scan(const uint8_t* base, uint64_t length, TYContainerHeader& header);
+    const TYContainerChunk* findChunk(uint32_t frame, TY_COMPONENT_ID comp) const;
+    bool  decode(const TYContainerChunk& chunk, void* out) const;
+    void  fillImage(const TYContainerChunk& chunk, void* buffer, TY_IMAGE_DATA& image) const;
+};
+
+}
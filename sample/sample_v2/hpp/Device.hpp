@@ -8,6 +8,11 @@
 #include <queue>
 #include <thread>
 #include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
 #include <stdint.h>
 
 #include "Frame.hpp"
@@ -182,6 +187,113 @@ class TYCamInterface
         std::vector<TY_INTERFACE_INFO> ifaces;
 };
 
+#define BUF_CNT      (3)
+#define BUF_MAX_CNT  (16)
+
+enum TYBufferPolicy {
+    //driver drops new frames while it has no empty buffer, fetch returns the oldest frame
+    TYBufferPolicyDropNewest = 0,
+    //fetch skips every frame waiting in the driver and returns the newest one
+    TYBufferPolicyDropOldest = 1,
+    //zero copy only, fetch waits for a frame to be released when all buffers are held
+    TYBufferPolicyBlock = 2,
+};
+
+struct TYBufferPoolConfig {
+    uint32_t       buffer_count = BUF_CNT;          //buffers kept in the driver queue
+    uint32_t       max_buffer_count = BUF_MAX_CNT;  //zero copy growth limit
+    uint32_t       alignment = 64;                  //power of two
+    bool           huge_pages = false;              //back buffers with 2MB pages where the system allows
+    TYBufferPolicy policy = TYBufferPolicyDropNewest;
+};
+
+struct TYBufferPoolStats {
+    uint64_t enqueued = 0;       //buffers handed to the driver
+    uint64_t starved = 0;        //fetches that left the driver with less than buffer_count buffers
+    uint64_t dropped = 0;        //frames skipped by TYBufferPolicyDropOldest
+    uint64_t driver_dropped = 0; //frames the device reported dropped, 0 if it has no statistics
+    uint32_t allocated = 0;      //buffers owned by the pool
+    uint32_t queued = 0;         //buffers waiting in the driver
+    uint32_t in_flight = 0;      //buffers held by zero copy frames
+};
+
+/*
+ * Driver frame buffers shared with zero copy frames.
+ * A fetched buffer is leased to the frame instead of being enqueued again, and
+ * comes back when the last reference to the frame and its images is dropped.
+ * Returned buffers are handed to the driver by refill(), called from the fetch
+ * thread, so the driver is never touched from the thread releasing a frame.
+ * While consumers hold too many frames the pool grows up to max_buffer_count.
+ */
+class TYFrameBufferPool : public std::enable_shared_from_this<TYFrameBufferPool>
+{
+    public:
+        TYFrameBufferPool(TY_DEV_HANDLE handle, uint32_t buffer_size, const TYBufferPoolConfig& config);
+        ~TYFrameBufferPool();
+        TYFrameBufferPool(TYFrameBufferPool const&) = delete;
+        void operator=(TYFrameBufferPool const&) = delete;
+
+        TY_STATUS start();
+        //driver queue has been cleared, leased buffers are freed with the pool
+        void stop();
+        //enqueue returned buffers, allocate new ones if the driver runs short
+        TY_STATUS refill();
+        //wait until a leased buffer comes back, false on timeout
+        bool waitReturned(uint32_t timeout_ms);
+        //take a fetched buffer out of the driver queue
+        std::shared_ptr<void> lease(void* buffer);
+        //give a fetched buffer straight back to the driver
+        TY_STATUS requeue(void* buffer);
+        void countDropped() { _dropped++; }
+
+        uint32_t queuedCount();
+        TYBufferPoolStats stats();
+        TY_DEV_HANDLE handle() const { return _handle; }
+
+    private:
+        struct Buffer {
+            void*  data;
+            size_t capacity;
+            bool   mapped;
+            bool   leased;
+        };
+
+        std::mutex _lock;
+        std::condition_variable _returned_cond;
+        TY_DEV_HANDLE _handle;
+        uint32_t _buffer_size;
+        TYBufferPoolConfig _config;
+        uint32_t _queued = 0;
+        bool _running = false;
+        bool _exhausted = false;
+
+        std::atomic<uint64_t> _enqueued;
+        std::atomic<uint64_t> _starved;
+        std::atomic<uint64_t> _dropped;
+
+        std::vector<Buffer> _buffers;
+        std::vector<void*> _returned;
+
+        bool allocate();
+        TY_STATUS enqueue(void* buffer);
+        void release(void* buffer);
+};
+
+typedef std::function<void(const std::shared_ptr<TYFrame>& frame)> TYFrameCallback;
+
+struct TYFrameDeliveryConfig {
+    uint32_t workers = 0;            //0: callbacks run on the fetch thread, else on a pool of this many threads
+    uint32_t max_pending = 2;        //frames waiting on the workers per callback before newer ones are skipped
+    uint32_t fetch_timeout_ms = 100; //longest wait of the fetch thread, bounds how long stop() takes
+};
+
+struct TYFrameCallbackStats {
+    TYStageTiming latency;           //frame timestamp to callback start, fetch time if the device clock is not synced
+    TYStageTiming duration;          //time spent in the callback
+    uint64_t      skipped = 0;       //frames not delivered while max_pending frames were waiting
+    bool          device_clock = false; //latency is measured from the device timestamp
+};
+
 class FastCamera
 {
     public:
@@ -194,9 +306,10 @@ class FastCamera
         stream_ir = stream_ir_left
     };
         friend class TYFrame;
+        friend class TYMultiDeviceScheduler;
         FastCamera();
         FastCamera(const char* sn);
-        ~FastCamera();
+        virtual ~FastCamera();
 
         virtual TY_STATUS open(const char* sn);
         TY_STATUS setIfaceId(const char* inf);
@@ -211,23 +324,75 @@ class FastCamera
 
         std::shared_ptr<TYFrame> tryGetFrames(uint32_t timeout_ms);
 
-        TY_DEV_HANDLE handle() {return device->_handle; }
+        /*
+         * Push delivery: with callbacks registered, start() runs a fetch thread that
+         * hands every frame to them and tryGetFrames() returns nothing.
+         * stop() ends the fetch thread and waits for running callbacks, called from
+         * one of the camera's own callbacks it returns TY_STATUS_BUSY and the camera
+         * keeps running. Callbacks are set while the camera is stopped.
+         */
+        TY_STATUS registerFrameCallback(const std::string& name, TYFrameCallback cb);
+        TY_STATUS unregisterFrameCallback(const std::string& name);
+        TY_STATUS setFrameDelivery(const TYFrameDeliveryConfig& config);
+        const TYFrameDeliveryConfig& frameDelivery() const { return delivery_config; }
+        std::map<std::string, TYFrameCallbackStats> frameCallbackStats();
+
+        //frames reference driver buffers instead of copying them, pool growth is set up on start()
+        void setZeroCopy(bool enable) { zero_copy = enable; }
+        bool zeroCopy() const { return zero_copy; }
+
+        //buffer count, allocation and backpressure policy, takes effect on start()
+        TY_STATUS setBufferPool(const TYBufferPoolConfig& config);
+        const TYBufferPoolConfig& bufferPool() const { return pool_config; }
+        TYBufferPoolStats bufferPoolStats();
+
+        TY_DEV_HANDLE handle() {return device ? device->_handle : nullptr; }
 
         void RegisterOfflineEventCallback(EventCallback cb, void* data) { device->registerEventCallback(TY_EVENT_DEVICE_OFFLINE, data, cb); }
     
+    protected:
+        std::mutex      _dev_lock;
+        bool isRuning = false;
+
+        //source of tryGetFrames(), the frame callbacks and the scheduler, never called concurrently
+        virtual std::shared_ptr<TYFrame> fetchFrames(uint32_t timeout_ms, bool quiet_timeout = false);
+        //frame callback thread when callbacks are registered, for sources overriding start() and stop()
+        void startDelivery();
+        //TY_STATUS_BUSY on a delivery thread, which can not wait for itself
+        TY_STATUS stopDelivery();
+        //the calling thread is running a frame callback of this camera
+        bool onDeliveryThread() const;
+        //name of the frame source for the scheduler, empty when nothing is opened
+        virtual std::string sourceName();
+
     private:
         std::string     mIfaceId;
-        std::mutex      _dev_lock;
 
         TY_COMPONENT_ID components = 0;
-#define BUF_CNT      (3)
-
-        bool isRuning = false;
-        std::shared_ptr<TYFrame> fetchFrames(uint32_t timeout_ms);
+        bool zero_copy = false;
+        TYBufferPoolConfig pool_config;
         TY_STATUS doStop();
 
         std::shared_ptr<TYDevice> device;
-        std::vector<uint8_t> stream_buffer[BUF_CNT];
+        std::shared_ptr<TYFrameBufferPool> buffer_pool;
+
+        struct FrameCallback {
+            std::string           name;
+            TYFrameCallback       cb;
+            std::atomic<uint32_t> pending;
+            std::mutex            lock;
+            TYFrameCallbackStats  stats;
+        };
+        std::vector<std::shared_ptr<FrameCallback>> frame_callbacks;
+        TYFrameDeliveryConfig         delivery_config;
+        std::atomic<bool>             delivering{false};
+        std::thread                   fetch_thread;
+        std::shared_ptr<TYWorkerPool> delivery_workers;
+        bool                          device_clock = false;
+
+        void deliveryLoop();
+        void invokeCallback(FrameCallback& cb, const std::shared_ptr<TYFrame>& frame,
+                            const std::chrono::steady_clock::time_point& fetched);
 };
 
 }
@@ -9,16 +9,26 @@
 #include <condition_variable>
 
 #include "common.hpp"
+#include "RingQueue.hpp"
+#include "WorkerPool.hpp"
 
 namespace percipio_layer {
 
+class TYJpegDecoder;
+
 class TYImage
 {
   public:
     TYImage();
     TYImage(const TY_IMAGE_DATA& image);
+    //wrap image data without copy, lease keeps the memory behind image.buffer alive
+    TYImage(const TY_IMAGE_DATA& image, const std::shared_ptr<void>& lease);
     TYImage(const TYImage& src);
     TYImage(int32_t width, int32_t height, TY_COMPONENT_ID compID, TYPixFmt format, int32_t size);
+#ifdef OPENCV_DEPENDENCIES
+    //share the pixels of mat, no copy
+    TYImage(const cv::Mat& mat, TY_COMPONENT_ID compID, TYPixFmt format);
+#endif
 
     ~TYImage();
 
@@ -38,11 +48,42 @@ class TYImage
 
     const TY_IMAGE_DATA* image() const { return &image_data; }
 
+    //buffer belongs to this image, not to a frame or another owner
+    bool     isOwner() const { return m_isOwner; }
+    //buffers allocated by TYImage on the calling thread so far
+    static uint64_t allocations();
+
   private:
     bool m_isOwner = false;
+    std::shared_ptr<void> m_lease;
     TY_IMAGE_DATA image_data;
 };
 
+/*
+ * Recycles TYImage storage between frames.
+ * An image handed out before is reused once every other reference to it is gone
+ * and its size and format match, so a processer in steady state stops allocating.
+ * Not thread safe, meant to be owned by one processer.
+ */
+class TYImagePool
+{
+  public:
+    TYImagePool(uint32_t max_images = 4) : _max_images(max_images) {}
+
+    std::shared_ptr<TYImage> acquire(int32_t width, int32_t height, TY_COMPONENT_ID compID, TYPixFmt format, int32_t size);
+    //image came from this pool, which keeps one reference to it
+    bool holds(const std::shared_ptr<TYImage>& image) const;
+
+    uint64_t allocations() const { return _allocations; }
+    uint64_t reuses() const { return _reuses; }
+
+  private:
+    uint32_t _max_images;
+    uint64_t _allocations = 0;
+    uint64_t _reuses = 0;
+    std::vector<std::shared_ptr<TYImage>> _images;
+};
+
 class TYFrame
 {
   public:
@@ -50,15 +91,35 @@ class TYFrame
     void operator=(TYFrame const&) = delete;
     TYFrame(TYFrame const&) = delete;
     TYFrame(const TY_FRAME_DATA& frame);
+    //zero copy: images point into frame.userBuffer, which stays valid until
+    //this frame and every image taken from it are released, then lease is dropped
+    TYFrame(const TY_FRAME_DATA& frame, const std::shared_ptr<void>& lease);
  
     std::shared_ptr<TYImage> depthImage()        { return _images[TY_COMPONENT_DEPTH_CAM];}
     std::shared_ptr<TYImage> colorImage()        { return _images[TY_COMPONENT_RGB_CAM];}
     std::shared_ptr<TYImage> leftIRImage()       { return _images[TY_COMPONENT_IR_CAM_LEFT];}
     std::shared_ptr<TYImage> rightIRImage()      { return _images[TY_COMPONENT_IR_CAM_RIGHT];}
+    //device timestamp of the earliest image in the frame, in us
+    uint64_t                 timestamp() const   { return _timestamp; }
+    //imageIndex of that image, the trigger count on devices that report it
+    int32_t                  imageIndex() const  { return _image_index; }
+    //every image of the frame, by component id
+    std::vector<std::shared_ptr<TYImage>> images() const
+    {
+      std::vector<std::shared_ptr<TYImage>> list;
+      for(auto& iter : _images) {
+        if(iter.second) list.push_back(iter.second);
+      }
+      return list;
+    }
 
   private:
     int32_t               bufferSize = 0;
-    std::vector<uint8_t>  userBuffer;
+    uint64_t              _timestamp = 0;
+    int32_t               _image_index = 0;
+    std::shared_ptr<void> userBuffer;
+
+    void attachImages(const TY_FRAME_DATA& frame, void* buffer);
 
     typedef std::map<TY_COMPONENT_ID, std::shared_ptr<TYImage>> ty_image;
     ty_image              _images;
@@ -103,9 +164,16 @@ class ImageProcesser
 
     const std::shared_ptr<TYImage>& image() const { return _image; }
     const std::string& win() { return win_name; }
+    const TYImagePool& imagePool() const { return _pool; }
 
   protected:
     std::shared_ptr<TYImage> _image;
+    TYImagePool _pool;
+
+    //output image for a processing step, recycled from earlier frames when possible
+    std::shared_ptr<TYImage> allocImage(int32_t width, int32_t height, TY_COMPONENT_ID compID, TYPixFmt format, int32_t size) {
+      return _pool.acquire(width, height, compID, format, size);
+    }
 
 #ifdef OPENCV_DEPENDENCIES
     ImageDisplay* disp_ptr;
@@ -114,6 +182,8 @@ class ImageProcesser
   private:
     std::string win_name;
     std::shared_ptr<TY_CAMERA_CALIB_INFO> _calib_data;
+    //created with the first jpeg frame
+    std::shared_ptr<TYJpegDecoder> _jpeg;
 
 #ifdef OPENCV_DEPENDENCIES
     DepthRender render;
@@ -121,6 +191,19 @@ class ImageProcesser
 };
 
 
+struct TYStageTiming
+{
+    uint64_t count = 0;
+    double   last_ms = 0;
+    double   total_ms = 0;
+    double   max_ms = 0;
+    //TYImage buffer allocations
+    uint64_t allocations = 0;
+    uint64_t last_allocations = 0;
+
+    double   average_ms() const { return count ? total_ms / count : 0; }
+};
+
 typedef void (*TYFrameKeyBoardEventCallback) (int, void*);
 typedef std::map<TY_COMPONENT_ID, std::shared_ptr<ImageProcesser>> ty_stream;
 class TYFrameParser
@@ -136,22 +219,38 @@ class TYFrameParser
 
     int setImageProcesser(TY_COMPONENT_ID id, std::shared_ptr<ImageProcesser> proc);
     virtual int doProcess(const std::shared_ptr<TYFrame>& frame);
+    //work done for one component image by doProcess, may run on a worker thread
+    virtual int processComponent(TY_COMPONENT_ID id, const std::shared_ptr<TYImage>& image);
+
+    //process and flush the components of a frame in parallel, threads = 0 sizes the pool by hardware
+    void setParallel(bool enable, uint32_t threads = 0);
+    //"frame" plus "<window>.parse" and "<window>.flush" for every processer, in ms and allocations
+    std::map<std::string, TYStageTiming> stageTimings();
     void update(const std::shared_ptr<TYFrame>& frame);
+    //frames overwritten before the display thread got to them
+    uint64_t droppedFrames() const { return images.dropped(); }
 
 protected:
     ty_stream stream;
-  private:
-    std::mutex      _queue_lock;
-    uint32_t        _max_queue_size;
 
-    bool            isRuning;
+    //run tasks on the worker pool if parallel, else one after another
+    void runTasks(const std::vector<std::function<void()>>& tasks);
+    void recordStage(const std::string& stage, double ms, uint64_t allocations = 0);
+  private:
+    std::atomic<bool> isRuning;
     std::thread     processThread_;
 
     void* user_data;
     TYFrameKeyBoardEventCallback     func_keyboard_event;
-    std::queue<std::shared_ptr<TYFrame>> images;
+    //update() overwrites the oldest frame when the display thread falls behind
+    TYRingQueue<std::shared_ptr<TYFrame>> images;
+
+    std::shared_ptr<TYWorkerPool> workers;
+    std::mutex      _timing_lock;
+    std::map<std::string, TYStageTiming> timings;
+    //allocations of the stages recorded since the last "frame" record
+    uint64_t        _frame_allocations = 0;
 
-    inline void ImageQueueSizeCheck();
     inline void display();
 };
 }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <functional>
+
+#include "Frame.hpp"
+
+namespace percipio_layer {
+
+/*
+ * JPEG to BGR8, read straight from the image buffer without a copy.
+ * scale 2, 4 or 8 runs the reduced size IDCT of libjpeg, the output is
+ * ceil(width / scale) x ceil(height / scale) and costs a fraction of a full
+ * decode, for previews and detectors that take small inputs.
+ * Built with libjpeg (JPEG_DEPENDENCIES), else on top of cv::imdecode, which
+ * shrinks after a full decode. One decoder is not thread safe, use one per
+ * thread or a TYJpegDecodePool.
+ */
+class TYJpegDecoder
+{
+  public:
+    TYJpegDecoder();
+    ~TYJpegDecoder();
+
+    TYJpegDecoder(TYJpegDecoder const&) = delete;
+    void operator=(TYJpegDecoder const&) = delete;
+
+    //a jpeg decoder was built in
+    static bool available();
+
+    //output size for scale 1, 2, 4 or 8, from the frame header only
+    static TY_STATUS outputSize(const void* data, size_t size, int scale, int32_t& width, int32_t& height);
+
+    //decode into bgr, which holds an outputSize() image with rows step bytes apart, 0 for packed
+    TY_STATUS decode(const void* data, size_t size, int scale, void* bgr, size_t step, int32_t width, int32_t height);
+    //TYPixelFormatJPEG image to a new BGR8 image with the same component, null on failure
+    std::shared_ptr<TYImage> decode(const std::shared_ptr<TYImage>& jpeg, int scale = 1);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+/*
+ * Decoder threads shared by several cameras.
+ * JPEG frames of different cameras, or of one camera when it outruns a single
+ * thread, decode concurrently, each on a decoder kept from earlier frames.
+ */
+class TYJpegDecodePool
+{
+  public:
+    //0 threads: one less than the hardware threads
+    TYJpegDecodePool(uint32_t threads = 0, int scale = 1);
+
+    TYJpegDecodePool(TYJpegDecodePool const&) = delete;
+    void operator=(TYJpegDecodePool const&) = delete;
+
+    int scale() const { return _scale; }
+
+    //decode a batch and wait for it, the calling thread decodes too; failed images are null
+    std::vector<std::shared_ptr<TYImage>> decodeAll(const std::vector<std::shared_ptr<TYImage>>& jpegs);
+    //decode on a pool thread, done gets the BGR8 image or null on that thread
+    void submit(const std::shared_ptr<TYImage>& jpeg, std::function<void(const std::shared_ptr<TYImage>&)> done);
+
+  private:
+    int _scale;
+    std::mutex _lock;
+    std::vector<std::unique_ptr<TYJpegDecoder>> _idle;
+    //last, so the threads are joined before the decoders go
+    TYWorkerPool _workers;
+
+    std::shared_ptr<TYImage> decode(const std::shared_ptr<TYImage>& jpeg);
+};
+
+//BGR8, RGB8 or Mono8 image to a TYPixelFormatJPEG image, quality 1..100, null on failure or without libjpeg
+std::shared_ptr<TYImage> TYJpegEncode(const std::shared_ptr<TYImage>& image, int quality = 90);
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "Frame.hpp"
+#include "Jpeg.hpp"
+#include "TYImageProc.h"
+#include "TYCoordinateMapper.h"
+
+namespace percipio_layer {
+
+class TYPipeline;
+
+/*
+ * One processing step of a TYPipeline.
+ * A node declares the pixel formats it takes, the format it produces and whether
+ * it can write its result over its input. The pipeline only lets it do so when
+ * nothing else references the input image, otherwise the node writes to an image
+ * of its pool, which is recycled once the frame that used it is released.
+ */
+class TYPipelineNode
+{
+  public:
+    TYPipelineNode(const std::string& name) : _name(name) {}
+    virtual ~TYPipelineNode() {}
+
+    const std::string& name() const { return _name; }
+
+    //formats the node takes, empty takes every format
+    virtual std::vector<TYPixFmt> inputFormats() const { return std::vector<TYPixFmt>(); }
+    virtual TYPixFmt outputFormat(TYPixFmt input) const { return input; }
+    //the node can overwrite an input of this format
+    virtual bool inPlace(TYPixFmt) const { return false; }
+    //component whose pipeline result this node reads, 0 for none
+    virtual TY_COMPONENT_ID dependency() const { return 0; }
+
+    //replace image by the result, it may be modified in place only if writable
+    virtual int process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline& pipeline) = 0;
+
+    bool accepts(TYPixFmt format) const;
+
+    const TYStageTiming& timing() const { return _timing; }
+    uint64_t allocations() const { return _timing.allocations; }
+    uint64_t lastAllocations() const { return _timing.last_allocations; }
+
+  protected:
+    //output image for process(), recycled from earlier frames when possible
+    std::shared_ptr<TYImage> allocImage(int32_t width, int32_t height, TY_COMPONENT_ID compID, TYPixFmt format, int32_t size) {
+      return _pool.acquire(width, height, compID, format, size);
+    }
+
+  private:
+    friend class TYPipeline;
+    std::string   _name;
+    TYStageTiming _timing;
+    TYImagePool   _pool;
+};
+
+/*
+ * Chains of nodes per component, run on the images of a frame.
+ * A chain whose node depends on another component runs after that component's
+ * chain, so a register node on the color chain sees the filtered depth.
+ * Frame images are shared with the frame, the first node that modifies one
+ * allocates, every later in place node reuses that buffer.
+ */
+class TYPipeline
+{
+  public:
+    //append a node to the chain of comp
+    TYPipeline& add(TY_COMPONENT_ID comp, const std::shared_ptr<TYPipelineNode>& node);
+
+    //check every chain against the formats its component delivers
+    bool validate(const std::map<TY_COMPONENT_ID, TYPixFmt>& inputs) const;
+
+    int run(const std::shared_ptr<TYFrame>& frame);
+    //run a single chain, for components handled without a frame
+    int run(TY_COMPONENT_ID comp, const std::shared_ptr<TYImage>& image);
+
+    //last output of the chain of comp, or its last input if comp has no chain
+    std::shared_ptr<TYImage> result(TY_COMPONENT_ID comp) const;
+
+    //wall time and TYImage allocations of every node
+    void report(std::ostream& os) const;
+
+  private:
+    struct Chain {
+      TY_COMPONENT_ID comp;
+      std::vector<std::shared_ptr<TYPipelineNode>> nodes;
+    };
+    std::vector<Chain> _chains;
+    std::map<TY_COMPONENT_ID, std::shared_ptr<TYImage>> _results;
+
+    int runChain(Chain& chain, std::shared_ptr<TYImage> image);
+};
+
+//frame image to Mono8/Mono16/BGR8/Coord3D_C16, formats already there pass without copy
+//jpeg_scale 2, 4 or 8 decodes jpeg frames at that fraction of their size
+//with a pool YUV and packed bayer frames are converted in bands on it, else on the calling thread;
+//a pool runs one conversion at a time, share it only among nodes run from one thread
+class TYDecodeNode : public TYPipelineNode
+{
+  public:
+    TYDecodeNode(int jpeg_scale = 1, const std::shared_ptr<TYMapperWorkerPool>& pool = std::shared_ptr<TYMapperWorkerPool>())
+      : TYPipelineNode("decode"), _jpeg_scale(jpeg_scale), _workers(pool) {}
+    TYPixFmt outputFormat(TYPixFmt input) const;
+    int process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline& pipeline);
+  private:
+    int           _jpeg_scale;
+    TYJpegDecoder _jpeg;
+    std::shared_ptr<TYMapperWorkerPool> _workers;
+};
+
+class TYUndistortNode : public TYPipelineNode
+{
+  public:
+    TYUndistortNode(const TY_CAMERA_CALIB_INFO& calib) : TYPipelineNode("undistort"), _calib(calib) {}
+    std::vector<TYPixFmt> inputFormats() const;
+    int process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline& pipeline);
+  private:
+    TY_CAMERA_CALIB_INFO _calib;
+};
+
+//TYDepthSpeckleFilter on depth
+class TYSpeckleFilterNode : public TYPipelineNode
+{
+  public:
+    TYSpeckleFilterNode(int max_speckle_size = 150, int max_speckle_diff = 64);
+    std::vector<TYPixFmt> inputFormats() const;
+    bool inPlace(TYPixFmt) const { return true; }
+    int process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline& pipeline);
+  private:
+    DepthSpeckleFilterParameters _param;
+};
+
+//IR enhancement, stretch the range of the central area to 0..255
+class TYLinearStretchNode : public TYPipelineNode
+{
+  public:
+    TYLinearStretchNode(double ratio_cut = 0.1) : TYPipelineNode("enhance"), _ratio_cut(ratio_cut) {}
+    std::vector<TYPixFmt> inputFormats() const;
+    TYPixFmt outputFormat(TYPixFmt) const { return TYPixelFormatMono8; }
+    bool inPlace(TYPixFmt input) const { return input == TYPixelFormatMono8; }
+    int process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline& pipeline);
+  private:
+    double _ratio_cut;
+};
+
+//map a color chain image to the depth image of depth_comp, through a TYRegistrationContext
+class TYRegisterNode : public TYPipelineNode
+{
+  public:
+    TYRegisterNode(const TY_CAMERA_CALIB_INFO& depth_calib, const TY_CAMERA_CALIB_INFO& color_calib,
+                   float f_scale_unit = 1.f, TY_COMPONENT_ID depth_comp = TY_COMPONENT_DEPTH_CAM);
+    ~TYRegisterNode();
+    std::vector<TYPixFmt> inputFormats() const;
+    TY_COMPONENT_ID dependency() const { return _depth_comp; }
+    int process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline& pipeline);
+  private:
+    TY_CAMERA_CALIB_INFO   _depth_calib;
+    TY_CAMERA_CALIB_INFO   _color_calib;
+    float                  _f_scale_unit;
+    TY_COMPONENT_ID        _depth_comp;
+    TYRegistrationContext* _ctx = nullptr;
+};
+
+//depth to a BGR color map, needs OpenCV
+class TYRenderNode : public TYPipelineNode
+{
+  public:
+    TYRenderNode() : TYPipelineNode("render") {}
+    std::vector<TYPixFmt> inputFormats() const;
+    TYPixFmt outputFormat(TYPixFmt) const { return TYPixelFormatBGR8; }
+    int process(std::shared_ptr<TYImage>& image, bool writable, const TYPipeline& pipeline);
+#ifdef OPENCV_DEPENDENCIES
+  private:
+    DepthRender _render;
+#endif
+};
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "Device.hpp"
+
+namespace percipio_layer {
+
+/*
+ * Frame recording file, little endian:
+ *   TYRecordHeader, then chunks of TYRecordChunk followed by size bytes
+ *   TYRecordChunkCalib       uint32_t component id + TY_CAMERA_CALIB_INFO
+ *   TYRecordChunkScaleUnit   float depth scale unit
+ *   TYRecordChunkFrame       TYRecordFrame, count TYRecordImage, the image payloads back to back
+ *   TYRecordChunkSession     no data, written by every TYFrameRecorder::open(), host_time
+ *                            of the frames after it restarts from 0
+ * Chunks are only ever appended, a file cut short by a crash loses its last chunk.
+ */
+#define TY_RECORD_MAGIC    "TYRF"
+#define TY_RECORD_VERSION  (1)
+
+enum TYRecordChunkType {
+    TYRecordChunkCalib = 1,
+    TYRecordChunkScaleUnit = 2,
+    TYRecordChunkFrame = 3,
+    TYRecordChunkSession = 4,
+};
+
+struct TYRecordHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t reserved[2];
+};
+
+struct TYRecordChunk {
+    uint32_t type;
+    uint32_t size;
+};
+
+struct TYRecordFrame {
+    uint64_t host_time;     //us since the recording session started
+    uint32_t count;         //images in the frame
+    uint32_t reserved;
+};
+
+//TY_IMAGE_DATA with the buffer as an offset into the frame payload
+struct TYRecordImage {
+    uint64_t timestamp;
+    uint64_t offset;
+    int32_t  imageIndex;
+    int32_t  status;
+    uint32_t componentID;
+    int32_t  size;
+    int32_t  width;
+    int32_t  height;
+    uint32_t pixelFormat;
+    uint32_t reserved;
+};
+
+/*
+ * Appends frames to a recording file.
+ * A frame is written with one gather write straight from its image buffers,
+ * with zero copy frames that is the driver buffer itself. In async mode a
+ * writer thread does the writing, frames waiting for it keep their buffers
+ * and the oldest is dropped when queue_size frames wait.
+ */
+class TYFrameRecorder
+{
+  public:
+    TYFrameRecorder();
+    ~TYFrameRecorder();
+    TYFrameRecorder(TYFrameRecorder const&) = delete;
+    void operator=(TYFrameRecorder const&) = delete;
+
+    //creates path or appends a session to a recording already there
+    TY_STATUS open(const char* path, bool async = true, uint32_t queue_size = 8);
+    //writes every queued frame before closing
+    void close();
+    bool isOpen() const { return _fd >= 0; }
+
+    TY_STATUS writeCalibration(TY_COMPONENT_ID comp, const TY_CAMERA_CALIB_INFO& calib);
+    TY_STATUS writeScaleUnit(float scale_unit);
+    //calibration of every image component and the depth scale unit of an opened camera
+    TY_STATUS writeDeviceInfo(FastCamera& camera);
+
+    TY_STATUS write(const std::shared_ptr<TYFrame>& frame);
+
+    uint64_t frames() const { return _frames; }
+    uint64_t bytes() const { return _bytes; }
+    uint64_t dropped() const { return _queue ? _queue->dropped() : 0; }
+
+  private:
+    int                   _fd;
+    std::mutex            _write_lock;
+    std::atomic<uint64_t> _frames;
+    std::atomic<uint64_t> _bytes;
+    std::chrono::steady_clock::time_point _start;
+
+    std::shared_ptr<TYRingQueue<std::pair<std::shared_ptr<TYFrame>, uint64_t>>> _queue;
+    std::mutex            _push_lock;   //the ring takes one producer
+    std::atomic<bool>     _writing;
+    std::thread           _writer;
+
+    TY_STATUS writeChunk(uint32_t type, const void* data, uint32_t size);
+    TY_STATUS writeFrame(const std::shared_ptr<TYFrame>& frame, uint64_t host_time);
+    TY_STATUS writeAll(std::vector<std::pair<const void*, size_t>>& parts);
+    void writerLoop();
+};
+
+enum TYReplayRate {
+    TYReplayRateRecorded = 0,   //frame spacing of the recording, scaled by speed
+    TYReplayRateFixed = 1,      //fps frames per second
+    TYReplayRateMax = 2,        //as fast as the consumer fetches
+};
+
+/*
+ * Plays a recording back as a FastCamera.
+ * open() takes the file path instead of a serial number, the rest of the
+ * camera interface works the same: streams, tryGetFrames(), frame callbacks
+ * and TYMultiDeviceScheduler::addCamera(). Frames own their buffer, no device
+ * is involved. Sessions appended to one file play back to back, each one
+ * starting a frame interval after the last frame of the one before.
+ */
+class TYReplayCamera : public FastCamera
+{
+  public:
+    TYReplayCamera() {}
+    TYReplayCamera(const char* path) { open(path); }
+    ~TYReplayCamera();
+
+    TY_STATUS open(const char* path);
+    TY_STATUS openByIP(const char*) { return TY_STATUS_NOT_PERMITTED; }
+    bool has_stream(stream_idx idx);
+    TY_STATUS stream_enable(stream_idx idx);
+    TY_STATUS stream_disable(stream_idx idx);
+
+    TY_STATUS start();
+    TY_STATUS stop();
+    void close();
+
+    //takes effect on start()
+    void setRate(TYReplayRate rate, double value = 1.0) { _rate = rate; _rate_value = value; }
+    void setLoop(bool loop) { _loop = loop; }
+
+    uint32_t frameCount() const { return static_cast<uint32_t>(_index.size()); }
+    bool     finished() const { return _finished; }
+    bool     calibration(TY_COMPONENT_ID comp, TY_CAMERA_CALIB_INFO& calib) const;
+    float    scaleUnit() const { return _scale_unit; }
+
+  private:
+    struct FrameEntry {
+      uint64_t offset;        //of the TYRecordFrame
+      uint32_t size;          //chunk size
+      uint64_t host_time;     //us since the first session started
+    };
+
+    std::string                        _path;
+    std::ifstream                      _file;
+    std::vector<FrameEntry>            _index;
+    std::map<TY_COMPONENT_ID, TY_CAMERA_CALIB_INFO> _calib;
+    float                              _scale_unit = 1.f;
+    TY_COMPONENT_ID                    _recorded = 0;
+    TY_COMPONENT_ID                    _enabled = 0;
+
+    TYReplayRate _rate = TYReplayRateRecorded;
+    double       _rate_value = 1.0;
+    bool         _loop = false;
+
+    size_t       _next = 0;
+    uint64_t     _played = 0;
+    std::atomic<bool> _finished{false};
+    std::chrono::steady_clock::time_point _start;
+
+    std::shared_ptr<TYFrame> fetchFrames(uint32_t timeout_ms, bool quiet_timeout = false);
+    std::shared_ptr<TYFrame> readFrame(const FrameEntry& entry);
+    std::chrono::steady_clock::time_point dueTime(size_t pos) const;
+    std::string sourceName() { return _file.is_open() ? _path : std::string(); }
+};
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <stdint.h>
+
+namespace percipio_layer {
+
+/*
+ * Bounded lock free ring, one producer and any number of consumers.
+ * Every slot carries a sequence number telling whose turn it is, so a slot is
+ * only touched by the thread that won it and items may be any movable type.
+ * With overwrite enabled a full ring drops its oldest item, the producer pops
+ * it like one more consumer. Consumers that find the ring empty can sleep on a
+ * condition variable, the producer only takes the mutex while someone waits.
+ * A slot tells a full from a free one by the lap, so there are at least two.
+ */
+template<class T>
+class TYRingQueue
+{
+  public:
+    TYRingQueue(uint32_t capacity, bool overwrite = true) :
+      _capacity(capacity ? capacity : 1),
+      _overwrite(overwrite),
+      _slots(std::max<uint32_t>(_capacity, 2)),
+      _head(0),
+      _tail(0),
+      _dropped(0),
+      _waiters(0),
+      _closed(false)
+    {
+      for(uint32_t i = 0; i < _slots.size(); i++) _slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    TYRingQueue(TYRingQueue const&) = delete;
+    void operator=(TYRingQueue const&) = delete;
+
+    //producer only, false if the ring is full and overwrite is off
+    bool push(T item)
+    {
+      for(;;) {
+        uint64_t pos = _tail.load(std::memory_order_relaxed);
+        Slot& slot = _slots[pos % _slots.size()];
+        //a one item ring has a spare slot, the distance to the head keeps it to one item
+        bool room = _slots.size() == _capacity || pos - _head.load(std::memory_order_acquire) < _capacity;
+        if(room && slot.seq.load(std::memory_order_acquire) == pos) {
+          slot.item = std::move(item);
+          slot.seq.store(pos + 1, std::memory_order_release);
+          _tail.store(pos + 1, std::memory_order_relaxed);
+          break;
+        }
+        //the slot still holds the item from one lap ago
+        if(!_overwrite) return false;
+        T oldest;
+        if(tryPop(oldest)) _dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      //pairs with the waiter count taken before a consumer checks the ring again
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(_waiters.load() > 0) {
+        std::unique_lock<std::mutex> lock(_lock);
+        _cond.notify_one();
+      }
+      return true;
+    }
+
+    bool tryPop(T& item)
+    {
+      uint64_t pos = _head.load(std::memory_order_relaxed);
+      for(;;) {
+        Slot& slot = _slots[pos % _slots.size()];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if(seq == pos + 1) {
+          if(_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            item = std::move(slot.item);
+            slot.item = T();
+            slot.seq.store(pos + _slots.size(), std::memory_order_release);
+            return true;
+          }
+        } else if(seq < pos + 1) {
+          return false;
+        } else {
+          pos = _head.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    //wait up to timeout_ms for an item, false on timeout or once closed and drained
+    bool pop(T& item, uint32_t timeout_ms)
+    {
+      if(tryPop(item)) return true;
+
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+      std::unique_lock<std::mutex> lock(_lock);
+      _waiters++;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      bool ok = false;
+      for(;;) {
+        if(tryPop(item)) {
+          ok = true;
+          break;
+        }
+        if(_closed || _cond.wait_until(lock, deadline) == std::cv_status::timeout) {
+          ok = tryPop(item);
+          break;
+        }
+      }
+      _waiters--;
+      return ok;
+    }
+
+    //wake every waiting consumer for shutdown
+    void close()
+    {
+      std::unique_lock<std::mutex> lock(_lock);
+      _closed = true;
+      _cond.notify_all();
+    }
+
+    void clear()
+    {
+      T item;
+      while(tryPop(item)) {}
+    }
+
+    uint32_t capacity() const { return _capacity; }
+    uint32_t size() const
+    {
+      uint64_t head = _head.load(std::memory_order_relaxed);
+      uint64_t tail = _tail.load(std::memory_order_relaxed);
+      return tail > head ? static_cast<uint32_t>(tail - head) : 0;
+    }
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+  private:
+    struct Slot {
+      std::atomic<uint64_t> seq;
+      T item;
+    };
+
+    const uint32_t   _capacity;
+    const bool       _overwrite;
+    std::vector<Slot> _slots;
+
+    std::atomic<uint64_t> _head;
+    std::atomic<uint64_t> _tail;
+    std::atomic<uint64_t> _dropped;
+
+    std::mutex              _lock;
+    std::condition_variable _cond;
+    std::atomic<int>        _waiters;
+    bool                    _closed;
+};
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Device.hpp"
+
+namespace percipio_layer {
+
+//non blocking fetch, returns nothing when the device has no frame ready
+typedef std::function<std::shared_ptr<TYFrame>()>                        TYFramePoll;
+typedef std::function<void(int device, const std::shared_ptr<TYFrame>&)> TYDeviceFrameCallback;
+
+struct TYSchedulerConfig {
+    uint32_t workers = 0;          //threads of the shared callback pool, 0 sizes it by hardware
+    uint32_t pollers = 1;          //threads sweeping the devices, each serves every pollers-th device
+    uint32_t queue_size = 4;       //frames kept per device, the oldest is dropped when full
+    uint32_t max_idle_us = 1000;   //longest sleep between sweeps that found no frame
+};
+
+struct TYDeviceSchedStats {
+    std::string   name;
+    uint64_t      frames = 0;      //frames fetched from the device
+    uint64_t      dropped = 0;     //frames overwritten in the device queue before delivery
+    TYStageTiming latency;         //fetch to callback start, or to tryGetFrames
+};
+
+/*
+ * Fetches frames of many devices with a few threads.
+ * The SDK can only wait on one device at a time, so instead of one blocking
+ * thread per camera the pollers sweep all devices without waiting and sleep
+ * only when a whole sweep came back empty, backing off up to max_idle_us.
+ * A slow or silent camera costs one non blocking call per sweep and never
+ * holds back the others.
+ * Every device has its own queue. Devices with a callback are drained on a
+ * shared worker pool, one task per device at a time so frames of a device
+ * stay in order, devices without one are read with tryGetFrames().
+ */
+class TYMultiDeviceScheduler
+{
+  public:
+    TYMultiDeviceScheduler(const TYSchedulerConfig& config = TYSchedulerConfig());
+    ~TYMultiDeviceScheduler();
+    TYMultiDeviceScheduler(TYMultiDeviceScheduler const&) = delete;
+    void operator=(TYMultiDeviceScheduler const&) = delete;
+
+    //devices are added while stopped, returns the device index or -1
+    //the camera is started and stopped by the application
+    int addCamera(const std::shared_ptr<FastCamera>& camera, TYDeviceFrameCallback cb = TYDeviceFrameCallback());
+    int addSource(const std::string& name, TYFramePoll poll, TYDeviceFrameCallback cb = TYDeviceFrameCallback());
+
+    TY_STATUS start();
+    //stops polling and waits for queued callbacks
+    void stop();
+    bool isRunning() const { return running; }
+
+    //next queued frame of a device without callback
+    std::shared_ptr<TYFrame> tryGetFrames(int device, uint32_t timeout_ms);
+
+    int deviceCount() const { return static_cast<int>(devices.size()); }
+    std::vector<TYDeviceSchedStats> stats();
+
+  private:
+    struct Device {
+      Device(uint32_t queue_size) : queue(queue_size) {}
+      int                   index;
+      std::string           name;
+      TYFramePoll           poll;
+      TYDeviceFrameCallback cb;
+      TYRingQueue<std::pair<std::shared_ptr<TYFrame>, std::chrono::steady_clock::time_point>> queue;
+      std::mutex            lock;
+      bool                  scheduled = false;
+      uint64_t              frames = 0;
+      TYStageTiming         latency;
+    };
+
+    TYSchedulerConfig                    config;
+    std::vector<std::shared_ptr<Device>> devices;
+    std::vector<std::thread>             pollers;
+    std::shared_ptr<TYWorkerPool>        workers;
+    std::atomic<bool>                    running;
+
+    void pollLoop(uint32_t first);
+    void schedule(const std::shared_ptr<Device>& dev);
+    void drain(const std::shared_ptr<Device>& dev);
+    void recordLatency(Device& dev, const std::chrono::steady_clock::time_point& fetched);
+};
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Device.hpp"
+
+namespace percipio_layer {
+
+//frames of all cameras that belong to one trigger, missing cameras are null
+struct TYFrameSet {
+    uint64_t timestamp = 0;   //timestamp or imageIndex of the first frame of the set
+    uint32_t count = 0;       //cameras present
+    std::vector<std::shared_ptr<TYFrame>> frames;
+
+    bool complete() const { return count == frames.size(); }
+};
+
+typedef std::function<void(const std::shared_ptr<TYFrameSet>& set)> TYFrameSetCallback;
+
+enum TYSyncMatch {
+    //device timestamps, the devices have to share a clock (TY_ENUM_TIME_SYNC_TYPE)
+    TYSyncMatchTimestamp = 0,
+    //imageIndex, for devices counting the same trigger signal from the same start
+    TYSyncMatchImageIndex = 1,
+};
+
+struct TYSyncConfig {
+    uint32_t    cameras = 2;
+    TYSyncMatch match = TYSyncMatchTimestamp;
+    uint64_t    tolerance = 2000;       //largest distance inside a set, us or index steps
+    uint32_t    max_pending_sets = 8;   //sets waiting for frames, the oldest is evicted when full
+    bool        emit_incomplete = false; //deliver evicted sets with the frames they got
+};
+
+struct TYSyncStats {
+    uint64_t complete = 0;    //sets delivered with every camera
+    uint64_t incomplete = 0;  //sets closed with cameras missing
+    uint64_t evicted = 0;     //incomplete sets closed because max_pending_sets was reached
+    uint64_t late = 0;        //frames older than sets already closed, dropped
+    uint64_t overwritten = 0; //closed sets dropped unread, tryGetFrameSet() fell behind the ring
+    uint32_t pending = 0;     //sets waiting now
+};
+
+/*
+ * Groups the frames of several cameras by trigger.
+ * Open sets are kept in a map ordered by their key, a frame finds its set with
+ * one lookup of the tolerance window, O(log n) in the open sets.
+ * Frames of one camera arrive in order, so a set is closed as incomplete as
+ * soon as every camera it misses has delivered a frame past its window.
+ * At most max_pending_sets are open, a zero copy frame held here keeps its
+ * driver buffer.
+ * Sets are handed to the callback, or queued for tryGetFrameSet() without one,
+ * in the order they close. That queue holds 2 * max_pending_sets, a full queue
+ * drops its oldest set.
+ */
+class TYFrameSynchronizer
+{
+  public:
+    TYFrameSynchronizer(const TYSyncConfig& config, TYFrameSetCallback cb = TYFrameSetCallback());
+    TYFrameSynchronizer(TYFrameSynchronizer const&) = delete;
+    void operator=(TYFrameSynchronizer const&) = delete;
+
+    //thread safe, cameras may push from their own threads
+    int push(uint32_t camera, const std::shared_ptr<TYFrame>& frame);
+
+    //feed the frames of a stopped camera through its frame callback
+    TY_STATUS attach(uint32_t camera, FastCamera& cam);
+
+    //close every open set, at the end of a stream
+    void flush();
+
+    std::shared_ptr<TYFrameSet> tryGetFrameSet(uint32_t timeout_ms);
+
+    const TYSyncConfig& config() const { return _config; }
+    TYSyncStats stats();
+
+  private:
+    typedef std::multimap<uint64_t, std::shared_ptr<TYFrameSet>> set_map;
+
+    TYSyncConfig        _config;
+    TYFrameSetCallback  _cb;
+
+    std::mutex          _lock;
+    set_map             _sets;
+    std::vector<uint64_t> _last_key;    //newest key per camera
+    std::vector<bool>   _seen;
+    uint64_t            _closed_key = 0; //newest key of a closed set
+    bool                _any_closed = false;
+    TYSyncStats         _stats;
+
+    //sets are delivered in the order they close, one thread at a time
+    std::mutex          _emit_lock;
+    TYRingQueue<std::shared_ptr<TYFrameSet>> _ready;
+
+    uint64_t frameKey(const std::shared_ptr<TYFrame>& frame) const;
+    bool     isDead(const TYFrameSet& set) const;
+    void     close(set_map::iterator it, bool evicted, std::vector<std::shared_ptr<TYFrameSet>>& out);
+    void     deliver(std::unique_lock<std::mutex>& lock, std::vector<std::shared_ptr<TYFrameSet>>& out);
+};
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <stdint.h>
+
+namespace percipio_layer {
+
+/*
+ * Fixed set of worker threads for per frame work.
+ * run() hands out a batch of tasks and returns once all of them are done, the
+ * calling thread works on the batch too instead of sleeping.
+ */
+class TYWorkerPool
+{
+  public:
+    //0 threads: one less than the hardware threads, the caller is the last one
+    TYWorkerPool(uint32_t threads = 0)
+    {
+      if(threads == 0) {
+        uint32_t hw = std::thread::hardware_concurrency();
+        threads = hw > 1 ? hw - 1 : 1;
+      }
+      for(uint32_t i = 0; i < threads; i++) {
+        _workers.push_back(std::thread(&TYWorkerPool::workerLoop, this));
+      }
+    }
+
+    ~TYWorkerPool()
+    {
+      {
+        std::unique_lock<std::mutex> lock(_lock);
+        _stop = true;
+        _task_cond.notify_all();
+      }
+      for(auto& worker : _workers) worker.join();
+    }
+
+    TYWorkerPool(TYWorkerPool const&) = delete;
+    void operator=(TYWorkerPool const&) = delete;
+
+    uint32_t size() const { return static_cast<uint32_t>(_workers.size()); }
+
+    //queue a task without waiting for it
+    void post(std::function<void()> task)
+    {
+      std::unique_lock<std::mutex> lock(_lock);
+      _tasks.push_back(std::move(task));
+      _task_cond.notify_one();
+    }
+
+    void run(const std::vector<std::function<void()>>& tasks)
+    {
+      if(tasks.empty()) return;
+
+      size_t pending = tasks.size();
+      std::condition_variable done_cond;
+      {
+        std::unique_lock<std::mutex> lock(_lock);
+        for(size_t i = 0; i < tasks.size(); i++) {
+          const std::function<void()>* task = &tasks[i];
+          _tasks.push_back([this, task, &pending, &done_cond]() {
+            (*task)();
+            std::unique_lock<std::mutex> lock(_lock);
+            if(--pending == 0) done_cond.notify_all();
+          });
+        }
+        _task_cond.notify_all();
+      }
+
+      std::unique_lock<std::mutex> lock(_lock);
+      while(pending) {
+        if(!_tasks.empty()) {
+          std::function<void()> task = std::move(_tasks.front());
+          _tasks.pop_front();
+          lock.unlock();
+          task();
+          lock.lock();
+        } else {
+          done_cond.wait(lock);
+        }
+      }
+    }
+
+  private:
+    std::mutex                        _lock;
+    std::condition_variable           _task_cond;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread>          _workers;
+    bool                              _stop = false;
+
+    void workerLoop()
+    {
+      std::unique_lock<std::mutex> lock(_lock);
+      for(;;) {
+        _task_cond.wait(lock, [this] { return _stop || !_tasks.empty(); });
+        if(_tasks.empty()) return;
+        std::function<void()> task = std::move(_tasks.front());
+        _tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+      }
+    }
+};
+
+}
@@ -0,0 +1,71 @@
+#include "Device.hpp"
+
+using namespace percipio_layer;
+
+int main(int argc, char* argv[])
+{
+    std::string ID;
+    uint32_t workers = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-id") == 0) {
+            ID = argv[++i];
+        } else if(strcmp(argv[i], "-workers") == 0) {
+            workers = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            std::cout << "Usage: " << argv[0] << "   [-h] [-id <ID>] [-workers <N>]" << std::endl;
+            return 0;
+        }
+    }
+
+    FastCamera camera;
+    if(TY_STATUS_OK != camera.open(ID.c_str())) {
+        std::cout << "open camera failed!" << std::endl;
+        return -1;
+    }
+
+    bool process_exit = false;
+
+    TYFrameParser parser;
+    parser.RegisterKeyBoardEventCallback([](int key, void* data) {
+        if(key == 'q' || key == 'Q') {
+            *(bool*)data = true;
+            std::cout << "Exit..." << std::endl; 
+        }
+    }, &process_exit);
+
+    if(TY_STATUS_OK != camera.stream_enable(FastCamera::stream_depth)) {
+        std::cout << "depth stream enable failed!" << std::endl;
+        return -1;
+    }
+
+    //frames are pushed from the camera fetch thread, no polling loop needed
+    TYFrameDeliveryConfig delivery;
+    delivery.workers = workers;
+    camera.setFrameDelivery(delivery);
+    camera.registerFrameCallback("display", [&parser](const std::shared_ptr<TYFrame>& frame) {
+        parser.update(frame);
+    });
+
+    if(TY_STATUS_OK != camera.start()) {
+        std::cout << "stream start failed!" << std::endl;
+        return -1;
+    }
+
+    while(!process_exit) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    //returns once the callbacks are done with their last frame
+    camera.stop();
+
+    auto stats = camera.frameCallbackStats();
+    for(auto& iter : stats) {
+        std::cout << iter.first << ": " << iter.second.latency.count << " frames, latency avg "
+                  << iter.second.latency.average_ms() << " ms max " << iter.second.latency.max_ms << " ms ("
+                  << (iter.second.device_clock ? "device timestamp" : "fetch time") << "), skipped "
+                  << iter.second.skipped << std::endl;
+    }
+
+    std::cout << "Main done!" << std::endl;
+    return 0;
+}
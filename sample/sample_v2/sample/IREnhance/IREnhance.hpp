@@ -49,16 +49,16 @@ public:
         cv::Mat grayIR = cv::Mat(_image->height(), _image->width(),
             type_ir, _image->buffer());
         TY_COMPONENT_ID comp_id = _image->componentID();
-        cv::Mat result;
         if ((type_ir == CV_16UC1) || (type_ir == CV_8UC1)) {
             double minVal, maxVal;
             int rows = grayIR.rows, cols = grayIR.cols;
             double ratiocut = 0.1;
             cv::Rect roi = cv::Rect(int(cols * ratiocut), int(rows * ratiocut), int(cols - cols * ratiocut * 2), int(rows - rows * ratiocut * 2));
             cv::minMaxLoc(grayIR(roi), &minVal, &maxVal);
+            std::shared_ptr<TYImage> dst = allocImage(cols, rows, comp_id, TYPixelFormatMono8, rows * cols);
+            cv::Mat result(rows, cols, CV_8UC1, dst->buffer());
             grayIR.convertTo(result, CV_8UC1, 255.0 / (maxVal - minVal), -minVal * 255.0 / (maxVal - minVal));
-            _image = std::shared_ptr<TYImage>(new TYImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, result.size().area()));
-            memcpy(_image->buffer(), result.data, result.size().area());
+            _image = dst;
         }
         else {
             LOGD("linearStretch support CV_8UC1 or CV_16UC1 gray,not support others type,please check grayIR type");
@@ -87,16 +87,15 @@ public:
         }
         cv::Mat grayIR = cv::Mat(_image->height(), _image->width(),
             type_ir, _image->buffer());
-        cv::Mat result;
         if (type_ir == CV_16UC1) {
+            std::shared_ptr<TYImage> dst = allocImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, grayIR.cols * grayIR.rows);
+            cv::Mat result(grayIR.rows, grayIR.cols, CV_8UC1, dst->buffer());
             grayIR.convertTo(result, CV_8UC1, multi_expandratio / 255.0);
-            _image = std::shared_ptr<TYImage>(new TYImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, result.size().area()));
-            memcpy(_image->buffer(), result.data, result.size().area());
+            _image = dst;
         }
         else if (type_ir == CV_8UC1) {
-            grayIR.convertTo(result, CV_8UC1, multi_expandratio);
-            //image size not changed, use org buffer and _image
-            memcpy(_image->buffer(), result.data, _image->size());
+            //image size not changed, scale the org buffer of _image in place
+            grayIR.convertTo(grayIR, CV_8UC1, multi_expandratio);
         }
         else {
             LOGD("linearStretch_multi support CV_8UC1 or CV_16UC1 gray,not support others type,please check grayIR type");
@@ -127,8 +126,6 @@ public:
         }
         cv::Mat grayIR = cv::Mat(_image->height(), _image->width(),
             type_ir, _image->buffer());
-        cv::Mat result;
-
         cv::Mat meanvalue, stdvalue;
         cv::meanStdDev(grayIR, meanvalue, stdvalue);
 
@@ -137,9 +134,10 @@ public:
         if ((type_ir == CV_16UC1) || (type_ir == CV_8UC1)) {
             double minVal, maxVal;
             cv::minMaxLoc(grayIR, &minVal, &maxVal);
+            std::shared_ptr<TYImage> dst = allocImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, grayIR.cols * grayIR.rows);
+            cv::Mat result(grayIR.rows, grayIR.cols, CV_8UC1, dst->buffer());
             grayIR.convertTo(result, CV_8UC1, 255.0 / use_norm);
-            _image = std::shared_ptr<TYImage>(new TYImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, result.size().area()));
-            memcpy(_image->buffer(), result.data, result.size().area());
+            _image = dst;
         }
         else {
             LOGD("GrayIR_linearStretch_std support CV_8UC1 or CV_16UC1 gray,not support others type,please check grayIR type");
@@ -171,11 +169,11 @@ public:
         }
         cv::Mat grayIR = cv::Mat(_image->height(), _image->width(),
             type_ir, _image->buffer());
-        cv::Mat result;
-        
         int rows = grayIR.rows;
         int cols = grayIR.cols;
-        result = cv::Mat::zeros(rows, cols, CV_8UC1);
+        //every pixel is written below, a recycled buffer needs no clearing
+        std::shared_ptr<TYImage> dst = allocImage(cols, rows, comp_id, TYPixelFormatMono8, rows * cols);
+        cv::Mat result(rows, cols, CV_8UC1, dst->buffer());
         if (type_ir == CV_16UC1) {
 
             for (int i = 0; i < rows; i++) {
@@ -206,8 +204,7 @@ public:
             LOGD("GrayIR_linearStretch_std support CV_8UC1 or CV_16UC1 gray,not support others type,please check grayIR type");
             return -1;
         }
-        _image = std::shared_ptr<TYImage>(new TYImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, result.size().area()));
-        memcpy(_image->buffer(), result.data, result.size().area());
+        _image = dst;
         return 0;
     }
     double log_expandratio = 6;
@@ -228,7 +225,8 @@ public:
         cv::Mat grayIR = cv::Mat(_image->height(), _image->width(),
             type_ir, _image->buffer());
         TY_COMPONENT_ID comp_id = _image->componentID();
-        cv::Mat result;
+        std::shared_ptr<TYImage> dst = allocImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, grayIR.cols * grayIR.rows);
+        cv::Mat result(grayIR.rows, grayIR.cols, CV_8UC1, dst->buffer());
 
         if (type_ir == CV_16UC1) {
             //This process will change type to CV_8UC1
@@ -244,8 +242,7 @@ public:
             LOGD("GrayIR_linearStretch_std support CV_8UC1 or CV_16UC1 gray,not support others type,please check grayIR type");
             return -1;
         }
-        _image = std::shared_ptr<TYImage>(new TYImage(grayIR.cols, grayIR.rows, comp_id, TYPixelFormatMono8, result.size().area()));
-        memcpy(_image->buffer(), result.data, result.size().area());
+        _image = dst;
         return 0;
     }
 };
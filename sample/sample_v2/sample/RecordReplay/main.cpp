@@ -0,0 +1,132 @@
+#include "Recorder.hpp"
+
+using namespace percipio_layer;
+
+static int record(const std::string& ID, const std::string& path)
+{
+    FastCamera camera;
+    if(TY_STATUS_OK != camera.open(ID.c_str())) {
+        std::cout << "open camera failed!" << std::endl;
+        return -1;
+    }
+
+    TYFrameRecorder recorder;
+    if(TY_STATUS_OK != recorder.open(path.c_str())) {
+        return -1;
+    }
+    //calibration and scale unit go first, a replay can parse the depth without the device
+    recorder.writeDeviceInfo(camera);
+
+    if(TY_STATUS_OK != camera.stream_enable(FastCamera::stream_depth)) {
+        std::cout << "depth stream enable failed!" << std::endl;
+        return -1;
+    }
+    if(camera.has_stream(FastCamera::stream_color)) {
+        camera.stream_enable(FastCamera::stream_color);
+    }
+
+    bool process_exit = false;
+    TYFrameParser parser;
+    parser.RegisterKeyBoardEventCallback([](int key, void* data) {
+        if(key == 'q' || key == 'Q') {
+            *(bool*)data = true;
+            std::cout << "Exit..." << std::endl; 
+        }
+    }, &process_exit);
+
+    //the recorder queues the frame for its writer thread and returns
+    camera.registerFrameCallback("record", [&recorder, &parser](const std::shared_ptr<TYFrame>& frame) {
+        recorder.write(frame);
+        parser.update(frame);
+    });
+
+    if(TY_STATUS_OK != camera.start()) {
+        std::cout << "stream start failed!" << std::endl;
+        return -1;
+    }
+
+    while(!process_exit) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    camera.stop();
+    recorder.close();
+    std::cout << path << ": " << recorder.frames() << " frames, " << recorder.bytes() << " bytes, dropped "
+              << recorder.dropped() << std::endl;
+    return 0;
+}
+
+static int replay(const std::string& path, TYReplayRate rate, double value, bool loop)
+{
+    TYReplayCamera camera;
+    if(TY_STATUS_OK != camera.open(path.c_str())) {
+        std::cout << "open record file failed!" << std::endl;
+        return -1;
+    }
+    camera.setRate(rate, value);
+    camera.setLoop(loop);
+
+    bool process_exit = false;
+    TYFrameParser parser;
+    parser.RegisterKeyBoardEventCallback([](int key, void* data) {
+        if(key == 'q' || key == 'Q') {
+            *(bool*)data = true;
+            std::cout << "Exit..." << std::endl; 
+        }
+    }, &process_exit);
+
+    if(TY_STATUS_OK != camera.start()) {
+        std::cout << "replay start failed!" << std::endl;
+        return -1;
+    }
+
+    uint32_t frames = 0;
+    auto start = std::chrono::steady_clock::now();
+    while(!process_exit && !camera.finished()) {
+        auto frame = camera.tryGetFrames(100);
+        if(!frame) continue;
+        parser.update(frame);
+        frames++;
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    camera.stop();
+
+    std::cout << "replayed " << frames << " frames in " << s << " s" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string ID, record_path, replay_path;
+    TYReplayRate rate = TYReplayRateRecorded;
+    double value = 1.0;
+    bool loop = false;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-id") == 0) {
+            ID = argv[++i];
+        } else if(strcmp(argv[i], "-record") == 0) {
+            record_path = argv[++i];
+        } else if(strcmp(argv[i], "-replay") == 0) {
+            replay_path = argv[++i];
+        } else if(strcmp(argv[i], "-speed") == 0) {
+            rate = TYReplayRateRecorded;
+            value = atof(argv[++i]);
+        } else if(strcmp(argv[i], "-fps") == 0) {
+            rate = TYReplayRateFixed;
+            value = atof(argv[++i]);
+        } else if(strcmp(argv[i], "-max") == 0) {
+            rate = TYReplayRateMax;
+        } else if(strcmp(argv[i], "-loop") == 0) {
+            loop = true;
+        } else if(strcmp(argv[i], "-h") == 0) {
+            std::cout << "Usage: " << argv[0] << "   [-h] [-id <ID>] -record <file>" << std::endl;
+            std::cout << "       " << argv[0] << "   [-h] -replay <file> [-speed <x> | -fps <N> | -max] [-loop]" << std::endl;
+            return 0;
+        }
+    }
+
+    if(!replay_path.empty()) return replay(replay_path, rate, value, loop);
+    if(!record_path.empty()) return record(ID, record_path);
+    std::cout << "-record or -replay required, -h for usage" << std::endl;
+    return -1;
+}